@@ -16,6 +16,7 @@ HierarchyUI::HierarchyUI(Scene*  /*scene*/, Renderer* renderer, MaterialSystem*
     renderer->AddDebugUIWindow(&m_propertiesWindow);
 
     Application::GetInstance()->GetEventHandler()->Subscribe(this, &HierarchyUI::OnEntityCreated);
+    Application::GetInstance()->GetEventHandler()->Subscribe(this, &HierarchyUI::OnEntitiesCreated);
 
     HierarchyUI::RegisterPropertyDrawFunction<Transform>(
         [](void* component, DebugUIWindow* window)
@@ -60,8 +61,18 @@ HierarchyUI::HierarchyUI(Scene*  /*scene*/, Renderer* renderer, MaterialSystem*
 
 void HierarchyUI::OnEntityCreated(EntityCreated event)
 {
-    auto node     = std::make_shared<TreeNode>(event.entity.GetName());
-    Entity entity = event.entity;
+    AddEntityNode(event.entity);
+}
+
+void HierarchyUI::OnEntitiesCreated(EntitiesCreated event)
+{
+    for(const Entity& entity : event.entities)
+        AddEntityNode(entity);
+}
+
+void HierarchyUI::AddEntityNode(const Entity& entity)
+{
+    auto node = std::make_shared<TreeNode>(entity.GetName());
     node->RegisterCallback(
         [this, entity](TreeNode* node)
         {
@@ -70,15 +81,15 @@ void HierarchyUI::OnEntityCreated(EntityCreated event)
             node->SetIsSelected(true);
         });
 
-    if(event.entity.GetParent() == Entity::INVALID_ENTITY)
+    if(entity.GetParent() == Entity::INVALID_ENTITY)
     {
         m_hierarchyWindow.AddElement(node);
-        m_hierarchyTree[event.entity] = node;
+        m_hierarchyTree[entity] = node;
     }
     else
     {
-        m_hierarchyTree[event.entity.GetParent()]->AddElement(node);
-        m_hierarchyTree[event.entity] = node;
+        m_hierarchyTree[entity.GetParent()]->AddElement(node);
+        m_hierarchyTree[entity] = node;
     }
 }
 
@@ -16,6 +16,7 @@ public:
 
 
     void OnEntityCreated(EntityCreated event);
+    void OnEntitiesCreated(EntitiesCreated event);
 
     template<typename T>
     static void RegisterPropertyDrawFunction(PropertyDrawFunction func)
@@ -24,6 +25,7 @@ public:
     }
 
 private:
+    void AddEntityNode(const Entity& entity);
     void EntitySelectedCallback(Entity entity);
 
     template<typename T>
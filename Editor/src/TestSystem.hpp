@@ -32,7 +32,8 @@ public:
                     .term_at(2)
                     .singleton()
                     .each(FixedUpdate);
-            });
+            },
+            true);  // every light only moves its own transform
     }
 
     static void FixedUpdate(flecs::entity e, Transform& transform, const TestSystemContext& ctx)
@@ -0,0 +1,206 @@
+#include "BenchUtils.hpp"
+#include "Utils/Math/AABBTree.hpp"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+// times building, moving and querying an AABBTree of 100k proxies, the queries next to testing every box like without the tree
+namespace
+{
+constexpr uint32_t PROXY_COUNT = 100'000;
+constexpr uint32_t QUERY_COUNT = 1000;
+constexpr float WORLD_SIZE     = 2000.0f;
+constexpr uint32_t RUNS        = 5;
+
+struct Box
+{
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
+std::mt19937 g_random(1234);
+
+float RandomFloat(float min, float max)
+{
+    return std::uniform_real_distribution<float>(min, max)(g_random);
+}
+
+Box RandomBox()
+{
+    const glm::vec3 center(RandomFloat(0.0f, WORLD_SIZE), RandomFloat(0.0f, WORLD_SIZE * 0.1f), RandomFloat(0.0f, WORLD_SIZE));
+    const glm::vec3 halfSize(RandomFloat(0.1f, 5.0f), RandomFloat(0.1f, 5.0f), RandomFloat(0.1f, 5.0f));
+    return {center - halfSize, center + halfSize};
+}
+
+std::vector<Box> RandomBoxes(uint32_t count)
+{
+    std::vector<Box> boxes(count);
+    for(Box& box : boxes)
+        box = RandomBox();
+    return boxes;
+}
+
+AABBTree Build(const std::vector<Box>& boxes, std::vector<int32_t>& proxies)
+{
+    AABBTree tree;
+    proxies.resize(boxes.size());
+    for(uint32_t i = 0; i < boxes.size(); ++i)
+        proxies[i] = tree.CreateProxy(boxes[i].min, boxes[i].max, i);
+    return tree;
+}
+
+void BenchBuild(const std::vector<Box>& boxes)
+{
+    std::vector<int32_t> proxies;
+    int32_t height  = 0;
+    const double ms = BestOf(RUNS, [&]() { height = Build(boxes, proxies).GetHeight(); });
+    std::printf("  insert %u proxies: %.2f ms, %.0f ns per proxy, height %d\n", PROXY_COUNT, ms, ms * 1e6 / PROXY_COUNT, height);
+}
+
+// most objects move a little every frame and stay inside their fat box, a few move far enough to be reinserted
+void BenchMove(const std::vector<Box>& boxes, float bigMoveFraction)
+{
+    std::vector<int32_t> proxies;
+    AABBTree tree = Build(boxes, proxies);
+
+    std::vector<glm::vec3> offsets(boxes.size());
+    for(glm::vec3& offset : offsets)
+        offset = RandomFloat(0.0f, 1.0f) < bigMoveFraction ? glm::vec3(RandomFloat(-100.0f, 100.0f), 0.0f, RandomFloat(-100.0f, 100.0f)) : glm::vec3(0.01f);
+
+    // every run moves the boxes away and back so they don't drift out of the world
+    uint32_t reinserted = 0;
+    float direction     = 1.0f;
+    const double ms     = BestOf(RUNS, [&]() {
+        reinserted = 0;
+        for(uint32_t i = 0; i < boxes.size(); ++i)
+        {
+            const glm::vec3 offset = offsets[i] * direction;
+            reinserted += tree.MoveProxy(proxies[i], boxes[i].min + offset, boxes[i].max + offset) ? 1 : 0;
+        }
+        direction = direction > 0.0f ? 0.0f : 1.0f;
+    });
+    std::printf("  update %u proxies, %.0f%% moving far: %.2f ms, %u reinserted, height %d\n", PROXY_COUNT, bigMoveFraction * 100.0f, ms, reinserted, tree.GetHeight());
+}
+
+template<typename TreeQuery, typename BoxTest>
+void BenchQuery(const char* name, const std::vector<Box>& boxes, const AABBTree& tree, TreeQuery treeQuery, BoxTest boxTest)
+{
+    uint64_t treeFound  = 0;
+    const double treeMs = BestOf(RUNS, [&]() {
+        treeFound = 0;
+        for(uint32_t q = 0; q < QUERY_COUNT; ++q)
+            treeFound += treeQuery(q);
+    });
+
+    uint64_t bruteFound  = 0;
+    const double bruteMs = BestOf(1, [&]() {  // way slower, one run is enough
+        bruteFound = 0;
+        for(uint32_t q = 0; q < QUERY_COUNT; ++q)
+        {
+            for(const Box& box : boxes)
+                bruteFound += boxTest(q, box) ? 1 : 0;
+        }
+    });
+    g_benchSink = g_benchSink + static_cast<double>(treeFound + bruteFound);
+
+    // the tree also returns the boxes whose fat box touches the query so it finds a few more
+    std::printf("  %u %s: %.2f ms, %.2f us per query, %llu found, every box %.2f ms, %llu found, %.0fx\n", QUERY_COUNT, name, treeMs, treeMs * 1e3 / QUERY_COUNT,
+                static_cast<unsigned long long>(treeFound), bruteMs, static_cast<unsigned long long>(bruteFound), bruteMs / treeMs);
+}
+
+void BenchQueries(const std::vector<Box>& boxes)
+{
+    std::vector<int32_t> proxies;
+    const AABBTree tree = Build(boxes, proxies);
+
+    std::vector<Box> queries(QUERY_COUNT);
+    std::vector<glm::vec3> directions(QUERY_COUNT);
+    for(uint32_t q = 0; q < QUERY_COUNT; ++q)
+    {
+        const Box box = RandomBox();
+        queries[q]    = {box.min - 20.0f, box.max + 20.0f};
+        directions[q] = glm::normalize(glm::vec3(RandomFloat(-1.0f, 1.0f), RandomFloat(-0.1f, 0.1f), RandomFloat(-1.0f, 1.0f)));
+    }
+
+    BenchQuery(
+        "box queries", boxes, tree,
+        [&](uint32_t q)
+        {
+            uint64_t found = 0;
+            tree.QueryBox(queries[q].min, queries[q].max, [&found](uint64_t) { ++found; });
+            return found;
+        },
+        [&](uint32_t q, const Box& box) { return glm::all(glm::lessThanEqual(box.min, queries[q].max)) && glm::all(glm::lessThanEqual(queries[q].min, box.max)); });
+
+    BenchQuery(
+        "sphere queries", boxes, tree,
+        [&](uint32_t q)
+        {
+            uint64_t found = 0;
+            tree.QuerySphere((queries[q].min + queries[q].max) * 0.5f, 25.0f, [&found](uint64_t) { ++found; });
+            return found;
+        },
+        [&](uint32_t q, const Box& box)
+        {
+            const glm::vec3 center = (queries[q].min + queries[q].max) * 0.5f;
+            const glm::vec3 d      = center - glm::clamp(center, box.min, box.max);
+            return glm::dot(d, d) <= 25.0f * 25.0f;
+        });
+
+    // rays that keep going through the world, then ones that only look for closer hits, without the tree every box is tested either way
+    const auto rayEnter = [&](uint32_t q, const Box& box)
+    {
+        const glm::vec3 origin       = (queries[q].min + queries[q].max) * 0.5f;
+        const glm::vec3 invDirection = 1.0f / directions[q];
+        const glm::vec3 t1           = (box.min - origin) * invDirection;
+        const glm::vec3 t2           = (box.max - origin) * invDirection;
+        const glm::vec3 tNear        = glm::min(t1, t2);
+        const glm::vec3 tFar         = glm::max(t1, t2);
+        const float enter            = std::max(std::max(tNear.x, std::max(tNear.y, tNear.z)), 0.0f);
+        return enter <= std::min(tFar.x, std::min(tFar.y, tFar.z)) && enter <= WORLD_SIZE;
+    };
+    BenchQuery(
+        "ray casts through every hit", boxes, tree,
+        [&](uint32_t q)
+        {
+            uint64_t found = 0;
+            tree.RayCast((queries[q].min + queries[q].max) * 0.5f, directions[q], WORLD_SIZE,
+                         [&found](uint64_t, float)
+                         {
+                             ++found;
+                             return WORLD_SIZE;
+                         });
+            return found;
+        },
+        rayEnter);
+    BenchQuery(
+        "ray casts to the closest hit", boxes, tree,
+        [&](uint32_t q)
+        {
+            uint64_t found = 0;
+            tree.RayCast((queries[q].min + queries[q].max) * 0.5f, directions[q], WORLD_SIZE,
+                         [&found](uint64_t, float distance)
+                         {
+                             ++found;
+                             return distance;
+                         });
+            return found;
+        },
+        rayEnter);
+}
+}
+
+int main()
+{
+    Log::Init();
+
+    const std::vector<Box> boxes = RandomBoxes(PROXY_COUNT);
+    std::printf("%u proxies\n", PROXY_COUNT);
+    BenchBuild(boxes);
+    BenchMove(boxes, 0.0f);
+    BenchMove(boxes, 0.05f);
+    BenchQueries(boxes);
+
+    return 0;
+}
@@ -0,0 +1,73 @@
+#include "BenchUtils.hpp"
+#include "Utils/Math/AffineTransforms.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <random>
+#include <vector>
+
+// times MathUtils::ComposeWorldTransforms next to the glm products it replaces, for roots and for children of a parent
+namespace
+{
+constexpr uint32_t TRANSFORM_COUNT = 100'000;
+constexpr uint32_t RUNS            = 5;
+
+std::vector<Transform> RandomTransforms(uint32_t count)
+{
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+    std::uniform_real_distribution<float> rotation(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> scale(0.2f, 5.0f);
+
+    std::vector<Transform> transforms(count);
+    for(Transform& transform : transforms)
+    {
+        transform.pos   = glm::vec3(position(random), position(random), position(random));
+        transform.rot   = glm::normalize(glm::quat(rotation(random), rotation(random), rotation(random), rotation(random)));
+        transform.scale = glm::vec3(scale(random), scale(random), scale(random));
+    }
+    return transforms;
+}
+
+glm::mat4 ReferenceTransform(const Transform& transform)
+{
+    return glm::translate(glm::mat4(1.0f), transform.pos) * glm::mat4_cast(transform.rot) * glm::scale(glm::mat4(1.0f), transform.scale);
+}
+
+void BenchCompose(const std::vector<Transform>& transforms, const InternalTransform* parentTransform)
+{
+    const auto count = static_cast<uint32_t>(transforms.size());
+
+    // what the transform system did before, including the comparison that tells if the world transform changed
+    std::vector<glm::mat4> worldTransforms(count);
+    std::vector<uint8_t> changed(count);
+    const double glmMs = BestOf(RUNS, [&]() {
+        for(uint32_t i = 0; i < count; ++i)
+        {
+            const glm::mat4 worldTransform = parentTransform != nullptr ? parentTransform->worldTransform * ReferenceTransform(transforms[i]) : ReferenceTransform(transforms[i]);
+            changed[i]                     = worldTransform != worldTransforms[i] ? 1 : 0;
+            worldTransforms[i]             = worldTransform;
+        }
+    });
+
+    std::vector<InternalTransform> internalTransforms(count);
+    const double composeMs = BestOf(RUNS, [&]() { MathUtils::ComposeWorldTransforms(transforms.data(), count, parentTransform, internalTransforms.data(), changed.data()); });
+    g_benchSink = g_benchSink + worldTransforms[count - 1][3][0] + internalTransforms[count - 1].worldTransform[3][0];
+
+    std::printf("  %u transforms%s: ComposeWorldTransforms %.3f ms, %.1f ns per transform, glm %.3f ms, %.2fx\n", count, parentTransform != nullptr ? " with a parent" : "",
+                composeMs, composeMs * 1e6 / count, glmMs, glmMs / composeMs);
+}
+}
+
+int main()
+{
+    Log::Init();
+
+    const std::vector<Transform> transforms = RandomTransforms(TRANSFORM_COUNT);
+    InternalTransform parent;
+    parent.worldTransform = ReferenceTransform(RandomTransforms(1)[0]);
+
+    BenchCompose(transforms, nullptr);
+    BenchCompose(transforms, &parent);
+
+    return 0;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+// Minimal helpers for the benchmark executables
+// every case runs a few times and the fastest run is kept, the slower ones are mostly the os scheduling something else
+class BenchTimer
+{
+public:
+    [[nodiscard]] double GetMilliseconds() const { return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_start).count(); }
+
+private:
+    std::chrono::steady_clock::time_point m_start = std::chrono::steady_clock::now();
+};
+
+template<typename Fn>
+double BestOf(uint32_t runs, Fn fn)
+{
+    double best = 1e30;
+    for(uint32_t i = 0; i < runs; ++i)
+    {
+        BenchTimer timer;
+        fn();
+        best = std::min(best, timer.GetMilliseconds());
+    }
+    return best;
+}
+
+// the results of the benchmarked work are added here so the compiler can't remove the work
+inline volatile double g_benchSink = 0.0;
@@ -0,0 +1,71 @@
+#include "BenchUtils.hpp"
+#include "ECS/Core.hpp"
+#include "ECS/CoreComponents/Transform.hpp"
+
+#include <format>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+// the time to create a scene's worth of entities with a Transform, one at a time like the importer used to and with the bulk init
+// every run creates them in a new ECS, only the creation is timed, the ECS' construction and destruction aren't
+namespace
+{
+constexpr uint32_t ENTITY_COUNT = 100'000;
+constexpr uint32_t RUNS         = 5;
+
+std::vector<Transform> RandomTransforms(uint32_t count)
+{
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> dist(-100.0f, 100.0f);
+    std::vector<Transform> transforms(count);
+    for(Transform& transform : transforms)
+        transform.pos = {dist(rng), dist(rng), dist(rng)};
+    return transforms;
+}
+
+// builds a new ECS for every run and times fn on it
+template<typename Fn>
+double BestOfFreshECS(Fn fn)
+{
+    double best = 1e30;
+    for(uint32_t i = 0; i < RUNS; ++i)
+    {
+        auto ecs = std::make_unique<ECS>();
+        BenchTimer timer;
+        fn(*ecs);
+        best = std::min(best, timer.GetMilliseconds());
+    }
+    return best;
+}
+}
+
+int main()
+{
+    Log::Init();
+
+    const std::vector<Transform> transforms = RandomTransforms(ENTITY_COUNT);
+    std::vector<std::string> names(ENTITY_COUNT);
+    for(uint32_t i = 0; i < ENTITY_COUNT; ++i)
+        names[i] = std::format("Node{}", i);
+
+    const double oneByOneMs = BestOfFreshECS([&](ECS& ecs) {
+        Entity parent = ecs.CreateEntity("Root");
+        for(uint32_t i = 0; i < ENTITY_COUNT; ++i)
+            ecs.CreateChildEntity(&parent, names[i]).SetComponent<Transform>(transforms[i]);
+    });
+    const double bulkNamedMs = BestOfFreshECS([&](ECS& ecs) {
+        Entity parent = ecs.CreateEntity("Root");
+        g_benchSink   = g_benchSink + static_cast<double>(ecs.CreateChildEntities(&parent, transforms, names).size());
+    });
+    const double bulkMs = BestOfFreshECS([&](ECS& ecs) {
+        Entity parent = ecs.CreateEntity("Root");
+        g_benchSink   = g_benchSink + static_cast<double>(ecs.CreateChildEntities(&parent, transforms).size());
+    });
+
+    std::printf("  %u children: one by one %.2f ms, bulk %.2f ms (%.2fx), bulk unnamed %.2f ms (%.2fx)\n", ENTITY_COUNT, oneByOneMs, bulkNamedMs, oneByOneMs / bulkNamedMs,
+                bulkMs, oneByOneMs / bulkMs);
+
+    return 0;
+}
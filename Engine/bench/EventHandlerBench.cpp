@@ -0,0 +1,212 @@
+#include "BenchUtils.hpp"
+#include "Core/Events/EventHandler.hpp"
+
+#include <atomic>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// events per second through the EventHandler's per thread queues, next to the single vector and allocator it replaced
+// the old handler can only be used from one thread, with a mutex around Send it stands in for the simplest thread safe version of it
+// its rate counts the events it dropped, which it didn't have to dispatch, so it's only comparable when nothing was dropped
+namespace
+{
+constexpr uint32_t EVENT_COUNT      = 4'000'000;
+constexpr uint32_t EVENTS_PER_FRAME = 100'000;  // a DispatchEvents every that many events on one thread, like a scene load spread over frames
+constexpr uint32_t RUNS             = 3;
+
+struct BenchEvent : public Event
+{
+    uint64_t value;
+    uint32_t thread;
+};
+
+// the EventHandler before the per thread queues, every Send appends to the same vector and allocator
+// it drops the events that don't fit in the allocator, which happens when the producers send more than that between two dispatches
+template<bool Locked>
+class OldEventHandler
+{
+public:
+    template<typename T>
+    void Send(T e)
+    {
+        std::unique_lock lock(m_mutex, std::defer_lock);
+        if constexpr(Locked)
+            lock.lock();
+        void* memory = m_allocator.Allocate(sizeof(T), alignof(T));
+        if(memory != nullptr)
+            m_pendingEvents.push_back(new(memory) T(e));
+    }
+
+    template<typename EventType>
+    void Subscribe(std::function<void(EventType)> Callback)
+    {
+        m_eventCallbacks[typeid(EventType)].emplace_back(std::make_unique<EventDelegate<EventType>>(Callback));
+    }
+
+    void DispatchEvents()
+    {
+        std::unique_lock lock(m_mutex, std::defer_lock);
+        if constexpr(Locked)
+            lock.lock();
+        for(Event* event : m_pendingEvents)
+        {
+            auto iter = m_eventCallbacks.find(event->GetEventTypeID());
+            if(iter != m_eventCallbacks.end())
+            {
+                for(auto& delegate : iter->second)
+                    delegate->Invoke(event);
+            }
+        }
+        for(Event* event : m_pendingEvents)
+            event->~Event();
+        m_pendingEvents.clear();
+        m_allocator.Clear();
+    }
+
+private:
+    LinearAllocator m_allocator{4194304};  // the old EVENT_BUFFER_SIZE
+    std::vector<Event*> m_pendingEvents;
+    std::unordered_map<std::type_index, std::list<std::unique_ptr<IEventDelegate>>> m_eventCallbacks;
+    std::mutex m_mutex;
+};
+
+// what the subscriber got, to check that every event was dispatched once
+struct Received
+{
+    uint64_t count = 0;
+    uint64_t sum   = 0;
+};
+
+template<typename Handler>
+void SubscribeReceived(Handler& handler, Received& received)
+{
+    received = {};
+    handler.template Subscribe<BenchEvent>(std::function<void(BenchEvent)>(
+        [&received](BenchEvent e)
+        {
+            ++received.count;
+            received.sum += e.value;
+        }));
+}
+
+void PrintRate(const char* name, double ms, const Received& received, uint32_t threadCount)
+{
+    const uint64_t perThread = EVENT_COUNT / threadCount;
+    const uint64_t sum       = threadCount * (perThread * (perThread - 1) / 2);
+    std::printf("  %s: %.1f M events/s", name, EVENT_COUNT / ms * 1e-3);
+    if(received.count != EVENT_COUNT)
+        std::printf(", %llu events dropped", static_cast<unsigned long long>(EVENT_COUNT - received.count));
+    else if(received.sum != sum)
+        std::printf(", wrong events dispatched");
+    std::printf("\n");
+}
+
+void BenchSingleThread()
+{
+    std::printf("1 thread, sending and dispatching\n");
+
+    Received oldReceived;
+    const double oldMs = BestOf(RUNS, [&]() {
+        OldEventHandler<false> handler;
+        SubscribeReceived(handler, oldReceived);
+        for(uint32_t i = 0; i < EVENT_COUNT; ++i)
+        {
+            BenchEvent event;
+            event.value = i;
+            handler.Send(event);
+            if((i + 1) % EVENTS_PER_FRAME == 0)
+                handler.DispatchEvents();
+        }
+        handler.DispatchEvents();
+    });
+    PrintRate("old handler", oldMs, oldReceived, 1);
+
+    Received newReceived;
+    const double newMs = BestOf(RUNS, [&]() {
+        EventHandler handler;
+        SubscribeReceived(handler, newReceived);
+        for(uint32_t i = 0; i < EVENT_COUNT; ++i)
+        {
+            BenchEvent event;
+            event.value = i;
+            handler.Send(event);
+            if((i + 1) % EVENTS_PER_FRAME == 0)
+                handler.DispatchEvents();
+        }
+        handler.DispatchEvents();
+    });
+    PrintRate("EventHandler", newMs, newReceived, 1);
+}
+
+// producer threads send while the calling thread dispatches until they are all done, like jobs sending events during a frame
+template<typename Handler>
+double RunProducers(Handler& handler, uint32_t threadCount)
+{
+    BenchTimer timer;
+    std::atomic<uint32_t> finished = 0;
+    std::vector<std::thread> threads;
+    for(uint32_t t = 0; t < threadCount; ++t)
+    {
+        threads.emplace_back(
+            [&handler, &finished, t, threadCount]()
+            {
+                for(uint32_t i = 0; i < EVENT_COUNT / threadCount; ++i)
+                {
+                    BenchEvent event;
+                    event.value  = i;
+                    event.thread = t;
+                    handler.Send(event);
+                }
+                ++finished;
+            });
+    }
+    while(finished.load() < threadCount)
+    {
+        handler.DispatchEvents();
+        std::this_thread::sleep_for(std::chrono::microseconds(500));  // a frame that does something else between the dispatches
+    }
+    for(std::thread& thread : threads)
+        thread.join();
+    handler.DispatchEvents();
+    return timer.GetMilliseconds();
+}
+
+void BenchProducers(uint32_t threadCount)
+{
+    std::printf("%u producer threads, dispatching on the calling thread\n", threadCount);
+
+    Received oldReceived;
+    double oldMs = 1e30;
+    for(uint32_t run = 0; run < RUNS; ++run)
+    {
+        OldEventHandler<true> handler;
+        SubscribeReceived(handler, oldReceived);
+        oldMs = std::min(oldMs, RunProducers(handler, threadCount));
+    }
+    PrintRate("old handler with a mutex", oldMs, oldReceived, threadCount);
+
+    Received newReceived;
+    double newMs = 1e30;
+    for(uint32_t run = 0; run < RUNS; ++run)
+    {
+        EventHandler handler;
+        SubscribeReceived(handler, newReceived);
+        newMs = std::min(newMs, RunProducers(handler, threadCount));
+    }
+    PrintRate("EventHandler", newMs, newReceived, threadCount);
+}
+}
+
+int main()
+{
+    Log::Init();
+
+    BenchSingleThread();
+    for(uint32_t threadCount : {1u, 2u, 4u, 8u})
+        BenchProducers(threadCount);
+
+    return 0;
+}
@@ -0,0 +1,113 @@
+#include "BenchUtils.hpp"
+#include "Core/Jobs/JobSystem.hpp"
+#include "Utils/Math/FrustumCuller.hpp"
+
+#include <array>
+#include <cmath>
+#include <random>
+#include <thread>
+#include <vector>
+
+// times FrustumCuller::Cull on 1M boxes next to testing the boxes one by one, on one thread and split over the workers
+namespace
+{
+constexpr uint32_t BOX_COUNT = 1'000'000;
+constexpr uint32_t RUNS      = 5;
+
+struct Box
+{
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
+// a world about as big as the view distance so about a quarter of the boxes are visible from the origin
+std::vector<Box> RandomBoxes(uint32_t count)
+{
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> horizontal(-500.0f, 500.0f);
+    std::uniform_real_distribution<float> vertical(-50.0f, 50.0f);
+    std::uniform_real_distribution<float> size(0.1f, 5.0f);
+
+    std::vector<Box> boxes(count);
+    for(Box& box : boxes)
+    {
+        const glm::vec3 center(horizontal(random), vertical(random), horizontal(random));
+        const glm::vec3 halfSize(size(random), size(random), size(random));
+        box = {center - halfSize, center + halfSize};
+    }
+    return boxes;
+}
+
+// the planes of a 90 degree perspective camera at the origin looking along +x, the far plane is infinite like the ones DrawcullPass extracts
+std::array<glm::vec4, 5> Frustum()
+{
+    return {glm::vec4(glm::normalize(glm::vec3(1.0f, 0.0f, 1.0f)), 0.0f),
+            glm::vec4(glm::normalize(glm::vec3(1.0f, 0.0f, -1.0f)), 0.0f),
+            glm::vec4(glm::normalize(glm::vec3(1.0f, 1.0f, 0.0f)), 0.0f),
+            glm::vec4(glm::normalize(glm::vec3(1.0f, -1.0f, 0.0f)), 0.0f),
+            glm::vec4(1.0f, 0.0f, 0.0f, -0.1f)};
+}
+
+// what the culling would be without the structure of arrays, one box at a time with an early out on the first plane it's behind
+void CullScalar(const std::vector<Box>& boxes, std::span<const glm::vec4> planes, std::vector<uint32_t>& visible)
+{
+    for(uint32_t i = 0; i < boxes.size(); ++i)
+    {
+        bool inside = true;
+        for(size_t p = 0; p < planes.size() && inside; ++p)
+        {
+            const glm::vec4& plane = planes[p];
+            const float x          = plane.x >= 0.0f ? boxes[i].max.x : boxes[i].min.x;
+            const float y          = plane.y >= 0.0f ? boxes[i].max.y : boxes[i].min.y;
+            const float z          = plane.z >= 0.0f ? boxes[i].max.z : boxes[i].min.z;
+            inside                 = x * plane.x + y * plane.y + z * plane.z + plane.w >= 0.0f;
+        }
+        if(inside)
+            visible.push_back(i);
+    }
+}
+
+void BenchCull(const std::vector<Box>& boxes, const FrustumCuller& culler)
+{
+    const std::array<glm::vec4, 5> planes = Frustum();
+    std::vector<uint32_t> visible;
+    visible.reserve(boxes.size());
+
+    const double scalarMs = BestOf(RUNS, [&]() {
+        visible.clear();
+        CullScalar(boxes, planes, visible);
+    });
+    const size_t scalarCount = visible.size();
+
+    const double cullerMs = BestOf(RUNS, [&]() {
+        visible.clear();
+        culler.Cull(planes, visible);
+    });
+    g_benchSink = g_benchSink + static_cast<double>(visible.size());
+
+    std::printf("  %u boxes, %zu visible: FrustumCuller %.3f ms, one by one %.3f ms, %.2fx%s\n", BOX_COUNT, visible.size(), cullerMs, scalarMs, scalarMs / cullerMs,
+                visible.size() == scalarCount ? "" : " (different visible counts)");
+}
+}
+
+int main()
+{
+    Log::Init();
+
+    const std::vector<Box> boxes = RandomBoxes(BOX_COUNT);
+    FrustumCuller culler;
+    culler.Resize(BOX_COUNT);
+    for(uint32_t i = 0; i < BOX_COUNT; ++i)
+        culler.SetBounds(i, boxes[i].min, boxes[i].max);
+
+    std::printf("no workers\n");
+    BenchCull(boxes, culler);
+
+    const uint32_t hardwareWorkers = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+    JobSystem::Initialize(hardwareWorkers);
+    std::printf("%u workers\n", hardwareWorkers);
+    BenchCull(boxes, culler);
+    JobSystem::Shutdown();
+
+    return 0;
+}
@@ -0,0 +1,102 @@
+#include "BenchUtils.hpp"
+#include "Core/Jobs/JobSystem.hpp"
+
+#include <cmath>
+#include <thread>
+#include <vector>
+
+// times the overhead of the JobSystem on jobs that do almost nothing, for 1 worker up to one per hardware thread
+// Run/Wait from the main thread, jobs spawned by jobs, and ParallelFor compared with the same loop on one thread
+namespace
+{
+constexpr uint32_t RUNS = 5;
+
+// a few nanoseconds of work that can't be folded away
+double TinyWork(uint32_t i)
+{
+    return std::sqrt(static_cast<double>(i));
+}
+
+void BenchRunWait(uint32_t jobCount)
+{
+    std::vector<double> results(jobCount);
+    const double ms = BestOf(RUNS, [&]() {
+        JobCounter counter;
+        for(uint32_t i = 0; i < jobCount; ++i)
+            JobSystem::Run([&results, i]() { results[i] = TinyWork(i); }, &counter);
+        JobSystem::Wait(counter);
+    });
+    g_benchSink = g_benchSink + results[jobCount - 1];
+    std::printf("  Run + Wait, %u jobs from the main thread: %.2f ms, %.0f ns per job\n", jobCount, ms, ms * 1e6 / jobCount);
+}
+
+// the main thread only starts the parents, the children are pushed to the workers' own deques and stolen from there
+void BenchNestedRun(uint32_t parentCount, uint32_t childCount)
+{
+    std::vector<double> results(parentCount * childCount);
+    const double ms = BestOf(RUNS, [&]() {
+        JobCounter counter;
+        for(uint32_t p = 0; p < parentCount; ++p)
+        {
+            JobSystem::Run(
+                [&results, p, childCount]() {
+                    JobCounter children;
+                    for(uint32_t c = 0; c < childCount; ++c)
+                    {
+                        const uint32_t i = p * childCount + c;
+                        JobSystem::Run([&results, i]() { results[i] = TinyWork(i); }, &children);
+                    }
+                    JobSystem::Wait(children);
+                },
+                &counter);
+        }
+        JobSystem::Wait(counter);
+    });
+    const uint32_t jobCount = parentCount * (childCount + 1);
+    g_benchSink             = g_benchSink + results.back();
+    std::printf("  Run + Wait, %u jobs spawning %u each: %.2f ms, %.0f ns per job\n", parentCount, childCount, ms, ms * 1e6 / jobCount);
+}
+
+void BenchParallelFor(uint32_t count, uint32_t minPerJob)
+{
+    std::vector<double> results(count);
+    const double serialMs = BestOf(RUNS, [&]() {
+        for(uint32_t i = 0; i < count; ++i)
+            results[i] = TinyWork(i);
+    });
+    const double parallelMs = BestOf(RUNS, [&]() {
+        JobSystem::ParallelFor(count, minPerJob, [&results](uint32_t first, uint32_t end) {
+            for(uint32_t i = first; i < end; ++i)
+                results[i] = TinyWork(i);
+        });
+    });
+    g_benchSink = g_benchSink + results[count - 1];
+    std::printf("  ParallelFor, %u elements, at least %u per job: %.3f ms, one thread %.3f ms, %.2fx\n", count, minPerJob, parallelMs, serialMs, serialMs / parallelMs);
+}
+}
+
+int main()
+{
+    Log::Init();
+
+    std::vector<uint32_t> workerCounts = {1, 2, 4};
+    const uint32_t hardwareWorkers     = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+    if(hardwareWorkers > 4)
+        workerCounts.push_back(hardwareWorkers);
+
+    for(uint32_t workerCount : workerCounts)
+    {
+        JobSystem::Initialize(workerCount);
+        std::printf("%u workers\n", workerCount);
+
+        BenchRunWait(100'000);
+        BenchNestedRun(1000, 100);
+        BenchParallelFor(1'000'000, 1024);
+        BenchParallelFor(1'000'000, 65536);
+        BenchParallelFor(10'000, 256);  // about the size of a frame's transform updates, where the overhead matters the most
+
+        JobSystem::Shutdown();
+    }
+
+    return 0;
+}
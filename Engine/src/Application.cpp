@@ -8,6 +8,9 @@
 #include "Utils/Time.hpp"
 #include "Core/Events/EventHandler.hpp"
 #include "Rendering/Renderer.hpp"
+#include "Rendering/RenderThread.hpp"
+#include "Utils/SystemScheduleUI.hpp"
+#include "Core/Jobs/JobSystem.hpp"
 
 Application* Application::s_instance = nullptr;
 
@@ -22,6 +25,9 @@ Application::Application(uint32_t width, uint32_t height, uint32_t frameRate, co
 
     Instrumentor::Get().BeginSession(title);
 
+    // before any world is created so flecs' worker tasks run on the job system
+    JobSystem::Initialize();
+    JobSystem::SetFlecsTaskAPI();
 
     m_eventHandler      = std::make_unique<EventHandler>();
     m_currentScene      = std::make_unique<Scene>();
@@ -36,15 +42,22 @@ Application::Application(uint32_t width, uint32_t height, uint32_t frameRate, co
 
 
     m_renderer->InitilizeRenderGraph();
+
+    m_systemsWindow = std::make_unique<DebugUIWindow>("Systems");
+    m_systemsWindow->AddElement(std::make_shared<SystemScheduleUI>());
+    m_renderer->AddDebugUIWindow(m_systemsWindow.get());
 }
 
 Application::~Application()
 {
+    m_renderThread.reset();
     vkDeviceWaitIdle(VulkanContext::GetDevice());
+    m_systemsWindow.reset();
     m_renderer.reset();
     m_materialSystem.reset();
     m_currentScene.reset();
     m_eventHandler.reset();
+    JobSystem::Shutdown();
 
     VulkanContext::Cleanup();
 
@@ -64,6 +77,9 @@ void Application::Run()
 
     double lastTime = Time::GetTime();
 
+    // simulation frame N + 1 runs while the render thread renders frame N from the snapshot taken at the end of frame N
+    m_renderThread = std::make_unique<RenderThread>(m_renderer.get(), m_pipelineDepth);
+
     while(!m_window->ShouldClose())
     {
         double startTime = Time::GetTime();
@@ -71,17 +87,32 @@ void Application::Run()
         lastTime         = startTime;
 
 
-        glfwPollEvents();  // TODO this blocks while you hold the title bar(or the resize cursor), only fix seems to be to render on another thread
+        glfwPollEvents();  // TODO this still blocks while you hold the title bar(or the resize cursor), the render thread only gets through the frames that were already queued
 
         if(glfwGetKey(w, GLFW_KEY_ESCAPE) == GLFW_PRESS)
             break;
 
-        m_eventHandler->DispatchEvents();
+        // recreating the swapchain needs the main thread for the window and the render thread out of the way
+        if(m_window->IsResized() || m_renderer->IsSwapchainOutOfDate())
+        {
+            m_renderThread->WaitIdle();
+            m_renderer->RecreateSwapchain();
+        }
+
+        // the renderer's event handlers change what the render thread draws
+        if(m_eventHandler->HasPendingEvents())
+        {
+            auto lock = m_renderer->LockFrame();
+            m_eventHandler->DispatchEvents();
+        }
+        JobSystem::ProcessMainThreadJobs();
 
 
         Time::SetDelta(deltaTime);
         m_currentScene->ecs->Update(static_cast<float>(deltaTime));
 
-        m_renderer->Render(deltaTime);
+        m_renderThread->Submit(m_renderer->ExtractFrame(deltaTime));
     }
+
+    m_renderThread.reset();
 }
@@ -7,6 +7,8 @@ class ECS;
 class MaterialSystem;
 class EventHandler;
 class Renderer;
+class RenderThread;
+class DebugUIWindow;
 
 class Application
 {
@@ -21,6 +23,9 @@ public:
 
     void SetScene(Scene* scene);
 
+    // how many frames the simulation can run ahead of the render thread, 0 renders on the main thread, has to be set before Run
+    void SetPipelineDepth(uint32_t depth) { m_pipelineDepth = depth; }
+
 
     Scene* GetScene() { return m_currentScene.get(); }
 
@@ -38,8 +43,11 @@ private:
     std::shared_ptr<Window> m_window;
     std::unique_ptr<EventHandler> m_eventHandler;
     std::unique_ptr<Renderer> m_renderer;
+    std::unique_ptr<RenderThread> m_renderThread;
+    uint32_t m_pipelineDepth = 1;
     double m_frameTime;
     std::unique_ptr<MaterialSystem> m_materialSystem;
+    std::unique_ptr<DebugUIWindow> m_systemsWindow;
 
     static Application* s_instance;
 };
@@ -2,6 +2,10 @@
 
 #include "Core/Events/Event.hpp"
 
+#include <functional>
+#include <span>
+#include <vector>
+
 class IEventDelegate
 {
 public:
@@ -24,3 +28,32 @@ public:
 private:
     std::function<void(EventType)> m_callback;
 };
+
+
+class IBatchEventDelegate
+{
+public:
+    virtual ~IBatchEventDelegate(){};
+    virtual void Invoke(const std::vector<Event*>& events) = 0;
+};
+
+// gets every event of its type that was sent since the last batch at once
+template<typename EventType>
+class BatchEventDelegate : public IBatchEventDelegate
+{
+public:
+    BatchEventDelegate(std::function<void(std::span<const EventType>)> callback)
+        : m_callback(callback) {}
+
+    void Invoke(const std::vector<Event*>& events) override
+    {
+        std::vector<EventType> batch;
+        batch.reserve(events.size());
+        for(Event* e : events)
+            batch.push_back(*static_cast<EventType*>(e));
+        (m_callback)(batch);
+    }
+
+private:
+    std::function<void(std::span<const EventType>)> m_callback;
+};
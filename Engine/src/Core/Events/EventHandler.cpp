@@ -1,36 +1,179 @@
 #include "Core/Events/EventHandler.hpp"
 
+#include <algorithm>
+#include <array>
+#include <thread>
+
+namespace
+{
+std::atomic<uint64_t> g_nextHandlerID = 0;
+
+// the queues of this thread in the last few handlers it sent to, the most recent one first
+// the ids are never reused, so the entries of a destroyed handler are never matched and get pushed out
+// a thread that sends to more handlers than that looks the others up in the handler, which still gives it the queue it had
+constexpr size_t THREAD_QUEUE_CACHE_SIZE = 4;
+
+struct ThreadQueue
+{
+    uint64_t handlerID = UINT64_MAX;
+    void* queue        = nullptr;
+};
+thread_local std::array<ThreadQueue, THREAD_QUEUE_CACHE_SIZE> t_queues;
+}  // namespace
+
 
 EventHandler::EventHandler()
+    : m_id(g_nextHandlerID++)
 {
-    m_allocator = std::make_unique<LinearAllocator>(EVENT_BUFFER_SIZE);
 }
 
 EventHandler::~EventHandler()
 {
     m_eventCallbacks.clear();
-    m_pendingEvents.clear();
+    for(auto& producer : m_producers)
+    {
+        for(EventBuffer& buffer : producer->buffers)
+            buffer.Clear();
+    }
+}
+
+void* EventHandler::EventBuffer::Allocate(size_t size, uint8_t alignment)
+{
+    while(true)
+    {
+        if(currentArena == arenas.size())
+            arenas.push_back(std::make_unique<LinearAllocator>(std::max<size_t>(EVENT_ARENA_SIZE, size + alignment)));
+
+        if(void* memory = arenas[currentArena]->Allocate(size, alignment))
+            return memory;
+        ++currentArena;
+    }
+}
+
+void EventHandler::EventBuffer::Clear()
+{
+    for(Event* event : events)  // the arenas only free the memory, some events own some of their own
+        event->~Event();
+    events.clear();
+
+    for(auto& arena : arenas)
+        arena->Clear();
+    currentArena = 0;
+}
+
+EventHandler::ProducerQueue& EventHandler::GetProducerQueue()
+{
+    if(t_queues[0].handlerID == m_id)
+        return *static_cast<ProducerQueue*>(t_queues[0].queue);
+
+    // moves the entry to the front, or the new one in place of the oldest one
+    auto it = std::find_if(t_queues.begin() + 1, t_queues.end(), [this](const ThreadQueue& entry) { return entry.handlerID == m_id; });
+    if(it != t_queues.end())
+    {
+        std::rotate(t_queues.begin(), it, it + 1);
+        return *static_cast<ProducerQueue*>(t_queues[0].queue);
+    }
+
+    ProducerQueue* queue;
+    {
+        std::lock_guard lock(m_producersMutex);
+        ProducerQueue*& threadQueue = m_producersByThread[std::this_thread::get_id()];
+        if(!threadQueue)
+        {
+            m_producers.push_back(std::make_unique<ProducerQueue>());
+            threadQueue = m_producers.back().get();
+        }
+        queue = threadQueue;
+    }
+    std::rotate(t_queues.begin(), t_queues.end() - 1, t_queues.end());
+    t_queues[0] = {m_id, queue};
+    return *queue;
+}
+
+bool EventHandler::HasPendingEvents() const
+{
+    std::lock_guard lock(m_producersMutex);
+    return std::any_of(m_producers.begin(), m_producers.end(), [](const auto& producer) { return producer->sent.load(std::memory_order_relaxed) != producer->dispatched; });
 }
 
 void EventHandler::DispatchEvents()
 {
-    size_t eventIndex = 0;
-    size_t eventEnd   = m_pendingEvents.size();
-    while(eventIndex < eventEnd)  // do it like this to handle if a new event is added during another is handled
+    PROFILE_FUNCTION();
+    ProducerQueue& ownQueue = GetProducerQueue();
+    ownQueue.dispatcher     = true;
+
+    // the flip happens once per call, the events other threads send from now on wait for the next one
+    const uint32_t frame = m_frame.load();
+    m_frame.store(1 - frame);  // seq_cst, a producer that didn't see this has set its sending flag before it read the old frame
+
+    std::vector<ProducerQueue*> producers;
+    {
+        std::lock_guard lock(m_producersMutex);
+        for(auto& producer : m_producers)
+            producers.push_back(producer.get());
+    }
+
+    m_dispatching.clear();
+    for(ProducerQueue* producer : producers)
+    {
+        while(producer->sending.load())  // seq_cst like the flip, at most one event that started before it
+            std::this_thread::yield();
+
+        const std::vector<Event*>& events = producer->buffers[frame].events;
+        m_dispatching.insert(m_dispatching.end(), events.begin(), events.end());
+        producer->dispatched += events.size();
+    }
+    Dispatch(m_dispatching);
+
+    // the events the handlers send go to this thread's other buffer, only this thread writes to it so it's swapped out and dispatched
+    // until the handlers stop sending, the buffers are kept until the batch subscribers had their events
+    EventBuffer& sending = ownQueue.buffers[1 - frame];
+    size_t drained       = 0;
+    while(!sending.events.empty())
     {
-        auto iter = m_eventCallbacks.find(m_pendingEvents[eventIndex]->GetEventTypeID());
+        if(drained == m_drainedBuffers.size())
+            m_drainedBuffers.emplace_back();
+        std::swap(m_drainedBuffers[drained], sending);  // sending gets the cleared arenas of an earlier call
+        ownQueue.dispatched += m_drainedBuffers[drained].events.size();
+        Dispatch(m_drainedBuffers[drained].events);
+        ++drained;
+    }
+
+    // once per call, what the batch subscribers send is dispatched the next time
+    DispatchBatches();
+
+    for(ProducerQueue* producer : producers)
+        producer->buffers[frame].Clear();
+    for(size_t i = 0; i < drained; ++i)
+        m_drainedBuffers[i].Clear();
+}
+
+void EventHandler::Dispatch(const std::vector<Event*>& events)
+{
+    for(Event* event : events)
+    {
+        auto iter = m_eventCallbacks.find(event->GetEventTypeID());
         if(iter != m_eventCallbacks.end())
         {
             auto& delegates = iter->second;
 
             for(auto it = delegates.begin(); it != delegates.end(); ++it)  // if an element is push_backed to a list the iterator doesn't get invalidated so this works
-                (*it)->Invoke(m_pendingEvents[eventIndex]);
+                (*it)->Invoke(event);
         }
-        eventIndex++;
-        eventEnd = m_pendingEvents.size();  // update last index in case a new event was added
+        if(m_batchCallbacks.contains(event->GetEventTypeID()))
+            m_batchedEvents[event->GetEventTypeID()].push_back(event);
     }
-
-    m_pendingEvents.clear();
-    m_allocator->Clear();
 }
 
+void EventHandler::DispatchBatches()
+{
+    for(auto& [type, batch] : m_batchedEvents)
+    {
+        if(batch.empty())
+            continue;
+
+        for(auto& delegate : m_batchCallbacks[type])
+            delegate->Invoke(batch);
+        batch.clear();
+    }
+}
@@ -1,9 +1,14 @@
 #pragma once
 
+#include <atomic>
 #include <typeindex>
 #include <unordered_map>
 #include <list>
 #include <memory>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <unordered_set>
 #include <vector>
 
 #include "Core/Events/EventDelegate.hpp"
@@ -14,33 +19,41 @@
 #include "ECS/Core.hpp"
 #include "ECS/Observer.hpp"
 
-#define EVENT_BUFFER_SIZE 4194304  // 4 MB
+#define EVENT_ARENA_SIZE 65536  // 64 KB
 class EventHandler
 {
 public:
     EventHandler();
     ~EventHandler();
 
+    // only from the main thread, the events sent from other threads while it runs are dispatched the next time
+    // the events its handlers send are dispatched in the same call, the batch subscribers are called once at the end
     void DispatchEvents();
+    [[nodiscard]] bool HasPendingEvents() const;
 
 
+    // can be called from any thread, the events of each thread are dispatched in the order that thread sent them
     template<typename T, typename... Args>
     void Send(Args&&... args)
     {
-        void* memory = m_allocator->Allocate(sizeof(T), alignof(T));
-        if(memory != nullptr)
-            m_pendingEvents.push_back(new(memory) T(std::forward<Args>(args)...));
-        else
-            LOG_ERROR("Event buffer is full");
+        ProducerQueue& queue = GetProducerQueue();
+
+        // m_frame only changes on the thread that dispatches, the others tell it they are writing to the buffer they read from it
+        // both seq_cst so DispatchEvents either sees the flag after it flipped m_frame or the producer sees the new frame
+        const bool handshake = !queue.dispatcher;
+        if(handshake)
+            queue.sending.store(true);
+        EventBuffer& buffer = queue.buffers[m_frame.load(handshake ? std::memory_order_seq_cst : std::memory_order_relaxed)];
+        buffer.events.push_back(new(buffer.Allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...));
+        if(handshake)
+            queue.sending.store(false, std::memory_order_release);
+
+        queue.sent.store(queue.sent.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);  // only this thread writes it
     }
     template<typename T>
     void Send(T e)
     {
-        void* memory = m_allocator->Allocate(sizeof(T), alignof(T));
-        if(memory != nullptr)
-            m_pendingEvents.push_back(new(memory) T(e));
-        else
-            LOG_ERROR("Event buffer is full");
+        Send<T, T>(std::move(e));
     }
 
 
@@ -55,6 +68,19 @@ public:
         m_eventCallbacks[typeid(EventType)].emplace_back(std::make_unique<EventDelegate<EventType>>(Callback));
     }
 
+    // batch subscribers get all the events of their type that were sent during the frame together, once the pending events were dispatched one by one
+    // which lets them handle a whole scene load at once instead of entity by entity, the events they send themselves wait for the next DispatchEvents
+    template<typename Class, typename EventType>
+    void Subscribe(Class* owner, void (Class::*Callback)(std::span<const EventType>))
+    {
+        m_batchCallbacks[typeid(EventType)].emplace_back(std::make_unique<BatchEventDelegate<EventType>>(std::bind(Callback, owner, std::placeholders::_1)));
+    }
+    template<typename EventType>
+    void Subscribe(std::function<void(std::span<const EventType>)> Callback)
+    {
+        m_batchCallbacks[typeid(EventType)].emplace_back(std::make_unique<BatchEventDelegate<EventType>>(Callback));
+    }
+
     // specific overloads for component events because we need to register them with the ECS when they are subscribed to for the first time
     template<typename Class, typename ComponentType>
     void Subscribe(Class* owner, void (Class::*Callback)(ComponentAdded<ComponentType>));
@@ -64,135 +90,118 @@ public:
     void Subscribe(Class* owner, void (Class::*Callback)(ComponentRemoved<ComponentType>));
     template<typename ComponentType>
     void Subscribe(std::function<void(ComponentRemoved<ComponentType>)> Callback);
+    template<typename Class, typename ComponentType>
+    void Subscribe(Class* owner, void (Class::*Callback)(std::span<const ComponentAdded<ComponentType>>));
+    template<typename Class, typename ComponentType>
+    void Subscribe(Class* owner, void (Class::*Callback)(std::span<const ComponentRemoved<ComponentType>>));
 
 
     void OnSceneSwitched(SceneSwitchedEvent e);
 
 private:
-    std::unique_ptr<LinearAllocator> m_allocator;
+    // registers the observer that sends an EventType<ComponentType> for each entity, with the current ECS and with the ECS of every scene switched to
+    template<template<typename> typename EventType, typename ComponentType>
+    void ObserveComponent(ECSEvent ecsEvent);
+
+    // the events a thread sends go to one of the two buffers of its own queue, the other one is dispatched meanwhile
+    // the events are allocated from arenas that are cleared after the dispatch, more are added when a frame needs them
+    struct EventBuffer
+    {
+        std::vector<std::unique_ptr<LinearAllocator>> arenas;
+        size_t currentArena = 0;
+        std::vector<Event*> events;
+
+        void* Allocate(size_t size, uint8_t alignment);
+        void Clear();
+    };
+    struct ProducerQueue
+    {
+        EventBuffer buffers[2];
+        std::atomic<bool> sending = false;  // set while Send writes to one of the buffers
+        std::atomic<uint64_t> sent = 0;     // the events sent so far, the thread that dispatches counts the ones it dispatched
+        uint64_t dispatched        = 0;
+        bool dispatcher            = false;  // the queue of the thread that calls DispatchEvents, it doesn't need the handshake
+    };
+
+    ProducerQueue& GetProducerQueue();
+    void Dispatch(const std::vector<Event*>& events);  // to the regular subscribers, queues the events of the batch subscribers
+    void DispatchBatches();
+
+    std::vector<std::unique_ptr<ProducerQueue>> m_producers;                  // one per thread that sent an event, in the order they first did
+    std::unordered_map<std::thread::id, ProducerQueue*> m_producersByThread;  // a thread gets a single queue however often it falls out of its cache
+    mutable std::mutex m_producersMutex;                                      // Send only takes it when the thread's queue isn't in its cache
+    std::atomic<uint32_t> m_frame = 0;                                        // the buffer the queues send to, DispatchEvents flips it before dispatching the other one
+    const uint64_t m_id;                                                      // tells apart the handlers the thread local queue pointers belong to
+    std::vector<Event*> m_dispatching;                        // the events of all the queues of the buffer that is dispatched
+    std::vector<EventBuffer> m_drainedBuffers;                // the events the handlers sent during DispatchEvents, swapped out of the dispatcher's queue
+
     std::unordered_map<std::type_index, std::list<std::unique_ptr<IEventDelegate>>> m_eventCallbacks;
-    std::vector<Event*> m_pendingEvents;  // these pointers will get deleted in the destructor of the linear allocator
+    std::unordered_map<std::type_index, std::list<std::unique_ptr<IBatchEventDelegate>>> m_batchCallbacks;
+    std::unordered_map<std::type_index, std::vector<Event*>> m_batchedEvents;  // the events waiting for their batch subscribers, cleared after each batch
+    std::unordered_set<std::type_index> m_observedComponentEvents;
 };
 
 
-template<typename Class, typename ComponentType>
-void EventHandler::Subscribe(Class* owner, void (Class::*Callback)(ComponentAdded<ComponentType>))
+template<template<typename> typename EventType, typename ComponentType>
+void EventHandler::ObserveComponent(ECSEvent ecsEvent)
 {
-    auto it = m_eventCallbacks.find(typeid(ComponentAdded<ComponentType>));
-    if(it == m_eventCallbacks.end())
+    if(!m_observedComponentEvents.insert(typeid(EventType<ComponentType>)).second)
+        return;
+
+    auto observe = [this, ecsEvent](ECS* ecs)
     {
-        ECS* ecs = Application::GetInstance()->GetScene()->GetECS();
-        ecs->AddObserver<ComponentType>(ECSEvent::OnAdd,
+        ecs->AddObserver<ComponentType>(ecsEvent,
                                         [this](flecs::entity e, ComponentType& /*component*/)
                                         {
-                                            ComponentAdded<ComponentType> event;
+                                            EventType<ComponentType> event;
                                             event.entity = Entity(e);
-                                            Send<ComponentAdded<ComponentType>>(event);
+                                            Send<EventType<ComponentType>>(event);
                                         });
+    };
+    observe(Application::GetInstance()->GetScene()->GetECS());
 
-        // need to reregister with the new ecs when the scene is switched
-        Subscribe<SceneSwitchedEvent>(
-            [this](SceneSwitchedEvent e)
-            {
-                e.newScene->ecs->AddObserver<ComponentType>(ECSEvent::OnAdd,
-                                                            [this](flecs::entity e, ComponentType& /*component*/)
-                                                            {
-                                                                ComponentAdded<ComponentType> event;
-                                                                event.entity = Entity(e);
-                                                                Send<ComponentAdded<ComponentType>>(event);
-                                                            });
-            });
-    }
+    // need to reregister with the new ecs when the scene is switched
+    Subscribe<SceneSwitchedEvent>([observe](SceneSwitchedEvent e) { observe(e.newScene->GetECS()); });
+}
+
+template<typename Class, typename ComponentType>
+void EventHandler::Subscribe(Class* owner, void (Class::*Callback)(ComponentAdded<ComponentType>))
+{
+    ObserveComponent<ComponentAdded, ComponentType>(ECSEvent::OnAdd);
     m_eventCallbacks[typeid(ComponentAdded<ComponentType>)].emplace_back(std::make_unique<EventDelegate<ComponentAdded<ComponentType>>>(std::bind(Callback, owner, std::placeholders::_1)));
 }
 
 template<typename ComponentType>
 void EventHandler::Subscribe(std::function<void(ComponentAdded<ComponentType>)> Callback)
 {
-    auto it = m_eventCallbacks.find(typeid(ComponentAdded<ComponentType>));
-    if(it == m_eventCallbacks.end())
-    {
-        ECS* ecs = Application::GetInstance()->GetScene()->GetECS();
-        ecs->AddObserver<ComponentType>(ECSEvent::OnAdd,
-                                        [this](flecs::entity e, ComponentType& component)
-                                        {
-                                            ComponentAdded<ComponentType> event;
-                                            event.entity = Entity(e);
-                                            Send<ComponentAdded<ComponentType>>(event);
-                                        });
-        // need to reregister with the new ecs when the scene is switched
-        Subscribe<SceneSwitchedEvent>(
-            [this](SceneSwitchedEvent e)
-            {
-                e.newScene->ecs->AddObserver<ComponentType>(ECSEvent::OnAdd,
-                                                            [this](flecs::entity e, ComponentType& component)
-                                                            {
-                                                                ComponentAdded<ComponentType> event;
-                                                                event.entity = Entity(e);
-                                                                Send<ComponentAdded<ComponentType>>(event);
-                                                            });
-            });
-    }
+    ObserveComponent<ComponentAdded, ComponentType>(ECSEvent::OnAdd);
     m_eventCallbacks[typeid(ComponentAdded<ComponentType>)].emplace_back(std::make_unique<EventDelegate<ComponentAdded<ComponentType>>>(Callback));
 }
 
 template<typename Class, typename ComponentType>
 void EventHandler::Subscribe(Class* owner, void (Class::*Callback)(ComponentRemoved<ComponentType>))
 {
-    auto it = m_eventCallbacks.find(typeid(ComponentRemoved<ComponentType>));
-    if(it == m_eventCallbacks.end())
-    {
-        ECS* ecs = Application::GetInstance()->GetScene()->GetECS();
-        ecs->AddObserver<ComponentType>(ECSEvent::OnRemove,
-                                        [this](flecs::entity e, ComponentType& /*component*/)
-                                        {
-                                            ComponentRemoved<ComponentType> event;
-                                            event.entity = Entity(e);
-                                            Send<ComponentRemoved<ComponentType>>(event);
-                                        });
-
-        // need to reregister with the new ecs when the scene is switched
-        Subscribe<SceneSwitchedEvent>(
-            [this](SceneSwitchedEvent e)
-            {
-                e.newScene->ecs->AddObserver<ComponentType>(ECSEvent::OnRemove,
-                                                            [this](flecs::entity e, ComponentType& /*component*/)
-                                                            {
-                                                                ComponentRemoved<ComponentType> event;
-                                                                event.entity = Entity(e);
-                                                                Send<ComponentRemoved<ComponentType>>(event);
-                                                            });
-            });
-    }
+    ObserveComponent<ComponentRemoved, ComponentType>(ECSEvent::OnRemove);
     m_eventCallbacks[typeid(ComponentRemoved<ComponentType>)].emplace_back(std::make_unique<EventDelegate<ComponentRemoved<ComponentType>>>(std::bind(Callback, owner, std::placeholders::_1)));
 }
 
 template<typename ComponentType>
 void EventHandler::Subscribe(std::function<void(ComponentRemoved<ComponentType>)> Callback)
 {
-    auto it = m_eventCallbacks.find(typeid(ComponentRemoved<ComponentType>));
-    if(it == m_eventCallbacks.end())
-    {
-        ECS* ecs = Application::GetInstance()->GetScene()->GetECS();
-        ecs->AddObserver<ComponentType>(ECSEvent::OnRemove,
-                                        [this](flecs::entity e, ComponentType& component)
-                                        {
-                                            ComponentRemoved<ComponentType> event;
-                                            event.entity = Entity(e);
-                                            Send<ComponentRemoved<ComponentType>>(event);
-                                        });
-        // need to reregister with the new ecs when the scene is switched
-        Subscribe<SceneSwitchedEvent>(
-            [this](SceneSwitchedEvent e)
-            {
-                e.newScene->ecs->AddObserver<ComponentType>(ECSEvent::OnRemove,
-                                                            [this](flecs::entity e, ComponentType& component)
-                                                            {
-                                                                ComponentRemoved<ComponentType> event;
-                                                                event.entity = Entity(e);
-                                                                Send<ComponentRemoved<ComponentType>>(event);
-                                                            });
-            });
-    }
+    ObserveComponent<ComponentRemoved, ComponentType>(ECSEvent::OnRemove);
     m_eventCallbacks[typeid(ComponentRemoved<ComponentType>)].emplace_back(std::make_unique<EventDelegate<ComponentRemoved<ComponentType>>>(Callback));
 }
+
+template<typename Class, typename ComponentType>
+void EventHandler::Subscribe(Class* owner, void (Class::*Callback)(std::span<const ComponentAdded<ComponentType>>))
+{
+    ObserveComponent<ComponentAdded, ComponentType>(ECSEvent::OnAdd);
+    m_batchCallbacks[typeid(ComponentAdded<ComponentType>)].emplace_back(std::make_unique<BatchEventDelegate<ComponentAdded<ComponentType>>>(std::bind(Callback, owner, std::placeholders::_1)));
+}
+
+template<typename Class, typename ComponentType>
+void EventHandler::Subscribe(Class* owner, void (Class::*Callback)(std::span<const ComponentRemoved<ComponentType>>))
+{
+    ObserveComponent<ComponentRemoved, ComponentType>(ECSEvent::OnRemove);
+    m_batchCallbacks[typeid(ComponentRemoved<ComponentType>)].emplace_back(std::make_unique<BatchEventDelegate<ComponentRemoved<ComponentType>>>(std::bind(Callback, owner, std::placeholders::_1)));
+}
@@ -0,0 +1,414 @@
+#include "Core/Jobs/JobSystem.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <flecs.h>
+
+namespace
+{
+struct QueuedJob
+{
+    Job job;
+    JobCounter* counter = nullptr;
+};
+
+// Bounded Chase-Lev deque, the owner pushes and pops at the bottom and the thieves take the oldest job at the top with a CAS
+// a thief claims a slot by moving top before it reads it and frees it once the job was moved out, so the owner never overwrites a job
+// that is still being stolen, it sees a full deque instead
+class WorkQueue
+{
+public:
+    static constexpr int64_t CAPACITY = 1024;  // a power of two, a fork-join rarely has more jobs in flight per thread
+
+    bool Push(QueuedJob& queued);   // owner, false without touching queued when the deque is full
+    bool Pop(QueuedJob& queued);    // owner
+    bool Steal(QueuedJob& queued);  // any thread
+
+    std::mutex ownerMutex;  // only for the queue of the threads that aren't workers, they take turns being its owner
+
+private:
+    struct Slot
+    {
+        QueuedJob queued;
+        std::atomic<bool> full = false;
+    };
+
+    alignas(64) std::atomic<int64_t> m_top    = 0;
+    alignas(64) std::atomic<int64_t> m_bottom = 0;
+    std::unique_ptr<Slot[]> m_slots           = std::make_unique<Slot[]>(CAPACITY);
+};
+
+bool WorkQueue::Push(QueuedJob& queued)
+{
+    const int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+    Slot& slot           = m_slots[bottom & (CAPACITY - 1)];
+    if(slot.full.load(std::memory_order_acquire))  // CAPACITY jobs are queued, or the oldest one is still being moved out by a thief
+        return false;
+
+    slot.queued = std::move(queued);
+    slot.full.store(true, std::memory_order_relaxed);
+    m_bottom.store(bottom + 1, std::memory_order_release);
+    return true;
+}
+
+bool WorkQueue::Pop(QueuedJob& queued)
+{
+    // every store to bottom is a release, a thief reads the slots below whichever value it sees
+    const int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+    m_bottom.store(bottom, std::memory_order_release);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t top = m_top.load(std::memory_order_relaxed);
+    if(top > bottom)
+    {
+        m_bottom.store(bottom + 1, std::memory_order_release);
+        return false;
+    }
+    if(top == bottom)
+    {
+        // the last job, a thief can be claiming it at the same time
+        const bool claimed = m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+        m_bottom.store(bottom + 1, std::memory_order_release);
+        if(!claimed)
+            return false;
+    }
+
+    Slot& slot = m_slots[bottom & (CAPACITY - 1)];
+    queued     = std::move(slot.queued);
+    slot.full.store(false, std::memory_order_release);
+    return true;
+}
+
+bool WorkQueue::Steal(QueuedJob& queued)
+{
+    int64_t top = m_top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const int64_t bottom = m_bottom.load(std::memory_order_acquire);
+    if(top >= bottom)
+        return false;
+    if(!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        return false;  // another thief or the owner got it first
+
+    Slot& slot = m_slots[top & (CAPACITY - 1)];
+    queued     = std::move(slot.queued);
+    slot.full.store(false, std::memory_order_release);
+    return true;
+}
+
+// flecs' tasks, only a few per frame so a locked deque is enough
+struct TaskQueue
+{
+    std::mutex mutex;
+    std::deque<QueuedJob> jobs;
+};
+
+constexpr uint32_t NO_QUEUE           = UINT32_MAX;
+constexpr uint32_t SPINS_BEFORE_SLEEP = 64;  // fine grained jobs come in bursts, going to sleep between them costs more than spinning a bit
+
+thread_local uint32_t t_queueIndex = NO_QUEUE;
+
+ecs_os_api_cond_wait_t g_flecsCondWait = nullptr;  // the default one, for the threads that aren't workers
+
+void Finish(QueuedJob& queued)
+{
+    queued.job();
+    if(queued.counter != nullptr)
+        queued.counter->pending.fetch_sub(1, std::memory_order_release);
+}
+}
+
+struct JobSystem::Data
+{
+    std::vector<std::unique_ptr<WorkQueue>> queues;  // 0: main thread, 1 to workerCount: workers, last: every other thread (locked)
+    std::vector<std::thread> workers;
+    std::thread::id mainThread;
+
+    // flecs' worker tasks block on each other, only idle workers pick them up so a thread waiting on a counter never ends up in one
+    TaskQueue tasks;
+
+    std::atomic<uint32_t> queuedJobs      = 0;  // jobs and tasks
+    std::atomic<uint32_t> sleepingWorkers = 0;
+    std::atomic<bool> stop                = false;
+    std::mutex sleepMutex;
+    std::condition_variable wakeUp;
+
+    std::mutex mainThreadMutex;
+    std::vector<Job> mainThreadJobs;
+};
+
+JobSystem::Data* JobSystem::s_data = nullptr;
+
+void JobSystem::Initialize(uint32_t workerCount)
+{
+    assert(s_data == nullptr);
+    if(workerCount == 0)
+        workerCount = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+
+    s_data             = new Data();
+    s_data->mainThread = std::this_thread::get_id();
+    for(uint32_t i = 0; i < workerCount + 2; ++i)
+        s_data->queues.emplace_back(std::make_unique<WorkQueue>());
+
+    t_queueIndex = 0;
+    s_data->workers.reserve(workerCount);
+    for(uint32_t i = 1; i <= workerCount; ++i)
+        s_data->workers.emplace_back(WorkerLoop, i);
+
+    LOG_INFO("Started the job system with {0} workers", workerCount);
+}
+
+void JobSystem::Shutdown()
+{
+    if(s_data == nullptr)
+        return;
+
+    // the workers finish the queued jobs before they exit
+    {
+        std::lock_guard lock(s_data->sleepMutex);
+        s_data->stop = true;
+    }
+    s_data->wakeUp.notify_all();
+    for(std::thread& worker : s_data->workers)
+        worker.join();
+
+    delete s_data;
+    s_data       = nullptr;
+    t_queueIndex = NO_QUEUE;
+}
+
+uint32_t JobSystem::GetWorkerCount()
+{
+    return s_data != nullptr ? static_cast<uint32_t>(s_data->workers.size()) : 0;
+}
+
+bool JobSystem::IsMainThread()
+{
+    return s_data != nullptr && std::this_thread::get_id() == s_data->mainThread;
+}
+
+void JobSystem::Run(Job job, JobCounter* counter)
+{
+    if(counter != nullptr)
+        counter->pending.fetch_add(1, std::memory_order_relaxed);
+
+    QueuedJob queued{std::move(job), counter};
+    if(s_data == nullptr)
+    {
+        Finish(queued);
+        return;
+    }
+
+    // counted before it's pushed so a thief never takes queuedJobs below 0
+    // a worker going to sleep counts itself before it checks queuedJobs, so one of the two always sees the other
+    s_data->queuedJobs.fetch_add(1);
+    bool pushed = false;
+    if(t_queueIndex != NO_QUEUE)
+        pushed = s_data->queues[t_queueIndex]->Push(queued);
+    else
+    {
+        WorkQueue& shared = *s_data->queues.back();
+        std::lock_guard lock(shared.ownerMutex);
+        pushed = shared.Push(queued);
+    }
+    if(!pushed)
+    {
+        s_data->queuedJobs.fetch_sub(1);
+        Finish(queued);  // the deque is full, the jobs in it keep the others busy
+        return;
+    }
+
+    if(s_data->sleepingWorkers.load() > 0)
+    {
+        {
+            std::lock_guard lock(s_data->sleepMutex);
+        }
+        s_data->wakeUp.notify_one();
+    }
+}
+
+void JobSystem::Wait(JobCounter& counter)
+{
+    const uint32_t queueIndex = t_queueIndex != NO_QUEUE || s_data == nullptr ? t_queueIndex : static_cast<uint32_t>(s_data->queues.size() - 1);
+    while(!counter.IsDone())
+    {
+        if(!TryRunJob(queueIndex))
+            std::this_thread::yield();
+    }
+}
+
+void JobSystem::ParallelFor(uint32_t count, uint32_t minPerJob, const std::function<void(uint32_t first, uint32_t end)>& fn)
+{
+    if(count == 0)
+        return;
+
+    const uint32_t jobCount = std::clamp(count / std::max(minPerJob, 1u), 1u, GetWorkerCount() + 1);
+    if(jobCount == 1)
+    {
+        fn(0, count);
+        return;
+    }
+
+    JobCounter counter;
+    for(uint32_t j = 1; j < jobCount; ++j)
+    {
+        const uint32_t first = static_cast<uint32_t>(static_cast<uint64_t>(count) * j / jobCount);
+        const uint32_t end   = static_cast<uint32_t>(static_cast<uint64_t>(count) * (j + 1) / jobCount);
+        Run([&fn, first, end]() { fn(first, end); }, &counter);
+    }
+    fn(0, count / jobCount);
+    Wait(counter);
+}
+
+void JobSystem::RunOnMainThread(Job job)
+{
+    if(s_data == nullptr || IsMainThread())
+    {
+        job();
+        return;
+    }
+
+    std::lock_guard lock(s_data->mainThreadMutex);
+    s_data->mainThreadJobs.push_back(std::move(job));
+}
+
+void JobSystem::ProcessMainThreadJobs()
+{
+    PROFILE_FUNCTION();
+    assert(s_data == nullptr || IsMainThread());
+    if(s_data == nullptr)
+        return;
+
+    // jobs queued while these run wait for the next call
+    std::vector<Job> jobs;
+    {
+        std::lock_guard lock(s_data->mainThreadMutex);
+        jobs.swap(s_data->mainThreadJobs);
+    }
+    for(Job& job : jobs)
+        job();
+}
+
+void JobSystem::SetFlecsTaskAPI()
+{
+    assert(s_data != nullptr);
+
+    ecs_os_set_api_defaults();
+    ecs_os_api_t api = ecs_os_api;
+
+    // the task handle is the counter of the job running it
+    api.task_new_ = [](ecs_os_thread_callback_t callback, void* param) -> ecs_os_thread_t
+    {
+        auto* counter = new JobCounter();
+        counter->pending.store(1, std::memory_order_relaxed);
+        {
+            std::lock_guard lock(s_data->tasks.mutex);
+            s_data->tasks.jobs.push_back({[callback, param]() { callback(param); }, counter});
+        }
+        s_data->queuedJobs.fetch_add(1);
+        {
+            std::lock_guard lock(s_data->sleepMutex);
+        }
+        s_data->wakeUp.notify_all();
+        return reinterpret_cast<ecs_os_thread_t>(counter);
+    };
+    api.task_join_ = [](ecs_os_thread_t thread) -> void*
+    {
+        auto* counter = reinterpret_cast<JobCounter*>(thread);
+        Wait(*counter);
+        delete counter;
+        return nullptr;
+    };
+
+    // flecs' threads wait for each other at the sync points of the pipeline, the workers would sit there while the main thread runs the
+    // single threaded systems, which fork-join on the job system themselves (the TransformSystem), so a waiting worker runs jobs instead
+    // flecs checks its condition again after every wait like after a spurious wakeup, so returning without a signal is fine
+    g_flecsCondWait = api.cond_wait_;
+    api.cond_wait_  = [](ecs_os_cond_t cond, ecs_os_mutex_t mutex)
+    {
+        if(t_queueIndex == 0 || t_queueIndex == NO_QUEUE)  // not a worker
+        {
+            g_flecsCondWait(cond, mutex);
+            return;
+        }
+
+        ecs_os_mutex_unlock(mutex);
+        if(!TryRunJob(t_queueIndex))
+            std::this_thread::yield();
+        ecs_os_mutex_lock(mutex);
+    };
+    ecs_os_set_api(&api);
+}
+
+bool JobSystem::TryRunJob(uint32_t queueIndex)
+{
+    // the own queue from the back, it is the most recently spawned work and still in the cache, then steal the oldest jobs of the others
+    const auto queueCount = static_cast<uint32_t>(s_data->queues.size());
+    QueuedJob queued;
+    bool found = false;
+    if(queueIndex == queueCount - 1)
+    {
+        WorkQueue& shared = *s_data->queues.back();
+        std::lock_guard lock(shared.ownerMutex);
+        found = shared.Pop(queued);
+    }
+    else
+        found = s_data->queues[queueIndex]->Pop(queued);
+
+    for(uint32_t i = 1; i < queueCount && !found; ++i)
+        found = s_data->queues[(queueIndex + i) % queueCount]->Steal(queued);
+    if(!found)
+        return false;
+
+    s_data->queuedJobs.fetch_sub(1);
+    Finish(queued);
+    return true;
+}
+
+void JobSystem::WorkerLoop(uint32_t queueIndex)
+{
+    t_queueIndex = queueIndex;
+
+    uint32_t spins = 0;
+    while(true)
+    {
+        QueuedJob task{};
+        {
+            std::lock_guard lock(s_data->tasks.mutex);
+            if(!s_data->tasks.jobs.empty())
+            {
+                task = std::move(s_data->tasks.jobs.front());
+                s_data->tasks.jobs.pop_front();
+            }
+        }
+        if(task.job)
+        {
+            s_data->queuedJobs.fetch_sub(1);
+            Finish(task);
+            spins = 0;
+            continue;
+        }
+
+        if(TryRunJob(queueIndex))
+        {
+            spins = 0;
+            continue;
+        }
+
+        if(++spins < SPINS_BEFORE_SLEEP)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        spins = 0;
+
+        std::unique_lock lock(s_data->sleepMutex);
+        s_data->sleepingWorkers.fetch_add(1);
+        s_data->wakeUp.wait(lock, []() { return s_data->stop || s_data->queuedJobs.load() > 0; });
+        s_data->sleepingWorkers.fetch_sub(1);
+        if(s_data->stop && s_data->queuedJobs.load() == 0)
+            return;
+    }
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// Counts the jobs of a fork-join that haven't finished yet, wait on it with JobSystem::Wait
+// it has to outlive the jobs it was passed to
+struct JobCounter
+{
+    std::atomic<uint32_t> pending = 0;
+
+    [[nodiscard]] bool IsDone() const { return pending.load(std::memory_order_acquire) == 0; }
+};
+
+// A callable of a fixed size, the lambda's captures are stored inline so queueing a job doesn't allocate like a std::function can
+// captures bigger than CAPACITY don't compile, capture a pointer to them instead
+class Job
+{
+public:
+    static constexpr size_t CAPACITY = 48;  // 64 bytes with the two function pointers, a job is one cache line
+
+    Job() = default;
+    template<typename F>
+        requires(!std::is_same_v<std::decay_t<F>, Job> && std::is_invocable_v<std::decay_t<F>&>)
+    Job(F&& fn)  // implicit so lambdas convert to jobs like they do to std::function
+    {
+        using T = std::decay_t<F>;
+        static_assert(sizeof(T) <= CAPACITY, "the captures of the job are too big, capture a pointer to them instead");
+        static_assert(alignof(T) <= alignof(std::max_align_t));
+
+        new(m_storage) T(std::forward<F>(fn));
+        m_invoke = [](void* storage) { (*static_cast<T*>(storage))(); };
+        m_move   = [](void* dst, void* src)
+        {
+            if(dst != nullptr)
+                new(dst) T(std::move(*static_cast<T*>(src)));
+            static_cast<T*>(src)->~T();
+        };
+    }
+    ~Job() { Reset(); }
+
+    Job(Job&& other) noexcept { *this = std::move(other); }
+    Job& operator=(Job&& other) noexcept
+    {
+        if(this == &other)
+            return *this;
+        Reset();
+        if(other.m_move != nullptr)
+        {
+            other.m_move(m_storage, other.m_storage);
+            m_invoke       = other.m_invoke;
+            m_move         = other.m_move;
+            other.m_invoke = nullptr;
+            other.m_move   = nullptr;
+        }
+        return *this;
+    }
+    Job(const Job&)            = delete;
+    Job& operator=(const Job&) = delete;
+
+    void operator()() { m_invoke(m_storage); }
+    explicit operator bool() const { return m_invoke != nullptr; }
+
+private:
+    alignas(std::max_align_t) std::byte m_storage[CAPACITY];
+    void (*m_invoke)(void* storage)      = nullptr;
+    void (*m_move)(void* dst, void* src) = nullptr;  // moves the callable to dst when it isn't nullptr and destroys the one in src
+
+    void Reset()
+    {
+        if(m_move != nullptr)
+            m_move(nullptr, m_storage);
+        m_invoke = nullptr;
+        m_move   = nullptr;
+    }
+};
+
+// Engine wide pool of worker threads, one per hardware thread besides the main thread
+// Every worker has its own bounded Chase-Lev deque, it pushes and pops the jobs it spawns at the back without locking and the idle workers
+// steal from the front of the others with a CAS, a job pushed to a full deque runs right away on the thread that pushed it
+// Threads waiting on a counter run jobs in the meantime so nested fork-joins don't block the pool
+// Jobs must not wait on the main thread, it might be waiting on them
+class JobSystem
+{
+public:
+    // workerCount 0 starts one worker per hardware thread minus the calling thread, which becomes the main thread
+    static void Initialize(uint32_t workerCount = 0);
+    static void Shutdown();
+
+    [[nodiscard]] static bool IsInitialized() { return s_data != nullptr; }
+    [[nodiscard]] static uint32_t GetWorkerCount();
+    [[nodiscard]] static bool IsMainThread();
+
+    // the counter is incremented right away and decremented once the job finished
+    static void Run(Job job, JobCounter* counter = nullptr);
+    static void Wait(JobCounter& counter);
+
+    // splits [0, count) into ranges of at least minPerJob elements, one per worker at most, and waits for all of them
+    // the calling thread runs the first range, everything runs on it when the job system isn't initialized
+    static void ParallelFor(uint32_t count, uint32_t minPerJob, const std::function<void(uint32_t first, uint32_t end)>& fn);
+
+    // queued from any thread and run by ProcessMainThreadJobs, for what has to happen on the main thread like touching the ECS or the window
+    static void RunOnMainThread(Job job);
+    static void ProcessMainThreadJobs();
+
+    // routes the worker tasks flecs starts for set_task_threads to the job system, has to be called before the worlds are created
+    // the workers waiting at flecs' sync points run jobs in the meantime
+    static void SetFlecsTaskAPI();
+
+private:
+    struct Data;
+    static Data* s_data;
+
+    static void WorkerLoop(uint32_t queueIndex);
+    static bool TryRunJob(uint32_t queueIndex);
+};
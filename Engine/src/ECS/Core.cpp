@@ -1,11 +1,21 @@
 #include "ECS/Core.hpp"
 #include "ECS/CoreSystems/MainCameraSystem.hpp"
 #include "ECS/CoreSystems/TransformSystem.hpp"
+#include "Core/Jobs/JobSystem.hpp"
+#include "Core/Events/EventHandler.hpp"
+#include "ECS/CoreEvents/EntityEvents.hpp"
+#include "ECS/CoreComponents/InternalTransform.hpp"
+#include "ECS/CoreComponents/Transform.hpp"
+#include "Application.hpp"
+#include <algorithm>
 #include <format>
 
 ECS::ECS()
 {
-    m_world.add<MainCameraData>();
+    SetThreadCount(JobSystem::GetWorkerCount() + 1);
+
+    AddSingleton<MainCameraData>();
+    AddSingleton<SystemSchedule>();
     AddSystem<TransformSystem>();
     AddSystem<MainCameraSystem>();
 }
@@ -16,7 +26,21 @@ ECS::~ECS()
 
 void ECS::Update(float dt)
 {
+    // one list per thread, the last update's are kept until now for the SystemScheduleUI
+    m_frameRecord.threads.resize(m_threadCount);
+    for(std::vector<SystemFrameRecord::Run>& runs : m_frameRecord.threads)
+        runs.clear();
+    m_frameRecord.start = std::chrono::steady_clock::now();
+
     m_world.progress(dt);
+
+    m_frameRecord.duration = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - m_frameRecord.start).count();
+}
+
+void ECS::SetThreadCount(uint32_t count)
+{
+    m_threadCount = std::clamp(count, 1u, JobSystem::GetWorkerCount() + 1);
+    m_world.set_task_threads(static_cast<int32_t>(m_threadCount));
 }
 
 Entity ECS::CreateEntity(const std::string& name)
@@ -34,6 +58,69 @@ Entity ECS::CreateChildEntity(const Entity* parent, const std::string& name)
     return e;
 }
 
+std::vector<Entity> ECS::CreateChildEntities(const Entity* parent, std::span<const Transform> transforms, std::span<const std::string> names)
+{
+    assert(names.empty() || names.size() == transforms.size());
+
+    // bulk init copies the transforms into the table
+    std::vector<flecs::id_t> ids{m_world.id<Transform>()};
+    std::vector<void*> data{const_cast<Transform*>(transforms.data())};
+    std::vector<Entity> entities = BulkInit(parent, static_cast<uint32_t>(transforms.size()), ids, data, true, false);
+
+    const std::string scope = parent ? parent->GetName() : "";
+    for(size_t i = 0; i < names.size(); ++i)
+    {
+        if(names[i].empty())
+            continue;
+        const uint32_t count = m_entityNames[parent ? std::format("{}::{}", scope, names[i]) : names[i]]++;
+        entities[i].SetName(count > 0 ? std::format("{}_({})", names[i], count) : names[i]);
+    }
+    return entities;
+}
+
+std::vector<Entity> ECS::BulkInit(const Entity* parent, uint32_t count, std::vector<flecs::id_t>& ids, std::vector<void*>& data, bool hasTransform, bool hasInternalTransform)
+{
+    PROFILE_FUNCTION();
+    if(!hasTransform)
+    {
+        ids.push_back(m_world.id<Transform>());
+        data.push_back(nullptr);
+    }
+    if(!hasInternalTransform)
+    {
+        ids.push_back(m_world.id<InternalTransform>());
+        data.push_back(nullptr);
+    }
+    if(parent)
+    {
+        ids.push_back(ecs_pair(flecs::ChildOf, parent->m_entity.id()));
+        data.push_back(nullptr);
+    }
+    assert(ids.size() <= FLECS_ID_DESC_MAX && "Too many components for a bulk init");
+
+    ecs_bulk_desc_t desc{};
+    desc.count = static_cast<int32_t>(count);
+    for(size_t i = 0; i < ids.size(); ++i)
+    {
+        desc.ids[i]  = ids[i];
+        desc.data[i] = data[i];
+    }
+    const ecs_entity_t* created = ecs_bulk_init(m_world.c_ptr(), &desc);  // points into flecs' storage, only valid until the next entity is created
+
+    EntitiesCreated event;
+    event.entities.reserve(count);
+    for(uint32_t i = 0; i < count; ++i)
+    {
+        Entity entity{m_world.entity(created[i])};
+        entity.m_ecs = this;
+        event.entities.push_back(entity);
+    }
+    std::vector<Entity> entities = event.entities;
+    if(Application* app = Application::GetInstance())  // there's none in the benchmarks
+        app->GetEventHandler()->Send<EntitiesCreated>(std::move(event));
+    return entities;
+}
+
 void ECS::DestroyEntity(Entity& entity)
 {
     entity.m_entity.destruct();
@@ -1,9 +1,19 @@
 #pragma once
 
 #include <flecs.h>
+#include <span>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
 #include "ECS/Entity.hpp"
 #include "ECS/Query.hpp"
 #include "ECS/Observer.hpp"
+#include "ECS/System.hpp"
+
+struct Transform;
+struct InternalTransform;
 
 
 class ECS
@@ -14,11 +24,38 @@ public:
 
     void Update(float dt);
 
+    // the multi threaded systems are split across count threads, the main thread included, the others run as tasks on the JobSystem's workers
+    // clamped to the workers + 1 because flecs' threads wait for each other, a task no worker picks up would block the rest
+    void SetThreadCount(uint32_t count);
+    [[nodiscard]] uint32_t GetThreadCount() const { return m_threadCount; }
+
+    // when the systems ran during the last Update and on which threads, read it on the main thread between the updates
+    [[nodiscard]] const SystemFrameRecord& GetLastFrameRecord() const { return m_frameRecord; }
+
 
     Entity CreateEntity(const std::string& name = "Entity");
     Entity CreateChildEntity(const Entity* parent, const std::string& name = "Entity");
     void DestroyEntity(Entity& entity);
 
+    // creates count entities with Transform, InternalTransform and Components in one go with flecs' bulk init, every entity is moved into its
+    // table once instead of once per component, and a single EntitiesCreated event is sent instead of one EntityCreated per entity
+    // flecs still runs the OnAdd/OnSet observers once per entity, so the ComponentAdded events are still sent for each of them
+    // every entity gets a copy of the given values, Transform and InternalTransform are default constructed unless they are passed too
+    // the entities aren't named, GetName makes one up from the id and SetName can name the ones that need it later
+    template<typename... Components>
+    std::vector<Entity> CreateEntities(uint32_t count, const Components&... components)
+    {
+        return CreateEntitiesInBulk(nullptr, count, components...);
+    }
+    template<typename... Components>
+    std::vector<Entity> CreateChildEntities(const Entity* parent, uint32_t count, const Components&... components)
+    {
+        return CreateEntitiesInBulk(parent, count, components...);
+    }
+    // the same with one child per transform, for loading a hierarchy a level at a time
+    // the names get the same suffixes as CreateChildEntity gives them to keep them unique, the entities with an empty name stay unnamed
+    std::vector<Entity> CreateChildEntities(const Entity* parent, std::span<const Transform> transforms, std::span<const std::string> names = {});
+
     template<typename T, typename... Args>
     void AddSystem(Args&&... args);
     // Do we want to be able to remove systems?
@@ -87,13 +124,39 @@ private:
     friend class Entity;
     flecs::world m_world;
     std::unordered_map<std::string, uint32_t> m_entityNames;
+    uint32_t m_threadCount = 1;
+    SystemFrameRecord m_frameRecord;  // the systems keep pointers into it, the ECS isn't moved
+
+    template<typename... Components>
+    std::vector<Entity> CreateEntitiesInBulk(const Entity* parent, uint32_t count, const Components&... components);
+    // data has one array of count values per id, nullptr for the ones that are default constructed and for tags
+    std::vector<Entity> BulkInit(const Entity* parent, uint32_t count, std::vector<flecs::id_t>& ids, std::vector<void*>& data, bool hasTransform, bool hasInternalTransform);
 };
 
+template<typename... Components>
+std::vector<Entity> ECS::CreateEntitiesInBulk(const Entity* parent, uint32_t count, const Components&... components)
+{
+    std::tuple<std::vector<Components>...> values{std::vector<Components>(count, components)...};  // bulk init copies these into the table
+
+    std::vector<flecs::id_t> ids;
+    std::vector<void*> data;
+    std::apply(
+        [&](auto&... arrays)
+        {
+            (ids.push_back(m_world.id<typename std::decay_t<decltype(arrays)>::value_type>()), ...);
+            (data.push_back(std::is_empty_v<typename std::decay_t<decltype(arrays)>::value_type> ? nullptr : static_cast<void*>(arrays.data())), ...);
+        },
+        values);
+
+    return BulkInit(parent, count, ids, data, (std::is_same_v<Components, Transform> || ...), (std::is_same_v<Components, InternalTransform> || ...));
+}
+
 template<typename T, typename... Args>
 void ECS::AddSystem(Args&&... args)
 {
     T system(std::forward<Args>(args)...);
-    system.m_world = &m_world;
+    system.m_world       = &m_world;
+    system.m_frameRecord = &m_frameRecord;
     system.Initialize();
     // we just need to initialise it so that the system will register itself with the world and we don't have to keep it around after as systems should have no persistent state
 }
@@ -1,7 +1,15 @@
 #pragma once
+#include <flecs.h>
 #include <glm/glm.hpp>
+#include "ECS/CoreComponents/Transform.hpp"
 
 struct InternalTransform
 {
     glm::mat4 worldTransform = glm::mat4(1);
+
+    // kept by the TransformSystem, worldTransform is only recomputed when the Transform, the parent or the parent's world transform changed
+    Transform localTransform;        // the Transform worldTransform was computed from
+    flecs::entity_t parent = 0;      // the parent worldTransform was computed with, 0 for the roots
+    uint32_t changedFrame  = 0;      // update of the TransformSystem that last changed worldTransform
+    bool computed          = false;  // false until the first update
 };
@@ -18,8 +18,8 @@ struct DirectionalLight
     float intensity;
 
 
-    uint32_t _slot;        // internal
-    uint32_t _shadowSlot;  // internal
+    uint32_t _slot = UINT32_MAX;  // internal, set once the renderer added the light
+    uint32_t _shadowSlot;         // internal
 };
 
 struct Attenuation
@@ -39,8 +39,8 @@ struct PointLight
     Attenuation attenuation;
 
 
-    uint32_t _slot;        // internal
-    uint32_t _shadowSlot;  // internal
+    uint32_t _slot = UINT32_MAX;  // internal, set once the renderer added the light
+    uint32_t _shadowSlot;         // internal
 };
 
 struct SpotLight
@@ -53,6 +53,6 @@ struct SpotLight
     Attenuation attenuation;
 
 
-    uint32_t _slot;        // internal
-    uint32_t _shadowSlot;  // internal
+    uint32_t _slot = UINT32_MAX;  // internal, set once the renderer added the light
+    uint32_t _shadowSlot;         // internal
 };
@@ -10,6 +10,30 @@ struct Vertex
     glm::vec3 normal;
 };
 
+// cluster of up to MESHLET_MAX_VERTICES vertices / MESHLET_MAX_TRIANGLES triangles, built at import time (see Utils/MeshletBuilder.hpp)
+// the bounds are in object space and are used for per cluster culling on the gpu
+struct Meshlet
+{
+    uint32_t indexOffset;  // into Mesh::indices, the triangles of a meshlet are contiguous
+    uint32_t indexCount;
+
+    glm::vec3 center;  // bounding sphere
+    float radius;
+
+    glm::vec3 coneAxis;  // normal cone, the meshlet is backfacing if dot(center - cameraPos, coneAxis) >= coneCutoff * length(center - cameraPos) + radius
+    float coneCutoff;    // 1 if the normals are too spread out for the cone test to ever cull the meshlet
+};
+
+constexpr uint32_t MAX_MESH_LODS = 4;  // has to match MAX_MESH_LODS in shaders/drawcull.comp
+
+// range of Mesh::indices used by one level of detail, generated at import time (see Utils/MeshSimplifier.hpp)
+struct MeshLod
+{
+    uint32_t indexOffset;
+    uint32_t indexCount;
+    float error;  // object space distance to the full detail mesh, 0 for LOD 0
+};
+
 struct Mesh
 {
     Mesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices) : vertices(vertices),
@@ -17,4 +41,6 @@ struct Mesh
     Mesh(){};
     std::vector<Vertex> vertices;
     std::vector<uint32_t> indices;
+    std::vector<Meshlet> meshlets;  // optional, empty if the mesh hasn't been split into meshlets, only covers LOD 0
+    std::vector<MeshLod> lods;      // optional, empty if the mesh has no LODs in which case all the indices are LOD 0
 };
@@ -4,8 +4,10 @@ struct Renderable
 {
     uint32_t vertexOffset;
     uint32_t vertexCount;
-    uint32_t indexOffset;
-    uint32_t indexCount;
+    uint32_t indexOffset;        // in the 16 bit index buffer if uses16BitIndices is set
+    uint32_t indexCount;         // includes the indices of every LOD
+    uint32_t meshletIndexCount;  // room after the indices for the visible meshlets of LOD 0, 0 if the mesh isn't culled per meshlet
+    bool uses16BitIndices;
 
     uint32_t objectID;
 };
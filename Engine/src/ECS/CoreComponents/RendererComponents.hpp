@@ -2,11 +2,16 @@
 
 #include "Rendering/Buffer.hpp"
 #include "Rendering/Image.hpp"
+#include "ECS/CoreComponents/Camera.hpp"
+
+#include <memory>
+#include <glm/glm.hpp>
 
 struct DrawCommandBuffer
 {
     DynamicBufferAllocator buffer;
     uint32_t count{};
+    uint32_t count16{};  // draws using 16 bit indices, they are at the start of the buffer
 
     template<typename... Args,
              std::enable_if_t<std::is_constructible_v<DynamicBufferAllocator, Args...>, int> = 0>
@@ -43,6 +48,143 @@ struct BoundingBoxBuffer
     BoundingBoxBuffer& operator=(BoundingBoxBuffer&&) = default;
 };
 
+// LODs of the draw commands, same order as DrawCommandBuffer
+struct DrawLodBuffer
+{
+    DynamicBufferAllocator buffer;
+
+    template<typename... Args,
+             std::enable_if_t<std::is_constructible_v<DynamicBufferAllocator, Args...>, int> = 0>
+    DrawLodBuffer(Args&&... args) : buffer(std::forward<Args>(args)...)
+    {
+    }
+
+    ~DrawLodBuffer() = default;
+
+    DrawLodBuffer(const DrawLodBuffer&)            = delete;
+    DrawLodBuffer& operator=(const DrawLodBuffer&) = delete;
+
+    DrawLodBuffer(DrawLodBuffer&&)            = default;
+    DrawLodBuffer& operator=(DrawLodBuffer&&) = default;
+};
+
+// dequantization parameters for the packed vertex positions, indexed by objectID (see Utils/VertexQuantization.hpp)
+// doesn't need a buffer per frame since they only change when a mesh is added
+struct VertexQuantizationBuffer
+{
+    DynamicBufferAllocator buffer;
+
+    template<typename... Args,
+             std::enable_if_t<std::is_constructible_v<DynamicBufferAllocator, Args...>, int> = 0>
+    VertexQuantizationBuffer(Args&&... args) : buffer(std::forward<Args>(args)...)
+    {
+    }
+
+    ~VertexQuantizationBuffer() = default;
+
+    VertexQuantizationBuffer(const VertexQuantizationBuffer&)            = delete;
+    VertexQuantizationBuffer& operator=(const VertexQuantizationBuffer&) = delete;
+
+    VertexQuantizationBuffer(VertexQuantizationBuffer&&)            = default;
+    VertexQuantizationBuffer& operator=(VertexQuantizationBuffer&&) = default;
+};
+
+// meshlet draws of the renderables drawn through meshlets, culled one by one by shaders/meshletcull.comp
+struct MeshletDrawCommandBuffer
+{
+    DynamicBufferAllocator buffer;
+    uint32_t count{};
+    uint32_t count16{};  // meshlets of meshes using 16 bit indices, they are at the start of the buffer
+
+    template<typename... Args,
+             std::enable_if_t<std::is_constructible_v<DynamicBufferAllocator, Args...>, int> = 0>
+    MeshletDrawCommandBuffer(Args&&... args) : buffer(std::forward<Args>(args)...)
+    {
+    }
+
+    ~MeshletDrawCommandBuffer() = default;
+
+    MeshletDrawCommandBuffer(const MeshletDrawCommandBuffer&)            = delete;
+    MeshletDrawCommandBuffer& operator=(const MeshletDrawCommandBuffer&) = delete;
+
+    MeshletDrawCommandBuffer(MeshletDrawCommandBuffer&&)            = default;
+    MeshletDrawCommandBuffer& operator=(MeshletDrawCommandBuffer&&) = default;
+};
+
+// hierarchical min depth buffer built by the HiZPass, read by the culling pass of the following frame
+struct DepthPyramid
+{
+    static constexpr uint32_t MAX_LEVELS = 16;  // has to match the slots array in shaders/meshletcull.comp
+
+    std::vector<std::unique_ptr<Image>> levels;  // level 0 is half the resolution of the depth image
+    uint32_t width  = 0;                         // size of the depth image the pyramid was created for
+    uint32_t height = 0;
+
+    glm::mat4 viewProj{1.0f};  // of the frame the pyramid was built in
+    bool valid = false;
+
+    DepthPyramid() = default;
+
+    ~DepthPyramid() = default;
+
+    DepthPyramid(const DepthPyramid&)            = delete;
+    DepthPyramid& operator=(const DepthPyramid&) = delete;
+
+    DepthPyramid(DepthPyramid&&)            = default;
+    DepthPyramid& operator=(DepthPyramid&&) = default;
+};
+
+// closest and farthest depth of the visible geometry found by the DepthReductionPass, the cascades of the directional lights are fit to it
+// every frame has its own buffer that is read back when the frame comes around again, so the range lags NUM_FRAMES_IN_FLIGHT frames behind
+struct DepthRange
+{
+    std::vector<Buffer> buffers;  // one per frame, the float bits of the min and max depth
+    float minDepth = 0.0f;        // reverse z, the farthest depth
+    float maxDepth = 0.0f;        // the closest depth, 0 when nothing was drawn
+    bool enabled   = true;
+
+    DepthRange()
+    {
+        buffers.reserve(NUM_FRAMES_IN_FLIGHT);
+    }
+
+    ~DepthRange() = default;
+
+    DepthRange(const DepthRange&)            = delete;
+    DepthRange& operator=(const DepthRange&) = delete;
+
+    DepthRange(DepthRange&&)            = default;
+    DepthRange& operator=(DepthRange&&) = default;
+};
+
+// depth of the casters with the Static tag for every cascade of the shadowed directional lights, only re-rendered when a cascade moves
+// the ShadowPass copies a cascade into the shadow map when it changed or when dynamic casters are drawn on top of it now or were the last frame
+// the other cascades of the shadow map still have the static casters of the last copy
+// the lists are only changed by Renderer::Render before and after the frame is recorded, the passes just read them
+struct StaticShadowCache
+{
+    std::vector<std::unique_ptr<Image>> images;  // same index and layers as the shadow maps
+    uint32_t dirtyLists   = ~0u;                 // one bit per shadow draw list (light * NUM_CASCADES + cascade) whose static casters have to be re-rendered
+    uint32_t dynamicLists = ~0u;                 // the lists whose cascade has casters without the Static tag in it this frame
+    uint32_t restoreLists = ~0u;                 // the dynamicLists of the last frame, their layer of the shadow map has to start from the cache again
+    bool enabled          = true;
+
+    StaticShadowCache() = default;
+
+    ~StaticShadowCache() = default;
+
+    StaticShadowCache(const StaticShadowCache&)            = delete;
+    StaticShadowCache& operator=(const StaticShadowCache&) = delete;
+
+    StaticShadowCache(StaticShadowCache&&)            = default;
+    StaticShadowCache& operator=(StaticShadowCache&&) = default;
+};
+
+// the MainCameraData of the frame that is being rendered, the render passes read this one because the MainCameraSystem already updates the next frame's
+struct FrameCameraData : MainCameraData
+{
+};
+
 struct TransformBuffers
 {
     std::vector<DynamicBufferAllocator> buffers;
@@ -101,15 +243,56 @@ struct ShadowBuffers
     ShadowBuffers& operator=(ShadowBuffers&&) = default;
 };
 
+// shadows of the point and spot lights, every light gets tiles of one atlas sized by how much of the screen it covers (see Renderer::UpdateShadowAtlas)
+// only the tiles in views are re-rendered this frame, the others keep what was rendered into them the last time
+struct LocalShadowBuffers
+{
+    std::vector<DynamicBufferAllocator> dataBuffers;  // one LocalShadowData per shadow slot of the point and spot lights
+    std::vector<DynamicBufferAllocator> viewBuffers;  // view projection of every tile in views
+    std::vector<glm::uvec3> views;                    // atlas offset and size of the tiles rendered this frame
+    float updateBudget = 12.0f;                       // tiles re-rendered per frame, a float so the debug ui can edit it
+
+    LocalShadowBuffers()
+    {
+        dataBuffers.reserve(NUM_FRAMES_IN_FLIGHT);
+        viewBuffers.reserve(NUM_FRAMES_IN_FLIGHT);
+    }
+
+    ~LocalShadowBuffers() = default;
+
+    LocalShadowBuffers(const LocalShadowBuffers&)            = delete;
+    LocalShadowBuffers& operator=(const LocalShadowBuffers&) = delete;
+
+    LocalShadowBuffers(LocalShadowBuffers&&)            = default;
+    LocalShadowBuffers& operator=(LocalShadowBuffers&&) = default;
+};
+
+// size of a packed light index list, Renderer::ResizeLightLists resizes the list to what the culling asked for
+struct LightListSize
+{
+    uint32_t capacity  = 0;  // in uints
+    uint32_t peak      = 0;  // the most the culling asked for during the low frames, the list shrinks to fit it
+    uint32_t lowFrames = 0;  // frames in a row the culling used less than a quarter of the list
+};
+
 struct LightBuffers
 {
     std::vector<DynamicBufferAllocator> buffers;
-    Buffer visibleLightsBuffer;  // this one is fixed max size
+    Buffer visibleLightsBuffer;             // offset and count of every 16x16 tile in tileLightIndexBuffer
+    Buffer tileLightIndexBuffer;            // packed lists of the tiles
+    LightListSize tileLightIndexSize;
+    Buffer clusterBuffer;                   // offset and count of every cluster in lightIndexBuffer
+    Buffer lightBinBuffer;                  // per bin of CLUSTER_BIN_TILES x CLUSTER_BIN_TILES cluster tiles, the count and the first MAX_BIN_LIGHTS lights that touch it
+    Buffer lightIndexBuffer;                // packed lists of the clusters
+    LightListSize lightIndexSize;
+    std::vector<Buffer> lightListCounters;  // one per frame, uints of tileLightIndexBuffer and of lightIndexBuffer the culling asked for, read back by Renderer::ResizeLightLists
     uint32_t lightNum = 0;
+    bool clustered    = true;  // otherwise the lights are culled per 2D tile
 
     LightBuffers()
     {
         buffers.reserve(NUM_FRAMES_IN_FLIGHT);
+        lightListCounters.reserve(NUM_FRAMES_IN_FLIGHT);
     }
 
     ~LightBuffers() = default;
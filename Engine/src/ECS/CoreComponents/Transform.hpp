@@ -9,4 +9,6 @@ struct Transform
 	glm::vec3 pos = glm::vec3(0);
 	glm::quat rot = glm::quat(1.0, 0.0, 0.0, 0.0);
 	glm::vec3 scale = glm::vec3(1);
+
+	bool operator==(const Transform& other) const = default;
 };
@@ -3,7 +3,15 @@
 #include "Core/Events/Event.hpp"
 #include "ECS/Entity.hpp"
 
+#include <vector>
+
 struct EntityCreated : public Event
 {
     Entity entity;
 };
+
+// sent once for all the entities of an ECS::CreateEntities call instead of an EntityCreated for each
+struct EntitiesCreated : public Event
+{
+    std::vector<Entity> entities;
+};
@@ -1,19 +1,42 @@
 #include "TransformSystem.hpp"
-#include <glm/gtx/quaternion.hpp>
+#include "ECS/Entity.hpp"
+#include "Core/Jobs/JobSystem.hpp"
+#include "Utils/Math/AffineTransforms.hpp"
+#include <algorithm>
 
 void TransformSystem::Initialize()
 {
+    AddContextSingleton<TransformSystemContext>({});
+
+    HierarchyQuery hierarchy = StartQueryBuilder<const Transform, const InternalTransform*, InternalTransform>()
+                                   .term_at(2)
+                                   .parent()
+                                   .cascade()   // second term comes from parent in breadth first order, the tables are grouped by depth
+                                   .optional()  // to match root level entities as well
+                                   .build();
+
     // Pre render phase because we want to calculate the world transforms at the end after all gameplay logic is done, right before rendering
-    StartSystemBuilder<const Transform, const InternalTransform*, InternalTransform>(
+    // the system only has the context singleton so it runs once per frame and iterates the hierarchy itself
+    StartSystemBuilder<TransformSystemContext>(
         SystemPhase::PostUpdate,  // TODO: is this the right phase for this?
-        [](auto& builder)
+        [hierarchy](auto& builder)
         {
-            builder.term_at(2)
-                .parent()
-                .cascade()   // second term comes from parent in breadth first order
-                .optional()  // to match root level entities as well
-
-                .each(CalculateWorldTransforms);
+            builder.term_at(1)
+                .singleton()
+                .iter(
+                    [hierarchy](flecs::iter& it, TransformSystemContext* context)
+                    {
+                        ++context->frame;
+                        if(context->parallel)
+                        {
+                            flecs::world world = it.world();
+                            UpdateParallel(world, hierarchy, *context);
+                        }
+                        else
+                        {
+                            UpdateSerial(hierarchy, *context);
+                        }
+                    });
         });
 }
 /*
@@ -26,12 +49,129 @@ void TransformSystem::CalculateWorldTransforms(const Transform* transform, const
     else
         internalTransform->worldTransform = parentTransform->worldTransform * localTransform;
 }*/
-void TransformSystem::CalculateWorldTransforms(const Transform& transform, const InternalTransform* parentTransform, InternalTransform& internalTransform)
+void TransformSystem::UpdateBatch(const TransformSystemContext::Batch& batch, uint32_t first, uint32_t end, uint32_t frame, uint8_t* changed)
 {
-    glm::mat4 localTransform = glm::translate(glm::mat4(1.0f), transform.pos) * glm::toMat4(transform.rot) * glm::scale(glm::mat4(1.0f), transform.scale);
+    // the parent's world transform is computed by the time its children are updated
+    const bool parentChanged = batch.parentTransform != nullptr && batch.parentTransform->changedFrame == frame;
+    const auto isDirty       = [&](uint32_t i)
+    {
+        const InternalTransform& internal = batch.internalTransforms[i];
+        if(!internal.computed)
+            return true;
+        return !batch.isStatic && (parentChanged || internal.parent != batch.parent || !(internal.localTransform == batch.transforms[i]));
+    };
 
-    if(parentTransform == nullptr)
-        internalTransform.worldTransform = localTransform;
-    else
-        internalTransform.worldTransform = parentTransform->worldTransform * localTransform;
+    // the runs of dirty entities go through the kernel together
+    uint32_t i = first;
+    while(i < end)
+    {
+        if(!isDirty(i))
+        {
+            changed[i++] = 0;
+            continue;
+        }
+
+        uint32_t runEnd = i + 1;
+        while(runEnd < end && isDirty(runEnd))
+            ++runEnd;
+
+        MathUtils::ComposeWorldTransforms(batch.transforms + i, runEnd - i, batch.parentTransform, batch.internalTransforms + i, changed + i);
+        for(; i < runEnd; ++i)
+        {
+            InternalTransform& internal = batch.internalTransforms[i];
+            internal.localTransform     = batch.transforms[i];
+            internal.parent             = batch.parent;
+            internal.computed           = true;
+            if(changed[i] != 0)
+                internal.changedFrame = frame;
+        }
+    }
+}
+
+void TransformSystem::UpdateSerial(const HierarchyQuery& hierarchy, TransformSystemContext& context)
+{
+    PROFILE_FUNCTION();
+
+    hierarchy.iter(
+        [&](flecs::iter& it, const Transform* transforms, const InternalTransform* parentTransforms, InternalTransform* internalTransforms)
+        {
+            const auto count = static_cast<uint32_t>(it.count());
+            const TransformSystemContext::Batch batch{it.c_ptr()->entities, transforms, parentTransforms, internalTransforms, it.src(2).id(), count, 0, it.table().has<Static>()};
+
+            context.changed.resize(count);
+            UpdateBatch(batch, 0, count, context.frame, context.changed.data());
+
+            // only entities that actually moved send an OnSet, the renderer uses it to know which lights to re-upload
+            for(uint32_t i = 0; i < count; ++i)
+            {
+                if(context.changed[i] != 0)
+                {
+                    flecs::entity entity = it.entity(i);
+                    entity.modified<InternalTransform>();
+                    context.changedEntities.push_back(entity);
+                }
+            }
+        });
+}
+
+void TransformSystem::UpdateRange(const TransformSystemContext& context, const TransformSystemContext::Level& level, uint32_t first, uint32_t end, uint8_t* changed)
+{
+    for(uint32_t b = level.firstBatch; b < context.batches.size() && context.batches[b].first < end; ++b)
+    {
+        const TransformSystemContext::Batch& batch = context.batches[b];
+        const uint32_t batchEnd                    = std::min(batch.first + batch.count, end);
+        const uint32_t batchFirst                  = std::max(batch.first, first);
+        if(batchFirst < batchEnd)
+            UpdateBatch(batch, batchFirst - batch.first, batchEnd - batch.first, context.frame, changed + batch.first);
+    }
+}
+
+void TransformSystem::UpdateParallel(flecs::world& world, const HierarchyQuery& hierarchy, TransformSystemContext& context)
+{
+    PROFILE_FUNCTION();
+
+    // the query goes through the tables one depth after the other, the column pointers stay valid until the end of the system
+    context.batches.clear();
+    context.levels.clear();
+    uint32_t entityCount = 0;
+    uint64_t depth       = 0;
+    hierarchy.iter(
+        [&](flecs::iter& it, const Transform* transforms, const InternalTransform* parentTransforms, InternalTransform* internalTransforms)
+        {
+            if(context.levels.empty() || it.group_id() != depth)
+            {
+                depth = it.group_id();
+                context.levels.push_back({static_cast<uint32_t>(context.batches.size()), entityCount, 0});
+            }
+
+            const auto count = static_cast<uint32_t>(it.count());
+            context.batches.push_back({it.c_ptr()->entities, transforms, parentTransforms, internalTransforms, it.src(2).id(), count, entityCount, it.table().has<Static>()});
+            context.levels.back().count += count;
+            entityCount += count;
+        });
+    context.changed.resize(entityCount);
+
+    // the levels are updated one after the other since the children read the world transforms of the level before
+    for(const TransformSystemContext::Level& level : context.levels)
+    {
+        JobSystem::ParallelFor(level.count, MIN_ENTITIES_PER_JOB,
+                               [&](uint32_t first, uint32_t end)
+                               {
+                                   UpdateRange(context, level, level.first + first, level.first + end, context.changed.data());
+                               });
+    }
+
+    // the OnSet observers aren't thread safe, they are sent once everything is updated
+    for(const TransformSystemContext::Batch& batch : context.batches)
+    {
+        for(uint32_t i = 0; i < batch.count; ++i)
+        {
+            if(context.changed[batch.first + i] != 0)
+            {
+                flecs::entity entity = world.entity(batch.entities[i]);
+                entity.modified<InternalTransform>();
+                context.changedEntities.push_back(entity);
+            }
+        }
+    }
 }
@@ -3,13 +3,57 @@
 #include "ECS/System.hpp"
 #include "ECS/CoreComponents/Transform.hpp"
 #include "ECS/CoreComponents/InternalTransform.hpp"
+#include <vector>
+
+struct TransformSystemContext
+{
+    // every depth level of the hierarchy is split in chunks that are updated by the JobSystem's workers, otherwise the tables are updated one by one
+    bool parallel = true;
+
+    // the entities whose world transform changed since the list was last cleared, the renderer uploads them and clears it
+    std::vector<flecs::entity> changedEntities;
+
+    uint32_t frame = 0;  // incremented every update, compared with InternalTransform::changedFrame
+
+    // reused every frame by the updates
+    struct Batch  // the entities of a table, they have the same parent so they are all at the same depth
+    {
+        const flecs::entity_t* entities;
+        const Transform* transforms;
+        const InternalTransform* parentTransform;  // nullptr for the roots
+        InternalTransform* internalTransforms;
+        flecs::entity_t parent;
+        uint32_t count;
+        uint32_t first;  // index of the first entity in the whole hierarchy
+        bool isStatic;   // the entities have the Static tag, they are only computed once
+    };
+    struct Level
+    {
+        uint32_t firstBatch;
+        uint32_t first;  // index of the first entity in the whole hierarchy
+        uint32_t count;
+    };
+    std::vector<Batch> batches;
+    std::vector<Level> levels;
+    std::vector<uint8_t> changed;  // if the world transform of the entity changed, accessed like the batches
+};
+
 class TransformSystem : public System
 {
 public:
-    //static void CalculateWorldTransforms(const Transform* transform, const InternalTransform* parentTransform, InternalTransform* internalTransform);
-    static void CalculateWorldTransforms(const Transform& transform, const InternalTransform* parentTransform, InternalTransform& internalTransform);
+    using HierarchyQuery = Query<const Transform, const InternalTransform*, InternalTransform>;
+
     void Initialize() override;
 
 private:
+    static constexpr uint32_t MIN_ENTITIES_PER_JOB = 4096;  // smaller levels aren't worth splitting
+
+    // recomputes the entities of the batch that aren't up to date, changed is set like for MathUtils::ComposeWorldTransforms
+    static void UpdateBatch(const TransformSystemContext::Batch& batch, uint32_t first, uint32_t end, uint32_t frame, uint8_t* changed);
+    static void UpdateSerial(const HierarchyQuery& hierarchy, TransformSystemContext& context);
+    static void UpdateParallel(flecs::world& world, const HierarchyQuery& hierarchy, TransformSystemContext& context);
+    // updates the entities [first, end) of a level, the range can cross batches
+    static void UpdateRange(const TransformSystemContext& context, const TransformSystemContext::Level& level, uint32_t first, uint32_t end, uint8_t* changed);
+
     const char* GetName() const override { return "TransformSystem"; }
 };
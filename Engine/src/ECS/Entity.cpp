@@ -6,6 +6,8 @@
 #include "ECS/CoreComponents/InternalTransform.hpp"
 #include "ECS/CoreComponents/Transform.hpp"
 
+#include <format>
+
 
 Entity::Entity(ECS* ecs, const std::string& name, const Entity* parent)
     : m_ecs(ecs)
@@ -23,7 +25,8 @@ Entity::Entity(ECS* ecs, const std::string& name, const Entity* parent)
 
     EntityCreated event;
     event.entity = *this;
-    Application::GetInstance()->GetEventHandler()->Send<EntityCreated>(event);
+    if(Application* app = Application::GetInstance())  // there's none in the benchmarks
+        app->GetEventHandler()->Send<EntityCreated>(event);
 }
 
 Entity Entity::CreateChild(const std::string& name) const
@@ -31,6 +34,17 @@ Entity Entity::CreateChild(const std::string& name) const
     return m_ecs->CreateChildEntity(this, name);
 }
 
+std::string Entity::GetName() const
+{
+    const char* name = m_entity.name().c_str();
+    return name ? name : std::format("#{}", m_entity.id());
+}
+
+void Entity::SetName(const std::string& name)
+{
+    m_entity.set_name(name.c_str());
+}
+
 void Entity::IterateChildren(EntityIterFn f)
 {
     m_entity.children(f);
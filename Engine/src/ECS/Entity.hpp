@@ -64,7 +64,11 @@ public:
 
     void SetStatic(bool isStatic);
 
-    [[nodiscard]] std::string GetName() const { return m_entity.name().c_str(); }
+    [[nodiscard]] bool IsAlive() const { return m_entity.is_alive(); }
+
+    // entities created in bulk have no name until SetName, they get "#<id>" like flecs prints them
+    [[nodiscard]] std::string GetName() const;
+    void SetName(const std::string& name);
 
     [[nodiscard]] Entity GetParent() const
     {
@@ -1,6 +1,11 @@
 #pragma once
 
+#include <chrono>
+#include <deque>
 #include <flecs.h>
+#include <string>
+#include <vector>
+#include "ECS/Query.hpp"
 
 enum class SystemPhase
 {
@@ -12,6 +17,65 @@ enum class SystemPhase
     PreRender,
 };
 
+inline const char* GetPhaseName(SystemPhase phase)
+{
+    switch(phase)
+    {
+    case SystemPhase::OnStart:
+        return "OnStart";
+    case SystemPhase::OnLoad:
+        return "OnLoad";
+    case SystemPhase::PreUpdate:
+        return "PreUpdate";
+    case SystemPhase::OnUpdate:
+        return "OnUpdate";
+    case SystemPhase::PostUpdate:
+        return "PostUpdate";
+    case SystemPhase::PreRender:
+        return "PreRender";
+    default:
+        return "Unknown";
+    }
+}
+
+// Singleton listing the systems registered through the System helpers in the order they were registered, which is the order flecs runs the systems of a phase in
+// flecs splits the entities of a multi threaded system across the ECS's threads, a system that isn't runs on the main thread and the others wait for it
+struct SystemSchedule
+{
+    struct Entry
+    {
+        std::string name;
+        SystemPhase phase;
+        bool multiThreaded;
+        uint32_t framerate;  // 0 for systems that run every frame
+    };
+    std::vector<Entry> systems;
+};
+
+// When the systems registered through the System helpers ran during the last ECS::Update and on which of the ECS's threads
+// recorded by their run action, every thread appends to its own list so they don't have to synchronize
+struct SystemFrameRecord
+{
+    struct Run
+    {
+        uint32_t system;  // index in SystemSchedule::systems
+        float start;      // milliseconds since the start of the update
+        float end;
+    };
+
+    // the ctx of a system's run action, the deque keeps them at the same address while systems are added
+    struct Context
+    {
+        SystemFrameRecord* record;
+        uint32_t system;
+    };
+
+    std::vector<std::vector<Run>> threads;  // indexed with the flecs stage the system ran on, 0 is the main thread
+    std::chrono::steady_clock::time_point start;
+    float duration = 0.0f;  // of the whole update in milliseconds
+    std::deque<Context> contexts;
+};
+
 template<typename... Components>
 using SystemBuilder = flecs::system_builder<Components...>;
 
@@ -30,43 +94,84 @@ protected:
     void AddContextSingleton(T context);
 
     // contextTerm is indexed from 1
+    // multiThreaded lets flecs split the matched entities across the ECS's threads (see ECS::SetThreadCount), fn is then called from several threads
+    // at once and must only write to the components it was called with, the singletons are shared by all of them
     template<class... Components>
-    void Register(SystemPhase phase, void (*fn)(flecs::iter& it, size_t i, Components... args), uint8_t contextTerm = 0);
+    void Register(SystemPhase phase, void (*fn)(flecs::iter& it, size_t i, Components... args), uint8_t contextTerm = 0, bool multiThreaded = false);
 
     // contextTerm is indexed from 1
     template<class... Components>
-    void Register(SystemPhase phase, void (*fn)(flecs::entity e, Components... args), uint8_t contextTerm = 0);
+    void Register(SystemPhase phase, void (*fn)(flecs::entity e, Components... args), uint8_t contextTerm = 0, bool multiThreaded = false);
 
     // contextTerm is indexed from 1
     template<class... Components>
-    void Register(SystemPhase phase, void (*fn)(Components... args), uint8_t contextTerm = 0);
+    void Register(SystemPhase phase, void (*fn)(Components... args), uint8_t contextTerm = 0, bool multiThreaded = false);
 
     // contextTerm is indexed from 1
     template<class... Components>
-    void RegisterFixed(SystemPhase phase, void (*fn)(flecs::iter& it, size_t i, Components... args), uint32_t framerate, uint8_t contextTerm = 0);
+    void RegisterFixed(SystemPhase phase, void (*fn)(flecs::iter& it, size_t i, Components... args), uint32_t framerate, uint8_t contextTerm = 0, bool multiThreaded = false);
 
     // contextTerm is indexed from 1
     template<class... Components>
-    void RegisterFixed(SystemPhase phase, void (*fn)(flecs::entity e, Components... args), uint32_t framerate, uint8_t contextTerm = 0);
+    void RegisterFixed(SystemPhase phase, void (*fn)(flecs::entity e, Components... args), uint32_t framerate, uint8_t contextTerm = 0, bool multiThreaded = false);
 
     // contextTerm is indexed from 1
     template<class... Components>
-    void RegisterFixed(SystemPhase phase, void (*fn)(Components... args), uint32_t framerate, uint8_t contextTerm = 0);
+    void RegisterFixed(SystemPhase phase, void (*fn)(Components... args), uint32_t framerate, uint8_t contextTerm = 0, bool multiThreaded = false);
 
     // expose this for systems that want to do more advanced queries, such as traversing the entity hierarchy,etc...
     // we put the function as a parameter to be able to deduce the template parameters so we dont have to specify them one by one when calling this function
     template<class... Components>
-    void StartSystemBuilder(SystemPhase phase, void (*buildFn)(SystemBuilder<Components...>& builder));
+    void StartSystemBuilder(SystemPhase phase, void (*buildFn)(SystemBuilder<Components...>& builder), bool multiThreaded = false);
 
     // after: Fn can be a generic lambda, captureless or not
     template<class... Components, typename Fn>
-    void StartSystemBuilder(SystemPhase phase, Fn buildFn);
+    void StartSystemBuilder(SystemPhase phase, Fn buildFn, bool multiThreaded = false);
+
+    // for systems that iterate a query themselves instead of letting the system match the entities, the query can be captured by the system's function
+    template<class... Components>
+    QueryBuilder<Components...> StartQueryBuilder()
+    {
+        return m_world->query_builder<Components...>();
+    }
 
 private:
     virtual const char* GetName() const { return nullptr; };
 
-    flecs::world* m_world = nullptr;
+    flecs::world* m_world            = nullptr;
+    SystemFrameRecord* m_frameRecord = nullptr;
     friend class ECS;
+
+    // adds the system to the SystemSchedule and gives it the run action that records it in the SystemFrameRecord
+    template<typename Builder>
+    void AddToSchedule(Builder& builder, SystemPhase phase, bool multiThreaded, uint32_t framerate = 0)
+    {
+        const char* name = GetName();
+        auto* schedule   = m_world->get_mut<SystemSchedule>();
+        schedule->systems.push_back({name != nullptr ? name : "Unnamed system", phase, multiThreaded, framerate});
+
+        const uint32_t index = static_cast<uint32_t>(schedule->systems.size() - 1);
+        builder.run(RecordRun).ctx(&m_frameRecord->contexts.emplace_back(SystemFrameRecord::Context{m_frameRecord, index}));
+    }
+
+    // iterates like flecs does for systems without a run action, the multi threaded systems are called once per thread with that thread's entities
+    // a system that isn't due (RegisterFixed) isn't called at all so it isn't recorded either
+    static void RecordRun(ecs_iter_t* it)
+    {
+        const auto begin = std::chrono::steady_clock::now();
+        while(ecs_iter_next(it))
+            it->callback(it);
+        const auto end = std::chrono::steady_clock::now();
+
+        const auto* context       = static_cast<const SystemFrameRecord::Context*>(it->ctx);
+        SystemFrameRecord& record = *context->record;
+        const auto stage          = static_cast<size_t>(ecs_get_stage_id(it->world));
+        if(stage < record.threads.size())
+        {
+            const auto toMilliseconds = [&record](std::chrono::steady_clock::time_point time) { return std::chrono::duration<float, std::milli>(time - record.start).count(); };
+            record.threads[stage].push_back({context->system, toMilliseconds(begin), toMilliseconds(end)});
+        }
+    }
     static flecs::entity_t ConvertPhase(SystemPhase phase)
     {
         switch(phase)
@@ -99,12 +204,13 @@ void System::AddContextSingleton(T context)
 
 // contextTerm is indexed from 1
 template<class... Components>
-void System::Register(SystemPhase phase, void (*fn)(flecs::iter& it, size_t i, Components... args), uint8_t contextTerm)
+void System::Register(SystemPhase phase, void (*fn)(flecs::iter& it, size_t i, Components... args), uint8_t contextTerm, bool multiThreaded)
 {
     assert(contextTerm <= sizeof...(Components));
-
     auto builder = m_world->system<Components...>(GetName())
-                       .kind(ConvertPhase(phase));
+                       .kind(ConvertPhase(phase))
+                       .multi_threaded(multiThreaded);
+    AddToSchedule(builder, phase, multiThreaded);
     if(contextTerm > 0)
         builder = builder.term_at(contextTerm).singleton();  // +1 because term_at isn't zero indexed
     builder.each(fn);
@@ -112,12 +218,13 @@ void System::Register(SystemPhase phase, void (*fn)(flecs::iter& it, size_t i, C
 
 // contextTerm is indexed from 1
 template<class... Components>
-void System::Register(SystemPhase phase, void (*fn)(flecs::entity e, Components... args), uint8_t contextTerm)
+void System::Register(SystemPhase phase, void (*fn)(flecs::entity e, Components... args), uint8_t contextTerm, bool multiThreaded)
 {
     assert(contextTerm <= sizeof...(Components));
-
     auto builder = m_world->system<Components...>(GetName())
-                       .kind(ConvertPhase(phase));
+                       .kind(ConvertPhase(phase))
+                       .multi_threaded(multiThreaded);
+    AddToSchedule(builder, phase, multiThreaded);
     if(contextTerm > 0)
         builder = builder.term_at(contextTerm).singleton();  // +1 because term_at isn't zero indexed
 
@@ -126,12 +233,13 @@ void System::Register(SystemPhase phase, void (*fn)(flecs::entity e, Components.
 
 // contextTerm is indexed from 1
 template<class... Components>
-void System::Register(SystemPhase phase, void (*fn)(Components... args), uint8_t contextTerm)
+void System::Register(SystemPhase phase, void (*fn)(Components... args), uint8_t contextTerm, bool multiThreaded)
 {
     assert(contextTerm <= sizeof...(Components));
-
     auto builder = m_world->system<Components...>(GetName())
-                       .kind(ConvertPhase(phase));
+                       .kind(ConvertPhase(phase))
+                       .multi_threaded(multiThreaded);
+    AddToSchedule(builder, phase, multiThreaded);
     if(contextTerm > 0)
         builder = builder.term_at(contextTerm).singleton();
     builder.each(fn);
@@ -140,13 +248,14 @@ void System::Register(SystemPhase phase, void (*fn)(Components... args), uint8_t
 
 // contextTerm is indexed from 1
 template<class... Components>
-void System::RegisterFixed(SystemPhase phase, void (*fn)(flecs::iter& it, size_t i, Components... args), uint32_t framerate, uint8_t contextTerm)
+void System::RegisterFixed(SystemPhase phase, void (*fn)(flecs::iter& it, size_t i, Components... args), uint32_t framerate, uint8_t contextTerm, bool multiThreaded)
 {
     assert(contextTerm <= sizeof...(Components));
-
     auto builder = m_world->system<Components...>(GetName())
                        .kind(ConvertPhase(phase))
-                       .interval(1.0f / framerate);
+                       .interval(1.0f / framerate)
+                       .multi_threaded(multiThreaded);
+    AddToSchedule(builder, phase, multiThreaded, framerate);
     if(contextTerm > 0)
         builder = builder.term_at(contextTerm).singleton();  // +1 because term_at isn't zero indexed
     builder.each(fn);
@@ -154,13 +263,14 @@ void System::RegisterFixed(SystemPhase phase, void (*fn)(flecs::iter& it, size_t
 
 // contextTerm is indexed from 1
 template<class... Components>
-void System::RegisterFixed(SystemPhase phase, void (*fn)(flecs::entity e, Components... args), uint32_t framerate, uint8_t contextTerm)
+void System::RegisterFixed(SystemPhase phase, void (*fn)(flecs::entity e, Components... args), uint32_t framerate, uint8_t contextTerm, bool multiThreaded)
 {
     assert(contextTerm <= sizeof...(Components));
-
     auto builder = m_world->system<Components...>(GetName())
                        .kind(ConvertPhase(phase))
-                       .interval(1.0f / framerate);
+                       .interval(1.0f / framerate)
+                       .multi_threaded(multiThreaded);
+    AddToSchedule(builder, phase, multiThreaded, framerate);
     if(contextTerm > 0)
         builder = builder.term_at(contextTerm).singleton();  // +1 because term_at isn't zero indexed
 
@@ -169,13 +279,14 @@ void System::RegisterFixed(SystemPhase phase, void (*fn)(flecs::entity e, Compon
 
 // contextTerm is indexed from 1
 template<class... Components>
-void System::RegisterFixed(SystemPhase phase, void (*fn)(Components... args), uint32_t framerate, uint8_t contextTerm)
+void System::RegisterFixed(SystemPhase phase, void (*fn)(Components... args), uint32_t framerate, uint8_t contextTerm, bool multiThreaded)
 {
     assert(contextTerm <= sizeof...(Components));
-
     auto builder = m_world->system<Components...>(GetName())
                        .kind(ConvertPhase(phase))
-                       .interval(1.0f / framerate);
+                       .interval(1.0f / framerate)
+                       .multi_threaded(multiThreaded);
+    AddToSchedule(builder, phase, multiThreaded, framerate);
     if(contextTerm > 0)
         builder = builder.term_at(contextTerm).singleton();
     builder.each(fn);
@@ -184,13 +295,17 @@ void System::RegisterFixed(SystemPhase phase, void (*fn)(Components... args), ui
 // expose this for systems that want to do more advanced queries, such as traversing the entity hierarchy,etc...
 // we put the function as a parameter to be able to deduce the template parameters so we dont have to specify them one by one when calling this function
 template<class... Components>
-void System::StartSystemBuilder(SystemPhase phase, void (*buildFn)(SystemBuilder<Components...>& builder))
+void System::StartSystemBuilder(SystemPhase phase, void (*buildFn)(SystemBuilder<Components...>& builder), bool multiThreaded)
 {
-    buildFn(m_world->system<Components...>(GetName()).kind(ConvertPhase(phase)));
+    auto builder = m_world->system<Components...>(GetName()).kind(ConvertPhase(phase)).multi_threaded(multiThreaded);
+    AddToSchedule(builder, phase, multiThreaded);
+    buildFn(builder);
 }
 template<class... Components, typename Fn>
-void System::StartSystemBuilder(SystemPhase phase, Fn buildFn)
+void System::StartSystemBuilder(SystemPhase phase, Fn buildFn, bool multiThreaded)
 {
     static_assert(std::is_invocable_v<Fn, SystemBuilder<Components...>&>, "buildFn must be invocable with SystemBuilder<Components…>&");
-    buildFn(m_world->system<Components...>(GetName()).kind(ConvertPhase(phase)));
+    auto builder = m_world->system<Components...>(GetName()).kind(ConvertPhase(phase)).multi_threaded(multiThreaded);
+    AddToSchedule(builder, phase, multiThreaded);
+    buildFn(builder);
 }
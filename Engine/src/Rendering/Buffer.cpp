@@ -180,6 +180,25 @@ void Buffer::Fill(const std::vector<const void*>& datas, const std::vector<uint6
     vmaUnmapMemory(VulkanContext::GetVmaBufferAllocator(), m_allocation);
 }
 
+void Buffer::Read(void* data, uint64_t size, uint64_t offset)
+{
+    // the gpu writes aren't visible to the host otherwise if the memory isn't host coherent
+    VK_CHECK(vmaInvalidateAllocation(VulkanContext::GetVmaBufferAllocator(), m_allocation, offset, size), "Failed to invalidate memory");
+
+    if(m_mappedMemory)
+    {
+        memcpy(data, (const void*)((uint8_t*)m_mappedMemory + offset), (size_t)size);
+        return;
+    }
+
+    void* memory = nullptr;
+    VK_CHECK(vmaMapMemory(VulkanContext::GetVmaBufferAllocator(), m_allocation, &memory), "Failed to map memory");
+
+    memcpy(data, (const void*)((uint8_t*)memory + offset), (size_t)size);
+
+    vmaUnmapMemory(VulkanContext::GetVmaBufferAllocator(), m_allocation);
+}
+
 void Buffer::ZeroFill()
 {
     if(m_mappedMemory)
@@ -199,7 +218,7 @@ void Buffer::ZeroFill()
 */
     vmaUnmapMemory(VulkanContext::GetVmaBufferAllocator(), m_allocation);
 }
-void Buffer::Bind(const CommandBuffer& commandBuffer)
+void Buffer::Bind(const CommandBuffer& commandBuffer, VkIndexType indexType)
 {
     switch(m_type)
     {
@@ -212,7 +231,7 @@ void Buffer::Bind(const CommandBuffer& commandBuffer)
         }
     case Type::INDEX:
         {
-            vkCmdBindIndexBuffer(commandBuffer.GetCommandBuffer(), m_buffer, 0, VK_INDEX_TYPE_UINT32);
+            vkCmdBindIndexBuffer(commandBuffer.GetCommandBuffer(), m_buffer, 0, indexType);
             break;
         }
     default:
@@ -383,24 +402,42 @@ void DynamicBufferAllocator::UploadData(const std::vector<uint64_t>& slots, cons
     }
     else
     {
-        m_stagingBuffer.Fill(datas, sizes, offsets);
+        // the datas are packed one after the other into the staging buffer and copied with one submit each time it is full
+        // the ones that don't fit in the rest of it are split
         std::vector<VkBufferCopy> copyRegions;
-        for(uint64_t i = 0; i < slots.size(); i++)
+        uint64_t stagingOffset = 0;
+        auto flush             = [&]()
         {
-            VkBufferCopy copyRegion = {};
-            copyRegion.srcOffset    = 0;
-            copyRegion.dstOffset    = offsets[i];
-            copyRegion.size         = sizes[i];
-            copyRegions.push_back(copyRegion);
-        }
+            CommandBuffer cb(VulkanContext::GetTransferQueue());
+            vkDeviceWaitIdle(VulkanContext::GetDevice());
+            cb.Begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+            vkCmdCopyBuffer(cb.GetCommandBuffer(), m_stagingBuffer.GetVkBuffer(), dst->GetVkBuffer(), static_cast<uint32_t>(copyRegions.size()), copyRegions.data());
 
-        CommandBuffer cb(VulkanContext::GetTransferQueue());
-        vkDeviceWaitIdle(VulkanContext::GetDevice());
-        cb.Begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
-        vkCmdCopyBuffer(cb.GetCommandBuffer(), m_stagingBuffer.GetVkBuffer(), dst->GetVkBuffer(), static_cast<uint32_t>(copyRegions.size()), copyRegions.data());
+            cb.Submit(VK_NULL_HANDLE, 0, VK_NULL_HANDLE, m_fence);
+            vkWaitForFences(VulkanContext::GetDevice(), 1, &m_fence, VK_TRUE, UINT64_MAX);
 
-        cb.Submit(VK_NULL_HANDLE, 0, VK_NULL_HANDLE, m_fence);
-        vkWaitForFences(VulkanContext::GetDevice(), 1, &m_fence, VK_TRUE, UINT64_MAX);
+            copyRegions.clear();
+            stagingOffset = 0;
+        };
+
+        for(uint64_t i = 0; i < slots.size(); i++)
+        {
+            uint64_t copied = 0;
+            while(copied < sizes[i])
+            {
+                if(stagingOffset == m_stagingBufferSize)
+                    flush();
+
+                uint64_t size = std::min(sizes[i] - copied, m_stagingBufferSize - stagingOffset);
+                m_stagingBuffer.Fill((const uint8_t*)datas[i] + copied, size, stagingOffset);
+                copyRegions.push_back({stagingOffset, offsets[i] + copied, size});
+
+                stagingOffset += size;
+                copied += size;
+            }
+        }
+        if(!copyRegions.empty())
+            flush();
     }
 }
 void DynamicBufferAllocator::Resize()
@@ -416,6 +453,7 @@ void DynamicBufferAllocator::Resize()
 
     std::vector<VkBufferCopy> copyRegions;
     copyRegions.reserve(m_allocations.size());
+    std::unordered_map<uint64_t, VmaVirtualAllocation> allocations;  // the slots change, the user data of the allocations goes with them
 
     // do it 1 by 1 instead of copying the whole buffer in order to reduce fragmentation in case the old buffer had things freed from it which left it fragmented
     for(auto [slot, allocation] : m_allocations)
@@ -433,11 +471,15 @@ void DynamicBufferAllocator::Resize()
 
         // find slot in new buffer
         VK_CHECK(vmaVirtualAllocate(block, &newAllocInfo, &newAllocation, &offset), "Failed to allocate virtual memory after new block creation");
-
+        vmaSetVirtualAllocationUserData(block, newAllocation, allocInfo.pUserData);
+        allocations[offset / m_elementSize] = newAllocation;
 
         copyRegions.push_back({allocInfo.offset, offset, allocInfo.size});
     }
-    m_block = block;
+    vmaClearVirtualBlock(m_block);
+    vmaDestroyVirtualBlock(m_block);
+    m_block       = block;
+    m_allocations = std::move(allocations);
     CommandBuffer cb(VulkanContext::GetTransferQueue());
     cb.Begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
     // don't need to sync because we only read from the old buffer
@@ -446,7 +488,8 @@ void DynamicBufferAllocator::Resize()
     cb.Submit(VK_NULL_HANDLE, 0, VK_NULL_HANDLE, m_fence);
     vkWaitForFences(VulkanContext::GetDevice(), 1, &m_fence, VK_TRUE, UINT64_MAX);
 
-    m_resizeCallback(this);
+    if(m_resizeCallback)
+        m_resizeCallback(this);
 }
 
 void DynamicBufferAllocator::DeleteOldIfNeeded()
@@ -59,7 +59,9 @@ public:
     // offsets must be sorted in ascending order
     void Fill(const std::vector<const void*>& datas, const std::vector<uint64_t>& sizes, const std::vector<uint64_t>& offsets);
     void ZeroFill();
-    void Bind(const CommandBuffer& commandBuffer);
+    // the memory of mappable buffers is meant to be written sequentially, reading it can be slow so only use it for small readbacks
+    void Read(void* data, uint64_t size, uint64_t offset = 0);
+    void Bind(const CommandBuffer& commandBuffer, VkIndexType indexType = VK_INDEX_TYPE_UINT32);  // indexType is only used for index buffers
     [[nodiscard]] const VkBuffer& GetVkBuffer() const { return m_buffer; }
     [[nodiscard]] VkDeviceSize GetSize() const { return m_size; }
     [[nodiscard]] uint64_t GetDeviceAddress() const
@@ -129,14 +131,14 @@ public:
     uint64_t Allocate(uint64_t numObjects, bool& didResize, void* pUserData = nullptr);
     uint64_t Allocate(uint64_t numObjects, void* pUserData = nullptr);
     void UploadData(uint64_t slot, const void* data, uint64_t offset = 0, uint64_t size = 0);
-    void UploadData(const std::vector<uint64_t>& slots, const std::vector<const void*>& datas);
+    void UploadData(const std::vector<uint64_t>& slots, const std::vector<const void*>& datas);  // the whole allocations, with as few staging copies as fit
 
 
     void Free(uint64_t slot);
 
     void DeleteOldIfNeeded();
 
-    void Bind(CommandBuffer& cb) { m_buffer.Bind(cb); }
+    void Bind(CommandBuffer& cb, VkIndexType indexType = VK_INDEX_TYPE_UINT32) { m_buffer.Bind(cb, indexType); }
 
     [[nodiscard]] uint64_t GetDeviceAddress(uint64_t slot) const
     {
@@ -2,15 +2,17 @@
 
 #include "Application.hpp"
 #include "ECS/CoreComponents/Camera.hpp"
+#include "ECS/CoreComponents/RendererComponents.hpp"
 #include "Rendering/RenderGraph/RenderGraph.hpp"
+#include "Rendering/RenderResources.hpp"
 #include "Rendering/Pipeline.hpp"
 #include "ECS/Core.hpp"
 #include <glm/glm.hpp>
 class DenoisePass
 {
 public:
-    DenoisePass(RenderGraph& rg)
-        : m_ecs(Application::GetInstance()->GetScene()->GetECS())
+    DenoisePass(RenderGraph& rg, RenderResources& resources)
+        : m_resources(&resources)
     {
         PipelineCreateInfo compute = {};
         compute.type               = PipelineType::COMPUTE;
@@ -46,7 +48,7 @@ private:
         pass.SetExecutionCallback(
             [&](CommandBuffer& cb, uint32_t /*imageIndex*/)
             {
-                const auto* mainCamera  = m_ecs->GetSingleton<MainCameraData>();
+                const auto* mainCamera  = m_resources->Get<FrameCameraData>();
                 const auto viewportSize = glm::vec2(VulkanContext::GetSwapchainExtent().width, VulkanContext::GetSwapchainExtent().height);
 
                 m_pipeline->Bind(cb);
@@ -71,5 +73,5 @@ private:
     }
 
     std::unique_ptr<Pipeline> m_pipeline;
-    ECS* m_ecs;
+    RenderResources* m_resources;
 };
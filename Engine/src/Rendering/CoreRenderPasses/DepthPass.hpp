@@ -6,12 +6,13 @@
 #include "ECS/CoreComponents/RendererComponents.hpp"
 #include "Rendering/Pipeline.hpp"
 #include "Rendering/RenderGraph/RenderGraph.hpp"
+#include "Rendering/RenderResources.hpp"
 #include <glm/glm.hpp>
 
 class DepthPass
 {
 public:
-    DepthPass(RenderGraph& rg)
+    DepthPass(RenderGraph& rg, RenderResources& resources)
     {
         LOG_WARN("Creating depth pipeline");
         PipelineCreateInfo depthPipeline;
@@ -31,7 +32,7 @@ public:
         // m_depthPipeline = AddPipeline("depth", depthPipeline, 0);
         m_depthPipeline = std::make_unique<Pipeline>("depth", depthPipeline, 0);
 
-        m_ecs = Application::GetInstance()->GetScene()->GetECS();
+        m_resources = &resources;
         RegisterPass(rg);
     }
 
@@ -46,6 +47,7 @@ private:
         uint64_t transformBufferPtr;
         uint64_t shaderDataPtr;
         uint64_t objectIDMapPtr;
+        uint64_t vertexQuantizationPtr;
     };
 
     void RegisterPass(RenderGraph& rg)
@@ -68,7 +70,7 @@ private:
             {
                 vkCmdBeginRendering(cb.GetCommandBuffer(), depthPass.GetRenderingInfo());
 
-                const MainCameraData* camera = m_ecs->GetSingleton<MainCameraData>();
+                const MainCameraData* camera = m_resources->Get<FrameCameraData>();
                 const ShaderData shaderData{
                     .viewProj = camera->viewProj,
                     .view     = camera->view,
@@ -77,22 +79,25 @@ private:
                 m_depthPipeline->UploadShaderData(&shaderData, imageIndex);
 
                 PushConstants pc{
-                    .transformBufferPtr = m_ecs->GetSingleton<TransformBuffers>()->buffers[imageIndex].GetDeviceAddress(0),
-                    .shaderDataPtr      = m_depthPipeline->GetShaderDataBufferPtr(imageIndex),
-                    .objectIDMapPtr     = drawObjBuffer.GetBufferPointer()->GetDeviceAddress(),
+                    .transformBufferPtr    = m_resources->Get<TransformBuffers>()->buffers[imageIndex].GetDeviceAddress(0),
+                    .shaderDataPtr         = m_depthPipeline->GetShaderDataBufferPtr(imageIndex),
+                    .objectIDMapPtr        = 0,  // set per index batch
+                    .vertexQuantizationPtr = m_resources->Get<VertexQuantizationBuffer>()->buffer.GetDeviceAddress(0),
                 };
 
 
                 m_depthPipeline->Bind(cb);
-                m_depthPipeline->SetPushConstants(cb, &pc, sizeof(PushConstants));
-
-                uint32_t maxCount = static_cast<uint32_t>(drawBuffer.GetBufferPointer()->GetSize() / sizeof(VkDrawIndexedIndirectCommand));
-                vkCmdDrawIndexedIndirectCount(cb.GetCommandBuffer(), drawBuffer.GetBufferPointer()->GetVkBuffer(), 0, drawObjBuffer.GetBufferPointer()->GetVkBuffer(), 0, maxCount, sizeof(VkDrawIndexedIndirectCommand));
+                Application::GetInstance()->GetRenderer()->DrawIndexedIndirectBatches(cb, *drawBuffer.GetBufferPointer(), *drawObjBuffer.GetBufferPointer(),
+                                                                                      [&](uint64_t objectIDMapPtr)
+                                                                                      {
+                                                                                          pc.objectIDMapPtr = objectIDMapPtr;
+                                                                                          m_depthPipeline->SetPushConstants(cb, &pc, sizeof(PushConstants));
+                                                                                      });
 
                 vkCmdEndRendering(cb.GetCommandBuffer());
             });
     }
 
     std::unique_ptr<Pipeline> m_depthPipeline;
-    ECS* m_ecs;
+    RenderResources* m_resources;
 };
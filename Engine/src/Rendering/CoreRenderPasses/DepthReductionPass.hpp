@@ -0,0 +1,92 @@
+#pragma once
+
+#include "Application.hpp"
+#include "ECS/Core.hpp"
+#include "ECS/CoreComponents/RendererComponents.hpp"
+#include "Rendering/Pipeline.hpp"
+#include "Rendering/RenderGraph/RenderGraph.hpp"
+#include "Rendering/RenderResources.hpp"
+#include <array>
+#include <glm/glm.hpp>
+
+// finds the closest and farthest depth of the depth prepass and writes them to the DepthRange buffer of the frame
+// Renderer::ReadDepthRange reads it back once the frame's fence is signaled and resets it for the next use
+class DepthReductionPass
+{
+public:
+    DepthReductionPass(RenderGraph& rg, RenderResources& resources)
+        : m_resources(&resources)
+    {
+        PipelineCreateInfo compute = {};
+        compute.type               = PipelineType::COMPUTE;
+        m_pipeline                 = std::make_unique<Pipeline>("depthreduce", compute);
+
+        m_resources->Add<DepthRange>();
+        auto* depthRange = m_resources->GetMut<DepthRange>();
+        for(int32_t i = 0; i < NUM_FRAMES_IN_FLIGHT; ++i)
+        {
+            auto& buffer = depthRange->buffers.emplace_back(2 * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, true);
+
+            const std::array<uint32_t, 2> reset = {~0u, 0u};
+            buffer.Fill(reset.data(), sizeof(reset));
+        }
+
+        RegisterPass(rg);
+
+        auto fitButton = std::make_shared<Button>("Disable Cascade Fitting");
+        fitButton->RegisterCallback(
+            [this](Button* button)
+            {
+                auto* depthRange    = m_resources->GetMut<DepthRange>();
+                depthRange->enabled = !depthRange->enabled;
+                button->SetName(depthRange->enabled ? "Disable Cascade Fitting" : "Enable Cascade Fitting");
+            });
+        Application::GetInstance()->GetRenderer()->AddDebugUIElement(fitButton);
+    }
+
+private:
+    struct PushConstants
+    {
+        glm::uvec2 size;
+        uint32_t depthTexture;
+        uint32_t filler;
+        uint64_t resultPtr;
+    };
+
+    void RegisterPass(RenderGraph& rg)
+    {
+        auto& pass         = rg.AddRenderPass("depthReductionPass", QueueTypeFlagBits::Compute);
+        auto& depthTexture = pass.AddTextureInput("depthImage");
+
+        pass.SetExecutionCallback(
+            [&](CommandBuffer& cb, uint32_t imageIndex)
+            {
+                const VkExtent2D extent = VulkanContext::GetSwapchainExtent();
+
+                PushConstants pc = {};
+                pc.size          = glm::uvec2(extent.width, extent.height);
+                pc.depthTexture  = depthTexture.GetImagePointer()->GetSampledSlot();
+                pc.resultPtr     = m_resources->Get<DepthRange>()->buffers[imageIndex].GetDeviceAddress();
+
+                m_pipeline->Bind(cb);
+                m_pipeline->SetPushConstants(cb, &pc, sizeof(PushConstants));
+                // every thread reduces 4x4 texels so a workgroup covers 64x64
+                vkCmdDispatch(cb.GetCommandBuffer(), (extent.width + 63) / 64, (extent.height + 63) / 64, 1);
+
+                // the host reads the result after waiting for the frame's fence
+                VkMemoryBarrier2 barrier = {VK_STRUCTURE_TYPE_MEMORY_BARRIER_2};
+                barrier.srcStageMask     = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+                barrier.srcAccessMask    = VK_ACCESS_2_SHADER_WRITE_BIT;
+                barrier.dstStageMask     = VK_PIPELINE_STAGE_2_HOST_BIT;
+                barrier.dstAccessMask    = VK_ACCESS_2_HOST_READ_BIT;
+
+                VkDependencyInfo dependency   = {VK_STRUCTURE_TYPE_DEPENDENCY_INFO};
+                dependency.memoryBarrierCount = 1;
+                dependency.pMemoryBarriers    = &barrier;
+                vkCmdPipelineBarrier2(cb.GetCommandBuffer(), &dependency);
+            });
+    }
+
+    std::unique_ptr<Pipeline> m_pipeline;
+    RenderResources* m_resources;
+};
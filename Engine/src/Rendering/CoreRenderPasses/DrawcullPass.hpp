@@ -6,20 +6,29 @@
 #include "ECS/CoreComponents/RendererComponents.hpp"
 #include "Rendering/Pipeline.hpp"
 #include "Rendering/RenderGraph/RenderGraph.hpp"
+#include "Rendering/RenderResources.hpp"
+#include <array>
+#include <span>
 #include <glm/glm.hpp>
 
 class DrawcullPass
 {
 public:
-    DrawcullPass(RenderGraph& rg)
+    DrawcullPass(RenderGraph& rg, RenderResources& resources)
     {
         LOG_WARN("Creating culling pipeline");
         PipelineCreateInfo cullPipeline;
         cullPipeline.type   = PipelineType::COMPUTE;
         cullPipeline.stages = VK_SHADER_STAGE_COMPUTE_BIT;
         m_cullPipeline      = std::make_unique<Pipeline>("drawcull", cullPipeline, 0);
+        m_meshletPipeline   = std::make_unique<Pipeline>("meshletcull", cullPipeline, 0);
+
+        m_resources = &resources;
+
+        // written by the object culling and read by the meshlet culling, one uint per objectID (same size as the transform buffers)
+        m_objectLods.Allocate(MAX_OBJECTS * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+        m_meshletDraws.Allocate(MAX_OBJECTS * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT);
 
-        m_ecs = Application::GetInstance()->GetScene()->GetECS();
         RegisterPass(rg);
 
         auto button = std::make_shared<Button>("Freeze Frustum");
@@ -38,16 +47,69 @@ public:
                 }
             });
         Application::GetInstance()->GetRenderer()->AddDebugUIElement(button);
+
+        auto occlusionButton = std::make_shared<Button>("Disable Occlusion Culling");
+        occlusionButton->RegisterCallback(
+            [this](Button* button)
+            {
+                m_useOcclusion = !m_useOcclusion;
+                button->SetName(m_useOcclusion ? "Disable Occlusion Culling" : "Enable Occlusion Culling");
+            });
+        Application::GetInstance()->GetRenderer()->AddDebugUIElement(occlusionButton);
+
+        auto lodButton = std::make_shared<Button>("Disable LODs");
+        lodButton->RegisterCallback(
+            [this](Button* button)
+            {
+                m_useLods = !m_useLods;
+                button->SetName(m_useLods ? "Disable LODs" : "Enable LODs");
+            });
+        Application::GetInstance()->GetRenderer()->AddDebugUIElement(lodButton);
+        Application::GetInstance()->GetRenderer()->AddDebugUIElement(std::make_shared<DragFloat>(&m_lodThreshold, "LOD error threshold (pixels)", 0.0f, 100.0f));
+
+        auto validateButton = std::make_shared<Button>("Validate CPU Culling");
+        validateButton->RegisterCallback(
+            [this](Button* button)
+            {
+                m_validateCpuCulling = !m_validateCpuCulling;
+                if(m_validateCpuCulling && m_lodReadbacks.empty())
+                {
+                    for(int32_t i = 0; i < NUM_FRAMES_IN_FLIGHT; ++i)
+                        m_lodReadbacks.emplace_back(MAX_OBJECTS * sizeof(uint32_t), VK_BUFFER_USAGE_TRANSFER_DST_BIT, true);
+                }
+                button->SetName(m_validateCpuCulling ? "Stop Validating CPU Culling" : "Validate CPU Culling");
+            });
+        Application::GetInstance()->GetRenderer()->AddDebugUIElement(validateButton);
+        Application::GetInstance()->GetRenderer()->AddDebugUIElement(m_validationText);
     }
 
 private:
+    static constexpr uint32_t MAX_OBJECTS = 50'000;
+    static constexpr uint32_t NOT_VISIBLE = 0xFFFFFFFF;  // has to match NOT_VISIBLE in shaders/drawcull.comp
+
     struct ShaderData
     {
-        glm::vec4 frustumPlanes[5];
+        glm::mat4 viewProj;
+        glm::vec3 cameraPos;
+        float lodScale;  // pixels per unit at a distance of 1, 0 disables the LODs
+        float lodThreshold;
+    };
+    struct MeshletShaderData
+    {
+        glm::mat4 view;
+        glm::mat4 hizViewProj;
+        glm::vec4 frustumPlanes[5];  // normalized so they can be used with bounding spheres
+        glm::vec3 cameraPos;
+        uint32_t hizEnabled;
+        glm::uvec2 depthSize;
+        uint32_t hizLevels;
+        uint32_t filler;
+        uint32_t hizSlots[DepthPyramid::MAX_LEVELS];
     };
     struct PushConstants
     {
         uint32_t inDrawCmdCount;
+        uint32_t inDrawCmdCount16;  // the first inDrawCmdCount16 draws use 16 bit indices
         uint64_t inDrawCmdPtr;
         uint64_t outDrawCmdPtr;
 
@@ -57,58 +119,256 @@ private:
 
         uint64_t transformBufferPtr;
 
-        glm::mat4 viewProj;
+        uint64_t drawLodsPtr;
+        uint64_t objectLodsPtr;
+        uint64_t meshletDrawsPtr;
+        uint64_t shaderDataPtr;
+    };
+    struct MeshletPushConstants
+    {
+        uint32_t inMeshletCount;
+        uint32_t inMeshletCount16;  // the first inMeshletCount16 meshlets use 16 bit indices
+        uint64_t inMeshletPtr;
+        uint64_t outDrawCmdPtr;
+
+        uint64_t indexBufferPtr;
+        uint64_t indexBuffer16Ptr;
+
+        uint64_t transformBufferPtr;
+        uint64_t objectLodsPtr;
+        uint64_t meshletDrawsPtr;
+        uint64_t shaderDataPtr;
     };
 
+    // world space planes of the view projection facing inside, the same ones drawcull.comp extracts (the far plane is infinite)
+    static std::array<glm::vec4, 5> GetFrustumPlanes(const glm::mat4& viewProj)
+    {
+        const glm::mat4 rows = glm::transpose(viewProj);
+        return {rows[3] + rows[0], rows[3] - rows[0], rows[3] + rows[1], rows[3] - rows[1], rows[3] - rows[2]};
+    }
+
+    // compares what the CPU culling found visible with the object LODs the GPU wrote the last time this frame was rendered
+    // the CPU tests the world space box around the transformed bounding box so it can keep more objects than the GPU, but never less
+    void CompareCpuCulling(uint32_t imageIndex)
+    {
+        const FrustumCuller& culler = Application::GetInstance()->GetRenderer()->GetFrustumCuller();
+        const uint32_t count        = std::min(culler.GetCount(), MAX_OBJECTS);
+
+        m_gpuLods.resize(count);
+        m_lodReadbacks[imageIndex].Read(m_gpuLods.data(), count * sizeof(uint32_t));
+
+        const std::vector<uint32_t>& cpuVisible = m_cpuVisible[imageIndex];
+        uint32_t gpuVisible                     = 0;
+        uint32_t cpuOnly                        = 0;
+        uint32_t missed                         = 0;
+        size_t next                             = 0;  // the CPU results are sorted
+        for(uint32_t objectID = 0; objectID < count; ++objectID)
+        {
+            const bool onCpu = next < cpuVisible.size() && cpuVisible[next] == objectID;
+            next += onCpu ? 1 : 0;
+            if(!culler.HasBounds(objectID))
+                continue;
+
+            const bool onGpu = m_gpuLods[objectID] != NOT_VISIBLE;
+            gpuVisible += onGpu ? 1 : 0;
+            cpuOnly += onCpu && !onGpu ? 1 : 0;
+            missed += onGpu && !onCpu ? 1 : 0;
+        }
+        if(missed != 0)
+            LOG_WARN("CPU culling missed {0} objects the GPU culling found visible", missed);
+
+        m_validationText->SetText("CPU culling: " + std::to_string(cpuVisible.size()) + " visible, GPU: " + std::to_string(gpuVisible) + " visible\n\t" + std::to_string(cpuOnly) + " only visible on the CPU, " + std::to_string(missed) + " missed");
+    }
+
     void RegisterPass(RenderGraph& rg)
     {
         auto& cullingPass   = rg.AddRenderPass("cullingPass", QueueTypeFlagBits::Compute);
         auto& outDrawBuffer = cullingPass.AddStorageBufferOutput("drawBuffer");
         auto& drawObjBuffer = cullingPass.AddStorageBufferOutput("drawObjBuffer");
+        drawObjBuffer.SetBufferInfo({0, VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_BUFFER_USAGE_TRANSFER_DST_BIT});  // the batch counts are cleared with vkCmdFillBuffer
 
         cullingPass.SetExecutionCallback(
             [&](CommandBuffer& cb, uint32_t imageIndex)
             {
-                const MainCameraData* camera = m_ecs->GetSingleton<MainCameraData>();
+                const MainCameraData* camera = m_resources->Get<FrameCameraData>();
+                const float screenHeight     = static_cast<float>(VulkanContext::GetSwapchainExtent().height);
                 const ShaderData shaderData{
-                    .frustumPlanes = {
-                                      camera->frustumPlanesVS[0],
-                                      camera->frustumPlanesVS[1],
-                                      camera->frustumPlanesVS[2],
-                                      camera->frustumPlanesVS[3],
-                                      camera->frustumPlanesVS[4],
-                                      }
+                    .viewProj     = m_frozenFrustum ? m_lastVP : camera->viewProj,
+                    .cameraPos    = m_frozenFrustum ? m_lastCameraPos : camera->pos,
+                    .lodScale     = m_useLods ? 0.5f * screenHeight / camera->clipToViewSpaceConsts.y : 0.0f,
+                    .lodThreshold = m_lodThreshold,
                 };
 
                 m_cullPipeline->UploadShaderData(&shaderData, imageIndex);
 
-                const auto* drawCmds          = m_ecs->GetSingleton<DrawCommandBuffer>();
-                const auto* boundingBoxBuffer = m_ecs->GetSingleton<BoundingBoxBuffer>();
+                const auto* drawCmds          = m_resources->Get<DrawCommandBuffer>();
+                const auto* boundingBoxBuffer = m_resources->Get<BoundingBoxBuffer>();
                 PushConstants pc{
                     .inDrawCmdCount     = drawCmds->count,
+                    .inDrawCmdCount16   = drawCmds->count16,
                     .inDrawCmdPtr       = drawCmds->buffer.GetDeviceAddress(0),
                     .outDrawCmdPtr      = outDrawBuffer.GetBufferPointer()->GetDeviceAddress(),
                     .drawObjPtr         = drawObjBuffer.GetBufferPointer()->GetDeviceAddress(),
                     .boundingBoxes      = boundingBoxBuffer->buffer.GetDeviceAddress(0),
-                    .transformBufferPtr = m_ecs->GetSingleton<TransformBuffers>()
+                    .transformBufferPtr = m_resources->Get<TransformBuffers>()
                                               ->buffers[imageIndex]
                                               .GetDeviceAddress(0),
-                    .viewProj = m_frozenFrustum ? m_lastVP : camera->viewProj,
+                    .drawLodsPtr        = m_resources->Get<DrawLodBuffer>()->buffer.GetDeviceAddress(0),
+                    .objectLodsPtr      = m_objectLods.GetDeviceAddress(),
+                    .meshletDrawsPtr    = m_meshletDraws.GetDeviceAddress(),
+                    .shaderDataPtr      = m_cullPipeline->GetShaderDataBufferPtr(imageIndex),
                 };
 
 
+                // the counts are cleared before the dispatch, a reset in the shader only syncs with its own workgroup
+                // last frame's draws also read the meshlet indices the culling overwrites, the dispatches wait for them through the clear
+                VkMemoryBarrier2 clearBarrier = {VK_STRUCTURE_TYPE_MEMORY_BARRIER_2};
+                clearBarrier.srcStageMask     = VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+                clearBarrier.srcAccessMask    = VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_2_INDEX_READ_BIT | VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT;
+                clearBarrier.dstStageMask     = VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT;
+                clearBarrier.dstAccessMask    = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+
+                VkDependencyInfo clearDependency   = {VK_STRUCTURE_TYPE_DEPENDENCY_INFO};
+                clearDependency.memoryBarrierCount = 1;
+                clearDependency.pMemoryBarriers    = &clearBarrier;
+                vkCmdPipelineBarrier2(cb.GetCommandBuffer(), &clearDependency);
+
+                for(uint32_t batch = 0; batch < NUM_INDEX_BATCHES; ++batch)
+                    vkCmdFillBuffer(cb.GetCommandBuffer(), drawObjBuffer.GetBufferPointer()->GetVkBuffer(), GetObjectIDMapBatchOffset(batch), sizeof(uint32_t), 0);
+
+                clearBarrier.srcStageMask  = VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT;
+                clearBarrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+                clearBarrier.dstStageMask  = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+                clearBarrier.dstAccessMask = VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT;
+                vkCmdPipelineBarrier2(cb.GetCommandBuffer(), &clearDependency);
+
                 m_cullPipeline->Bind(cb);
                 m_cullPipeline->SetPushConstants(cb, &pc, sizeof(PushConstants));
 
                 vkCmdDispatch(cb.GetCommandBuffer(), 10, 1, 1);
 
+                if(m_validating[imageIndex])
+                    CompareCpuCulling(imageIndex);
+                m_validating[imageIndex] = m_validateCpuCulling;
+                if(m_validateCpuCulling)
+                {
+                    // the renderer applies the bounds of the snapshot to the culler on this thread before executing the graph
+                    const std::array<glm::vec4, 5> planes = GetFrustumPlanes(shaderData.viewProj);
+                    m_cpuVisible[imageIndex].clear();
+                    Application::GetInstance()->GetRenderer()->GetFrustumCuller().Cull(planes, m_cpuVisible[imageIndex]);
+
+                    // the host reads the copy after waiting for the frame's fence
+                    VkMemoryBarrier2 copyBarrier = {VK_STRUCTURE_TYPE_MEMORY_BARRIER_2};
+                    copyBarrier.srcStageMask     = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+                    copyBarrier.srcAccessMask    = VK_ACCESS_2_SHADER_WRITE_BIT;
+                    copyBarrier.dstStageMask     = VK_PIPELINE_STAGE_2_COPY_BIT;
+                    copyBarrier.dstAccessMask    = VK_ACCESS_2_TRANSFER_READ_BIT;
+
+                    VkDependencyInfo copyDependency   = {VK_STRUCTURE_TYPE_DEPENDENCY_INFO};
+                    copyDependency.memoryBarrierCount = 1;
+                    copyDependency.pMemoryBarriers    = &copyBarrier;
+                    vkCmdPipelineBarrier2(cb.GetCommandBuffer(), &copyDependency);
+
+                    VkBufferCopy region = {};
+                    region.size         = MAX_OBJECTS * sizeof(uint32_t);
+                    vkCmdCopyBuffer(cb.GetCommandBuffer(), m_objectLods.GetVkBuffer(), m_lodReadbacks[imageIndex].GetVkBuffer(), 1, &region);
+
+                    copyBarrier.srcStageMask  = VK_PIPELINE_STAGE_2_COPY_BIT;
+                    copyBarrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+                    copyBarrier.dstStageMask  = VK_PIPELINE_STAGE_2_HOST_BIT;
+                    copyBarrier.dstAccessMask = VK_ACCESS_2_HOST_READ_BIT;
+                    vkCmdPipelineBarrier2(cb.GetCommandBuffer(), &copyDependency);
+                }
+
                 if(!m_frozenFrustum)
-                    m_lastVP = camera->viewProj;
+                {
+                    m_lastVP        = camera->viewProj;
+                    m_lastView      = camera->view;
+                    m_lastCameraPos = camera->pos;
+                }
+
+                const auto* meshletDraws = m_resources->Get<MeshletDrawCommandBuffer>();
+                if(meshletDraws->count == 0)
+                    return;
+
+                // the meshlets grow the draws and read the object LODs, they have to wait for the whole object culling
+                VkMemoryBarrier2 barrier = {VK_STRUCTURE_TYPE_MEMORY_BARRIER_2};
+                barrier.srcStageMask     = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+                barrier.srcAccessMask    = VK_ACCESS_2_SHADER_WRITE_BIT;
+                barrier.dstStageMask     = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+                barrier.dstAccessMask    = VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT;
+
+                VkDependencyInfo dependency   = {VK_STRUCTURE_TYPE_DEPENDENCY_INFO};
+                dependency.memoryBarrierCount = 1;
+                dependency.pMemoryBarriers    = &barrier;
+                vkCmdPipelineBarrier2(cb.GetCommandBuffer(), &dependency);
+
+                // the pyramid isn't an input of this pass since it's built later in the frame by the HiZPass, we use last frame's one
+                const auto* pyramid      = m_resources->Get<DepthPyramid>();
+                const Renderer* renderer = Application::GetInstance()->GetRenderer();
+                const VkExtent2D ext     = VulkanContext::GetSwapchainExtent();
+                const bool useHiZ        = m_useOcclusion && !m_frozenFrustum && pyramid->valid && pyramid->width == ext.width && pyramid->height == ext.height;
+
+                MeshletShaderData meshletData{};
+                meshletData.view        = m_lastView;
+                meshletData.hizViewProj = pyramid->viewProj;
+                for(uint32_t i = 0; i < 5; ++i)
+                    meshletData.frustumPlanes[i] = camera->frustumPlanesVS[i] / glm::length(glm::vec3(camera->frustumPlanesVS[i]));
+                meshletData.cameraPos  = m_lastCameraPos;
+                meshletData.hizEnabled = useHiZ ? 1 : 0;
+                meshletData.depthSize  = glm::uvec2(pyramid->width, pyramid->height);
+                meshletData.hizLevels  = static_cast<uint32_t>(pyramid->levels.size());
+                for(uint32_t i = 0; i < pyramid->levels.size(); ++i)
+                    meshletData.hizSlots[i] = pyramid->levels[i]->GetSampledSlot();
+
+                m_meshletPipeline->UploadShaderData(&meshletData, imageIndex);
+
+                MeshletPushConstants meshletPC{
+                    .inMeshletCount     = meshletDraws->count,
+                    .inMeshletCount16   = meshletDraws->count16,
+                    .inMeshletPtr       = meshletDraws->buffer.GetDeviceAddress(0),
+                    .outDrawCmdPtr      = outDrawBuffer.GetBufferPointer()->GetDeviceAddress(),
+                    .indexBufferPtr     = renderer->GetIndexBufferAddress(),
+                    .indexBuffer16Ptr   = renderer->GetIndexBuffer16Address(),
+                    .transformBufferPtr = pc.transformBufferPtr,
+                    .objectLodsPtr      = pc.objectLodsPtr,
+                    .meshletDrawsPtr    = pc.meshletDrawsPtr,
+                    .shaderDataPtr      = m_meshletPipeline->GetShaderDataBufferPtr(imageIndex),
+                };
+
+                m_meshletPipeline->Bind(cb);
+                m_meshletPipeline->SetPushConstants(cb, &meshletPC, sizeof(MeshletPushConstants));
+
+                vkCmdDispatch(cb.GetCommandBuffer(), (meshletDraws->count + 63) / 64, 1, 1);
+
+                // the index buffers aren't render graph resources, the draws of the frame read the copied indices
+                barrier.srcStageMask  = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+                barrier.srcAccessMask = VK_ACCESS_2_SHADER_WRITE_BIT;
+                barrier.dstStageMask  = VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT;
+                barrier.dstAccessMask = VK_ACCESS_2_INDEX_READ_BIT;
+                vkCmdPipelineBarrier2(cb.GetCommandBuffer(), &dependency);
             });
     }
 
     std::unique_ptr<Pipeline> m_cullPipeline;
-    ECS* m_ecs;
+    std::unique_ptr<Pipeline> m_meshletPipeline;
+    RenderResources* m_resources;
     glm::mat4 m_lastVP;
+    glm::mat4 m_lastView;
+    glm::vec3 m_lastCameraPos;
     bool m_frozenFrustum = false;
+    bool m_useOcclusion  = true;
+    bool m_useLods       = true;
+    float m_lodThreshold = 1.0f;  // a LOD is used when its error is smaller than this many pixels on screen
+
+    Buffer m_objectLods;
+    Buffer m_meshletDraws;  // the draw of each object drawn per meshlet, written by the object culling for the meshlet culling
+
+    // validation of the CPU culling against the GPU one, with the same frustum
+    bool m_validateCpuCulling = false;
+    std::array<bool, NUM_FRAMES_IN_FLIGHT> m_validating{};                 // if the frame copied its object LODs the last time it was rendered
+    std::vector<Buffer> m_lodReadbacks;                                    // one per frame, copies of m_objectLods
+    std::array<std::vector<uint32_t>, NUM_FRAMES_IN_FLIGHT> m_cpuVisible;  // the objectIDs the CPU culling found visible for the frame
+    std::vector<uint32_t> m_gpuLods;
+    std::shared_ptr<Text> m_validationText = std::make_shared<Text>("CPU culling not validated");
 };
@@ -2,7 +2,9 @@
 
 #include "Application.hpp"
 #include "ECS/CoreComponents/Camera.hpp"
+#include "ECS/CoreComponents/RendererComponents.hpp"
 #include "Rendering/RenderGraph/RenderGraph.hpp"
+#include "Rendering/RenderResources.hpp"
 #include "Rendering/Pipeline.hpp"
 #include "ECS/Core.hpp"
 #include "Utils/Math/Hilbert.hpp"
@@ -10,8 +12,8 @@
 class GTAOPass
 {
 public:
-    GTAOPass(RenderGraph& rg)
-        : m_ecs(Application::GetInstance()->GetScene()->GetECS())
+    GTAOPass(RenderGraph& rg, RenderResources& resources)
+        : m_resources(&resources)
     {
         Buffer staging(64 * 64 * sizeof(uint32_t), VK_BUFFER_USAGE_TRANSFER_SRC_BIT, true);
         staging.Fill(MathUtils::GenerateHilbertLUT(64).data(), 64 * 64 * sizeof(uint32_t));
@@ -65,7 +67,7 @@ private:
         pass.SetExecutionCallback(
             [&](CommandBuffer& cb, uint32_t /*imageIndex*/)
             {
-                const auto* mainCamera  = m_ecs->GetSingleton<MainCameraData>();
+                const auto* mainCamera  = m_resources->Get<FrameCameraData>();
                 const auto viewportSize = glm::vec2(VulkanContext::GetSwapchainExtent().width, VulkanContext::GetSwapchainExtent().height);
 
                 m_pipeline->Bind(cb);
@@ -90,5 +92,5 @@ private:
 
     std::unique_ptr<Image> m_hilbertLUT;
     std::unique_ptr<Pipeline> m_pipeline;
-    ECS* m_ecs;
+    RenderResources* m_resources;
 };
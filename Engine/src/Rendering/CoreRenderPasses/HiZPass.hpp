@@ -0,0 +1,143 @@
+#pragma once
+
+#include "Application.hpp"
+#include "ECS/Core.hpp"
+#include "ECS/CoreComponents/Camera.hpp"
+#include "ECS/CoreComponents/RendererComponents.hpp"
+#include "Rendering/Pipeline.hpp"
+#include "Rendering/RenderGraph/RenderGraph.hpp"
+#include "Rendering/RenderResources.hpp"
+#include <glm/glm.hpp>
+
+// builds a min depth pyramid from the depth prepass, the culling pass tests meshlets against it in the next frame
+// with reverse z the farthest depth is the smallest so every texel holds the farthest depth of the area it covers
+class HiZPass
+{
+public:
+    HiZPass(RenderGraph& rg, RenderResources& resources)
+        : m_resources(&resources)
+    {
+        PipelineCreateInfo compute = {};
+        compute.type               = PipelineType::COMPUTE;
+        m_pipeline                 = std::make_unique<Pipeline>("hiz", compute);
+
+        m_resources->Add<DepthPyramid>();
+
+        RegisterPass(rg);
+    }
+
+private:
+    struct PushConstants
+    {
+        uint32_t inTexture;  // sampled slot of the depth image or the previous level
+        uint32_t outTexture;
+        glm::uvec2 inSize;
+        glm::uvec2 outSize;
+    };
+
+    void CreatePyramid(uint32_t width, uint32_t height)
+    {
+        auto* pyramid = m_resources->GetMut<DepthPyramid>();
+
+        // level 0 is half the depth resolution rounded down, the shader folds the extra row/column of odd sizes into the last texel
+        uint32_t levelWidth  = glm::max(width / 2, 1u);
+        uint32_t levelHeight = glm::max(height / 2, 1u);
+        while(pyramid->levels.size() < DepthPyramid::MAX_LEVELS)
+        {
+            ImageCreateInfo imageCreateInfo = {};
+            imageCreateInfo.format          = VK_FORMAT_R32_SFLOAT;
+            imageCreateInfo.usage           = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+            imageCreateInfo.aspectFlags     = VK_IMAGE_ASPECT_COLOR_BIT;
+            imageCreateInfo.useMips         = false;  // separate images so every level gets its own texture and storage slot
+            imageCreateInfo.debugName       = "depthPyramid" + std::to_string(pyramid->levels.size());
+
+            auto& level = pyramid->levels.emplace_back(std::make_unique<Image>(levelWidth, levelHeight, imageCreateInfo));
+            level->TransitionLayout(VK_IMAGE_LAYOUT_GENERAL);
+            Application::GetInstance()->GetRenderer()->AddTexture(level.get());
+            Application::GetInstance()->GetRenderer()->AddStorageImage(level.get());
+
+            if(levelWidth == 1 && levelHeight == 1)
+                break;
+            levelWidth  = glm::max(levelWidth / 2, 1u);
+            levelHeight = glm::max(levelHeight / 2, 1u);
+        }
+
+        pyramid->width  = width;
+        pyramid->height = height;
+        pyramid->valid  = false;
+    }
+
+    void DestroyPyramid()
+    {
+        auto* pyramid = m_resources->GetMut<DepthPyramid>();
+        if(pyramid->levels.empty())
+            return;
+
+        vkDeviceWaitIdle(VulkanContext::GetDevice());
+        for(auto& level : pyramid->levels)
+        {
+            Application::GetInstance()->GetRenderer()->RemoveTexture(level.get());
+            Application::GetInstance()->GetRenderer()->RemoveStorageImage(level.get());
+        }
+        pyramid->levels.clear();
+        pyramid->valid = false;
+    }
+
+    void RegisterPass(RenderGraph& rg)
+    {
+        auto& pass         = rg.AddRenderPass("hizPass", QueueTypeFlagBits::Compute);
+        auto& depthTexture = pass.AddTextureInput("depthImage");
+
+        pass.SetExecutionCallback(
+            [&](CommandBuffer& cb, uint32_t /*imageIndex*/)
+            {
+                const VkExtent2D extent = VulkanContext::GetSwapchainExtent();
+                auto* pyramid           = m_resources->GetMut<DepthPyramid>();
+                if(pyramid->width != extent.width || pyramid->height != extent.height)
+                {
+                    DestroyPyramid();
+                    CreatePyramid(extent.width, extent.height);
+                }
+
+                // the culling pass of this frame was still reading the pyramid
+                VkMemoryBarrier2 barrier = {VK_STRUCTURE_TYPE_MEMORY_BARRIER_2};
+                barrier.srcStageMask     = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+                barrier.srcAccessMask    = VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT;
+                barrier.dstStageMask     = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+                barrier.dstAccessMask    = VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT;
+
+                VkDependencyInfo dependency   = {VK_STRUCTURE_TYPE_DEPENDENCY_INFO};
+                dependency.memoryBarrierCount = 1;
+                dependency.pMemoryBarriers    = &barrier;
+                vkCmdPipelineBarrier2(cb.GetCommandBuffer(), &dependency);
+
+                m_pipeline->Bind(cb);
+
+                glm::uvec2 inSize(extent.width, extent.height);
+                uint32_t inTexture = depthTexture.GetImagePointer()->GetSampledSlot();
+                for(const auto& level : pyramid->levels)
+                {
+                    PushConstants pc = {};
+                    pc.inTexture     = inTexture;
+                    pc.outTexture    = level->GetStorageSlot();
+                    pc.inSize        = inSize;
+                    pc.outSize       = glm::uvec2(level->GetWidth(), level->GetHeight());
+
+                    m_pipeline->SetPushConstants(cb, &pc, sizeof(PushConstants));
+                    vkCmdDispatch(cb.GetCommandBuffer(), (pc.outSize.x + 7) / 8, (pc.outSize.y + 7) / 8, 1);
+
+                    // the next level reads this one
+                    vkCmdPipelineBarrier2(cb.GetCommandBuffer(), &dependency);
+
+                    inTexture = level->GetSampledSlot();
+                    inSize    = pc.outSize;
+                }
+
+                pyramid->viewProj = m_resources->Get<FrameCameraData>()->viewProj;
+                pyramid->valid    = true;
+            });
+    }
+
+    std::unique_ptr<Pipeline> m_pipeline;
+    RenderResources* m_resources;
+};
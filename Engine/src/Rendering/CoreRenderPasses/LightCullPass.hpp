@@ -3,21 +3,41 @@
 #include "Application.hpp"
 #include "ECS/CoreComponents/Camera.hpp"
 #include "Rendering/RenderGraph/RenderGraph.hpp"
+#include "Rendering/RenderResources.hpp"
 #include "Rendering/Pipeline.hpp"
 #include "ECS/Core.hpp"
 #include "ECS/CoreComponents/RendererComponents.hpp"
 #include <glm/glm.hpp>
+
+// culls the lights into per cluster lists (CLUSTER_TILE_SIZE screen tiles times CLUSTER_SLICES exponential depth slices) that share one index list
+// the lights are binned per CLUSTER_BIN_TILES x CLUSTER_BIN_TILES tiles first so that the tiles only test the lights of their bin
+// the clusters are counted, a prefix sum gives every cluster its offset and the indices are written in a second pass
+// the 2D tiled culling per 16x16 tile is kept behind LightBuffers::clustered, the tiles append their lights to a packed list
+// both index lists are sized from what earlier frames asked for (Renderer::ResizeLightLists resizes them before the frame is recorded)
 class LightCullPass
 {
 public:
-    LightCullPass(RenderGraph& rg)
-        : m_ecs(Application::GetInstance()->GetScene()->GetECS())
+    LightCullPass(RenderGraph& rg, RenderResources& resources)
+        : m_resources(&resources)
     {
         PipelineCreateInfo compute = {};
         compute.type               = PipelineType::COMPUTE;
         m_pipeline                 = std::make_unique<Pipeline>("lightCulling", compute);
+        m_binPipeline              = std::make_unique<Pipeline>("clusterBinning", compute);
+        m_clusterPipeline          = std::make_unique<Pipeline>("clusterCulling", compute);
+        m_scanPipeline             = std::make_unique<Pipeline>("clusterScan", compute);
 
         RegisterPass(rg);
+
+        auto clusterButton = std::make_shared<Button>("Use Tiled Light Culling");
+        clusterButton->RegisterCallback(
+            [this](Button* button)
+            {
+                auto* lightBuffers      = m_resources->GetMut<LightBuffers>();
+                lightBuffers->clustered = !lightBuffers->clustered;
+                button->SetName(lightBuffers->clustered ? "Use Tiled Light Culling" : "Use Clustered Light Culling");
+            });
+        Application::GetInstance()->GetRenderer()->AddDebugUIElement(clusterButton);
     }
 
 private:
@@ -31,6 +51,10 @@ private:
         int lightNum;
         int depthTextureId;
         int debugTextureId;
+        uint32_t use16BitIndices;  // two indices per uint
+        uint64_t lightIndexBuffer;
+        uint64_t lightIndexCounter;
+        uint32_t maxIndices;  // uints in lightIndexBuffer
     };
     struct PushConstants
     {
@@ -39,6 +63,104 @@ private:
         int32_t debugMode;
         uint64_t shaderDataPtr;
     };
+    struct ClusterPushConstants
+    {
+        glm::mat4 view;
+        glm::vec2 clipToView;  // (aspect * tan(fov / 2), tan(fov / 2))
+        glm::vec2 tileSizeNDC;
+        float sliceScale;  // slice = log(distance) * sliceScale + sliceBias
+        float sliceBias;
+        uint32_t lightNum;
+        uint32_t writeIndices;  // 0 only counts
+        uint64_t lightBuffer;
+        uint64_t clusters;
+        uint64_t lightIndices;
+        uint64_t bins;
+    };
+    struct ScanPushConstants
+    {
+        uint64_t clusters;
+        uint32_t clusterCount;
+        uint32_t maxIndices;
+        uint64_t counter;  // the clusters' uint of LightBuffers::lightListCounters
+    };
+
+    static void ComputeBarrier(CommandBuffer& cb)
+    {
+        VkMemoryBarrier2 barrier = {VK_STRUCTURE_TYPE_MEMORY_BARRIER_2};
+        barrier.srcStageMask     = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+        barrier.srcAccessMask    = VK_ACCESS_2_SHADER_WRITE_BIT;
+        barrier.dstStageMask     = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+        barrier.dstAccessMask    = VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT;
+
+        VkDependencyInfo dependency   = {VK_STRUCTURE_TYPE_DEPENDENCY_INFO};
+        dependency.memoryBarrierCount = 1;
+        dependency.pMemoryBarriers    = &barrier;
+        vkCmdPipelineBarrier2(cb.GetCommandBuffer(), &dependency);
+    }
+    // the packed lists aren't resources of the graph since they get reallocated when they are resized
+    static void LightListBarrier(CommandBuffer& cb)
+    {
+        VkMemoryBarrier2 barrier = {VK_STRUCTURE_TYPE_MEMORY_BARRIER_2};
+        barrier.srcStageMask     = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+        barrier.srcAccessMask    = VK_ACCESS_2_SHADER_WRITE_BIT;
+        barrier.dstStageMask     = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_2_HOST_BIT;
+        barrier.dstAccessMask    = VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_HOST_READ_BIT;
+
+        VkDependencyInfo dependency   = {VK_STRUCTURE_TYPE_DEPENDENCY_INFO};
+        dependency.memoryBarrierCount = 1;
+        dependency.pMemoryBarriers    = &barrier;
+        vkCmdPipelineBarrier2(cb.GetCommandBuffer(), &dependency);
+    }
+
+    void CullClusters(CommandBuffer& cb, uint32_t imageIndex)
+    {
+        const auto* lightBuffers = m_resources->Get<LightBuffers>();
+        const auto* mainCamera   = m_resources->Get<FrameCameraData>();
+        const VkExtent2D extent  = VulkanContext::GetSwapchainExtent();
+        const glm::uvec2 tileNums((extent.width + CLUSTER_TILE_SIZE - 1) / CLUSTER_TILE_SIZE, (extent.height + CLUSTER_TILE_SIZE - 1) / CLUSTER_TILE_SIZE);
+        const glm::uvec2 binNums((tileNums + glm::uvec2(CLUSTER_BIN_TILES - 1)) / glm::uvec2(CLUSTER_BIN_TILES));
+
+        ClusterPushConstants pc = {};
+        pc.view                 = mainCamera->view;
+        pc.clipToView           = mainCamera->clipToViewSpaceConsts;
+        pc.tileSizeNDC          = 2.0f * glm::vec2(CLUSTER_TILE_SIZE) / glm::vec2(extent.width, extent.height);
+        pc.sliceScale           = CLUSTER_SLICES / std::log(CLUSTER_FAR_PLANE / mainCamera->zNear);
+        pc.sliceBias            = -std::log(mainCamera->zNear) * pc.sliceScale;
+        pc.lightNum             = lightBuffers->lightNum;
+        pc.writeIndices         = 0;
+        pc.lightBuffer          = lightBuffers->buffers[imageIndex].GetDeviceAddress(0);
+        pc.clusters             = lightBuffers->clusterBuffer.GetDeviceAddress();
+        pc.lightIndices         = lightBuffers->lightIndexBuffer.GetDeviceAddress();
+        pc.bins                 = lightBuffers->lightBinBuffer.GetDeviceAddress();
+
+        ComputeBarrier(cb);  // the bins are only used in this pass, the last frame's clusters might still read them
+        m_binPipeline->Bind(cb);
+        m_binPipeline->SetPushConstants(cb, &pc, sizeof(ClusterPushConstants));
+        vkCmdDispatch(cb.GetCommandBuffer(), binNums.x, binNums.y, 1);
+        ComputeBarrier(cb);
+
+        m_clusterPipeline->Bind(cb);
+        m_clusterPipeline->SetPushConstants(cb, &pc, sizeof(ClusterPushConstants));
+        vkCmdDispatch(cb.GetCommandBuffer(), tileNums.x, tileNums.y, 1);
+        ComputeBarrier(cb);
+
+        ScanPushConstants scan = {};
+        scan.clusters          = pc.clusters;
+        scan.clusterCount      = tileNums.x * tileNums.y * CLUSTER_SLICES;
+        scan.maxIndices        = lightBuffers->lightIndexSize.capacity;
+        scan.counter           = lightBuffers->lightListCounters[imageIndex].GetDeviceAddress() + sizeof(uint32_t);
+        m_scanPipeline->Bind(cb);
+        m_scanPipeline->SetPushConstants(cb, &scan, sizeof(ScanPushConstants));
+        vkCmdDispatch(cb.GetCommandBuffer(), 1, 1, 1);
+        ComputeBarrier(cb);
+
+        pc.writeIndices = 1;
+        m_clusterPipeline->Bind(cb);
+        m_clusterPipeline->SetPushConstants(cb, &pc, sizeof(ClusterPushConstants));
+        vkCmdDispatch(cb.GetCommandBuffer(), tileNums.x, tileNums.y, 1);
+        LightListBarrier(cb);
+    }
 
 
     void RegisterPass(RenderGraph& rg)
@@ -47,6 +169,9 @@ private:
         auto& visibleLightsBuffer = lightCullPass.AddStorageBufferOutput("visibleLightsBuffer", "", VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, true);
         auto& depthTexture        = lightCullPass.AddTextureInput("depthImage");
         auto& debugTexture        = lightCullPass.AddStorageImageOutput("debugImage", VK_FORMAT_R8_UNORM);
+        auto& clusterBuffer       = lightCullPass.AddStorageBufferOutput("clusterBuffer", "", VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, true);
+        auto* lightBuffers        = m_resources->GetMut<LightBuffers>();
+        clusterBuffer.SetBufferPointer(&lightBuffers->clusterBuffer);
 
         lightCullPass.SetInitialiseCallback(
             [&](RenderGraph& /*rg*/)
@@ -58,7 +183,7 @@ private:
                 data.depthTextureId      = depthTexture.GetImagePointer()->GetSampledSlot();
                 data.debugTextureId      = debugTexture.GetImagePointer()->GetStorageSlot();
 
-                const auto* lightBuffers = m_ecs->GetSingleton<LightBuffers>();
+                const auto* lightBuffers = m_resources->Get<LightBuffers>();
                 data.lightNum            = lightBuffers->lightNum;
                 for(int i = 0; i < NUM_FRAMES_IN_FLIGHT; ++i)
                 {
@@ -69,18 +194,29 @@ private:
         lightCullPass.SetExecutionCallback(
             [&](CommandBuffer& cb, uint32_t imageIndex)
             {
-                const auto* lightBuffers = m_ecs->GetSingleton<LightBuffers>();
+                const auto* lightBuffers = m_resources->Get<LightBuffers>();
+                if(lightBuffers->clustered)
+                {
+                    CullClusters(cb, imageIndex);
+                    return;
+                }
+
                 ShaderData data          = {};
                 data.lightNum            = lightBuffers->lightNum;
                 data.lightBuffer         = lightBuffers->buffers[imageIndex].GetDeviceAddress(0);
+                data.use16BitIndices     = lightBuffers->lightNum < 65536 ? 1 : 0;
+                data.lightIndexBuffer    = lightBuffers->tileLightIndexBuffer.GetDeviceAddress();
+                data.lightIndexCounter   = lightBuffers->lightListCounters[imageIndex].GetDeviceAddress();
+                data.maxIndices          = lightBuffers->tileLightIndexSize.capacity;
                 m_pipeline->UploadShaderData(&data, imageIndex, offsetof(ShaderData, lightBuffer), sizeof(uint64_t) + sizeof(int));
+                m_pipeline->UploadShaderData(&data, imageIndex, offsetof(ShaderData, use16BitIndices), sizeof(ShaderData) - offsetof(ShaderData, use16BitIndices));
 
                 m_pipeline->Bind(cb);
 
                 PushConstants pc = {};
 
 
-                const auto* mainCamera = m_ecs->GetSingleton<MainCameraData>();
+                const auto* mainCamera = m_resources->Get<FrameCameraData>();
                 pc.viewProj            = mainCamera->viewProj;
                 pc.cameraPos           = mainCamera->pos;
                 pc.shaderDataPtr       = m_pipeline->GetShaderDataBufferPtr(imageIndex);
@@ -92,9 +228,13 @@ private:
 
                 auto tileNums = glm::ivec2(ceil(viewportSize.x / 16.0f), ceil(viewportSize.y / 16.0f));
                 vkCmdDispatch(cb.GetCommandBuffer(), tileNums.x, tileNums.y, 1);
+                LightListBarrier(cb);
             });
     }
 
-    std::unique_ptr<Pipeline> m_pipeline;
-    ECS* m_ecs;
+    std::unique_ptr<Pipeline> m_pipeline;  // tiled
+    std::unique_ptr<Pipeline> m_binPipeline;
+    std::unique_ptr<Pipeline> m_clusterPipeline;
+    std::unique_ptr<Pipeline> m_scanPipeline;
+    RenderResources* m_resources;
 };
@@ -3,6 +3,7 @@
 #include "Application.hpp"
 #include "ECS/CoreComponents/Camera.hpp"
 #include "Rendering/RenderGraph/RenderGraph.hpp"
+#include "Rendering/RenderResources.hpp"
 #include "Rendering/Pipeline.hpp"
 #include "ECS/Core.hpp"
 #include "ECS/CoreComponents/RendererComponents.hpp"
@@ -11,8 +12,8 @@
 class LightingPass
 {
 public:
-    LightingPass(RenderGraph& rg)
-        : m_ecs(Application::GetInstance()->GetScene()->GetECS()),
+    LightingPass(RenderGraph& rg, RenderResources& resources)
+        : m_resources(&resources),
           m_statsText(std::make_shared<Text>("LightingPass stats"))
     {
         PipelineCreateInfo ci;
@@ -63,7 +64,7 @@ public:
     void OnDirectionalLightAdded(ComponentAdded<DirectionalLight> e)
     {
         // updata only the data that concerncs shadows when a new light is added
-        const auto* shadowBuffers = m_ecs->GetSingleton<ShadowBuffers>();
+        const auto* shadowBuffers = m_resources->Get<ShadowBuffers>();
         ShaderData data           = {};
         data.shadowMapCount       = shadowBuffers->numIndices;
 
@@ -92,6 +93,18 @@ private:
         uint32_t BRDFLUTIndex;
 
         uint32_t aoTextureIndex;
+
+        uint32_t shadowAtlasIndex;
+        uint64_t localShadowBuffer;  // shadows of the point and spot lights, accessed with their shadow slot
+
+        // updated every frame
+        uint32_t useClusters;     // otherwise the tiled light lists are used
+        float clusterSliceScale;  // with reverse z the slice is -log(depth) * clusterSliceScale
+        uint32_t clusterTilesX;
+        uint32_t use16BitIndices;  // of the tiled lists
+        uint64_t clusterBuffer;
+        uint64_t lightIndexBuffer;  // both lists are reallocated when they are resized
+        uint64_t tileLightIndexBuffer;
     };
 
     struct PushConstants
@@ -103,6 +116,7 @@ private:
         uint64_t transformBufferPtr;
         uint64_t materialDataPtr;
         uint64_t objectIdMapPtr;
+        uint64_t vertexQuantizationPtr;
     };
     void RegisterPass(RenderGraph& rg)
     {
@@ -118,9 +132,12 @@ private:
         auto& drawObjBuffer       = lightingPass.AddDrawCommandBuffer("drawObjBuffer");
         auto& drawBuffer          = lightingPass.AddDrawCommandBuffer("drawBuffer");
         auto& visibleLightsBuffer = lightingPass.AddStorageBufferReadOnly("visibleLightsBuffer", VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, true);
-        auto* lightBuffers        = m_ecs->GetSingletonMut<LightBuffers>();
+        auto* lightBuffers        = m_resources->GetMut<LightBuffers>();
         visibleLightsBuffer.SetBufferPointer(&lightBuffers->visibleLightsBuffer);
+        auto& clusterBuffer = lightingPass.AddStorageBufferReadOnly("clusterBuffer", VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, true);
+        clusterBuffer.SetBufferPointer(&lightBuffers->clusterBuffer);
         lightingPass.AddTextureArrayInput("shadowMaps", VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT);
+        auto& shadowAtlas = lightingPass.AddTextureArrayInput("shadowAtlas", VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT);
         auto& aoTexture = lightingPass.AddTextureInput("finalAOImage");
 
         lightingPass.SetInitialiseCallback(
@@ -130,24 +147,28 @@ private:
                 data.viewportSize = glm::ivec2(VulkanContext::GetSwapchainExtent().width, VulkanContext::GetSwapchainExtent().height);
                 data.tileNums     = glm::ivec2(ceil(data.viewportSize.x / 16.0f), ceil(data.viewportSize.y / 16.0f));
 
-                const auto* pbrEnv          = m_ecs->GetSingleton<PBREnvironment>();
+                const auto* pbrEnv          = m_resources->Get<PBREnvironment>();
                 data.irradianceMapIndex     = pbrEnv->irradianceMap.GetSampledSlot();
                 data.prefilteredEnvMapIndex = pbrEnv->prefilteredEnvMap.GetSampledSlot();
                 data.BRDFLUTIndex           = pbrEnv->BRDFLUT.GetSampledSlot();
 
 
-                const auto* shadowBuffers = m_ecs->GetSingleton<ShadowBuffers>();
+                const auto* shadowBuffers = m_resources->Get<ShadowBuffers>();
                 data.shadowMapCount       = shadowBuffers->numIndices;
 
 
                 data.visibleLightsBuffer = visibleLightsBuffer.GetBufferPointer()->GetDeviceAddress();
                 data.aoTextureIndex      = aoTexture.GetImagePointer()->GetSampledSlot();
-                const auto* lightBuffers = m_ecs->GetSingleton<LightBuffers>();
+                data.shadowAtlasIndex    = shadowAtlas.GetImagePointers()[0]->GetSampledSlot();
+                data.clusterBuffer       = clusterBuffer.GetBufferPointer()->GetDeviceAddress();
+                const auto* lightBuffers = m_resources->Get<LightBuffers>();
+                const auto* localShadows = m_resources->Get<LocalShadowBuffers>();
                 for(int i = 0; i < NUM_FRAMES_IN_FLIGHT; ++i)
                 {
                     data.lightBuffer          = lightBuffers->buffers[i].GetDeviceAddress(0);
                     data.shadowMapIds         = shadowBuffers->indicesBuffers[i].GetDeviceAddress(0);
                     data.shadowMatricesBuffer = shadowBuffers->matricesBuffers[i].GetDeviceAddress(0);
+                    data.localShadowBuffer    = localShadows->dataBuffers[i].GetDeviceAddress(0);
                     m_pipeline->UploadShaderData(&data, i);
                 }
             });
@@ -158,23 +179,38 @@ private:
                 vkCmdBeginRendering(cb.GetCommandBuffer(), lightingPass.GetRenderingInfo());
 
 
+                const auto* mainCamera    = m_resources->Get<FrameCameraData>();
+                const auto* lightBuffers  = m_resources->Get<LightBuffers>();
+                ShaderData data           = {};
+                data.useClusters          = lightBuffers->clustered ? 1 : 0;
+                data.clusterSliceScale    = CLUSTER_SLICES / std::log(CLUSTER_FAR_PLANE / mainCamera->zNear);
+                data.clusterTilesX        = (VulkanContext::GetSwapchainExtent().width + CLUSTER_TILE_SIZE - 1) / CLUSTER_TILE_SIZE;
+                data.use16BitIndices      = lightBuffers->lightNum < 65536 ? 1 : 0;
+                data.lightIndexBuffer     = lightBuffers->lightIndexBuffer.GetDeviceAddress();
+                data.tileLightIndexBuffer = lightBuffers->tileLightIndexBuffer.GetDeviceAddress();
+                m_pipeline->UploadShaderData(&data, imageIndex, offsetof(ShaderData, useClusters), 4 * sizeof(uint32_t));
+                m_pipeline->UploadShaderData(&data, imageIndex, offsetof(ShaderData, lightIndexBuffer), 2 * sizeof(uint64_t));
+
                 PushConstants pc = {};
 
 
-                const auto* mainCamera = m_ecs->GetSingleton<MainCameraData>();
-                pc.viewProj            = mainCamera->viewProj;
-                pc.cameraPos           = mainCamera->pos;
-                pc.transformBufferPtr  = m_ecs->GetSingleton<TransformBuffers>()->buffers[imageIndex].GetDeviceAddress(0);
-                pc.shaderDataPtr       = m_pipeline->GetShaderDataBufferPtr(imageIndex);
-                pc.materialDataPtr     = m_pipeline->GetMaterialBufferPtr();
-                pc.objectIdMapPtr      = drawObjBuffer.GetBufferPointer()->GetDeviceAddress();
+                pc.viewProj              = mainCamera->viewProj;
+                pc.cameraPos             = mainCamera->pos;
+                pc.transformBufferPtr    = m_resources->Get<TransformBuffers>()->buffers[imageIndex].GetDeviceAddress(0);
+                pc.shaderDataPtr         = m_pipeline->GetShaderDataBufferPtr(imageIndex);
+                pc.materialDataPtr       = m_pipeline->GetMaterialBufferPtr();
+                pc.objectIdMapPtr        = 0;  // set per index batch
+                pc.vertexQuantizationPtr = m_resources->Get<VertexQuantizationBuffer>()->buffer.GetDeviceAddress(0);
 
 
                 vkCmdBeginQuery(cb.GetCommandBuffer(), m_queryPool, m_queryIndex, 0);
                 m_pipeline->Bind(cb);
-                m_pipeline->SetPushConstants(cb, &pc, sizeof(PushConstants));
-                uint32_t maxCount = static_cast<uint32_t>(drawBuffer.GetBufferPointer()->GetSize() / sizeof(VkDrawIndexedIndirectCommand));
-                vkCmdDrawIndexedIndirectCount(cb.GetCommandBuffer(), drawBuffer.GetBufferPointer()->GetVkBuffer(), 0, drawObjBuffer.GetBufferPointer()->GetVkBuffer(), 0, maxCount, sizeof(VkDrawIndexedIndirectCommand));
+                Application::GetInstance()->GetRenderer()->DrawIndexedIndirectBatches(cb, *drawBuffer.GetBufferPointer(), *drawObjBuffer.GetBufferPointer(),
+                                                                                      [&](uint64_t objectIDMapPtr)
+                                                                                      {
+                                                                                          pc.objectIdMapPtr = objectIDMapPtr;
+                                                                                          m_pipeline->SetPushConstants(cb, &pc, sizeof(PushConstants));
+                                                                                      });
 
                 vkCmdEndQuery(cb.GetCommandBuffer(), m_queryPool, m_queryIndex);
 
@@ -201,7 +237,7 @@ private:
     }
 
     std::unique_ptr<Pipeline> m_pipeline;
-    ECS* m_ecs;
+    RenderResources* m_resources;
     VkQueryPool m_queryPool;
     std::shared_ptr<Text> m_statsText;
     std::vector<uint64_t> m_queryResults;
@@ -0,0 +1,140 @@
+#pragma once
+
+#include "Application.hpp"
+#include "ECS/Core.hpp"
+#include "ECS/CoreComponents/RendererComponents.hpp"
+#include "Rendering/Pipeline.hpp"
+#include "Rendering/RenderGraph/RenderGraph.hpp"
+#include "Rendering/RenderResources.hpp"
+
+// renders the point and spot light shadows into the tiles of the shadow atlas picked by Renderer::UpdateShadowAtlas
+// only the tiles of LocalShadowBuffers::views are cleared and re-rendered, each one with its own draw list written by the ShadowCullPass
+class ShadowAtlasPass
+{
+public:
+    ShadowAtlasPass(RenderGraph& rg, RenderResources& resources)
+        : m_resources(&resources)
+    {
+        LOG_WARN("Creating shadow atlas pipeline");
+        PipelineCreateInfo atlasPipeline;
+        atlasPipeline.type               = PipelineType::GRAPHICS;
+        atlasPipeline.useColor           = false;
+        atlasPipeline.depthCompareOp     = VK_COMPARE_OP_GREATER;
+        atlasPipeline.depthWriteEnable   = true;
+        atlasPipeline.useDepth           = true;
+        atlasPipeline.msaaSamples        = VK_SAMPLE_COUNT_1_BIT;
+        atlasPipeline.stages             = VK_SHADER_STAGE_VERTEX_BIT;
+        atlasPipeline.useMultiSampling   = true;
+        atlasPipeline.useColorBlend      = false;
+        atlasPipeline.useDynamicViewport = true;  // one viewport per tile
+        atlasPipeline.isGlobal           = true;
+        m_pipeline                       = std::make_unique<Pipeline>("shadowatlas", atlasPipeline);
+
+        ImageCreateInfo ci;
+        ci.format      = VK_FORMAT_D32_SFLOAT;
+        ci.aspectFlags = VK_IMAGE_ASPECT_DEPTH_BIT;
+        ci.layout      = VK_IMAGE_LAYOUT_ATTACHMENT_OPTIMAL;
+        ci.useMips     = false;
+        ci.usage       = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        ci.debugName   = "shadowAtlas";
+        m_atlas        = std::make_unique<Image>(SHADOW_ATLAS_SIZE, SHADOW_ATLAS_SIZE, ci);
+
+        SamplerConfig shadowSampler{};
+        shadowSampler.filter         = VK_FILTER_LINEAR;
+        shadowSampler.addressMode    = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;  // the lighting clamps to the tiles anyway
+        shadowSampler.depthCompareOp = VK_COMPARE_OP_GREATER;
+        shadowSampler.anisotropy     = 0;
+        Application::GetInstance()->GetRenderer()->AddTexture(m_atlas.get(), shadowSampler);
+
+        RegisterPass(rg);
+
+        auto* localShadows = m_resources->GetMut<LocalShadowBuffers>();
+        Application::GetInstance()->GetRenderer()->AddDebugUIElement(std::make_shared<DragFloat>(&localShadows->updateBudget, "Shadow atlas tiles per frame", 0.0f, static_cast<float>(MAX_SHADOW_ATLAS_UPDATES)));
+    }
+
+private:
+    struct PushConstants
+    {
+        int32_t viewIndex;
+        uint64_t atlasViewsPtr;
+        uint64_t transformBufferPtr;
+        uint64_t objectIDMapPtr;
+        uint64_t vertexQuantizationPtr;
+    };
+
+    void RegisterPass(RenderGraph& rg)
+    {
+        auto& shadowAtlasPass = rg.AddRenderPass("shadowAtlasPass", QueueTypeFlagBits::Graphics);
+        auto& drawObjBuffer   = shadowAtlasPass.AddDrawCommandBuffer("shadowDrawObjBuffer");
+        auto& drawBuffer      = shadowAtlasPass.AddDrawCommandBuffer("shadowDrawBuffer");
+
+        // the tiles that aren't rendered this frame keep their content, the atlas is never transitioned from the undefined layout
+        auto& atlasResource = shadowAtlasPass.AddTextureArrayOutput("shadowAtlas", VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT);
+        atlasResource.SetFormat(VK_FORMAT_D32_SFLOAT);
+        atlasResource.AddImagePointer(m_atlas.get());
+
+        shadowAtlasPass.SetExecutionCallback(
+            [&](CommandBuffer& cb, uint32_t imageIndex)
+            {
+                const auto* localShadows = m_resources->Get<LocalShadowBuffers>();
+                if(localShadows->views.empty())
+                    return;
+
+                PushConstants pc         = {};
+                pc.atlasViewsPtr         = localShadows->viewBuffers[imageIndex].GetDeviceAddress(0);
+                pc.transformBufferPtr    = m_resources->Get<TransformBuffers>()->buffers[imageIndex].GetDeviceAddress(0);
+                pc.objectIDMapPtr        = 0;  // set per index batch
+                pc.vertexQuantizationPtr = m_resources->Get<VertexQuantizationBuffer>()->buffer.GetDeviceAddress(0);
+
+                const Buffer& drawCmds = *drawBuffer.GetBufferPointer();
+                const Buffer& drawObjs = *drawObjBuffer.GetBufferPointer();
+
+                for(uint32_t view = 0; view < localShadows->views.size(); ++view)
+                {
+                    const glm::uvec3 tile = localShadows->views[view];
+
+                    // the render area limits the clear to the tile
+                    VkRenderingInfo rendering   = {};
+                    rendering.sType             = VK_STRUCTURE_TYPE_RENDERING_INFO;
+                    rendering.renderArea.offset = {static_cast<int32_t>(tile.x), static_cast<int32_t>(tile.y)};
+                    rendering.renderArea.extent = {tile.z, tile.z};
+                    rendering.layerCount        = 1;
+
+                    VkRenderingAttachmentInfo depthAttachment     = {};
+                    depthAttachment.sType                         = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+                    depthAttachment.imageView                     = m_atlas->GetImageView();
+                    depthAttachment.clearValue.depthStencil.depth = 0.0f;
+                    depthAttachment.loadOp                        = VK_ATTACHMENT_LOAD_OP_CLEAR;
+                    depthAttachment.storeOp                       = VK_ATTACHMENT_STORE_OP_STORE;
+                    depthAttachment.imageLayout                   = VK_IMAGE_LAYOUT_ATTACHMENT_OPTIMAL;
+                    rendering.pDepthAttachment                    = &depthAttachment;
+
+                    vkCmdBeginRendering(cb.GetCommandBuffer(), &rendering);
+
+                    m_pipeline->Bind(cb);
+
+                    VkViewport viewport  = VulkanContext::GetViewport(tile.z, tile.z);
+                    viewport.x          += static_cast<float>(tile.x);
+                    viewport.y          += static_cast<float>(tile.y);
+                    vkCmdSetViewport(cb.GetCommandBuffer(), 0, 1, &viewport);
+                    vkCmdSetScissor(cb.GetCommandBuffer(), 0, 1, &rendering.renderArea);
+
+                    pc.viewIndex = static_cast<int32_t>(view);
+                    Application::GetInstance()->GetRenderer()->DrawIndexedIndirectBatches(
+                        cb, drawCmds, drawObjs,
+                        [&](uint64_t objectIDMapPtr)
+                        {
+                            pc.objectIDMapPtr = objectIDMapPtr;
+                            m_pipeline->SetPushConstants(cb, &pc, sizeof(PushConstants));
+                        },
+                        2 * MAX_SHADOW_DRAW_LISTS + view);  // see ShadowCullPass
+
+                    vkCmdEndRendering(cb.GetCommandBuffer());
+                }
+            });
+    }
+
+    std::unique_ptr<Pipeline> m_pipeline;
+    std::unique_ptr<Image> m_atlas;
+    RenderResources* m_resources;
+};
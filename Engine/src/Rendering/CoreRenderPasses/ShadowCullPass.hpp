@@ -0,0 +1,113 @@
+#pragma once
+
+#include "Application.hpp"
+#include "ECS/Core.hpp"
+#include "ECS/CoreComponents/RendererComponents.hpp"
+#include "Rendering/Pipeline.hpp"
+#include "Rendering/RenderGraph/RenderGraph.hpp"
+#include "Rendering/RenderResources.hpp"
+
+// culls the shadow casters against the ortho box of every cascade independently of the camera culling
+// casters outside of the camera frustum still throw shadows into it and every cascade only draws what falls inside of it
+// the static casters get their own lists after the MAX_SHADOW_DRAW_LISTS dynamic ones, only filled for the cascades of StaticShadowCache::dirtyLists
+// the shadow atlas tiles rendered this frame (LocalShadowBuffers::views) come after those, one list each
+class ShadowCullPass
+{
+public:
+    ShadowCullPass(RenderGraph& rg, RenderResources& resources)
+        : m_resources(&resources)
+    {
+        PipelineCreateInfo cullPipeline;
+        cullPipeline.type   = PipelineType::COMPUTE;
+        cullPipeline.stages = VK_SHADER_STAGE_COMPUTE_BIT;
+        m_pipeline          = std::make_unique<Pipeline>("shadowcull", cullPipeline, 0);
+
+        RegisterPass(rg);
+    }
+
+private:
+    struct PushConstants
+    {
+        uint32_t inDrawCmdCount;
+        uint32_t inDrawCmdCount16;  // the first inDrawCmdCount16 draws use 16 bit indices
+        uint64_t inDrawCmdPtr;
+        uint64_t outDrawCmdPtr;
+
+        uint64_t drawObjPtr;
+
+        uint64_t boundingBoxes;
+        uint64_t transformBufferPtr;
+        uint64_t shadowMatricesBuffer;
+        uint64_t drawLodsPtr;
+
+        uint32_t resetCounts;
+        uint32_t listCount;
+        uint32_t staticLists;  // one bit per list whose static casters are drawn
+        uint32_t atlasViewCount;
+        uint64_t atlasViewsPtr;
+    };
+
+    void RegisterPass(RenderGraph& rg)
+    {
+        auto& shadowCullPass      = rg.AddRenderPass("shadowCullPass", QueueTypeFlagBits::Compute);
+        auto& shadowDrawBuffer    = shadowCullPass.AddStorageBufferOutput("shadowDrawBuffer");
+        auto& shadowDrawObjBuffer = shadowCullPass.AddStorageBufferOutput("shadowDrawObjBuffer");
+
+        shadowCullPass.SetExecutionCallback(
+            [&](CommandBuffer& cb, uint32_t imageIndex)
+            {
+                // one list per cascade of every shadowed directional light, the shadow pass uses the same order
+                const uint32_t lightCount     = m_resources->Get<ShadowBuffers>()->numIndices;  // at most MAX_SHADOWED_DIRECTIONAL_LIGHTS
+                const uint32_t listCount      = lightCount * NUM_CASCADES;
+                const auto* localShadows      = m_resources->Get<LocalShadowBuffers>();
+                const uint32_t atlasViewCount = static_cast<uint32_t>(localShadows->views.size());
+                if(listCount == 0 && atlasViewCount == 0)
+                    return;
+
+                const auto* drawCmds    = m_resources->Get<DrawCommandBuffer>();
+                const auto* staticCache = m_resources->Get<StaticShadowCache>();
+                PushConstants pc{
+                    .inDrawCmdCount       = drawCmds->count,
+                    .inDrawCmdCount16     = drawCmds->count16,
+                    .inDrawCmdPtr         = drawCmds->buffer.GetDeviceAddress(0),
+                    .outDrawCmdPtr        = shadowDrawBuffer.GetBufferPointer()->GetDeviceAddress(),
+                    .drawObjPtr           = shadowDrawObjBuffer.GetBufferPointer()->GetDeviceAddress(),
+                    .boundingBoxes        = m_resources->Get<BoundingBoxBuffer>()->buffer.GetDeviceAddress(0),
+                    .transformBufferPtr   = m_resources->Get<TransformBuffers>()->buffers[imageIndex].GetDeviceAddress(0),
+                    .shadowMatricesBuffer = m_resources->Get<ShadowBuffers>()->matricesBuffers[imageIndex].GetDeviceAddress(0),
+                    .drawLodsPtr          = m_resources->Get<DrawLodBuffer>()->buffer.GetDeviceAddress(0),
+                    .resetCounts          = 1,
+                    .listCount            = listCount,
+                    .staticLists          = staticCache->enabled ? staticCache->dirtyLists : ~0u,
+                    .atlasViewCount       = atlasViewCount,
+                    .atlasViewsPtr        = localShadows->viewBuffers[imageIndex].GetDeviceAddress(0),
+                };
+
+                m_pipeline->Bind(cb);
+                m_pipeline->SetPushConstants(cb, &pc, sizeof(PushConstants));
+                vkCmdDispatch(cb.GetCommandBuffer(), (glm::max(listCount, atlasViewCount) + 63) / 64, 1, 1);
+
+                // the counts have to be cleared before any list gets appended to
+                VkMemoryBarrier2 barrier = {VK_STRUCTURE_TYPE_MEMORY_BARRIER_2};
+                barrier.srcStageMask     = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+                barrier.srcAccessMask    = VK_ACCESS_2_SHADER_WRITE_BIT;
+                barrier.dstStageMask     = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+                barrier.dstAccessMask    = VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT;
+
+                VkDependencyInfo dependency   = {VK_STRUCTURE_TYPE_DEPENDENCY_INFO};
+                dependency.memoryBarrierCount = 1;
+                dependency.pMemoryBarriers    = &barrier;
+                vkCmdPipelineBarrier2(cb.GetCommandBuffer(), &dependency);
+
+                if(drawCmds->count == 0)
+                    return;
+
+                pc.resetCounts = 0;
+                m_pipeline->SetPushConstants(cb, &pc, sizeof(PushConstants));
+                vkCmdDispatch(cb.GetCommandBuffer(), (drawCmds->count + 63) / 64, listCount + atlasViewCount, 1);
+            });
+    }
+
+    std::unique_ptr<Pipeline> m_pipeline;
+    RenderResources* m_resources;
+};
@@ -2,6 +2,7 @@
 
 #include "Application.hpp"
 #include "Rendering/RenderGraph/RenderGraph.hpp"
+#include "Rendering/RenderResources.hpp"
 #include "Rendering/Pipeline.hpp"
 #include "ECS/Core.hpp"
 #include "ECS/CoreComponents/RendererComponents.hpp"
@@ -9,8 +10,8 @@
 class ShadowPass
 {
 public:
-    ShadowPass(RenderGraph& rg)
-        : m_ecs(Application::GetInstance()->GetScene()->GetECS())
+    ShadowPass(RenderGraph& rg, RenderResources& resources)
+        : m_resources(&resources)
     {
         // Shadow prepass pipeline
         LOG_WARN("Creating shadow pipeline");
@@ -21,18 +22,32 @@ public:
         shadowPipeline.depthCompareOp   = VK_COMPARE_OP_GREATER;
         shadowPipeline.depthWriteEnable = true;
         shadowPipeline.useDepth         = true;
-        shadowPipeline.depthClampEnable = false;
+        shadowPipeline.depthClampEnable = true;  // casters between the light and the cascade are flattened onto the near plane (see shadowcull.comp)
         shadowPipeline.msaaSamples      = VK_SAMPLE_COUNT_1_BIT;
         shadowPipeline.stages           = VK_SHADER_STAGE_VERTEX_BIT;
         shadowPipeline.useMultiSampling = true;
         shadowPipeline.useColorBlend    = false;
         shadowPipeline.viewportExtent   = {SHADOWMAP_SIZE, SHADOWMAP_SIZE};
-        shadowPipeline.viewMask         = (1 << NUM_CASCADES) - 1;  // NUM_CASCADES of 1s
         shadowPipeline.isGlobal         = true;
 
-        m_pipeline = std::make_unique<Pipeline>("shadow", shadowPipeline);
+        // every cascade has its own culled draw list so they are rendered one by one, each pipeline only renders to the view of its cascade
+        for(uint32_t cascade = 0; cascade < NUM_CASCADES; ++cascade)
+        {
+            shadowPipeline.viewMask = 1 << cascade;
+            m_pipelines[cascade]    = std::make_unique<Pipeline>("shadow", shadowPipeline);
+        }
 
         RegisterPass(rg);
+
+        auto cacheButton = std::make_shared<Button>("Disable Static Shadow Cache");
+        cacheButton->RegisterCallback(
+            [this](Button* button)
+            {
+                auto* staticCache    = m_resources->GetMut<StaticShadowCache>();
+                staticCache->enabled = !staticCache->enabled;
+                button->SetName(staticCache->enabled ? "Disable Static Shadow Cache" : "Enable Static Shadow Cache");
+            });
+        Application::GetInstance()->GetRenderer()->AddDebugUIElement(cacheButton);
     }
 
 
@@ -43,13 +58,88 @@ private:
         uint64_t shadowMatricesBuffer;
         uint64_t transformBufferPtr;
         uint64_t objectIDMapPtr;
+        uint64_t vertexQuantizationPtr;
     };
+    // renders one draw list into the layer of a cascade
+    void DrawCascade(CommandBuffer& cb, PushConstants& pc, const Image& img, VkImageLayout layout, VkAttachmentLoadOp loadOp, uint32_t cascade, const Buffer& drawBuffer, const Buffer& drawObjBuffer, uint32_t list)
+    {
+        // set up the renderingInfo struct
+        VkRenderingInfo rendering          = {};
+        rendering.sType                    = VK_STRUCTURE_TYPE_RENDERING_INFO;
+        rendering.renderArea.extent.width  = img.GetWidth();
+        rendering.renderArea.extent.height = img.GetHeight();
+        rendering.viewMask                 = m_pipelines[cascade]->GetViewMask();  // only clears and renders the layer of this cascade
+
+        VkRenderingAttachmentInfo depthAttachment     = {};
+        depthAttachment.sType                         = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+        depthAttachment.imageView                     = img.GetImageView();
+        depthAttachment.clearValue.depthStencil.depth = 0.0f;
+        depthAttachment.loadOp                        = loadOp;
+        depthAttachment.storeOp                       = VK_ATTACHMENT_STORE_OP_STORE;
+        depthAttachment.imageLayout                   = layout;
+        rendering.pDepthAttachment                    = &depthAttachment;
+
+        vkCmdBeginRendering(cb.GetCommandBuffer(), &rendering);
+
+        m_pipelines[cascade]->Bind(cb);
+
+        Application::GetInstance()->GetRenderer()->DrawIndexedIndirectBatches(
+            cb, drawBuffer, drawObjBuffer,
+            [&](uint64_t objectIDMapPtr)
+            {
+                pc.objectIDMapPtr = objectIDMapPtr;
+                m_pipelines[cascade]->SetPushConstants(cb, &pc, sizeof(PushConstants));
+            },
+            list);
+
+        vkCmdEndRendering(cb.GetCommandBuffer());
+    }
+
+    static void Barrier(CommandBuffer& cb, VkPipelineStageFlags2 srcStages, VkAccessFlags2 srcAccess, VkPipelineStageFlags2 dstStages, VkAccessFlags2 dstAccess)
+    {
+        VkMemoryBarrier2 barrier = {VK_STRUCTURE_TYPE_MEMORY_BARRIER_2};
+        barrier.srcStageMask     = srcStages;
+        barrier.srcAccessMask    = srcAccess;
+        barrier.dstStageMask     = dstStages;
+        barrier.dstAccessMask    = dstAccess;
+
+        VkDependencyInfo dependency   = {VK_STRUCTURE_TYPE_DEPENDENCY_INFO};
+        dependency.memoryBarrierCount = 1;
+        dependency.pMemoryBarriers    = &barrier;
+        vkCmdPipelineBarrier2(cb.GetCommandBuffer(), &dependency);
+    }
+
+    // the render graph expects the shadow maps in the attachment layout, the copy from the cache needs the layer of a cascade as a transfer destination
+    static void TransitionShadowMap(CommandBuffer& cb, const Image& img, uint32_t cascade, VkImageLayout oldLayout, VkImageLayout newLayout)
+    {
+        const bool toTransfer = newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+
+        VkImageMemoryBarrier2 barrier           = {VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2};
+        barrier.srcStageMask                    = toTransfer ? VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT : VK_PIPELINE_STAGE_2_COPY_BIT;
+        barrier.srcAccessMask                   = toTransfer ? 0 : VK_ACCESS_2_TRANSFER_WRITE_BIT;
+        barrier.dstStageMask                    = toTransfer ? VK_PIPELINE_STAGE_2_COPY_BIT : VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT;
+        barrier.dstAccessMask                   = toTransfer ? VK_ACCESS_2_TRANSFER_WRITE_BIT : VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        barrier.oldLayout                       = toTransfer ? VK_IMAGE_LAYOUT_UNDEFINED : oldLayout;  // the whole layer gets overwritten by the copy
+        barrier.newLayout                       = newLayout;
+        barrier.image                           = img.GetImage();
+        barrier.subresourceRange.aspectMask     = VK_IMAGE_ASPECT_DEPTH_BIT;
+        barrier.subresourceRange.baseMipLevel   = 0;
+        barrier.subresourceRange.levelCount     = 1;
+        barrier.subresourceRange.baseArrayLayer = cascade;
+        barrier.subresourceRange.layerCount     = 1;
+
+        VkDependencyInfo dependency        = {VK_STRUCTURE_TYPE_DEPENDENCY_INFO};
+        dependency.imageMemoryBarrierCount = 1;
+        dependency.pImageMemoryBarriers    = &barrier;
+        vkCmdPipelineBarrier2(cb.GetCommandBuffer(), &dependency);
+    }
+
     void RegisterPass(RenderGraph& rg)
     {
         auto& shadowPass    = rg.AddRenderPass("shadowPass", QueueTypeFlagBits::Graphics);
         // auto& shadowMatricesBuffer = shadowPass.AddStorageBufferReadOnly("shadowMatrices", VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT, true);
-        auto& drawObjBuffer = shadowPass.AddDrawCommandBuffer("drawObjBuffer");
-        auto& drawBuffer    = shadowPass.AddDrawCommandBuffer("drawBuffer");
+        auto& drawObjBuffer = shadowPass.AddDrawCommandBuffer("shadowDrawObjBuffer");
+        auto& drawBuffer    = shadowPass.AddDrawCommandBuffer("shadowDrawBuffer");
 
         auto& shadowMapRessource = shadowPass.AddTextureArrayOutput("shadowMaps", VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT);
 
@@ -57,49 +147,86 @@ private:
         shadowPass.SetExecutionCallback(
             [&](CommandBuffer& cb, uint32_t imageIndex)
             {
-                PushConstants pc        = {};
-                pc.transformBufferPtr   = m_ecs->GetSingleton<TransformBuffers>()->buffers[imageIndex].GetDeviceAddress(0);
-                pc.shadowMatricesBuffer = m_ecs->GetSingleton<ShadowBuffers>()->matricesBuffers[imageIndex].GetDeviceAddress(0);
-                pc.objectIDMapPtr       = drawObjBuffer.GetBufferPointer()->GetDeviceAddress();
-                for(uint32_t i = 0; i < shadowMapRessource.GetImagePointers().size(); ++i)
+                PushConstants pc         = {};
+                pc.transformBufferPtr    = m_resources->Get<TransformBuffers>()->buffers[imageIndex].GetDeviceAddress(0);
+                pc.shadowMatricesBuffer  = m_resources->Get<ShadowBuffers>()->matricesBuffers[imageIndex].GetDeviceAddress(0);
+                pc.objectIDMapPtr        = 0;  // set per index batch
+                pc.vertexQuantizationPtr = m_resources->Get<VertexQuantizationBuffer>()->buffer.GetDeviceAddress(0);
+                // the draw lists written by the ShadowCullPass, one per cascade of every light with a shadow map (see MAX_SHADOWED_DIRECTIONAL_LIGHTS)
+                const uint32_t lightCount = static_cast<uint32_t>(shadowMapRessource.GetImagePointers().size());
+                assert(lightCount <= MAX_SHADOWED_DIRECTIONAL_LIGHTS);
+                const auto* staticCache   = m_resources->Get<StaticShadowCache>();
+                const uint32_t dirtyLists = staticCache->enabled ? staticCache->dirtyLists : ~0u;
+                // the layers that don't need a copy still have the static casters of the last one and nothing on top
+                const uint32_t copyLists = dirtyLists | staticCache->dynamicLists | staticCache->restoreLists;
+
+                const Buffer& drawCmds = *drawBuffer.GetBufferPointer();
+                const Buffer& drawObjs = *drawObjBuffer.GetBufferPointer();
+
+                // the previous copies out of the caches have to be done before they are rendered to again
+                if(dirtyLists != 0)
+                    Barrier(cb, VK_PIPELINE_STAGE_2_COPY_BIT, 0, VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT, 0);
+
+                for(uint32_t i = 0; i < lightCount; ++i)
                 {
-                    const auto* img = shadowMapRessource.GetImagePointers()[i];
-
-                    // set up the renderingInfo struct
-                    VkRenderingInfo rendering          = {};
-                    rendering.sType                    = VK_STRUCTURE_TYPE_RENDERING_INFO;
-                    rendering.renderArea.extent.width  = img->GetWidth();
-                    rendering.renderArea.extent.height = img->GetHeight();
-                    // rendering.layerCount               = 1;
-                    rendering.viewMask                 = m_pipeline->GetViewMask();
-
-                    VkRenderingAttachmentInfo depthAttachment     = {};
-                    depthAttachment.sType                         = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
-                    depthAttachment.imageView                     = img->GetImageView();
-                    depthAttachment.clearValue.depthStencil.depth = 0.0f;
-                    depthAttachment.loadOp                        = VK_ATTACHMENT_LOAD_OP_CLEAR;
-                    depthAttachment.storeOp                       = VK_ATTACHMENT_STORE_OP_STORE;
-                    depthAttachment.imageLayout                   = VK_IMAGE_LAYOUT_ATTACHMENT_OPTIMAL;
-                    rendering.pDepthAttachment                    = &depthAttachment;
-
-                    vkCmdBeginRendering(cb.GetCommandBuffer(), &rendering);
+                    pc.lightIndex = static_cast<int32_t>(i);
 
-                    // render the corresponding light
+                    // re-render the static casters of the cascades that moved
+                    const Image* cache = staticCache->images[i].get();
+                    for(uint32_t cascade = 0; cascade < NUM_CASCADES; ++cascade)
+                    {
+                        const uint32_t list = i * NUM_CASCADES + cascade;
+                        if(dirtyLists & (1u << list))
+                            DrawCascade(cb, pc, *cache, VK_IMAGE_LAYOUT_GENERAL, VK_ATTACHMENT_LOAD_OP_CLEAR, cascade, drawCmds, drawObjs, MAX_SHADOW_DRAW_LISTS + list);
+                    }
+                }
 
-                    m_pipeline->Bind(cb);
+                if(copyLists != 0)
+                    Barrier(cb, VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_READ_BIT);
 
+                for(uint32_t i = 0; i < lightCount; ++i)
+                {
                     pc.lightIndex = static_cast<int32_t>(i);
 
-                    m_pipeline->SetPushConstants(cb, &pc, sizeof(PushConstants));
-
-                    uint32_t maxCount = static_cast<uint32_t>(drawBuffer.GetBufferPointer()->GetSize() / sizeof(VkDrawIndexedIndirectCommand));
-                    vkCmdDrawIndexedIndirectCount(cb.GetCommandBuffer(), drawBuffer.GetBufferPointer()->GetVkBuffer(), 0, drawObjBuffer.GetBufferPointer()->GetVkBuffer(), 0, maxCount, sizeof(VkDrawIndexedIndirectCommand));
-                    vkCmdEndRendering(cb.GetCommandBuffer());
+                    const Image* img   = shadowMapRessource.GetImagePointers()[i];
+                    const Image* cache = staticCache->images[i].get();
+
+                    // start from the static casters and draw the dynamic ones on top
+                    std::array<VkImageCopy, NUM_CASCADES> regions{};
+                    uint32_t regionCount = 0;
+                    for(uint32_t cascade = 0; cascade < NUM_CASCADES; ++cascade)
+                    {
+                        if((copyLists & (1u << (i * NUM_CASCADES + cascade))) == 0)
+                            continue;
+
+                        TransitionShadowMap(cb, *img, cascade, VK_IMAGE_LAYOUT_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+                        VkImageCopy& region                  = regions[regionCount++];
+                        region.srcSubresource.aspectMask     = VK_IMAGE_ASPECT_DEPTH_BIT;
+                        region.srcSubresource.baseArrayLayer = cascade;
+                        region.srcSubresource.layerCount     = 1;
+                        region.dstSubresource                = region.srcSubresource;
+                        region.extent                        = {img->GetWidth(), img->GetHeight(), 1};
+                    }
+                    if(regionCount == 0)
+                        continue;  // nothing moved, nothing dynamic in any cascade
+
+                    vkCmdCopyImage(cb.GetCommandBuffer(), cache->GetImage(), VK_IMAGE_LAYOUT_GENERAL, img->GetImage(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, regionCount, regions.data());
+
+                    for(uint32_t r = 0; r < regionCount; ++r)
+                        TransitionShadowMap(cb, *img, regions[r].dstSubresource.baseArrayLayer, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_ATTACHMENT_OPTIMAL);
+
+                    for(uint32_t cascade = 0; cascade < NUM_CASCADES; ++cascade)
+                    {
+                        const uint32_t list = i * NUM_CASCADES + cascade;
+                        if(staticCache->dynamicLists & (1u << list))
+                            DrawCascade(cb, pc, *img, VK_IMAGE_LAYOUT_ATTACHMENT_OPTIMAL, VK_ATTACHMENT_LOAD_OP_LOAD, cascade, drawCmds, drawObjs, list);
+                    }
                 }
             });
     }
 
 
-    std::unique_ptr<Pipeline> m_pipeline;
-    ECS* m_ecs;
+    std::array<std::unique_ptr<Pipeline>, NUM_CASCADES> m_pipelines;
+    RenderResources* m_resources;
 };
@@ -3,18 +3,20 @@
 #include "ECS/CoreComponents/SkyboxComponent.hpp"
 #include "Rendering/Pipeline.hpp"
 #include "Rendering/RenderGraph/RenderGraph.hpp"
+#include "Rendering/RenderResources.hpp"
 #include "Rendering/VulkanContext.hpp"
 #include "Application.hpp"
 #include "ECS/CoreComponents/Camera.hpp"
+#include "ECS/CoreComponents/RendererComponents.hpp"
 
 #include <glm/glm.hpp>
 
 class SkyboxPass
 {
 public:
-    SkyboxPass(RenderGraph& rg)
-        : m_ecs(Application::GetInstance()->GetScene()->GetECS()),
-          m_envMap(&m_ecs->GetSingleton<SkyboxComponent>()->skybox)
+    SkyboxPass(RenderGraph& rg, RenderResources& resources)
+        : m_resources(&resources),
+          m_envMap(&m_resources->Get<SkyboxComponent>()->skybox)
     {
         // Skybox pipeline
         LOG_WARN("Creating skybox pipeline");
@@ -56,7 +58,7 @@ private:
 
                 m_skyboxPipeline->Bind(cb);
 
-                PushConstants pc{m_ecs->GetSingleton<MainCameraData>()->viewProj, m_envMap->GetSampledSlot()};
+                PushConstants pc{m_resources->Get<FrameCameraData>()->viewProj, m_envMap->GetSampledSlot()};
                 m_skyboxPipeline->SetPushConstants(cb, &pc, sizeof(PushConstants));
 
                 vkCmdDraw(cb.GetCommandBuffer(), 6, 1, 0, 0);
@@ -65,6 +67,6 @@ private:
     }
     std::unique_ptr<Pipeline> m_skyboxPipeline;
 
-    ECS* m_ecs;
+    RenderResources* m_resources;
     const Image* m_envMap;
 };
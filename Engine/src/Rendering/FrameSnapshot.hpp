@@ -0,0 +1,58 @@
+#pragma once
+
+#include "ECS/CoreComponents/Camera.hpp"
+#include "ECS/CoreComponents/Lights.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <glm/glm.hpp>
+
+struct DebugUIFrame;
+
+// What the render thread needs from the simulation to render one frame, copied out of the ECS by Renderer::ExtractFrame at the end of the main thread's frame
+// Rendering only reads this and the renderer's own state so the next simulation frame can run while it is recorded
+struct FrameSnapshot
+{
+    // a renderable whose world transform changed
+    struct TransformUpdate
+    {
+        glm::mat4 worldTransform;
+        glm::vec3 boundsMin;  // world space box, only set with hasBounds
+        glm::vec3 boundsMax;
+        uint32_t objectID;
+        bool hasBounds;  // the renderable has a BoundingBox and a proxy in the scene tree
+    };
+
+    // a renderable whose mesh was added or removed, applied to the FrustumCuller before the transforms
+    struct BoundsUpdate
+    {
+        glm::vec3 boundsMin;  // world space box, not set when removed
+        glm::vec3 boundsMax;
+        uint32_t objectID;
+        bool removed;
+        bool isStatic = false;  // it had the Static tag when its mesh was added, the static shadow casters don't go in the dynamic caster culler
+    };
+
+    // a light that was set or moved, the fields that don't apply to its type aren't set
+    struct LightUpdate
+    {
+        uint32_t slot;
+        LightType type;
+        glm::vec3 color;
+        float intensity;
+        glm::vec3 direction;    // directional and spot
+        float cutoff;           // spot
+        glm::vec3 position;     // point and spot
+        float range;            // same
+        glm::vec3 attenuation;  // quadratic, linear, constant like in the light buffer
+    };
+
+    double dt = 0.0;
+    MainCameraData camera{};
+    std::vector<TransformUpdate> transforms;
+    std::vector<BoundsUpdate> bounds;
+    std::vector<LightUpdate> lights;
+    uint32_t staticShadowDirtyLists = 0;    // shadow draw lists whose static casters changed during the frame, see StaticShadowCache::dirtyLists
+    std::shared_ptr<DebugUIFrame> debugUI;  // nullptr when the frame doesn't draw the debug UI
+};
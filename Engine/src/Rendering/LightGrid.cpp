@@ -0,0 +1,205 @@
+#include "Rendering/LightGrid.hpp"
+
+#include <algorithm>
+
+LightGrid::LightGrid(float cellSize)
+    : m_cellSize(cellSize)
+{
+    assert(cellSize > 0.0f);
+}
+
+uint32_t LightGrid::GetLevel(float radius) const
+{
+    // lights too big for the last level still go into it, its margin grows to fit them
+    uint32_t level = 0;
+    while(level + 1 < LEVEL_COUNT && GetCellSize(level) < 2.0f * radius)
+        ++level;
+    return level;
+}
+
+glm::ivec3 LightGrid::GetCellCoords(const glm::vec3& position, uint32_t level) const
+{
+    return glm::ivec3(glm::floor(position / GetCellSize(level)));
+}
+
+uint64_t LightGrid::GetCellKey(const glm::ivec3& coords, uint32_t level)
+{
+    // 20 bits per axis, the cells wrap around after a million of them
+    constexpr uint64_t mask = (1ull << 20) - 1;
+    return (static_cast<uint64_t>(level) << 60) | ((static_cast<uint64_t>(coords.x) & mask) << 40) | ((static_cast<uint64_t>(coords.y) & mask) << 20) | (static_cast<uint64_t>(coords.z) & mask);
+}
+
+void LightGrid::Update(uint32_t light, const glm::vec3& center, float radius)
+{
+    if(light >= m_lights.size())
+        m_lights.resize(light + 1);
+
+    const uint32_t level    = GetLevel(radius);
+    const glm::ivec3 coords = GetCellCoords(center, level);
+    const uint64_t key      = GetCellKey(coords, level);
+    m_levelMargins[level]   = glm::max(m_levelMargins[level], radius);
+
+    Light& entry = m_lights[light];
+    entry.center = center;
+    entry.radius = radius;
+    if(entry.inserted && entry.cell == key)
+        return;
+
+    if(entry.inserted)
+    {
+        RemoveFromCell(light);
+    }
+    else
+    {
+        entry.inserted = true;
+        ++m_lightCount;
+    }
+
+    auto [it, created] = m_cells.try_emplace(key);
+    Cell& cell         = it->second;
+    if(created)
+    {
+        cell.coords = coords;
+        cell.level  = level;
+        ++m_levelCells[level];
+    }
+    entry.cell        = key;
+    entry.indexInCell = static_cast<uint32_t>(cell.lights.size());
+    cell.lights.push_back(light);
+}
+
+void LightGrid::Remove(uint32_t light)
+{
+    if(light >= m_lights.size() || !m_lights[light].inserted)
+        return;
+
+    RemoveFromCell(light);
+    m_lights[light].inserted = false;
+    --m_lightCount;
+}
+
+void LightGrid::RemoveFromCell(uint32_t light)
+{
+    const Light& entry = m_lights[light];
+    auto it            = m_cells.find(entry.cell);
+    assert(it != m_cells.end());
+
+    // swap with the last light of the cell
+    Cell& cell                     = it->second;
+    const uint32_t last            = cell.lights.back();
+    cell.lights[entry.indexInCell] = last;
+    m_lights[last].indexInCell     = entry.indexInCell;
+    cell.lights.pop_back();
+
+    if(cell.lights.empty())
+    {
+        --m_levelCells[cell.level];
+        m_cells.erase(it);
+    }
+}
+
+template<typename Fn>
+void LightGrid::ForEachCellInBox(const glm::vec3& min, const glm::vec3& max, Fn fn) const
+{
+    for(uint32_t level = 0; level < LEVEL_COUNT; ++level)
+    {
+        if(m_levelCells[level] == 0)
+            continue;
+
+        // the lights of a cell can stick out of it by the margin of the level
+        const glm::ivec3 first = GetCellCoords(min - m_levelMargins[level], level);
+        const glm::ivec3 last  = GetCellCoords(max + m_levelMargins[level], level);
+        const glm::ivec3 range = last - first + 1;
+
+        // big boxes look at the cells that exist instead of every cell they cover
+        if(static_cast<uint64_t>(range.x) * static_cast<uint64_t>(range.y) * static_cast<uint64_t>(range.z) > m_levelCells[level])
+        {
+            for(const auto& [_, cell] : m_cells)
+            {
+                if(cell.level == level && glm::all(glm::greaterThanEqual(cell.coords, first)) && glm::all(glm::lessThanEqual(cell.coords, last)))
+                    fn(cell);
+            }
+            continue;
+        }
+
+        for(int32_t x = first.x; x <= last.x; ++x)
+        {
+            for(int32_t y = first.y; y <= last.y; ++y)
+            {
+                for(int32_t z = first.z; z <= last.z; ++z)
+                {
+                    auto it = m_cells.find(GetCellKey({x, y, z}, level));
+                    if(it != m_cells.end())
+                        fn(it->second);
+                }
+            }
+        }
+    }
+}
+
+void LightGrid::QueryBox(const glm::vec3& min, const glm::vec3& max, std::vector<uint32_t>& lights) const
+{
+    ForEachCellInBox(min, max,
+                     [&](const Cell& cell)
+                     {
+                         for(uint32_t light : cell.lights)
+                         {
+                             const Light& entry = m_lights[light];
+                             const glm::vec3 d  = entry.center - glm::clamp(entry.center, min, max);
+                             if(glm::dot(d, d) <= entry.radius * entry.radius)
+                                 lights.push_back(light);
+                         }
+                     });
+}
+
+void LightGrid::QuerySphere(const glm::vec3& center, float radius, std::vector<uint32_t>& lights) const
+{
+    ForEachCellInBox(center - radius, center + radius,
+                     [&](const Cell& cell)
+                     {
+                         for(uint32_t light : cell.lights)
+                         {
+                             const Light& entry = m_lights[light];
+                             const glm::vec3 d  = entry.center - center;
+                             const float reach  = entry.radius + radius;
+                             if(glm::dot(d, d) <= reach * reach)
+                                 lights.push_back(light);
+                         }
+                     });
+}
+
+void LightGrid::QueryFrustum(std::span<const glm::vec4> planes, std::vector<uint32_t>& lights) const
+{
+    std::array<float, 8> planeLengths{};
+    assert(planes.size() <= planeLengths.size());
+    for(size_t i = 0; i < planes.size(); ++i)
+        planeLengths[i] = glm::length(glm::vec3(planes[i]));
+
+    for(const auto& [_, cell] : m_cells)
+    {
+        // the corner of the grown cell that is the farthest along the plane's normal has to be inside
+        const float cellSize = GetCellSize(cell.level);
+        const glm::vec3 min  = glm::vec3(cell.coords) * cellSize - m_levelMargins[cell.level];
+        const glm::vec3 max  = glm::vec3(cell.coords + 1) * cellSize + m_levelMargins[cell.level];
+
+        bool visible = true;
+        for(size_t i = 0; i < planes.size() && visible; ++i)
+        {
+            const glm::vec3 normal = glm::vec3(planes[i]);
+            const glm::vec3 corner = glm::mix(min, max, glm::greaterThanEqual(normal, glm::vec3(0.0f)));
+            visible                = glm::dot(normal, corner) + planes[i].w >= 0.0f;
+        }
+        if(!visible)
+            continue;
+
+        for(uint32_t light : cell.lights)
+        {
+            const Light& entry = m_lights[light];
+            bool inside        = true;
+            for(size_t i = 0; i < planes.size() && inside; ++i)
+                inside = glm::dot(glm::vec3(planes[i]), entry.center) + planes[i].w >= -entry.radius * planeLengths[i];
+            if(inside)
+                lights.push_back(light);
+        }
+    }
+}
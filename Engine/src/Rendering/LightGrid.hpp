@@ -0,0 +1,65 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <unordered_map>
+#include <vector>
+#include <glm/glm.hpp>
+
+// Loose hash grid over the range spheres of the point and spot lights, used for the CPU side light queries
+// The grid has a level per power of two cell size, a light goes into the level whose cells are at least as big as its sphere
+// and into the cell that holds its center, so growing a cell by the biggest radius of its level is enough to contain all of its lights
+// Moving a light only touches the cells it leaves and enters, only the cells that hold lights exist
+class LightGrid
+{
+public:
+    explicit LightGrid(float cellSize);  // size of the cells of the first level
+
+    // inserts the light the first time it's called for it, lights are identified by their slot in the light buffers
+    void Update(uint32_t light, const glm::vec3& center, float radius);
+    void Remove(uint32_t light);
+
+    // the queries append the lights whose sphere touches the query shape
+    void QueryBox(const glm::vec3& min, const glm::vec3& max, std::vector<uint32_t>& lights) const;
+    void QuerySphere(const glm::vec3& center, float radius, std::vector<uint32_t>& lights) const;
+    void QueryFrustum(std::span<const glm::vec4> planes, std::vector<uint32_t>& lights) const;  // world space planes facing inside, they don't have to be normalized
+
+    [[nodiscard]] uint32_t GetLightCount() const { return m_lightCount; }
+
+private:
+    static constexpr uint32_t LEVEL_COUNT = 16;
+
+    struct Light
+    {
+        glm::vec3 center{0.0f};
+        float radius         = 0.0f;
+        uint64_t cell        = 0;
+        uint32_t indexInCell = 0;
+        bool inserted        = false;
+    };
+
+    struct Cell
+    {
+        glm::ivec3 coords{0};
+        uint32_t level = 0;
+        std::vector<uint32_t> lights;
+    };
+
+    [[nodiscard]] uint32_t GetLevel(float radius) const;
+    [[nodiscard]] float GetCellSize(uint32_t level) const { return m_cellSize * static_cast<float>(1u << level); }
+    [[nodiscard]] glm::ivec3 GetCellCoords(const glm::vec3& position, uint32_t level) const;
+    [[nodiscard]] static uint64_t GetCellKey(const glm::ivec3& coords, uint32_t level);
+
+    void RemoveFromCell(uint32_t light);
+
+    template<typename Fn>
+    void ForEachCellInBox(const glm::vec3& min, const glm::vec3& max, Fn fn) const;
+
+    float m_cellSize;
+    uint32_t m_lightCount = 0;
+    std::vector<Light> m_lights;  // accessed with the light slot
+    std::unordered_map<uint64_t, Cell> m_cells;
+    std::array<uint32_t, LEVEL_COUNT> m_levelCells{};  // number of cells of every level, the queries skip the empty ones
+    std::array<float, LEVEL_COUNT> m_levelMargins{};   // biggest radius that went into every level, how much its cells are grown by
+};
@@ -1,9 +1,30 @@
 #include "Pipeline.hpp"
 #include "Application.hpp"
 #include "Core/Events/EventHandler.hpp"
+#include "Core/Jobs/JobSystem.hpp"
 #include "Rendering/VulkanContext.hpp"
 #include "Rendering/MaterialSystem.hpp"
 
+namespace
+{
+PipelineBatch* g_batch = nullptr;  // the batch of the main thread, the only one that creates pipelines
+}
+
+PipelineBatch::PipelineBatch()
+{
+    assert(g_batch == nullptr && "the batches can't be nested");
+    g_batch = this;
+}
+
+PipelineBatch::~PipelineBatch()
+{
+    PROFILE_FUNCTION();
+    JobSystem::Wait(m_counter);
+    g_batch = nullptr;
+    for(Pipeline* pipeline : m_pipelines)
+        pipeline->FinishSetup();
+}
+
 Pipeline::Pipeline(const std::string& shaderName, PipelineCreateInfo createInfo, uint16_t priority)
     : m_renderer(Application::GetInstance()->GetRenderer()),
       m_name(shaderName),
@@ -11,7 +32,13 @@ Pipeline::Pipeline(const std::string& shaderName, PipelineCreateInfo createInfo,
       m_priority(priority),
       m_shaderDataSlots({})
 {
-    Setup();
+    if(g_batch != nullptr)
+    {
+        QueueShaderCompilation(g_batch->m_counter);
+        g_batch->m_pipelines.push_back(this);
+    }
+    else
+        Setup();
 
     Application::GetInstance()->GetEventHandler()->Subscribe(this, &Pipeline::OnPipelineReload);
 
@@ -20,24 +47,50 @@ Pipeline::Pipeline(const std::string& shaderName, PipelineCreateInfo createInfo,
 
 void Pipeline::Setup()
 {
-    // m_shaderDataSlots.clear();
-    m_vertexInputAttributes.clear();
+    JobCounter counter;
+    QueueShaderCompilation(counter);
+    JobSystem::Wait(counter);
+    FinishSetup();
+}
 
+void Pipeline::QueueShaderCompilation(JobCounter& counter)
+{
+    m_stages.clear();
     if(m_createInfo.type == PipelineType::GRAPHICS)
     {
         if(m_createInfo.stages & VK_SHADER_STAGE_VERTEX_BIT)
         {
-            m_shaders.emplace_back(m_name, VK_SHADER_STAGE_VERTEX_BIT, this);
+            m_stages.push_back(VK_SHADER_STAGE_VERTEX_BIT);
         }
         if(m_createInfo.stages & VK_SHADER_STAGE_FRAGMENT_BIT)
         {
-            m_shaders.emplace_back(m_name, VK_SHADER_STAGE_FRAGMENT_BIT, this);
+            m_stages.push_back(VK_SHADER_STAGE_FRAGMENT_BIT);
         }
     }
     else
     {
-        m_shaders.emplace_back(m_name, VK_SHADER_STAGE_COMPUTE_BIT, this);
+        m_stages.push_back(VK_SHADER_STAGE_COMPUTE_BIT);
+    }
+
+    // the compilation is most of the time spent setting up a pipeline, the stages compile on the job system and only the reflection into
+    // this pipeline and the module creation stay on the thread that calls FinishSetup
+    m_spirv.assign(m_stages.size(), {});
+    for(size_t i = 0; i < m_stages.size(); ++i)
+    {
+        JobSystem::Run([this, i]() { m_spirv[i] = Shader::Compile(m_name, m_stages[i]); }, &counter);
+    }
+}
+
+void Pipeline::FinishSetup()
+{
+    // m_shaderDataSlots.clear();
+    m_vertexInputAttributes.clear();
+
+    for(size_t i = 0; i < m_stages.size(); ++i)
+    {
+        m_shaders.emplace_back(m_name, m_stages[i], std::move(m_spirv[i]), this);
     }
+    m_spirv.clear();
 
 
     if(m_createInfo.type == PipelineType::GRAPHICS)
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "Core/Jobs/JobSystem.hpp"
 #include "Rendering/CommandBuffer.hpp"
 #include "Rendering/Renderer.hpp"
 #include "VulkanContext.hpp"
@@ -59,6 +60,23 @@ struct PipelineReloadEvent : public Event
     std::string name;
 };
 
+// While one is alive the pipelines that are constructed on this thread only queue the compilation of their shaders on the job system,
+// the destructor waits for all of them at once and then creates the pipelines in the order they were constructed
+// so the shaders of every pass compile in parallel instead of one pipeline at a time, the pipelines can't be used before the batch ends
+class PipelineBatch
+{
+public:
+    PipelineBatch();
+    ~PipelineBatch();
+    PipelineBatch(const PipelineBatch&)            = delete;
+    PipelineBatch& operator=(const PipelineBatch&) = delete;
+
+private:
+    friend class Pipeline;
+    JobCounter m_counter;
+    std::vector<Pipeline*> m_pipelines;
+};
+
 class Pipeline
 {
 public:
@@ -127,8 +145,11 @@ private:
     friend class MaterialSystem;
     friend class DescriptorSetAllocator;
     friend class Shader;
+    friend class PipelineBatch;
 
     void Setup();
+    void QueueShaderCompilation(JobCounter& counter);  // the compiled stages go to m_spirv, the counter has to be waited on before FinishSetup
+    void FinishSetup();
 
     void CreateGraphicsPipeline();
     void CreateComputePipeline();
@@ -153,10 +174,12 @@ private:
     PipelineCreateInfo m_createInfo;
     uint16_t m_priority;
     std::vector<Shader> m_shaders;
+    std::vector<VkShaderStageFlagBits> m_stages;
+    std::vector<std::vector<uint32_t>> m_spirv;  // accessed with the index of the stage, only between QueueShaderCompilation and FinishSetup
 
 
-    VkPipeline m_pipeline;
-    VkPipelineLayout m_layout;
+    VkPipeline m_pipeline{VK_NULL_HANDLE};
+    VkPipelineLayout m_layout{VK_NULL_HANDLE};
 
     uint64_t m_materialBufferPtr = 0;
 
@@ -131,7 +131,7 @@ RenderingBufferResource& RenderPass::AddBufferInput(const std::string& name, VkD
 
 RenderingBufferResource& RenderPass::AddDrawCommandBuffer(const std::string& name)
 {
-    auto& resource = AddBufferInput(name, sizeof(DrawCommand) * MAX_DRAW_COMMANDS, VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+    auto& resource = AddBufferInput(name, sizeof(VkDrawIndexedIndirectCommand) * MAX_DRAW_COMMANDS, VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
     resource.AddUse(m_id, VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT);
     // TODO lifetime? should be permanent i think but i still want the renderpass to allocate it which isnt possible yet (but also transient resources are kind of permanent for now as they aren't reset on each frame)
 
@@ -2,6 +2,7 @@
 
 #include "Rendering/CommandBuffer.hpp"
 #include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
 
 #include <utility>
 
@@ -39,6 +40,63 @@ struct DrawCommand
     int32_t vertexOffset;
     uint32_t objectID;
 };
+
+// LODs of a DrawCommand, uploaded in the same order as the draw commands
+constexpr uint32_t MAX_DRAW_LODS = 4;  // same as MAX_MESH_LODS
+struct DrawLods
+{
+    struct Lod
+    {
+        uint32_t firstIndex;
+        uint32_t indexCount;
+        float error;  // object space, see MeshLod
+        uint32_t filler;
+    };
+
+    uint32_t lodCount;
+    uint32_t drawnByMeshlets;    // LOD 0 is drawn by the meshlet culling instead of the draw command
+    uint32_t isStatic;           // has the Static tag, cached in the static shadow maps
+    uint32_t meshletFirstIndex;  // where the meshlet culling copies the indices of the visible meshlets, see Renderable::meshletIndexCount
+    Lod lods[MAX_DRAW_LODS];
+};
+
+// DrawCommand of a single meshlet together with its bounds, see Meshlet in ECS/CoreComponents/Mesh.hpp
+struct MeshletDrawCommand
+{
+    glm::vec3 center;  // object space bounding sphere
+    float radius;
+    glm::vec3 coneAxis;  // object space normal cone, see Meshlet
+    float coneCutoff;
+
+    uint32_t indexCount;
+    uint32_t firstIndex;  // renderable index offset + meshlet index offset
+    int32_t vertexOffset;
+    uint32_t objectID;
+};
+
+// the culled draws are split into one batch per index type since the index type can't change inside an indirect draw
+// each batch has its own region in the draw and object id map buffers (the object id map region starts with the batch's draw count)
+enum IndexBatch : uint32_t
+{
+    INDEX_BATCH_UINT16 = 0,
+    INDEX_BATCH_UINT32,
+    NUM_INDEX_BATCHES
+};
+constexpr uint32_t MAX_DRAWS_PER_BATCH = MAX_DRAW_COMMANDS / NUM_INDEX_BATCHES;  // has to match MAX_DRAWS_PER_BATCH in bindings.glsl
+
+
+// a buffer can hold several draw lists one after the other (the shadow culling writes one per cascade), every list has all the index batches
+constexpr VkDeviceSize DRAW_LIST_SIZE          = static_cast<VkDeviceSize>(MAX_DRAW_COMMANDS) * sizeof(VkDrawIndexedIndirectCommand);
+constexpr VkDeviceSize OBJECT_ID_MAP_LIST_SIZE = static_cast<VkDeviceSize>(NUM_INDEX_BATCHES) * (MAX_DRAWS_PER_BATCH + 1) * sizeof(uint32_t);
+
+constexpr VkDeviceSize GetDrawBatchOffset(uint32_t batch, uint32_t list = 0)
+{
+    return list * DRAW_LIST_SIZE + static_cast<VkDeviceSize>(batch) * MAX_DRAWS_PER_BATCH * sizeof(VkDrawIndexedIndirectCommand);
+}
+constexpr VkDeviceSize GetObjectIDMapBatchOffset(uint32_t batch, uint32_t list = 0)
+{
+    return list * OBJECT_ID_MAP_LIST_SIZE + static_cast<VkDeviceSize>(batch) * (MAX_DRAWS_PER_BATCH + 1) * sizeof(uint32_t);
+}
 class RenderPass
 {
 public:
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <memory>
+#include <typeindex>
+#include <unordered_map>
+#include <utility>
+
+// The renderer's singletons (the gpu buffers, the camera of the frame that is being recorded, the depth pyramid...), one value per type
+// They are kept out of the ECS because the render thread reads them while the main thread runs the next Update
+// Only the render thread and the renderer's event handlers (while they hold the frame lock) use them, the values are added while the renderer is set up
+class RenderResources
+{
+public:
+    // does nothing when there already is a T, like adding a component that is already there
+    template<typename T>
+    T* Add()
+    {
+        if(T* resource = GetMut<T>())
+            return resource;
+        return Emplace<T>();
+    }
+    // replaces the T that is already there
+    template<typename T, typename... Args>
+    T* Emplace(Args&&... args)
+    {
+        auto resource          = std::make_shared<T>(std::forward<Args>(args)...);
+        T* ptr                 = resource.get();
+        m_resources[typeid(T)] = std::move(resource);
+        return ptr;
+    }
+
+    template<typename T>
+    const T* Get() const
+    {
+        auto it = m_resources.find(typeid(T));
+        return it != m_resources.end() ? static_cast<const T*>(it->second.get()) : nullptr;
+    }
+    template<typename T>
+    T* GetMut()
+    {
+        auto it = m_resources.find(typeid(T));
+        return it != m_resources.end() ? static_cast<T*>(it->second.get()) : nullptr;
+    }
+
+private:
+    std::unordered_map<std::type_index, std::shared_ptr<void>> m_resources;  // shared_ptr<void> still calls T's destructor
+};
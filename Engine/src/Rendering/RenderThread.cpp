@@ -0,0 +1,72 @@
+#include "Rendering/RenderThread.hpp"
+
+#include "Rendering/Renderer.hpp"
+
+RenderThread::RenderThread(Renderer* renderer, uint32_t pipelineDepth) : m_renderer(renderer), m_pipelineDepth(pipelineDepth)
+{
+    if(m_pipelineDepth > 0)
+        m_thread = std::thread(&RenderThread::Loop, this);
+}
+
+RenderThread::~RenderThread()
+{
+    if(!m_thread.joinable())
+        return;
+
+    {
+        std::lock_guard lock(m_mutex);
+        m_stop = true;
+    }
+    m_changed.notify_all();
+    m_thread.join();
+}
+
+void RenderThread::Submit(FrameSnapshot&& frame)
+{
+    PROFILE_FUNCTION();
+    if(m_pipelineDepth == 0)
+    {
+        m_renderer->Render(frame);
+        return;
+    }
+
+    {
+        std::unique_lock lock(m_mutex);
+        m_changed.wait(lock, [this]() { return m_queue.size() + (m_rendering ? 1 : 0) < m_pipelineDepth; });
+        m_queue.push_back(std::move(frame));
+    }
+    m_changed.notify_all();
+}
+
+void RenderThread::WaitIdle()
+{
+    PROFILE_FUNCTION();
+    std::unique_lock lock(m_mutex);
+    m_changed.wait(lock, [this]() { return m_queue.empty() && !m_rendering; });
+}
+
+void RenderThread::Loop()
+{
+    while(true)
+    {
+        FrameSnapshot frame;
+        {
+            std::unique_lock lock(m_mutex);
+            m_changed.wait(lock, [this]() { return m_stop || !m_queue.empty(); });
+            if(m_queue.empty())
+                return;
+
+            frame = std::move(m_queue.front());
+            m_queue.pop_front();
+            m_rendering = true;
+        }
+
+        m_renderer->Render(frame);
+
+        {
+            std::lock_guard lock(m_mutex);
+            m_rendering = false;
+        }
+        m_changed.notify_all();
+    }
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "Rendering/FrameSnapshot.hpp"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+class Renderer;
+
+// Renders the snapshots the main thread submits on a thread of its own, in the order they were submitted
+// The pipeline depth is how many frames the simulation can run ahead of the frame that is being rendered, Submit blocks once that many are queued or rendering
+// 1 overlaps the simulation of the next frame with the rendering of the last one, more smooths out spikes at the cost of latency
+// 0 doesn't start a thread, Submit renders the snapshot right away like the renderer did before
+class RenderThread
+{
+public:
+    RenderThread(Renderer* renderer, uint32_t pipelineDepth);
+    ~RenderThread();  // renders what is still queued before it joins
+
+    RenderThread(const RenderThread&)            = delete;
+    RenderThread& operator=(const RenderThread&) = delete;
+
+    void Submit(FrameSnapshot&& frame);
+    void WaitIdle();  // until every submitted snapshot was rendered, the main thread has the renderer to itself after this
+
+    [[nodiscard]] uint32_t GetPipelineDepth() const { return m_pipelineDepth; }
+
+private:
+    void Loop();
+
+    Renderer* m_renderer;
+    uint32_t m_pipelineDepth;
+
+    std::mutex m_mutex;
+    std::condition_variable m_changed;  // a snapshot was queued or one finished rendering
+    std::deque<FrameSnapshot> m_queue;
+    bool m_rendering = false;
+    bool m_stop      = false;
+
+    std::thread m_thread;  // last so it starts after the rest is initialized
+};
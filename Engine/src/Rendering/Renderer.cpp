@@ -1,6 +1,8 @@
 #include "Rendering/Renderer.hpp"
 #include "ECS/CoreComponents/BoundingBox.hpp"
 
+#include <algorithm>
+#include <bit>
 #include <memory>
 #include <numeric>
 #include <sstream>
@@ -9,6 +11,7 @@
 #include <limits>
 #include <array>
 #include <string>
+#include <span>
 #include <utility>
 #include <vulkan/vulkan.h>
 #define VMA_IMPLEMENTATION
@@ -37,6 +40,7 @@
 #include "ECS/CoreComponents/Material.hpp"
 #include "ECS/CoreComponents/RendererComponents.hpp"
 #include "ECS/CoreComponents/SkyboxComponent.hpp"
+#include "ECS/CoreSystems/TransformSystem.hpp"
 
 
 #include "Rendering/CoreRenderPasses/DepthPass.hpp"
@@ -47,10 +51,45 @@
 #include "Rendering/CoreRenderPasses/ShadowPass.hpp"
 #include "Rendering/CoreRenderPasses/GTAOPass.hpp"
 #include "Rendering/CoreRenderPasses/DenoisePass.hpp"
+#include "Rendering/CoreRenderPasses/HiZPass.hpp"
+#include "Rendering/CoreRenderPasses/DepthReductionPass.hpp"
+#include "Rendering/CoreRenderPasses/ShadowCullPass.hpp"
+#include "Rendering/CoreRenderPasses/ShadowAtlasPass.hpp"
+
+#include "Utils/VertexQuantization.hpp"
+#include "Utils/TransformPacking.hpp"
 
 
 const uint32_t MAX_FRAMES_IN_FLIGHT = 2;
 
+// renderables with less meshlets than this are cheaper to cull as a whole
+const uint32_t MIN_MESHLETS_FOR_MESHLET_CULLING = 4;
+
+static_assert(MAX_DRAW_LODS == MAX_MESH_LODS);
+static_assert(MAX_SHADOW_DRAW_LISTS <= 32, "StaticShadowCache::dirtyLists has one bit per shadow draw list");
+
+// near plane of the point and spot light shadows
+const float LOCAL_SHADOW_NEAR_PLANE = 0.05f;
+
+// the layout of the vertices in the vertex buffer, has to match the vertex inputs in shaders/vertex.glsl
+#ifdef PACKED_VERTICES
+using GPUVertex = VertexQuantization::PackedVertex;
+#else
+using GPUVertex = Vertex;
+#endif
+
+// the layout of the transforms in the TransformBuffers, has to match Transforms in shaders/bindings.glsl
+#if defined(AFFINE_TRANSFORMS)
+using GPUTransform = TransformPacking::AffineTransform;
+static GPUTransform PackTransform(const glm::mat4& transform) { return TransformPacking::PackAffine(transform); }
+#elif defined(RIGID_TRANSFORMS)
+using GPUTransform = TransformPacking::RigidTransform;
+static GPUTransform PackTransform(const glm::mat4& transform) { return TransformPacking::PackRigid(transform); }
+#else
+using GPUTransform = glm::mat4;
+static GPUTransform PackTransform(const glm::mat4& transform) { return transform; }
+#endif
+
 
 struct QueueFamilyIndices
 {
@@ -103,15 +142,12 @@ Renderer::Renderer(std::shared_ptr<Window> window)
       m_freeTextureSlots(NUM_TEXTURE_DESCRIPTORS),
       m_freeStorageImageSlots(NUM_TEXTURE_DESCRIPTORS)
 {
-    m_transformsQuery        = m_ecs->StartQueryBuilder<const InternalTransform, const Renderable, TransformBuffers>("TransformsQuery").term_at(3).singleton().build();
-    m_renderablesQuery       = m_ecs->StartQueryBuilder<const Renderable, const BoundingBox>("RenderablesQuery").build();
-    m_directionalLightsQuery = m_ecs->StartQueryBuilder<const DirectionalLight, const InternalTransform>("DirectionalLightsQuery").build();
-    m_pointLightsQuery       = m_ecs->StartQueryBuilder<const PointLight, const InternalTransform>("PointLightsQuery").build();
-    m_spotLightsQuery        = m_ecs->StartQueryBuilder<const SpotLight, const InternalTransform>("SpotLightsQuery").build();
+    m_renderablesQuery       = m_ecs->StartQueryBuilder<const Renderable, const BoundingBox, const Mesh>("RenderablesQuery").build();
+    RegisterObservers();
 
 
     Application::GetInstance()->GetEventHandler()->Subscribe(this, &Renderer::OnSceneSwitched);
-    Application::GetInstance()->GetEventHandler()->Subscribe(this, &Renderer::OnMeshComponentAdded);
+    Application::GetInstance()->GetEventHandler()->Subscribe(this, &Renderer::OnMeshComponentsAdded);
     Application::GetInstance()->GetEventHandler()->Subscribe(this, &Renderer::OnMeshComponentRemoved);
     Application::GetInstance()->GetEventHandler()->Subscribe(this, &Renderer::OnMaterialComponentAdded);
     Application::GetInstance()->GetEventHandler()->Subscribe(this, &Renderer::OnDirectionalLightAdded);
@@ -129,7 +165,8 @@ Renderer::Renderer(std::shared_ptr<Window> window)
     CreateSwapchain();
     CreateVmaAllocator();
 
-    m_changedLights.resize(m_swapchainImages.size());
+    assert(m_swapchainImages.size() <= 32 && "m_pendingLightFrames has one bit per frame");
+    m_changedLocalShadows.resize(m_swapchainImages.size());
 
 
     CreateCommandPool();
@@ -155,33 +192,57 @@ Renderer::Renderer(std::shared_ptr<Window> window)
     VulkanContext::m_textureSampler = m_samplers.emplace(SamplerConfig{}, SamplerConfig{}).first->second.GetVkSampler();
 
 
-    m_vertexBuffer = std::make_unique<DynamicBufferAllocator>(5'000'000, sizeof(Vertex), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, 500'000);
-    m_indexBuffer  = std::make_unique<DynamicBufferAllocator>(5'000'000, sizeof(uint32_t), VK_BUFFER_USAGE_INDEX_BUFFER_BIT, 5'000'000);
+    m_vertexBuffer  = std::make_unique<DynamicBufferAllocator>(5'000'000, sizeof(GPUVertex), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, 500'000);
+    // the meshlet culling copies the indices of the visible meshlets in the index buffers (see meshletcull.comp)
+    m_indexBuffer   = std::make_unique<DynamicBufferAllocator>(1'000'000, sizeof(uint32_t), VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, 1'000'000);
+    m_indexBuffer16 = std::make_unique<DynamicBufferAllocator>(5'000'000, sizeof(uint16_t), VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, 5'000'000);
 
     m_shaderDataBuffer = std::make_unique<DynamicBufferAllocator>(100'000, 1, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, 10'000, true);  // objectSize = 1 byte because each shader data can be diff size so we "store them as bytes"
     VK_SET_DEBUG_NAME(m_shaderDataBuffer->GetVkBuffer(), VK_OBJECT_TYPE_BUFFER, "ShaderDataBuffer");
 
 
-    m_ecs->EmplaceSingleton<DrawCommandBuffer>(1000, sizeof(DrawCommand), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, 0, true);  // TODO change to non mappable and use staging buffer
-    m_ecs->EmplaceSingleton<BoundingBoxBuffer>(1000, sizeof(BoundingBox), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, 0, true);                                        // TODO change to non mappable and use staging buffer
+    m_resources.Emplace<DrawCommandBuffer>(1000, sizeof(DrawCommand), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, 0, true);  // TODO change to non mappable and use staging buffer
+    m_resources.Emplace<BoundingBoxBuffer>(1000, sizeof(BoundingBox), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, 0, true);                                        // TODO change to non mappable and use staging buffer
+    m_resources.Emplace<DrawLodBuffer>(1000, sizeof(DrawLods), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, 0, true);                                               // TODO change to non mappable and use staging buffer
+    m_resources.Emplace<MeshletDrawCommandBuffer>(10'000, sizeof(MeshletDrawCommand), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, 0, true);                  // TODO change to non mappable and use staging buffer
+
+    m_resources.Emplace<VertexQuantizationBuffer>(50'000, sizeof(VertexQuantization::QuantizationParams), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, 0, true);
 
-    m_ecs->AddSingleton<TransformBuffers>();
-    m_ecs->AddSingleton<ShadowBuffers>();
-    m_ecs->AddSingleton<LightBuffers>();
-    auto* transformBuffers = m_ecs->GetSingletonMut<TransformBuffers>();
-    auto* shadowBuffers    = m_ecs->GetSingletonMut<ShadowBuffers>();
-    auto* lightBuffers     = m_ecs->GetSingletonMut<LightBuffers>();
+    m_resources.Add<TransformBuffers>();
+    m_resources.Add<ShadowBuffers>();
+    m_resources.Add<StaticShadowCache>();
+    m_resources.Add<LocalShadowBuffers>();
+    m_resources.Add<LightBuffers>();
+    m_resources.Add<FrameCameraData>();
+    auto* transformBuffers   = m_resources.GetMut<TransformBuffers>();
+    auto* shadowBuffers      = m_resources.GetMut<ShadowBuffers>();
+    auto* localShadowBuffers = m_resources.GetMut<LocalShadowBuffers>();
+    auto* lightBuffers       = m_resources.GetMut<LightBuffers>();
 
     uint32_t totaltiles = static_cast<uint32_t>(glm::ceil(m_swapchainExtent.width / 16.f) * glm::ceil(m_swapchainExtent.height / 16.f));
-    lightBuffers->visibleLightsBuffer.Allocate(totaltiles * sizeof(TileLights), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT);  // MAX_LIGHTS_PER_TILE
+    lightBuffers->visibleLightsBuffer.Allocate(totaltiles * sizeof(LightList), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT);
+    lightBuffers->tileLightIndexBuffer.Allocate(MIN_TILE_LIGHT_INDICES * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT);
+    lightBuffers->tileLightIndexSize.capacity = MIN_TILE_LIGHT_INDICES;
+    const glm::uvec2 clusterTiles((m_swapchainExtent.width + CLUSTER_TILE_SIZE - 1) / CLUSTER_TILE_SIZE, (m_swapchainExtent.height + CLUSTER_TILE_SIZE - 1) / CLUSTER_TILE_SIZE);
+    const glm::uvec2 lightBins((clusterTiles + glm::uvec2(CLUSTER_BIN_TILES - 1)) / glm::uvec2(CLUSTER_BIN_TILES));
+    uint32_t totalClusters = clusterTiles.x * clusterTiles.y * CLUSTER_SLICES;
+    lightBuffers->clusterBuffer.Allocate(totalClusters * sizeof(LightList), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT);
+    lightBuffers->lightBinBuffer.Allocate(lightBins.x * lightBins.y * (MAX_BIN_LIGHTS + 1) * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT);
+    lightBuffers->lightIndexBuffer.Allocate(MIN_CLUSTER_LIGHT_INDICES * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT);
+    lightBuffers->lightIndexSize.capacity = MIN_CLUSTER_LIGHT_INDICES;
     for(int32_t i = 0; i < NUM_FRAMES_IN_FLIGHT; ++i)
     {
-        transformBuffers->buffers.emplace_back(50'000, sizeof(glm::mat4), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, 10'000, true);
+        transformBuffers->buffers.emplace_back(50'000, sizeof(GPUTransform), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, 10'000, true);
 
         shadowBuffers->matricesBuffers.emplace_back(100, sizeof(ShadowMatrices), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, 100, true);
         shadowBuffers->indicesBuffers.emplace_back(100, sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, 100, false);
 
+        localShadowBuffers->dataBuffers.emplace_back(100, sizeof(LocalShadowData), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, 0, true);
+        localShadowBuffers->viewBuffers.emplace_back(MAX_SHADOW_ATLAS_UPDATES, sizeof(glm::mat4), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, 0, true);
+        localShadowBuffers->viewBuffers.back().Allocate(MAX_SHADOW_ATLAS_UPDATES);  // one slot per view, always the same ones
+
         lightBuffers->buffers.emplace_back(100, sizeof(Light), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, 0, true);  // MAX_LIGHTS_PER_TILE
+        lightBuffers->lightListCounters.emplace_back(2 * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, true).ZeroFill();  // tiles, clusters
     }
 
 
@@ -220,6 +281,9 @@ Renderer::~Renderer()
 
 void Renderer::RecreateSwapchain()
 {
+    m_window->SetResized(false);
+    m_swapchainOutOfDate = false;
+
     while(m_window->GetWidth() == 0 || m_window->GetHeight() == 0)
         glfwWaitEvents();
 
@@ -421,6 +485,7 @@ void Renderer::CreateDevice()
     deviceFeatures.sampleRateShading                    = VK_TRUE;
     deviceFeatures.shaderInt64                          = VK_TRUE;
     deviceFeatures.multiDrawIndirect                    = VK_TRUE;
+    deviceFeatures.depthClamp                           = VK_TRUE;
     deviceFeatures.shaderStorageImageReadWithoutFormat  = VK_TRUE;
     deviceFeatures.shaderStorageImageWriteWithoutFormat = VK_TRUE;
     deviceFeatures.pipelineStatisticsQuery              = VK_TRUE;
@@ -431,6 +496,7 @@ void Renderer::CreateDevice()
     device11Features.sType                            = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES;
     device11Features.shaderDrawParameters             = VK_TRUE;
     device11Features.multiview                        = VK_TRUE;
+    device11Features.storageBuffer16BitAccess         = VK_TRUE;  // 16 bit index copies in meshletcull.comp
 
     VkPhysicalDeviceVulkan12Features device12Features             = {};
     device12Features.sType                                        = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
@@ -589,6 +655,8 @@ Pipeline* Renderer::AddPipeline(const std::string& name, PipelineCreateInfo crea
 }
 void Renderer::CreatePipeline()
 {
+    PipelineBatch batch;  // the environment map pipelines are only used once they all exist
+
     {
         // Equirectangular to cubemap pipeline
         LOG_WARN("Creating equiToCube pipeline");
@@ -801,14 +869,31 @@ void Renderer::CreateUniformBuffers()
 
 void Renderer::InitilizeRenderGraph()
 {
-    m_depthPass     = std::make_unique<DepthPass>(m_renderGraph);
-    m_drawCullPass  = std::make_unique<DrawcullPass>(m_renderGraph);
-    m_lightCullPass = std::make_unique<LightCullPass>(m_renderGraph);
-    m_shadowPass    = std::make_unique<ShadowPass>(m_renderGraph);
-    m_lightingPass  = std::make_unique<LightingPass>(m_renderGraph);
-    m_skyboxPass    = std::make_unique<SkyboxPass>(m_renderGraph);
-    m_gtaoPass      = std::make_unique<GTAOPass>(m_renderGraph);
-    m_denoisePass   = std::make_unique<DenoisePass>(m_renderGraph);
+    {
+        PipelineBatch batch;  // the shaders of all the passes compile at once, the pipelines are created when it goes out of scope
+        m_depthPass          = std::make_unique<DepthPass>(m_renderGraph, m_resources);
+        m_drawCullPass       = std::make_unique<DrawcullPass>(m_renderGraph, m_resources);
+        m_lightCullPass      = std::make_unique<LightCullPass>(m_renderGraph, m_resources);
+        m_shadowCullPass     = std::make_unique<ShadowCullPass>(m_renderGraph, m_resources);
+        m_shadowPass         = std::make_unique<ShadowPass>(m_renderGraph, m_resources);
+        m_shadowAtlasPass    = std::make_unique<ShadowAtlasPass>(m_renderGraph, m_resources);
+        m_lightingPass       = std::make_unique<LightingPass>(m_renderGraph, m_resources);
+        m_skyboxPass         = std::make_unique<SkyboxPass>(m_renderGraph, m_resources);
+        m_gtaoPass           = std::make_unique<GTAOPass>(m_renderGraph, m_resources);
+        m_denoisePass        = std::make_unique<DenoisePass>(m_renderGraph, m_resources);
+        m_hizPass            = std::make_unique<HiZPass>(m_renderGraph, m_resources);
+        m_depthReductionPass = std::make_unique<DepthReductionPass>(m_renderGraph, m_resources);
+    }
+
+    auto meshletButton = std::make_shared<Button>("Disable Meshlet Culling");
+    meshletButton->RegisterCallback(
+        [this](Button* button)
+        {
+            m_useMeshletCulling      = !m_useMeshletCulling;
+            m_needDrawBufferReupload = true;
+            button->SetName(m_useMeshletCulling ? "Disable Meshlet Culling" : "Enable Meshlet Culling");
+        });
+    m_rendererDebugWindow->AddElement(meshletButton);
 
 
     {
@@ -852,7 +937,8 @@ void Renderer::InitilizeRenderGraph()
             [&](CommandBuffer& cb, uint32_t /*frameIndex*/)
             {
                 vkCmdBeginRendering(cb.GetCommandBuffer(), uiPass.GetRenderingInfo());
-                m_debugUI->Draw(&cb);
+                if(m_debugUIFrame != nullptr)
+                    DebugUI::Draw(&cb, *m_debugUIFrame);
                 vkCmdEndRendering(cb.GetCommandBuffer());
             });
     }
@@ -863,47 +949,129 @@ void Renderer::InitilizeRenderGraph()
 
 void Renderer::RefreshDrawCommands()
 {
-    auto* draws             = m_ecs->GetSingletonMut<DrawCommandBuffer>();
-    auto* boundingBoxBuffer = m_ecs->GetSingletonMut<BoundingBoxBuffer>();
-    std::vector<DrawCommand> drawCommands;
-    std::vector<BoundingBox> boundingBoxes;
+    auto* draws             = m_resources.GetMut<DrawCommandBuffer>();
+    auto* boundingBoxBuffer = m_resources.GetMut<BoundingBoxBuffer>();
+    auto* drawLodBuffer     = m_resources.GetMut<DrawLodBuffer>();
+    auto* meshletDraws      = m_resources.GetMut<MeshletDrawCommandBuffer>();
+    // draws are grouped by index type, the 16 bit ones go first so the culling pass can tell them apart with just a count
+    std::array<std::vector<DrawCommand>, NUM_INDEX_BATCHES> batchDrawCommands;
+    std::array<std::vector<BoundingBox>, NUM_INDEX_BATCHES> batchBoundingBoxes;
+    std::array<std::vector<DrawLods>, NUM_INDEX_BATCHES> batchDrawLods;
+    std::array<std::vector<MeshletDrawCommand>, NUM_INDEX_BATCHES> batchMeshletDrawCommands;
     m_renderablesQuery.each(
-        [&](const Renderable& renderable, const BoundingBox& boundingBox)
+        [&](flecs::entity entity, const Renderable& renderable, const BoundingBox& boundingBox, const Mesh& mesh)
         {
+            uint32_t batch = renderable.uses16BitIndices ? INDEX_BATCH_UINT16 : INDEX_BATCH_UINT32;
+
+            // big meshes are culled per meshlet instead of as a whole when they are close enough to use LOD 0
+            const bool drawnByMeshlets = m_useMeshletCulling && renderable.meshletIndexCount != 0;
+            if(drawnByMeshlets)
+            {
+                for(const Meshlet& meshlet : mesh.meshlets)
+                {
+                    MeshletDrawCommand mdc{};
+                    mdc.center       = meshlet.center;
+                    mdc.radius       = meshlet.radius;
+                    mdc.coneAxis     = meshlet.coneAxis;
+                    mdc.coneCutoff   = meshlet.coneCutoff;
+                    mdc.indexCount   = meshlet.indexCount;
+                    mdc.firstIndex   = renderable.indexOffset + meshlet.indexOffset;
+                    mdc.vertexOffset = static_cast<int32_t>(renderable.vertexOffset);
+                    mdc.objectID     = renderable.objectID;
+                    batchMeshletDrawCommands[batch].push_back(mdc);
+
+                    meshletDraws->buffer.Allocate(1);
+                }
+            }
+
+            DrawLods lods{};
+            lods.drawnByMeshlets   = drawnByMeshlets ? 1 : 0;
+            lods.isStatic          = entity.has<Static>() ? 1 : 0;
+            lods.meshletFirstIndex = renderable.indexOffset + renderable.indexCount;
+            if(mesh.lods.empty())
+            {
+                lods.lodCount = 1;
+                lods.lods[0]  = {renderable.indexOffset, renderable.indexCount, 0.0f, 0};
+            }
+            else
+            {
+                lods.lodCount = static_cast<uint32_t>(mesh.lods.size());
+                for(uint32_t i = 0; i < mesh.lods.size(); ++i)
+                    lods.lods[i] = {renderable.indexOffset + mesh.lods[i].indexOffset, mesh.lods[i].indexCount, mesh.lods[i].error, 0};
+            }
+
             DrawCommand dc{};
-            dc.indexCount   = renderable.indexCount;
+            dc.indexCount   = lods.lods[0].indexCount;
             // dc.instanceCount = 1;
             dc.firstIndex   = renderable.indexOffset;
             dc.vertexOffset = static_cast<int32_t>(renderable.vertexOffset);
             // dc.firstInstance = 0;
             dc.objectID     = renderable.objectID;
 
-            drawCommands.push_back(dc);
-
-            boundingBoxes.push_back(boundingBox);
+            batchDrawCommands[batch].push_back(dc);
+            batchBoundingBoxes[batch].push_back(boundingBox);
+            batchDrawLods[batch].push_back(lods);
 
             draws->buffer.Allocate(1);
             boundingBoxBuffer->buffer.Allocate(1);
+            drawLodBuffer->buffer.Allocate(1);
         });
 
+    // every renderable is drawn with at most one draw, the visible meshlets of one are compacted into a single draw
+    for(uint32_t batch = 0; batch < NUM_INDEX_BATCHES; ++batch)
+    {
+        if(batchDrawCommands[batch].size() > MAX_DRAWS_PER_BATCH)
+            LOG_ERROR("{0} renderables in index batch {1}, more than MAX_DRAWS_PER_BATCH ({2})", batchDrawCommands[batch].size(), batch, MAX_DRAWS_PER_BATCH);
+        assert(batchDrawCommands[batch].size() <= MAX_DRAWS_PER_BATCH);
+    }
+
+    const auto count16                    = static_cast<uint32_t>(batchDrawCommands[INDEX_BATCH_UINT16].size());
+    std::vector<DrawCommand> drawCommands = std::move(batchDrawCommands[INDEX_BATCH_UINT16]);
+    drawCommands.insert(drawCommands.end(), batchDrawCommands[INDEX_BATCH_UINT32].begin(), batchDrawCommands[INDEX_BATCH_UINT32].end());
+    std::vector<BoundingBox> boundingBoxes = std::move(batchBoundingBoxes[INDEX_BATCH_UINT16]);
+    boundingBoxes.insert(boundingBoxes.end(), batchBoundingBoxes[INDEX_BATCH_UINT32].begin(), batchBoundingBoxes[INDEX_BATCH_UINT32].end());
+    std::vector<DrawLods> drawLods = std::move(batchDrawLods[INDEX_BATCH_UINT16]);
+    drawLods.insert(drawLods.end(), batchDrawLods[INDEX_BATCH_UINT32].begin(), batchDrawLods[INDEX_BATCH_UINT32].end());
+
+    const auto meshletCount16                           = static_cast<uint32_t>(batchMeshletDrawCommands[INDEX_BATCH_UINT16].size());
+    std::vector<MeshletDrawCommand> meshletDrawCommands = std::move(batchMeshletDrawCommands[INDEX_BATCH_UINT16]);
+    meshletDrawCommands.insert(meshletDrawCommands.end(), batchMeshletDrawCommands[INDEX_BATCH_UINT32].begin(), batchMeshletDrawCommands[INDEX_BATCH_UINT32].end());
+
     // TODO: find a nicer wayto do the upload
     std::vector<uint64_t> slots;
     std::vector<const void*> dcDatas;
     std::vector<const void*> boundingBoxDatas;
+    std::vector<const void*> lodDatas;
 
     for(uint32_t i = 0; i < drawCommands.size(); ++i)
     {
         slots.push_back(i);
         dcDatas.push_back(&drawCommands[i]);
         boundingBoxDatas.push_back(&boundingBoxes[i]);
+        lodDatas.push_back(&drawLods[i]);
     }
 
     draws->buffer.UploadData(slots, dcDatas);
-    draws->count = static_cast<uint32_t>(drawCommands.size());
+    draws->count   = static_cast<uint32_t>(drawCommands.size());
+    draws->count16 = count16;
 
     boundingBoxBuffer->buffer.UploadData(slots, boundingBoxDatas);
     boundingBoxBuffer->count = static_cast<uint32_t>(boundingBoxes.size());
 
+    drawLodBuffer->buffer.UploadData(slots, lodDatas);
+
+    std::vector<uint64_t> meshletSlots;
+    std::vector<const void*> meshletDatas;
+    for(uint32_t i = 0; i < meshletDrawCommands.size(); ++i)
+    {
+        meshletSlots.push_back(i);
+        meshletDatas.push_back(&meshletDrawCommands[i]);
+    }
+
+    meshletDraws->buffer.UploadData(meshletSlots, meshletDatas);
+    meshletDraws->count   = static_cast<uint32_t>(meshletDrawCommands.size());
+    meshletDraws->count16 = meshletCount16;
+
 
     m_needDrawBufferReupload = false;
 }
@@ -912,6 +1080,21 @@ void Renderer::RefreshShaderDataOffsets()
 {
 }
 
+void Renderer::DrawIndexedIndirectBatches(CommandBuffer& cb, const Buffer& drawBuffer, const Buffer& drawObjBuffer, const std::function<void(uint64_t)>& setObjectIDMap, uint32_t list)
+{
+    for(uint32_t batch = 0; batch < NUM_INDEX_BATCHES; ++batch)
+    {
+        if(batch == INDEX_BATCH_UINT16)
+            m_indexBuffer16->Bind(cb, VK_INDEX_TYPE_UINT16);
+        else
+            m_indexBuffer->Bind(cb, VK_INDEX_TYPE_UINT32);
+
+        setObjectIDMap(drawObjBuffer.GetDeviceAddress() + GetObjectIDMapBatchOffset(batch, list));
+
+        vkCmdDrawIndexedIndirectCount(cb.GetCommandBuffer(), drawBuffer.GetVkBuffer(), GetDrawBatchOffset(batch, list), drawObjBuffer.GetVkBuffer(), GetObjectIDMapBatchOffset(batch, list), MAX_DRAWS_PER_BATCH, sizeof(VkDrawIndexedIndirectCommand));
+    }
+}
+
 // TODO: make it possible to specifiy sampler parameters per texture (for example we want to use clamp to edge for the brdf texture while using repeat for the material textures)
 void Renderer::AddTexture(Image* texture, SamplerConfig samplerConf)
 {
@@ -1054,9 +1237,9 @@ void Renderer::CreateEnvironmentMap()
         ci.isCubeMap   = true;
         ci.debugName   = "Environment Map";
 
-        m_ecs->EmplaceSingleton<SkyboxComponent>(512u, 512u, ci);
+        m_resources.Emplace<SkyboxComponent>(512u, 512u, ci);
 
-        envMap = &m_ecs->GetSingletonMut<SkyboxComponent>()->skybox;
+        envMap = &m_resources.GetMut<SkyboxComponent>()->skybox;
         cb.Begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
         // set up the renderingInfo struct
         VkRenderingInfo rendering          = {};
@@ -1307,14 +1490,34 @@ void Renderer::CreateEnvironmentMap()
         AddTexture(&BRDFLUT, samplerConf);
     }
 
-    m_ecs->EmplaceSingleton<PBREnvironment>(std::move(convEnvMap), std::move(prefilteredEnvMap), std::move(BRDFLUT));
+    m_resources.Emplace<PBREnvironment>(std::move(convEnvMap), std::move(prefilteredEnvMap), std::move(BRDFLUT));
+}
+
+// light space box of a cascade
+struct CascadeBounds
+{
+    glm::vec3 min;
+    glm::vec3 max;
+    glm::vec2 zPlanes;
+};
+
+// only depends on the direction so the cascade boxes of a light can be compared from one frame to the next
+glm::mat4 GetLightView(const glm::vec3& lightDir)
+{
+    glm::vec3 up(lightDir.y, -lightDir.x, 0.0f);  // TODO
+    return glm::lookAt(glm::vec3(0.0f), lightDir, glm::normalize(up));
+}
+
+// the far side of the box (min z, away from the light) maps to 0 because of reverse z
+glm::mat4 GetCascadeProjection(const glm::vec3& min, const glm::vec3& max)
+{
+    return glm::ortho(min.x, max.x, min.y, max.y, -min.z, -max.z);
 }
 
-std::tuple<std::array<glm::mat4, NUM_CASCADES>, std::array<glm::mat4, NUM_CASCADES>, std::array<glm::vec2, NUM_CASCADES>> GetCascadeMatricesOrtho(const glm::mat4& invCamera, const glm::vec3& lightDir, float zNear, float maxDepth)
+// the cascades are split between minDistance and maxDistance from the camera, zNear is only used to convert the distances to reverse z depth
+std::array<CascadeBounds, NUM_CASCADES> GetCascadeBoundsOrtho(const glm::mat4& invCamera, const glm::mat4& lightView, float zNear, float minDistance, float maxDistance)
 {
-    std::array<glm::mat4, NUM_CASCADES> resVP{};
-    std::array<glm::mat4, NUM_CASCADES> resV{};
-    std::array<glm::vec2, NUM_CASCADES> zPlanes{};
+    std::array<CascadeBounds, NUM_CASCADES> res{};
 
     // float maxDepthNDC = zNear / maxDepth;
     // float depthNDCStep = (1 - maxDepthNDC) / NUM_CASCADES;
@@ -1329,14 +1532,14 @@ std::tuple<std::array<glm::mat4, NUM_CASCADES>, std::array<glm::mat4, NUM_CASCAD
         float t = static_cast<float>(i) / static_cast<float>(NUM_CASCADES);
 
         // Logarithmic split for near cascades, linear split for far cascades
-        float logSplit    = zNear * std::pow(maxDepth / zNear, t);
-        float linearSplit = zNear + t * (maxDepth - zNear);
+        float logSplit    = minDistance * std::pow(maxDistance / minDistance, t);
+        float linearSplit = minDistance + t * (maxDistance - minDistance);
 
         // Blend between logarithmic and linear splits
         float splitDistance = logSplit + lambda * (linearSplit - logSplit);
         cascadeSplits.push_back(splitDistance);
     }
-    cascadeSplits.push_back(maxDepth);
+    cascadeSplits.push_back(maxDistance);
 
     for(int i = 0; i < NUM_CASCADES; ++i)
     {
@@ -1363,17 +1566,8 @@ std::tuple<std::array<glm::mat4, NUM_CASCADES>, std::array<glm::mat4, NUM_CASCAD
             vert /= vert.w;
         }
 
-        glm::vec3 center(0.0f);
-        for(const glm::vec4& vert : boundingVertices)
-        {
-            center += glm::vec3(vert);
-        }
-        center /= boundingVertices.size();
-
-        glm::vec3 up(lightDir.y, -lightDir.x, 0.0f);  // TODO
-        glm::mat4 lightView = glm::lookAt(center - lightDir, center, glm::normalize(up));
-
         // world space to light space
+        glm::vec3 center(0.0f);
         for(glm::vec4& vert : boundingVertices)
         {
             vert  = lightView * vert;
@@ -1383,7 +1577,10 @@ std::tuple<std::array<glm::mat4, NUM_CASCADES>, std::array<glm::mat4, NUM_CASCAD
             max.x = glm::max(max.x, vert.x);
             max.y = glm::max(max.y, vert.y);
             max.z = glm::max(max.z, vert.z);
+
+            center += glm::vec3(vert);
         }
+        center /= boundingVertices.size();
 
         // make the cascade constant size in world space
         float radius = glm::distance(boundingVertices[0], boundingVertices[7]) / 2.0f;
@@ -1393,158 +1590,705 @@ std::tuple<std::array<glm::mat4, NUM_CASCADES>, std::array<glm::mat4, NUM_CASCAD
         max.x = center.x + radius;
         max.y = center.y + radius;
 
-        /*
-        // round the boundaries to pixel size
-        float pixelSize = radius * 2.0f / SHADOWMAP_SIZE;
-        min.x = std::round(min.y / pixelSize) * pixelSize;
-        max.x = std::round(max.y / pixelSize) * pixelSize;
-        min.y = std::round(min.y / pixelSize) * pixelSize;
-        max.y = std::round(max.y / pixelSize) * pixelSize;
-        */
-        // glm::mat4 proj = glm::ortho(-500.f, 500.f, -500.f, 500.f, 500.f, -500.f);
-        resV[i]    = lightView;
-        resVP[i]   = glm::ortho(min.x, max.x, min.y, max.y, max.z, min.z) * lightView;  // for z we do max for near and min for far because of reverse z
-        zPlanes[i] = glm::vec2(cascadeDepthStart, cascadeDepthEnd);
+        res[i] = {min, max, glm::vec2(cascadeDepthStart, cascadeDepthEnd)};
     }
-    return {resVP, resV, zPlanes};
+
+    // the range is a few frames old, what ends up in front of the first or behind the last cascade still picks the closest one
+    res[0].zPlanes.x                = 1.0f;
+    res[NUM_CASCADES - 1].zPlanes.y = 0.0f;
+    return res;
 }
 
-void Renderer::UpdateLights(uint32_t index)
+void Renderer::RegisterObservers()
+{
+    // UpdateLights only looks at what was set or moved, the TransformSystem only sets the InternalTransforms that changed
+    m_ecs->AddObserver<DirectionalLight>(ECSEvent::OnSet, [this](flecs::entity e, DirectionalLight& /*light*/) { m_dirtyLights.emplace_back(e); });
+    m_ecs->AddObserver<PointLight>(ECSEvent::OnSet, [this](flecs::entity e, PointLight& /*light*/) { m_dirtyLights.emplace_back(e); });
+    m_ecs->AddObserver<SpotLight>(ECSEvent::OnSet, [this](flecs::entity e, SpotLight& /*light*/) { m_dirtyLights.emplace_back(e); });
+    m_ecs->AddObserver<InternalTransform>(ECSEvent::OnSet,
+                                          [this](flecs::entity e, InternalTransform& /*transform*/)
+                                          {
+                                              if(e.has<DirectionalLight>() || e.has<PointLight>() || e.has<SpotLight>())
+                                                  m_dirtyLights.emplace_back(e);
+                                          });
+}
+
+void Renderer::QueueLightUpload(uint32_t slot)
+{
+    if(slot >= m_pendingLightFrames.size())
+        m_pendingLightFrames.resize(slot + 1, 0);
+
+    if(m_pendingLightFrames[slot] == 0)
+        m_pendingLights.push_back(slot);
+    m_pendingLightFrames[slot] = (1u << m_swapchainImages.size()) - 1;
+}
+
+void Renderer::ExtractLights(FrameSnapshot& frame)
 {
     PROFILE_FUNCTION();
+    for(const Entity& entity : m_dirtyLights)
     {
-        PROFILE_SCOPE("Directional Lights update");
+        // lights set in the same frame they were created don't have a slot until their ComponentAdded event, which marks them dirty again
+        const auto* transform = entity.IsAlive() ? entity.GetComponent<InternalTransform>() : nullptr;
+        if(transform == nullptr)
+            continue;
 
-        m_directionalLightsQuery.each(
-            [&](const DirectionalLight& lightComp, const InternalTransform& transform)
-            {
-                auto newDir        = glm::normalize(-glm::vec3(transform.worldTransform[2]));
-                float newIntensity = lightComp.intensity;
-                auto newColor      = lightComp.color.ToVec3();
+        FrameSnapshot::LightUpdate update{};
+        if(const auto* dirLight = entity.GetComponent<DirectionalLight>(); dirLight != nullptr && dirLight->_slot != UINT32_MAX)
+        {
+            update.slot      = dirLight->_slot;
+            update.type      = LightType::Directional;
+            update.direction = glm::normalize(-glm::vec3(transform->worldTransform[2]));
+            update.intensity = dirLight->intensity;
+            update.color     = dirLight->color.ToVec3();
+        }
+        else if(const auto* pointLight = entity.GetComponent<PointLight>(); pointLight != nullptr && pointLight->_slot != UINT32_MAX)
+        {
+            update.slot        = pointLight->_slot;
+            update.type        = LightType::Point;
+            update.position    = glm::vec3(transform->worldTransform[3]);
+            update.range       = pointLight->range;
+            update.intensity   = pointLight->intensity;
+            update.color       = pointLight->color.ToVec3();
+            update.attenuation = {pointLight->attenuation.quadratic, pointLight->attenuation.linear, pointLight->attenuation.constant};
+        }
+        else if(const auto* spotLight = entity.GetComponent<SpotLight>(); spotLight != nullptr && spotLight->_slot != UINT32_MAX)
+        {
+            update.slot        = spotLight->_slot;
+            update.type        = LightType::Spot;
+            update.position    = glm::vec3(transform->worldTransform[3]);
+            update.direction   = glm::normalize(glm::vec3(transform->worldTransform[2]));
+            update.range       = spotLight->range;
+            update.intensity   = spotLight->intensity;
+            update.cutoff      = spotLight->cutoff;
+            update.color       = spotLight->color.ToVec3();
+            update.attenuation = {spotLight->attenuation.quadratic, spotLight->attenuation.linear, spotLight->attenuation.constant};
+        }
+        else
+            continue;
 
+        // the main thread's grid, QueryLights reads it without waiting for the render thread
+        if(update.type != LightType::Directional)
+            m_lightGrid.Update(update.slot, update.position, update.range);
+        frame.lights.push_back(update);
+    }
+    m_dirtyLights.clear();
+}
 
-                Light& light = m_lightMap[lightComp._slot];
-                bool changed = newDir != light.direction || newIntensity != light.intensity || newColor != light.color;
-                if(changed)
-                {
-                    light.direction = newDir;
-                    light.intensity = newIntensity;
-                    light.color     = newColor;
+void Renderer::ApplyLights(const FrameSnapshot& frame)
+{
+    for(const FrameSnapshot::LightUpdate& update : frame.lights)
+    {
+        Light& light    = m_lightMap[update.slot];
+        light.intensity = update.intensity;
+        light.color     = update.color;
+        if(update.type == LightType::Directional)
+            light.direction = update.direction;
+        else
+        {
+            light.position       = update.position;
+            light.range          = update.range;
+            light.attenuation[0] = update.attenuation.x;
+            light.attenuation[1] = update.attenuation.y;
+            light.attenuation[2] = update.attenuation.z;
+            if(update.type == LightType::Spot)
+            {
+                light.direction = update.direction;
+                light.cutoff    = update.cutoff;
+            }
 
-                    for(auto& dict : m_changedLights)
-                        dict[lightComp._slot] = &light;  // if it isn't in the dict then put it in otherwise just replace it (which actually does nothing but we would have to check if the dict contains it anyway so shouldn't matter for perf)
-                }
-                // light.lightSpaceMatrices = GetCascadeMatricesOrtho(glm::mat4(1.0), newDir,
-            });
+            m_renderLightGrid.Update(update.slot, light.position, light.range);  // the whole sphere for spot lights, not only the cone
+        }
+
+        QueueLightUpload(update.slot);
     }
+}
+
+void Renderer::UpdateLights(uint32_t index)
+{
+    PROFILE_FUNCTION();
+
+    // every frame buffer gets the lights it missed in one upload, the slots that are up to date everywhere leave the list
+    std::vector<uint64_t> slots;
+    std::vector<const void*> datas;
+    const uint32_t frameBit = 1u << index;
+    size_t pendingCount     = 0;
+    for(uint32_t slot : m_pendingLights)
     {
-        PROFILE_SCOPE("Point Lights update");
+        uint32_t& frames = m_pendingLightFrames[slot];
+        if(frames & frameBit)
+        {
+            slots.push_back(slot);
+            datas.push_back(&m_lightMap[slot]);
+            frames &= ~frameBit;
+        }
+        if(frames != 0)
+            m_pendingLights[pendingCount++] = slot;
+    }
+    m_pendingLights.resize(pendingCount);
 
-        m_pointLightsQuery.each(
-            [&](const PointLight& lightComp, const InternalTransform& transform)
-            {
-                auto newPos = glm::vec3(transform.worldTransform[3]);
-
-                float newRange     = lightComp.range;
-                float newIntensity = lightComp.intensity;
-                glm::vec3 newColor = lightComp.color.ToVec3();
-                Attenuation newAtt = lightComp.attenuation;
-
-                Light& light = m_lightMap[lightComp._slot];
-                bool changed = newPos != light.position || newIntensity != light.intensity
-                            || newColor != light.color || newRange != light.range
-                            || newAtt.quadratic != light.attenuation[0] || newAtt.linear != light.attenuation[1] || newAtt.constant != light.attenuation[2];
-                if(changed)
-                {
-                    light.position  = newPos;
-                    light.range     = newRange;
-                    light.intensity = newIntensity;
-                    light.color     = newColor;
+    if(!slots.empty())
+        m_resources.GetMut<LightBuffers>()->buffers[index].UploadData(slots, datas);
+}
 
-                    light.attenuation[0] = newAtt.quadratic;
-                    light.attenuation[1] = newAtt.linear;
-                    light.attenuation[2] = newAtt.constant;
+// box around the transformed local box, from its transformed center and the extents projected on the world axes
+static void GetWorldBounds(const BoundingBox& box, const glm::mat4& transform, glm::vec3& min, glm::vec3& max)
+{
+    const glm::vec3 center  = glm::vec3(transform * glm::vec4(0.5f * glm::vec3(box.min + box.max), 1.0f));
+    const glm::vec3 extents = 0.5f * glm::vec3(box.max - box.min);
 
-                    for(auto& dict : m_changedLights)
-                        dict[lightComp._slot] = &light;  // if it isn't in the dict then put it in otherwise just replace it (which actually does nothing but we would have to check if the dict contains it anyway so shouldn't matter for perf)
-                }
-            });
-    }
+    const glm::mat3 absolute = glm::mat3(glm::abs(glm::vec3(transform[0])), glm::abs(glm::vec3(transform[1])), glm::abs(glm::vec3(transform[2])));
+    const glm::vec3 halfSize = absolute * extents;
+
+    min = center - halfSize;
+    max = center + halfSize;
+}
+
+void Renderer::ExtractTransforms(FrameSnapshot& frame)
+{
+    PROFILE_FUNCTION();
+
+    auto* context = m_ecs->GetSingletonMut<TransformSystemContext>();
+    if(context == nullptr)
+        return;
+
+    // the list is only cleared here so the changes of the frames that weren't extracted are still in the next snapshot
+    frame.transforms.reserve(context->changedEntities.size());
+    for(const flecs::entity& e : context->changedEntities)
     {
-        PROFILE_SCOPE("Spot Lights update");
+        const Entity entity(e);
+        if(!entity.IsAlive())
+            continue;
 
-        m_spotLightsQuery.each(
-            [&](const SpotLight& lightComp, const InternalTransform& transform)
-            {
-                auto newPos        = glm::vec3(transform.worldTransform[3]);
-                auto newDir        = glm::normalize(glm::vec3(transform.worldTransform[2]));
-                float newRange     = lightComp.range;
-                float newIntensity = lightComp.intensity;
-                float newCutoff    = lightComp.cutoff;
-                glm::vec3 newColor = lightComp.color.ToVec3();
+        const auto* renderable = entity.GetComponent<Renderable>();
+        const auto* transform  = entity.GetComponent<InternalTransform>();
+        if(renderable == nullptr || transform == nullptr)
+            continue;
 
-                Attenuation newAtt = lightComp.attenuation;
+        FrameSnapshot::TransformUpdate update{};
+        update.worldTransform = transform->worldTransform;
+        update.objectID       = renderable->objectID;
 
+        const auto* box = entity.GetComponent<BoundingBox>();
+        if(box != nullptr && renderable->objectID < m_sceneProxies.size() && m_sceneProxies[renderable->objectID] != AABBTree::NULL_NODE)
+        {
+            GetWorldBounds(*box, transform->worldTransform, update.boundsMin, update.boundsMax);
+            update.hasBounds = true;
+            m_sceneTree.MoveProxy(m_sceneProxies[renderable->objectID], update.boundsMin, update.boundsMax);
+        }
+        frame.transforms.push_back(update);
+    }
+    context->changedEntities.clear();
+}
 
-                Light& light = m_lightMap[lightComp._slot];
-                bool changed = newPos != light.position || newDir != light.direction || newIntensity != light.intensity
-                            || newColor != light.color || newRange != light.range || newCutoff != light.cutoff
-                            || newAtt.quadratic != light.attenuation[0] || newAtt.linear != light.attenuation[1] || newAtt.constant != light.attenuation[2];
+void Renderer::ApplyTransforms(const FrameSnapshot& frame)
+{
+    PROFILE_FUNCTION();
 
-                if(changed)
-                {
-                    light.position  = newPos;
-                    light.direction = newDir;
-                    light.range     = newRange;
-                    light.intensity = newIntensity;
-                    light.cutoff    = newCutoff;
-                    light.color     = newColor;
-
-                    light.attenuation[0] = newAtt.quadratic;
-                    light.attenuation[1] = newAtt.linear;
-                    light.attenuation[2] = newAtt.constant;
-
-                    for(auto& dict : m_changedLights)
-                        dict[lightComp._slot] = &light;  // if it isn't in the dict then put it in otherwise just replace it (which actually does nothing but we would have to check if the dict contains it anyway so shouldn't matter for perf)
-                }
-            });
+    // packed first so every transform buffer gets all of them with a single UploadData
+    std::vector<GPUTransform> packed;
+    std::vector<uint64_t> slots;
+    std::vector<const void*> datas;
+    packed.reserve(frame.transforms.size());
+    slots.reserve(frame.transforms.size());
+    datas.reserve(frame.transforms.size());
+    for(const FrameSnapshot::TransformUpdate& update : frame.transforms)
+    {
+        packed.push_back(PackTransform(update.worldTransform));
+        slots.push_back(update.objectID);
+        datas.push_back(&packed.back());
+    }
+    if(!slots.empty())
+    {
+        for(auto& buffer : m_resources.GetMut<TransformBuffers>()->buffers)
+            buffer.UploadData(slots, datas);
     }
 
-    auto* lightBuffers = m_ecs->GetSingletonMut<LightBuffers>();
-    std::vector<std::pair<uint32_t, void*>> slotsAndDatas;
-    for(auto& [slot, newLight] : m_changedLights[index])
+    // the cullers only change here so their boxes are the ones of this snapshot, even when the main thread already added or removed meshes since
+    for(const FrameSnapshot::BoundsUpdate& update : frame.bounds)
     {
-        slotsAndDatas.emplace_back(slot, newLight);
-        lightBuffers->buffers[index].UploadData(slot, newLight);  // TODO batch the upload together
+        if(update.objectID >= m_frustumCuller.GetCount())
+        {
+            m_frustumCuller.Resize(update.objectID + 1);
+            m_dynamicCasterCuller.Resize(update.objectID + 1);
+        }
+        m_dynamicCasterCuller.ClearBounds(update.objectID);
+        if(update.removed)
+        {
+            m_frustumCuller.ClearBounds(update.objectID);
+            continue;
+        }
+        m_frustumCuller.SetBounds(update.objectID, update.boundsMin, update.boundsMax);
+        if(!update.isStatic)
+            m_dynamicCasterCuller.SetBounds(update.objectID, update.boundsMin, update.boundsMax);
     }
-    m_changedLights[index].clear();
 
-    // m_lightsBuffers[index]->UpdateBuffer(slotsAndDatas);
+    for(const FrameSnapshot::TransformUpdate& update : frame.transforms)
+    {
+        if(!update.hasBounds)
+            continue;
+
+        if(update.objectID < m_frustumCuller.GetCount() && m_frustumCuller.HasBounds(update.objectID))
+            m_frustumCuller.SetBounds(update.objectID, update.boundsMin, update.boundsMax);
+        if(update.objectID < m_dynamicCasterCuller.GetCount() && m_dynamicCasterCuller.HasBounds(update.objectID))
+            m_dynamicCasterCuller.SetBounds(update.objectID, update.boundsMin, update.boundsMax);
+    }
+}
+
+void Renderer::QueryLights(const glm::vec3& min, const glm::vec3& max, std::vector<Entity>& lights) const
+{
+    std::vector<uint32_t> slots;  // not a member, the systems can query from several threads at once
+    m_lightGrid.QueryBox(min, max, slots);
+    for(uint32_t slot : slots)
+        lights.push_back(m_lightEntities[slot]);
+}
+
+void Renderer::QueryLights(const glm::vec3& center, float radius, std::vector<Entity>& lights) const
+{
+    std::vector<uint32_t> slots;
+    m_lightGrid.QuerySphere(center, radius, slots);
+    for(uint32_t slot : slots)
+        lights.push_back(m_lightEntities[slot]);
 }
 
 void Renderer::UpdateLightMatrices(uint32_t index)
 {
-    const auto* mainCamera = m_ecs->GetSingleton<MainCameraData>();
+    const auto* mainCamera = m_resources.Get<FrameCameraData>();
     glm::mat4 inverseVP    = glm::inverse(mainCamera->viewProj);
 
-    auto* shadowBuffers = m_ecs->GetSingletonMut<ShadowBuffers>();
+    // fit the cascades to the visible geometry, the whole shadow distance until something was read back
+    const auto* depthRange = m_resources.Get<DepthRange>();
+    float minDistance      = mainCamera->zNear;
+    float maxDistance      = MAX_SHADOW_DEPTH;
+    if(depthRange->enabled && depthRange->maxDepth > 0.0f)
+    {
+        minDistance = glm::max(mainCamera->zNear / depthRange->maxDepth * (1.0f - DEPTH_RANGE_PADDING), mainCamera->zNear);
+        maxDistance = glm::clamp(mainCamera->zNear / depthRange->minDepth * (1.0f + DEPTH_RANGE_PADDING), minDistance * 2.0f, static_cast<float>(MAX_SHADOW_DEPTH));
+        minDistance = glm::min(minDistance, maxDistance * 0.5f);
+    }
+
+    auto* shadowBuffers = m_resources.GetMut<ShadowBuffers>();
+    auto* staticCache   = m_resources.GetMut<StaticShadowCache>();
+    std::vector<uint32_t> dynamicCasters;
+    staticCache->dynamicLists = 0;
     for(const auto& [_, internalLight] : m_lightMap)
     {
-        if(internalLight.type != LightType::Directional)
+        if(internalLight.type != LightType::Directional || internalLight.shadowSlot == NO_SHADOW_SLOT)
             continue;
 
-        auto [cascadesVP, cascadesV, zPlanes] = GetCascadeMatricesOrtho(inverseVP, internalLight.direction, mainCamera->zNear, MAX_SHADOW_DEPTH);
+        const glm::mat4 lightView = GetLightView(internalLight.direction);
+        const auto cascades       = GetCascadeBoundsOrtho(inverseVP, lightView, mainCamera->zNear, minDistance, maxDistance);
+
+        CascadeCache& cache   = m_cascadeCaches[internalLight.shadowSlot];
+        const bool lightMoved = cache.direction != internalLight.direction;
+        cache.direction       = internalLight.direction;
 
         ShadowMatrices data{};
-        data.lightSpaceMatrices = cascadesVP;
-        data.lightViewMatrices  = cascadesV;
-        data.zPlanes            = zPlanes;
+        for(uint32_t i = 0; i < NUM_CASCADES; ++i)
+        {
+            const CascadeBounds& bounds = cascades[i];
+            const bool inside           = glm::all(glm::greaterThanEqual(bounds.min, cache.min[i])) && glm::all(glm::lessThanEqual(bounds.max, cache.max[i]));
+            // the depth range got much tighter, a smaller box gives back the resolution
+            const bool tooBig = bounds.max.x - bounds.min.x < (cache.max[i].x - cache.min[i].x) * SHADOW_CASCADE_SHRINK;
+            if(lightMoved || !inside || tooBig)
+            {
+                // grow the box so the camera can move for a while before it has to move again, snapped to whole texels so the shadows don't shimmer when it does
+                // the size is rounded up to 1/8 octave steps so a refit from a slightly different depth range keeps the same texel size
+                const float padding    = (bounds.max.x - bounds.min.x) * SHADOW_CASCADE_PADDING;
+                const float halfSize   = std::exp2(std::ceil(std::log2((bounds.max.x - bounds.min.x) * 0.5f + padding) * 8.0f) / 8.0f);
+                const float texelSize  = 2.0f * halfSize / SHADOWMAP_SIZE;
+                const glm::vec2 center = glm::round(glm::vec2(bounds.min + bounds.max) * 0.5f / texelSize) * texelSize;
+
+                cache.min[i] = glm::vec3(center - halfSize, bounds.min.z - padding);
+                cache.max[i] = glm::vec3(center + halfSize, bounds.max.z + padding);
+
+                staticCache->dirtyLists |= 1u << (internalLight.shadowSlot * NUM_CASCADES + i);
+            }
+
+            data.lightSpaceMatrices[i] = GetCascadeProjection(cache.min[i], cache.max[i]) * lightView;
+            data.lightViewMatrices[i]  = lightView;
+            data.zPlanes[i]            = bounds.zPlanes;
+
+            // the planes shadowcull.comp tests the casters with, without the near one (reverse z so the far plane is z = 0)
+            const glm::mat4 rows                  = glm::transpose(data.lightSpaceMatrices[i]);
+            const std::array<glm::vec4, 5> planes = {rows[3] + rows[0], rows[3] - rows[0], rows[3] + rows[1], rows[3] - rows[1], rows[2]};
+            dynamicCasters.clear();
+            m_dynamicCasterCuller.Cull(planes, dynamicCasters);
+            if(!dynamicCasters.empty())
+                staticCache->dynamicLists |= 1u << (internalLight.shadowSlot * NUM_CASCADES + i);
+        }
 
         shadowBuffers->matricesBuffers[index].UploadData(internalLight.matricesSlot, &data);
     }
 }
 
-void Renderer::Render(double /*dt*/)
+void Renderer::ReadDepthRange(uint32_t index)
+{
+    // the frame's fence was waited on so the DepthReductionPass of the last time this index was rendered is done
+    auto* depthRange = m_resources.GetMut<DepthRange>();
+    Buffer& buffer   = depthRange->buffers[index];
+
+    std::array<uint32_t, 2> result{};
+    buffer.Read(result.data(), sizeof(result));
+    // nothing but sky keeps the last range
+    if(result[1] != 0)
+    {
+        depthRange->minDepth = std::bit_cast<float>(result[0]);
+        depthRange->maxDepth = std::bit_cast<float>(result[1]);
+    }
+
+    const std::array<uint32_t, 2> reset = {~0u, 0u};
+    buffer.Fill(reset.data(), sizeof(reset));
+}
+
+// grows as soon as the culling asks for more and only shrinks after it used less than a quarter of the list for a while, so it doesn't go back and forth
+// returns the new capacity, 0 when the list keeps its size
+static uint32_t NextLightListCapacity(LightListSize& size, uint32_t requested, uint32_t minCapacity)
+{
+    size.peak         = std::max(size.peak, requested);
+    uint32_t capacity = size.capacity;
+    if(requested > capacity)
+    {
+        capacity = requested + requested / 2;
+    }
+    else if(requested < capacity / 4 && capacity > minCapacity)
+    {
+        if(++size.lowFrames < LIGHT_LIST_SHRINK_FRAMES)
+            return 0;
+        capacity = std::max<uint32_t>(size.peak + size.peak / 2, minCapacity);
+    }
+    else
+    {
+        size.lowFrames = 0;
+        size.peak      = 0;
+        return 0;
+    }
+
+    size.lowFrames = 0;
+    size.peak      = 0;
+    size.capacity  = capacity;
+    return capacity;
+}
+
+void Renderer::ResizeLightLists(uint32_t index)
+{
+    auto* lightBuffers = m_resources.GetMut<LightBuffers>();
+    Buffer& counter    = lightBuffers->lightListCounters[index];
+
+    // the frame's fence was waited on, this is what the tiles or the clusters asked for the last time it was rendered
+    std::array<uint32_t, 2> requested = {};
+    counter.Read(requested.data(), sizeof(requested));
+    counter.ZeroFill();
+
+    // only the list of the culling that is used is resized, the other one wasn't written
+    LightListSize& size  = lightBuffers->clustered ? lightBuffers->lightIndexSize : lightBuffers->tileLightIndexSize;
+    Buffer& list         = lightBuffers->clustered ? lightBuffers->lightIndexBuffer : lightBuffers->tileLightIndexBuffer;
+    uint32_t minCapacity = lightBuffers->clustered ? MIN_CLUSTER_LIGHT_INDICES : MIN_TILE_LIGHT_INDICES;
+    uint32_t capacity    = NextLightListCapacity(size, requested[lightBuffers->clustered ? 1 : 0], minCapacity);
+    if(capacity == 0)
+        return;
+
+    RetireBuffer(std::move(list));  // the other frames in flight might still read the old list
+    list.Allocate(static_cast<VkDeviceSize>(capacity) * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT);
+    LOG_INFO("{} light lists resized to {} indices", lightBuffers->clustered ? "Cluster" : "Tiled", capacity);
+}
+
+void Renderer::RetireBuffer(Buffer&& buffer)
+{
+    m_retiredBuffers.push_back({std::move(buffer), NUM_FRAMES_IN_FLIGHT});
+}
+
+void Renderer::FreeRetiredBuffers()
+{
+    // a frame in flight is done once its fence was waited on again, after NUM_FRAMES_IN_FLIGHT frames none of them can use the buffer anymore
+    for(RetiredBuffer& retired : m_retiredBuffers)
+        --retired.framesLeft;
+    std::erase_if(m_retiredBuffers, [](const RetiredBuffer& retired) { return retired.framesLeft == 0; });
+}
+
+uint32_t Renderer::AddLocalShadow(uint32_t lightSlot)
+{
+    auto* localShadowBuffers = m_resources.GetMut<LocalShadowBuffers>();
+    uint32_t shadowSlot      = 0;
+    for(auto& buffer : localShadowBuffers->dataBuffers)
+        shadowSlot = static_cast<uint32_t>(buffer.Allocate(1));  // slot should be the same for all of these, since we allocate to every buffer every time
+
+    if(shadowSlot >= m_localShadows.size())
+    {
+        m_localShadows.resize(shadowSlot + 1);
+        m_localShadowData.resize(shadowSlot + 1);
+    }
+    m_localShadows[shadowSlot]    = {};
+    m_localShadowData[shadowSlot] = {};  // no shadow until its tiles are rendered
+
+    m_localShadows[shadowSlot].lightSlot = lightSlot;
+    m_lightMap[lightSlot].shadowSlot     = shadowSlot;
+
+    for(auto& changed : m_changedLocalShadows)
+        changed.insert(shadowSlot);
+
+    return shadowSlot;
+}
+
+bool Renderer::AllocateLocalShadowTiles(uint32_t shadowSlot, uint32_t tileSize)
+{
+    LocalShadow& shadow      = m_localShadows[shadowSlot];
+    const uint32_t faceCount = m_lightMap[shadow.lightSlot].type == LightType::Point ? 6 : 1;
+
+    std::array<ShadowAtlas::Tile, 6> tiles{};
+    for(uint32_t face = 0; face < faceCount; ++face)
+    {
+        tiles[face] = m_shadowAtlas.Allocate(tileSize);
+        if(!tiles[face].IsValid())
+        {
+            for(const auto& tile : tiles)
+                m_shadowAtlas.Free(tile);
+            return false;
+        }
+    }
+
+    // the old tiles are only given back once the new ones are there so a light that can't grow keeps its shadow
+    FreeLocalShadowTiles(shadowSlot);
+    shadow.tiles    = tiles;
+    shadow.tileSize = tileSize;
+    return true;
+}
+
+void Renderer::FreeLocalShadowTiles(uint32_t shadowSlot)
+{
+    LocalShadow& shadow = m_localShadows[shadowSlot];
+    if(shadow.tileSize == 0)
+        return;
+
+    for(auto& tile : shadow.tiles)
+        m_shadowAtlas.Free(tile);
+    shadow.tiles      = {};
+    shadow.tileSize   = 0;
+    shadow.lastUpdate = 0;
+
+    // the tiles can be given to another light this frame, stop sampling them
+    m_localShadowData[shadowSlot].atlasRects = {};
+    for(auto& changed : m_changedLocalShadows)
+        changed.insert(shadowSlot);
+}
+
+// picks the tile size of every point and spot light from how much of the screen it covers and how bright it is, and which tiles get re-rendered this frame
+void Renderer::UpdateShadowAtlas(uint32_t index)
+{
+    PROFILE_FUNCTION();
+    ++m_shadowAtlasFrame;
+
+    const auto* mainCamera   = m_resources.Get<FrameCameraData>();
+    auto* localShadowBuffers = m_resources.GetMut<LocalShadowBuffers>();
+
+    const float screenHeight  = static_cast<float>(m_swapchainExtent.height);
+    const float pixelsPerUnit = 0.5f * screenHeight / mainCamera->clipToViewSpaceConsts.y;  // at a distance of 1
+
+    struct Candidate
+    {
+        uint32_t shadowSlot;
+        float importance;
+        uint32_t tileSize;
+    };
+
+    // world space planes of the view frustum, the light grid only hands back the lights whose range touches it
+    const glm::mat4 viewTranspose = glm::transpose(mainCamera->view);
+    std::array<glm::vec4, 5> frustumPlanes{};
+    for(size_t i = 0; i < frustumPlanes.size(); ++i)
+        frustumPlanes[i] = viewTranspose * mainCamera->frustumPlanesVS[i];
+
+    m_queriedLights.clear();
+    m_renderLightGrid.QueryFrustum(frustumPlanes, m_queriedLights);
+
+    std::vector<Candidate> candidates;
+    candidates.reserve(m_queriedLights.size());
+    for(uint32_t lightSlot : m_queriedLights)
+    {
+        const Light& light = m_lightMap[lightSlot];
+        if(light.range <= 0.0f)
+            continue;
+
+        // height in pixels of the light's sphere on screen, a cube face only sees a quarter of it
+        const float distance = glm::length(glm::vec3(mainCamera->view * glm::vec4(light.position, 1.0f)));
+        const float coverage = distance > light.range ? glm::min(2.0f * light.range / distance * pixelsPerUnit, screenHeight) : screenHeight;
+        const float faceSize = light.type == LightType::Point ? 0.5f * coverage : coverage;
+
+        Candidate candidate{};
+        candidate.shadowSlot = light.shadowSlot;
+        candidate.importance = coverage * light.intensity * glm::max(light.color.r, glm::max(light.color.g, light.color.b));
+        candidate.tileSize   = std::bit_ceil(glm::clamp(static_cast<uint32_t>(faceSize), static_cast<uint32_t>(SHADOW_ATLAS_MIN_TILE_SIZE), static_cast<uint32_t>(SHADOW_ATLAS_MAX_TILE_SIZE)));
+        candidates.push_back(candidate);
+    }
+
+    // the atlas can't hold more lights than that, only the most important ones get sorted
+    const auto moreImportant = [](const Candidate& lhs, const Candidate& rhs) { return lhs.importance > rhs.importance; };
+    if(candidates.size() > MAX_SHADOWED_LOCAL_LIGHTS)
+    {
+        std::nth_element(candidates.begin(), candidates.begin() + MAX_SHADOWED_LOCAL_LIGHTS, candidates.end(), moreImportant);
+        candidates.resize(MAX_SHADOWED_LOCAL_LIGHTS);
+    }
+    std::sort(candidates.begin(), candidates.end(), moreImportant);
+
+    // the lights that had tiles and aren't candidates anymore (out of view or not important enough) give them back
+    for(const Candidate& candidate : candidates)
+        m_localShadows[candidate.shadowSlot].lastSelected = m_shadowAtlasFrame;
+    for(uint32_t shadowSlot : m_tiledLocalShadows)
+    {
+        if(m_localShadows[shadowSlot].lastSelected != m_shadowAtlasFrame)
+            FreeLocalShadowTiles(shadowSlot);
+    }
+
+    // the most important lights get their tiles first
+    for(size_t i = 0; i < candidates.size(); ++i)
+    {
+        const Candidate& candidate = candidates[i];
+        const uint32_t currentSize = m_localShadows[candidate.shadowSlot].tileSize;
+
+        // only shrink when the light needs a quarter of its tile size so lights at the border between two sizes don't get new tiles every frame
+        if(currentSize != 0 && candidate.tileSize <= currentSize)
+        {
+            if(candidate.tileSize * 4 <= currentSize)
+            {
+                FreeLocalShadowTiles(candidate.shadowSlot);
+                AllocateLocalShadowTiles(candidate.shadowSlot, candidate.tileSize);  // can't fail, it fits in the tiles we just freed
+            }
+            continue;
+        }
+
+        // try smaller tiles when the atlas is full, a light that already has tiles keeps them if it can't grow
+        // a light without tiles takes them from the least important lights before giving up
+        size_t evicted = candidates.size();
+        while(true)
+        {
+            bool allocated = false;
+            for(uint32_t size = candidate.tileSize; size > currentSize && size >= SHADOW_ATLAS_MIN_TILE_SIZE && !allocated; size /= 2)
+                allocated = AllocateLocalShadowTiles(candidate.shadowSlot, size);
+
+            if(allocated || currentSize != 0 || evicted <= i + 1)
+                break;
+            FreeLocalShadowTiles(candidates[--evicted].shadowSlot);
+        }
+    }
+
+    // the tiles that were just allocated or whose light changed are rendered first, what's left of the budget refreshes the oldest ones for the dynamic casters
+    std::vector<uint32_t> outdated;
+    std::vector<uint32_t> refreshable;
+    m_tiledLocalShadows.clear();
+    for(const Candidate& candidate : candidates)
+    {
+        const LocalShadow& shadow = m_localShadows[candidate.shadowSlot];
+        if(shadow.tileSize == 0)
+            continue;
+        m_tiledLocalShadows.push_back(candidate.shadowSlot);
+
+        const Light& light = m_lightMap[shadow.lightSlot];
+        const bool changed = shadow.lastUpdate == 0 || light.position != shadow.position || light.range != shadow.range
+                          || (light.type == LightType::Spot && (light.direction != shadow.direction || light.cutoff != shadow.cutoff));
+        (changed ? outdated : refreshable).push_back(candidate.shadowSlot);
+    }
+    std::stable_sort(refreshable.begin(), refreshable.end(), [&](uint32_t lhs, uint32_t rhs) { return m_localShadows[lhs].lastUpdate < m_localShadows[rhs].lastUpdate; });
+    outdated.insert(outdated.end(), refreshable.begin(), refreshable.end());
+
+    const float atlasSize = static_cast<float>(m_shadowAtlas.GetSize());
+    const uint32_t budget = glm::min(static_cast<uint32_t>(localShadowBuffers->updateBudget), static_cast<uint32_t>(MAX_SHADOW_ATLAS_UPDATES));
+    localShadowBuffers->views.clear();
+    for(uint32_t shadowSlot : outdated)
+    {
+        LocalShadow& shadow      = m_localShadows[shadowSlot];
+        const Light& light       = m_lightMap[shadow.lightSlot];
+        const bool isPoint       = light.type == LightType::Point;
+        const uint32_t faceCount = isPoint ? 6 : 1;
+        if(localShadowBuffers->views.size() + faceCount > budget)
+            continue;
+
+        // reverse z like the camera, so near and far are swapped
+        std::array<glm::mat4, 6> views{};
+        glm::mat4 projection{};
+        if(isPoint)
+        {
+            // the face order matches the one forwardplus.frag picks with the major axis
+            const std::array<glm::vec3, 6> forward = {
+                glm::vec3( 1.0f,  0.0f,  0.0f),
+                glm::vec3(-1.0f,  0.0f,  0.0f),
+                glm::vec3( 0.0f,  1.0f,  0.0f),
+                glm::vec3( 0.0f, -1.0f,  0.0f),
+                glm::vec3( 0.0f,  0.0f,  1.0f),
+                glm::vec3( 0.0f,  0.0f, -1.0f)
+            };
+            const std::array<glm::vec3, 6> up = {
+                glm::vec3(0.0f, -1.0f,  0.0f),
+                glm::vec3(0.0f, -1.0f,  0.0f),
+                glm::vec3(0.0f,  0.0f,  1.0f),
+                glm::vec3(0.0f,  0.0f, -1.0f),
+                glm::vec3(0.0f, -1.0f,  0.0f),
+                glm::vec3(0.0f, -1.0f,  0.0f)
+            };
+            for(uint32_t face = 0; face < 6; ++face)
+                views[face] = glm::lookAt(light.position, light.position + forward[face], up[face]);
+            projection = glm::perspective(glm::radians(90.0f), 1.0f, light.range, LOCAL_SHADOW_NEAR_PLANE);
+        }
+        else
+        {
+            // the cone points away from the light's direction and its cutoff is the cosine of the half angle (see CalculateAttenuation in forwardplus.frag)
+            const glm::vec3 forward = -light.direction;
+            const glm::vec3 up      = glm::abs(forward.y) > 0.99f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+            const float fov         = glm::min(2.0f * glm::acos(glm::clamp(light.cutoff, 0.0f, 1.0f)), glm::radians(170.0f));
+            views[0]                = glm::lookAt(light.position, light.position + forward, up);
+            projection              = glm::perspective(fov, 1.0f, light.range, LOCAL_SHADOW_NEAR_PLANE);
+        }
+
+        LocalShadowData& data = m_localShadowData[shadowSlot];
+        data                  = {};
+        for(uint32_t face = 0; face < faceCount; ++face)
+        {
+            const ShadowAtlas::Tile& tile = shadow.tiles[face];
+            data.viewProj[face]           = projection * views[face];
+            data.atlasRects[face]         = glm::vec4(glm::vec2(tile.offset) / atlasSize, static_cast<float>(tile.size) / atlasSize, 0.0f);
+
+            const auto view = static_cast<uint32_t>(localShadowBuffers->views.size());
+            localShadowBuffers->viewBuffers[index].UploadData(view, &data.viewProj[face]);
+            localShadowBuffers->views.emplace_back(tile.offset, tile.size);
+        }
+        for(auto& changed : m_changedLocalShadows)
+            changed.insert(shadowSlot);
+
+        shadow.lastUpdate = m_shadowAtlasFrame;
+        shadow.position   = light.position;
+        shadow.direction  = light.direction;
+        shadow.range      = light.range;
+        shadow.cutoff     = light.cutoff;
+    }
+
+    for(uint32_t shadowSlot : m_changedLocalShadows[index])
+        localShadowBuffers->dataBuffers[index].UploadData(shadowSlot, &m_localShadowData[shadowSlot]);
+    m_changedLocalShadows[index].clear();
+}
+
+FrameSnapshot Renderer::ExtractFrame(double dt)
+{
+    PROFILE_FUNCTION();
+    auto lock = LockFrame();
+
+    FrameSnapshot frame;
+    frame.dt     = dt;
+    frame.camera = *m_ecs->GetSingleton<MainCameraData>();
+    ExtractTransforms(frame);
+    ExtractLights(frame);
+    frame.bounds = std::move(m_changedBounds);
+    m_changedBounds.clear();
+
+    // both go through the ECS, the draw commands with the renderables query and the ui with the windows
+    if(m_needDrawBufferReupload)
+    {
+        RefreshDrawCommands();
+        frame.staticShadowDirtyLists = ~0u;  // static casters could have been added or removed
+    }
+    frame.debugUI = m_debugUI->BuildFrame();
+
+    return frame;
+}
+
+void Renderer::Render(FrameSnapshot& frame)
 {
     // PROFILE_FUNCTION();
     uint32_t imageIndex = 0;
@@ -1557,15 +2301,28 @@ void Renderer::Render(double /*dt*/)
         }
 
         result = vkAcquireNextImageKHR(m_device, m_swapchain, UINT64_MAX, m_imageAvailable[m_currentFrame], VK_NULL_HANDLE, &imageIndex);
+    }
 
+    auto lock = LockFrame();
 
-        if(result == VK_ERROR_OUT_OF_DATE_KHR)
-        {
-            RecreateSwapchain();
-            return;
-        }
-        else if(result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
-            throw std::runtime_error("Failed to acquire swap chain image");
+    // the snapshot has the only copy of these changes, they are applied even when the frame is skipped
+    ApplyTransforms(frame);
+    ApplyLights(frame);
+    static_cast<MainCameraData&>(*m_resources.GetMut<FrameCameraData>()) = frame.camera;
+
+    auto* staticShadowCache = m_resources.GetMut<StaticShadowCache>();
+    staticShadowCache->dirtyLists |= frame.staticShadowDirtyLists;  // the cascades that move add theirs in UpdateLightMatrices
+
+    if(result == VK_ERROR_OUT_OF_DATE_KHR)
+    {
+        m_swapchainOutOfDate = true;
+        return;
+    }
+    else if(result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
+        throw std::runtime_error("Failed to acquire swap chain image");
+
+    {
+        PROFILE_SCOPE("Frame updates");
 
         // Check if a previous frame is using this image (i.e. there is its fence to wait on)
         if(m_imagesInFlight[imageIndex] != VK_NULL_HANDLE)
@@ -1581,28 +2338,23 @@ void Renderer::Render(double /*dt*/)
 
 
         //
+        FreeRetiredBuffers();
         UpdateLights(imageIndex);
+        ReadDepthRange(imageIndex);
+        ResizeLightLists(imageIndex);
         UpdateLightMatrices(imageIndex);
+        UpdateShadowAtlas(imageIndex);
         // m_ubAllocators["camera" + std::to_string(imageIndex)]->UpdateBuffer(0, &cs);
-
-        if(m_needDrawBufferReupload)
-        {
-            RefreshDrawCommands();
-        }
-        m_transformsQuery.each(
-            [&](const InternalTransform& transform, const Renderable& renderable, TransformBuffers& transformBuffers)
-            {
-                glm::mat4 model = transform.worldTransform;
-                for(auto& buffer : transformBuffers.buffers)
-                    buffer.UploadData(renderable.objectID, &model);
-            });
     }
 
+    m_debugUIFrame = frame.debugUI;
+
     m_mainCommandBuffers[imageIndex].Begin(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
 
-    m_vertexBuffer->Bind(m_mainCommandBuffers[imageIndex]);
-    m_indexBuffer->Bind(m_mainCommandBuffers[imageIndex]);
+    m_vertexBuffer->Bind(m_mainCommandBuffers[imageIndex]);  // index buffers are bound per batch in DrawIndexedIndirectBatches
     m_renderGraph.Execute(m_mainCommandBuffers[imageIndex], m_currentFrame, imageIndex);
+    staticShadowCache->dirtyLists   = 0;  // the ShadowPass re-rendered them
+    staticShadowCache->restoreLists = staticShadowCache->dynamicLists;
 
     VkPipelineStageFlags wait = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
     m_mainCommandBuffers[imageIndex].Submit(m_imageAvailable[m_currentFrame], wait, m_renderFinished[m_currentFrame], m_inFlightFences[m_currentFrame]);
@@ -1627,11 +2379,8 @@ void Renderer::Render(double /*dt*/)
     }
     if(result == VK_ERROR_DEVICE_LOST)
         VK_CHECK(result, "Queue present failed");
-    if(result == VK_SUBOPTIMAL_KHR || m_window->IsResized())
-    {
-        m_window->SetResized(false);
-        RecreateSwapchain();
-    }
+    if(result == VK_SUBOPTIMAL_KHR || result == VK_ERROR_OUT_OF_DATE_KHR)
+        m_swapchainOutOfDate = true;
     else
         VK_CHECK(result, "Failed to present the swapchain image");
 
@@ -1644,72 +2393,230 @@ void Renderer::Render(double /*dt*/)
 void Renderer::OnSceneSwitched(SceneSwitchedEvent e)
 {
     m_ecs = e.newScene->GetECS();
+
+    m_dirtyLights.clear();
+    RegisterObservers();
 }
 
-void Renderer::OnMeshComponentAdded(ComponentAdded<Mesh> e)
+void Renderer::OnMeshComponentsAdded(std::span<const ComponentAdded<Mesh>> events)
 {
+    PROFILE_FUNCTION();
     // TODO don't keep the vertex and index vectors after sending them to gpu
-    const Mesh* mesh = e.entity.GetComponent<Mesh>();
-    // VkDeviceSize vBufferSize = sizeof(mesh->vertices[0]) * mesh->vertices.size();
-    Renderable comp{};
 
+    // the mesh can be gone again when it was removed in the same frame
+    std::vector<Entity> entities;
+    entities.reserve(events.size());
+    for(const ComponentAdded<Mesh>& e : events)
+    {
+        if(e.entity.IsAlive() && e.entity.HasComponent<Mesh>())
+            entities.push_back(e.entity);
+    }
+    if(entities.empty())
+        return;
 
-    // create the vertex and index buffers on the gpu
-    bool didVBResize    = false;
-    uint64_t vertexSlot = m_vertexBuffer->Allocate(mesh->vertices.size(), didVBResize, (void*)&comp);
+    // the geometry of all the meshes is allocated first and then uploaded with one staging copy per buffer
+    // the Renderables are only set after that because setting them moves the entities to another table, which moves the meshes too
+    std::vector<Renderable> comps(entities.size());
+    std::vector<VertexQuantization::QuantizationParams> quantizations(entities.size());
+#ifdef PACKED_VERTICES
+    std::vector<std::vector<GPUVertex>> packedVertices(entities.size());
+#endif
+    std::vector<std::vector<uint16_t>> indices16(entities.size());
+    std::vector<std::vector<uint32_t>> meshletIndices(entities.size());  // the 32 bit indices of the meshes culled per meshlet, padded with their room for the visible meshlets
 
-    m_vertexBuffer->UploadData(vertexSlot, mesh->vertices.data());
+    std::vector<const void*> vertexDatas;
+    std::vector<const void*> indexDatas;
+    std::vector<const void*> index16Datas;
 
-    comp.vertexOffset = static_cast<uint32_t>(vertexSlot);
-    comp.vertexCount  = static_cast<uint32_t>(mesh->vertices.size());
+    // the allocations are tagged with the index of their entity in m_geometryOwners so the offsets can be fixed when a buffer resizes
+    const size_t firstOwner = m_geometryOwners.size();
+    m_geometryOwners.insert(m_geometryOwners.end(), entities.begin(), entities.end());
 
+    bool didVBResize   = false;
     bool didIBResize   = false;
-    uint64_t indexSlot = m_indexBuffer->Allocate(mesh->indices.size(), didIBResize, &comp);
+    bool didIB16Resize = false;
+    for(size_t i = 0; i < entities.size(); ++i)
+    {
+        const Mesh* mesh = entities[i].GetComponent<Mesh>();
+        Renderable& comp = comps[i];
+        void* owner      = reinterpret_cast<void*>(firstOwner + i + 1);  // not 0, vma's "no user data"
+
+        // create the vertex and index buffers on the gpu
+        uint64_t vertexSlot = m_vertexBuffer->Allocate(mesh->vertices.size(), didVBResize, owner);
+
+#ifdef PACKED_VERTICES
+        quantizations[i]  = VertexQuantization::ComputeQuantizationParams(mesh->vertices);
+        packedVertices[i] = VertexQuantization::PackVertices(mesh->vertices, quantizations[i]);
+        vertexDatas.push_back(packedVertices[i].data());
+#else
+        vertexDatas.push_back(mesh->vertices.data());
+#endif
+
+        comp.vertexOffset = static_cast<uint32_t>(vertexSlot);
+        comp.vertexCount  = static_cast<uint32_t>(mesh->vertices.size());
 
-    m_indexBuffer->UploadData(indexSlot, mesh->indices.data());
+        // indices are relative to the mesh's vertexOffset so 16 bits are enough for meshes with less than 65535 vertices
+        // (0xFFFF is left out so it can't be mistaken for a primitive restart index)
+        comp.uses16BitIndices = mesh->vertices.size() < std::numeric_limits<uint16_t>::max();
 
-    comp.indexOffset = static_cast<uint32_t>(indexSlot);
-    comp.indexCount  = static_cast<uint32_t>(mesh->indices.size());
+        // the meshlet culling compacts the visible meshlets of LOD 0 right after the mesh's indices so they can be drawn with one draw
+        comp.meshletIndexCount = 0;
+        if(mesh->meshlets.size() >= MIN_MESHLETS_FOR_MESHLET_CULLING)
+        {
+            for(const Meshlet& meshlet : mesh->meshlets)
+                comp.meshletIndexCount += meshlet.indexCount;
+        }
+        const size_t indexCount = mesh->indices.size() + comp.meshletIndexCount;
+
+        if(comp.uses16BitIndices)
+        {
+            uint64_t indexSlot = m_indexBuffer16->Allocate(indexCount, didIB16Resize, owner);
+            indices16[i].assign(mesh->indices.begin(), mesh->indices.end());
+            indices16[i].resize(indexCount);
+            index16Datas.push_back(indices16[i].data());
+            comp.indexOffset = static_cast<uint32_t>(indexSlot);
+        }
+        else
+        {
+            uint64_t indexSlot = m_indexBuffer->Allocate(indexCount, didIBResize, owner);
+            if(comp.meshletIndexCount == 0)
+            {
+                indexDatas.push_back(mesh->indices.data());
+            }
+            else
+            {
+                meshletIndices[i].assign(mesh->indices.begin(), mesh->indices.end());
+                meshletIndices[i].resize(indexCount);
+                indexDatas.push_back(meshletIndices[i].data());
+            }
+            comp.indexOffset = static_cast<uint32_t>(indexSlot);
+        }
+        comp.indexCount = static_cast<uint32_t>(mesh->indices.size());
+    }
 
+    // a resize moves every allocation of the buffer, the meshes of this batch get their new offsets in comps and the older ones in their Renderable
+    // the draw buffers are uploaded again below either way
+    auto FindRenderable = [&](const VmaVirtualAllocationInfo& info) -> Renderable*
+    {
+        if(info.pUserData == nullptr)
+            return nullptr;
+        const size_t owner = reinterpret_cast<size_t>(info.pUserData) - 1;
+        if(owner >= firstOwner)
+            return &comps[owner - firstOwner];
+        Entity& entity = m_geometryOwners[owner];
+        return entity.IsAlive() ? entity.GetComponentMut<Renderable>() : nullptr;
+    };
     if(didVBResize)
     {
         for(const auto& [slot, info] : m_vertexBuffer->GetAllocationInfos())
         {
-            auto* renderable         = (Renderable*)info.pUserData;  // TODO
-            renderable->vertexOffset = static_cast<uint32_t>(slot);
+            if(Renderable* renderable = FindRenderable(info))
+                renderable->vertexOffset = static_cast<uint32_t>(slot);
         }
     }
-
-    if(didIBResize)
+    for(auto [indexBuffer, didResize] : {std::pair{m_indexBuffer.get(), didIBResize}, std::pair{m_indexBuffer16.get(), didIB16Resize}})
     {
-        for(const auto& [slot, info] : m_indexBuffer->GetAllocationInfos())
+        if(!didResize)
+            continue;
+
+        for(const auto& [slot, info] : indexBuffer->GetAllocationInfos())
         {
-            auto* renderable        = (Renderable*)info.pUserData;
-            renderable->indexOffset = static_cast<uint32_t>(slot);
+            if(Renderable* renderable = FindRenderable(info))
+                renderable->indexOffset = static_cast<uint32_t>(slot);
         }
     }
 
-    if(didVBResize || didIBResize)
+    // the slots are only read now, an allocation later in the loop could have resized the buffer
+    std::vector<uint64_t> vertexSlots;
+    std::vector<uint64_t> indexSlots;
+    std::vector<uint64_t> index16Slots;
+    for(const Renderable& comp : comps)
     {
-        // RecreateDrawBuffers();
+        vertexSlots.push_back(comp.vertexOffset);
+        (comp.uses16BitIndices ? index16Slots : indexSlots).push_back(comp.indexOffset);
     }
 
-    uint32_t slot          = 0;
-    auto* transformBuffers = m_ecs->GetSingletonMut<TransformBuffers>();
-    for(auto& buffer : transformBuffers->buffers)
+    m_vertexBuffer->UploadData(vertexSlots, vertexDatas);
+    if(!indexSlots.empty())
+        m_indexBuffer->UploadData(indexSlots, indexDatas);
+    if(!index16Slots.empty())
+        m_indexBuffer16->UploadData(index16Slots, index16Datas);
+
+    auto* transformBuffers   = m_resources.GetMut<TransformBuffers>();
+    auto* quantizationBuffer = m_resources.GetMut<VertexQuantizationBuffer>();
+
+    // the per object data is uploaded together after the loop as well
+    std::vector<uint64_t> quantizationSlots;
+    std::vector<const void*> quantizationDatas;
+    std::vector<GPUTransform> packedTransforms;
+    std::vector<uint64_t> transformSlots;
+    std::vector<const void*> transformDatas;
+    packedTransforms.reserve(entities.size());  // the datas point into it
+    for(size_t i = 0; i < entities.size(); ++i)
     {
-        slot = static_cast<uint32_t>(buffer.Allocate(1));
+        Entity& entity   = entities[i];
+        Renderable& comp = comps[i];
+
+        uint32_t slot = 0;
+        for(auto& buffer : transformBuffers->buffers)
+        {
+            slot = static_cast<uint32_t>(buffer.Allocate(1));
+        }
+        comp.objectID = slot;
+
+        // allocated in lockstep with the transform buffers so the slot is the objectID as well
+        uint64_t quantizationSlot = quantizationBuffer->buffer.Allocate(1);
+        assert(quantizationSlot == slot);
+        quantizationSlots.push_back(quantizationSlot);
+        quantizationDatas.push_back(&quantizations[i]);
+
+        entity.SetComponent<Renderable>(comp);
+
+        if(slot >= m_sceneProxies.size())
+        {
+            m_sceneProxies.resize(slot + 1, AABBTree::NULL_NODE);
+            m_renderableEntities.resize(slot + 1);
+        }
+        m_renderableEntities[slot] = entity;
+
+        // only the transforms that change later are uploaded by UpdateTransforms
+        const auto* box       = entity.GetComponent<BoundingBox>();
+        const auto* transform = entity.GetComponent<InternalTransform>();
+        if(transform != nullptr)
+        {
+            packedTransforms.push_back(PackTransform(transform->worldTransform));
+            transformSlots.push_back(slot);
+            transformDatas.push_back(&packedTransforms.back());
+        }
+        if(box != nullptr && transform != nullptr)
+        {
+            glm::vec3 min;
+            glm::vec3 max;
+            GetWorldBounds(*box, transform->worldTransform, min, max);
+            m_sceneProxies[slot] = m_sceneTree.CreateProxy(min, max, slot);
+            m_changedBounds.push_back({min, max, slot, false, entity.HasComponent<Static>()});
+        }
     }
-    comp.objectID = slot;
 
+    quantizationBuffer->buffer.UploadData(quantizationSlots, quantizationDatas);
+    if(!transformSlots.empty())
+    {
+        for(auto& buffer : transformBuffers->buffers)
+            buffer.UploadData(transformSlots, transformDatas);
+    }
     m_needDrawBufferReupload = true;
-
-    e.entity.SetComponent<Renderable>(comp);
 }
 
 void Renderer::OnMeshComponentRemoved(ComponentRemoved<Mesh> e)
 {
     // TODO remove the vertex and index buffers from the gpu
+    const auto* renderable = e.entity.IsAlive() ? e.entity.GetComponent<Renderable>() : nullptr;
+    if(renderable != nullptr && m_sceneProxies[renderable->objectID] != AABBTree::NULL_NODE)
+    {
+        m_sceneTree.DestroyProxy(m_sceneProxies[renderable->objectID]);
+        m_sceneProxies[renderable->objectID] = AABBTree::NULL_NODE;
+        m_changedBounds.push_back({glm::vec3(0.0f), glm::vec3(0.0f), renderable->objectID, true});
+    }
     e.entity.RemoveComponent<Renderable>();
 }
 
@@ -1732,7 +2639,7 @@ void Renderer::OnMaterialComponentAdded(ComponentAdded<Material> /*e*/)
 
 void Renderer::OnDirectionalLightAdded(ComponentAdded<DirectionalLight> e)
 {
-    auto* lightBuffers = m_ecs->GetSingletonMut<LightBuffers>();
+    auto* lightBuffers = m_resources.GetMut<LightBuffers>();
     ++lightBuffers->lightNum;
     uint32_t slot = 0;
     for(auto& buffer : lightBuffers->buffers)
@@ -1744,25 +2651,30 @@ void Renderer::OnDirectionalLightAdded(ComponentAdded<DirectionalLight> e)
     m_lightMap[slot] = {LightType::Directional};  // 0 = DirectionalLight
     Light* light     = &m_lightMap[slot];
 
-    auto* shadowBuffers   = m_ecs->GetSingletonMut<ShadowBuffers>();
+    auto* shadowBuffers   = m_resources.GetMut<ShadowBuffers>();
     uint32_t matricesSlot = 0;
     for(auto& buffer : shadowBuffers->matricesBuffers)
         matricesSlot = static_cast<uint32_t>(buffer.Allocate(1));  // slot should be the same for all of these, since we allocate to every buffer every time
 
     light->matricesSlot = matricesSlot;
 
-    for(auto& dict : m_changedLights)
+    m_dirtyLights.push_back(e.entity);
+
+    // the shadow culling has draw lists for the cascades of MAX_SHADOWED_DIRECTIONAL_LIGHTS lights, the others get no shadow map and the shader skips their shadows
+    if(m_shadowmaps.size() >= MAX_SHADOWED_DIRECTIONAL_LIGHTS)
     {
-        dict[slot] = light;
+        LOG_WARN("Only the first {} directional lights cast shadows", MAX_SHADOWED_DIRECTIONAL_LIGHTS);
+        comp->_shadowSlot = NO_SHADOW_SLOT;
+        light->shadowSlot = NO_SHADOW_SLOT;
+        return;
     }
 
-
     ImageCreateInfo ci;
     ci.format      = VK_FORMAT_D32_SFLOAT;
     ci.aspectFlags = VK_IMAGE_ASPECT_DEPTH_BIT;
     ci.layout      = VK_IMAGE_LAYOUT_ATTACHMENT_OPTIMAL;  // the render pass will transfer to good layout
     ci.useMips     = false;
-    ci.usage       = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    ci.usage       = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;  // the static cache is copied into it
     ci.layerCount  = NUM_CASCADES;
 
     slot              = static_cast<uint32_t>(m_shadowmaps.size());
@@ -1781,6 +2693,14 @@ void Renderer::OnDirectionalLightAdded(ComponentAdded<DirectionalLight> e)
 
     AddTexture(img, shadowSampler);
     m_renderGraph.GetTextureArrayResource("shadowMaps").AddImagePointer(img);
+
+    // only used by the ShadowPass so it stays in the general layout instead of being tracked by the render graph
+    ImageCreateInfo cacheCi = ci;
+    cacheCi.usage           = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    cacheCi.layout          = VK_IMAGE_LAYOUT_GENERAL;
+    cacheCi.debugName       = "staticShadowCache" + std::to_string(slot);
+    m_resources.GetMut<StaticShadowCache>()->images.emplace_back(std::make_unique<Image>(SHADOWMAP_SIZE, SHADOWMAP_SIZE, cacheCi));
+    m_cascadeCaches.emplace_back();
     for(auto& buffer : shadowBuffers->indicesBuffers)
     {
         uint64_t shadowSlot = buffer.Allocate(1);
@@ -1810,7 +2730,7 @@ void Renderer::OnDirectionalLightAdded(ComponentAdded<DirectionalLight> e)
 
 void Renderer::OnPointLightAdded(ComponentAdded<PointLight> e)
 {
-    auto* lightBuffers = m_ecs->GetSingletonMut<LightBuffers>();
+    auto* lightBuffers = m_resources.GetMut<LightBuffers>();
     ++lightBuffers->lightNum;
     uint32_t slot = 0;
     for(auto& buffer : lightBuffers->buffers)
@@ -1819,18 +2739,20 @@ void Renderer::OnPointLightAdded(ComponentAdded<PointLight> e)
     auto* comp  = e.entity.GetComponentMut<PointLight>();
     comp->_slot = slot;
 
+    if(slot >= m_lightEntities.size())
+        m_lightEntities.resize(slot + 1);
+    m_lightEntities[slot] = e.entity;
+
     m_lightMap[slot] = {LightType::Point};  // 1 = PointLight
-    Light* light     = &m_lightMap[slot];
 
-    for(auto& dict : m_changedLights)
-    {
-        dict[slot] = light;
-    }
+    comp->_shadowSlot = AddLocalShadow(slot);
+
+    m_dirtyLights.push_back(e.entity);
 }
 
 void Renderer::OnSpotLightAdded(ComponentAdded<SpotLight> e)
 {
-    auto* lightBuffers = m_ecs->GetSingletonMut<LightBuffers>();
+    auto* lightBuffers = m_resources.GetMut<LightBuffers>();
     ++lightBuffers->lightNum;
     uint32_t slot = 0;
     for(auto& buffer : lightBuffers->buffers)
@@ -1839,13 +2761,15 @@ void Renderer::OnSpotLightAdded(ComponentAdded<SpotLight> e)
     auto* comp  = e.entity.GetComponentMut<SpotLight>();
     comp->_slot = slot;
 
+    if(slot >= m_lightEntities.size())
+        m_lightEntities.resize(slot + 1);
+    m_lightEntities[slot] = e.entity;
+
     m_lightMap[slot] = {LightType::Spot};  // 2 = SpotLight
-    Light* light     = &m_lightMap[slot];
 
-    for(auto& dict : m_changedLights)
-    {
-        dict[slot] = light;
-    }
+    comp->_shadowSlot = AddLocalShadow(slot);
+
+    m_dirtyLights.push_back(e.entity);
 }
 
 
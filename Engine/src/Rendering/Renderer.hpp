@@ -7,15 +7,26 @@
 #include "ECS/CoreEvents/ComponentEvents.hpp"
 
 #include <vulkan/vulkan.h>
+#include <atomic>
 #include <vector>
 #include <memory>
+#include <mutex>
 #include <glm/glm.hpp>
 #include <set>
+#include <span>
 #include <list>
+#include <functional>
+#include <unordered_set>
 
 #include "Rendering/RenderGraph/RenderGraph.hpp"
+#include "Rendering/FrameSnapshot.hpp"
+#include "Rendering/LightGrid.hpp"
+#include "Rendering/RenderResources.hpp"
 #include "Rendering/Sampler.hpp"
+#include "Rendering/ShadowAtlas.hpp"
 #include "Utils/DebugUIElements.hpp"
+#include "Utils/Math/AABBTree.hpp"
+#include "Utils/Math/FrustumCuller.hpp"
 #include "Window.hpp"
 #include "CommandBuffer.hpp"
 #include "Buffer.hpp"
@@ -31,6 +42,31 @@
 #define MAX_SHADOW_DEPTH 1000
 #define NUM_CASCADES     4
 
+#define SHADOW_CASCADE_PADDING 0.1f  // fraction of its size the camera can move before a cascade (and its static shadow cache) has to follow it
+#define SHADOW_CASCADE_SHRINK  0.6f  // a cached cascade box is refit once the cascade needs less than this fraction of its width
+#define DEPTH_RANGE_PADDING    0.1f  // the read back depth range is a few frames old, it gets widened by this fraction on both ends
+
+#define MAX_SHADOWED_DIRECTIONAL_LIGHTS 4  // the directional lights added after these don't cast shadows, their shadowSlot is NO_SHADOW_SLOT
+#define MAX_SHADOW_DRAW_LISTS           (MAX_SHADOWED_DIRECTIONAL_LIGHTS * NUM_CASCADES)  // the shadow culling writes one draw list per cascade of the shadowed directional lights
+#define NO_SHADOW_SLOT                  UINT32_MAX  // has to match shaders/common.glsl
+
+#define CLUSTER_TILE_SIZE         64  // has to match shaders/common.glsl
+#define CLUSTER_SLICES            32  // same
+#define CLUSTER_BIN_TILES         4   // same, the lights are binned per 4x4 cluster tiles before the clusters are culled
+#define MAX_BIN_LIGHTS            1024  // same, the tiles of a fuller bin test every light
+#define CLUSTER_FAR_PLANE         1000.0f  // the last depth slice ends here, what is farther away uses it too
+#define MIN_CLUSTER_LIGHT_INDICES (1024 * 1024)  // uints, the cluster light index list starts at this size and grows when the clusters need more
+#define MIN_TILE_LIGHT_INDICES    (256 * 1024)   // same for the packed tiled light lists
+#define LIGHT_LIST_SHRINK_FRAMES  300            // frames a light list has to use less than a quarter of its room in a row before it shrinks
+
+#define SHADOW_ATLAS_SIZE          4096
+#define SHADOW_ATLAS_MIN_TILE_SIZE 128
+#define SHADOW_ATLAS_MAX_TILE_SIZE 1024  // per cube face for the point lights
+#define MAX_SHADOW_ATLAS_UPDATES   32    // tiles of the atlas that can be re-rendered in one frame, each one gets a shadow draw list after the ones of the cascades
+#define MAX_SHADOWED_LOCAL_LIGHTS  ((SHADOW_ATLAS_SIZE / SHADOW_ATLAS_MIN_TILE_SIZE) * (SHADOW_ATLAS_SIZE / SHADOW_ATLAS_MIN_TILE_SIZE))  // no more lights than this can have tiles at once
+
+#define LIGHT_GRID_CELL_SIZE 8.0f  // cells of the first level of the LightGrid
+
 class Pipeline;
 struct PipelineCreateInfo;
 struct TransformBuffers;
@@ -43,6 +79,10 @@ class SkyboxPass;
 class ShadowPass;
 class GTAOPass;
 class DenoisePass;
+class HiZPass;
+class DepthReductionPass;
+class ShadowCullPass;
+class ShadowAtlasPass;
 
 class Renderer
 {
@@ -54,7 +94,19 @@ public:
     Renderer& operator=(const Renderer&) = delete;
     Renderer& operator=(Renderer&&)      = delete;
     void InitilizeRenderGraph();
-    void Render(double dt);
+
+    // main thread, copies what changed in the ECS since the last call into the snapshot the next Render draws, takes the frame lock
+    FrameSnapshot ExtractFrame(double dt);
+    // draws a snapshot, on the render thread or inline on the main thread with a pipeline depth of 0
+    void Render(FrameSnapshot& frame);
+
+    // the main thread's event handlers change the state the render thread draws, they run while holding this
+    // the render thread holds it while it records and submits a frame, but not while it waits for the gpu or the swapchain
+    [[nodiscard]] std::unique_lock<std::mutex> LockFrame() { return std::unique_lock(m_frameMutex); }
+
+    // set by Render when the swapchain is out of date or suboptimal, the main thread recreates it once the render thread is idle
+    [[nodiscard]] bool IsSwapchainOutOfDate() const { return m_swapchainOutOfDate.load(); }
+    void RecreateSwapchain();  // main thread, polls the window until it isn't minimized
 
     void SetupEnvironmentMaps();
 
@@ -62,16 +114,34 @@ public:
 
     void AddDebugUIWindow(DebugUIWindow* window) { m_debugUI->AddWindow(window); };
     void AddDebugUIElement(const std::shared_ptr<DebugUIElement>& element) { m_rendererDebugWindow->AddElement(element); };
-    void AddShaderButton(std::string_view name) { m_shaderButtons.push_back(name); };
+    void AddShaderButton(std::string_view name)
+    {
+        // several pipelines can share a shader (one shadow pipeline per cascade)
+        if(std::find(m_shaderButtons.begin(), m_shaderButtons.end(), name) == m_shaderButtons.end())
+            m_shaderButtons.push_back(name);
+    };
 
     void AddDebugUIImage(const RenderingTextureResource& image)
     {
         m_uiImages.push_back(image);
     }
 
+    // point and spot lights whose range touches the world space box or sphere, directional lights light everything and are never returned
+    // these and the scene tree are the main thread's own copies, they only change in ExtractFrame and the event handlers so the systems can
+    // read them during Update (from any of its threads) without the frame lock
+    void QueryLights(const glm::vec3& min, const glm::vec3& max, std::vector<Entity>& lights) const;
+    void QueryLights(const glm::vec3& center, float radius, std::vector<Entity>& lights) const;
+
+    // world space bounds of the renderables as of the last ExtractFrame, the user data of the proxies is the objectID of the Renderable
+    const AABBTree& GetSceneTree() const { return m_sceneTree; }
+    // the same bounds without the fat margins, the indices of the boxes are the objectIDs
+    // only updated from the snapshots in Render, so unlike the rest it's read on the render thread and not from the main thread
+    const FrustumCuller& GetFrustumCuller() const { return m_frustumCuller; }
+    Entity GetRenderableEntity(uint32_t objectID) const { return m_renderableEntities[objectID]; }
+
     void OnSceneSwitched(SceneSwitchedEvent e);
 
-    void OnMeshComponentAdded(ComponentAdded<Mesh> e);
+    void OnMeshComponentsAdded(std::span<const ComponentAdded<Mesh>> events);  // all the meshes added during the frame, their geometry is uploaded together
     void OnMeshComponentRemoved(ComponentRemoved<Mesh> e);
     void OnMaterialComponentAdded(ComponentAdded<Material> e);
     void OnDirectionalLightAdded(ComponentAdded<DirectionalLight> e);
@@ -84,6 +154,14 @@ public:
     void RemoveStorageImage(Image* img);
 
     DynamicBufferAllocator& GetShaderDataBuffer() { return *m_shaderDataBuffer; }
+    // read and written by the meshlet culling, they move when they grow so get them every frame
+    uint64_t GetIndexBufferAddress() const { return m_indexBuffer->GetDeviceAddress(0); }
+    uint64_t GetIndexBuffer16Address() const { return m_indexBuffer16->GetDeviceAddress(0); }
+
+    // issues one indirect draw per index type batch written by the culling pass, binding the matching index buffer for each
+    // setObjectIDMap gets the address of the batch's object id map and has to push it to the shader (gl_DrawID restarts at 0 for each batch)
+    // list selects one of several draw lists stored in the same buffers (see DRAW_LIST_SIZE)
+    void DrawIndexedIndirectBatches(CommandBuffer& cb, const Buffer& drawBuffer, const Buffer& drawObjBuffer, const std::function<void(uint64_t)>& setObjectIDMap, uint32_t list = 0);
 
 private:
     struct Light
@@ -112,10 +190,18 @@ private:
         std::array<glm::vec2, NUM_CASCADES> zPlanes;
     };
 
-    struct TileLights
+    // shadow of a point or spot light in the shadow atlas, indexed by the light's shadow slot
+    struct LocalShadowData
     {
+        std::array<glm::mat4, 6> viewProj;    // one per cube face for point lights, spot lights only use the first one
+        std::array<glm::vec4, 6> atlasRects;  // xy = offset, z = size in atlas uv, z = 0 when the face has no shadow
+    };
+
+    // lights of one tile or cluster in a packed light index list
+    struct LightList
+    {
+        glm::uint offset;  // in indices, not in uints when the tiled list uses 16 bit indices
         glm::uint count;
-        glm::uint indices[1024];
     };
 
     struct PushConstants
@@ -133,14 +219,80 @@ private:
 
     std::unique_ptr<Pipeline> m_compute;
     std::unordered_map<uint32_t, Light> m_lightMap;
-    std::vector<std::unordered_map<uint32_t, Light*>> m_changedLights;
-    void UpdateLights(uint32_t index);
+    std::vector<Entity> m_dirtyLights;                  // lights that were set or moved since the last ExtractFrame, can hold the same light more than once
+    std::vector<uint32_t> m_pendingLights;              // slots of the lights that some of the per frame buffers don't have the latest data of
+    std::vector<uint32_t> m_pendingLightFrames;         // accessed with the light slot, one bit per frame buffer that still needs the light
+    std::vector<Entity> m_lightEntities;                // accessed with the light slot
+    LightGrid m_lightGrid{LIGHT_GRID_CELL_SIZE};        // range spheres of the point and spot lights, accessed with the light slot, updated in ExtractLights for QueryLights
+    LightGrid m_renderLightGrid{LIGHT_GRID_CELL_SIZE};  // the same from the snapshots, updated in ApplyLights for the shadow atlas on the render thread
+    std::vector<uint32_t> m_queriedLights;              // reused by UpdateShadowAtlas
+    void RegisterObservers();
+    void QueueLightUpload(uint32_t slot);
+    void ExtractLights(FrameSnapshot& frame);  // main thread, reads the dirty lights
+    void ApplyLights(const FrameSnapshot& frame);
+    void UpdateLights(uint32_t index);  // uploads the lights this frame's buffer is missing
     void UpdateLightMatrices(uint32_t index);
+    void ReadDepthRange(uint32_t index);  // reads back what the DepthReductionPass wrote the last time this frame was rendered
+    void ResizeLightLists(uint32_t index);  // before the frame is recorded, from what the LightCullPass asked for the last time this frame was rendered
+
+    // buffers that were replaced while frames in flight might still use them, freed once those are done
+    struct RetiredBuffer
+    {
+        Buffer buffer;
+        uint32_t framesLeft;
+    };
+    std::vector<RetiredBuffer> m_retiredBuffers;
+    void RetireBuffer(Buffer&& buffer);
+    void FreeRetiredBuffers();  // once per frame after its fence was waited on
+
+    AABBTree m_sceneTree;
+    std::vector<int32_t> m_sceneProxies;       // accessed with the objectID, AABBTree::NULL_NODE for renderables without a BoundingBox
+    std::vector<Entity> m_renderableEntities;  // accessed with the objectID
+    FrustumCuller m_frustumCuller;
+    FrustumCuller m_dynamicCasterCuller;  // the boxes of the renderables without the Static tag, only their cascades need the ShadowPass to draw over the static cache
+    std::vector<FrameSnapshot::BoundsUpdate> m_changedBounds;  // the meshes added and removed since the last ExtractFrame, in order
+    void ExtractTransforms(FrameSnapshot& frame);              // main thread, the world transforms the TransformSystem changed and their world bounds, moves them in the scene tree
+    void ApplyTransforms(const FrameSnapshot& frame);          // uploads the world transforms and applies the bounds to the frustum culler
 
     std::shared_ptr<Image> m_lightCullDebugImage;
 
     std::vector<std::unique_ptr<Image>> m_shadowmaps;
 
+    // light space boxes the cascades of a directional light are rendered with, they stay in place as long as the camera is inside of them
+    struct CascadeCache
+    {
+        glm::vec3 direction{0.0f};
+        std::array<glm::vec3, NUM_CASCADES> min{};
+        std::array<glm::vec3, NUM_CASCADES> max{};
+    };
+    std::vector<CascadeCache> m_cascadeCaches;  // accessed with the shadow slot
+
+    // tiles of the shadow atlas owned by a point or spot light
+    struct LocalShadow
+    {
+        uint32_t lightSlot = 0;
+        std::array<ShadowAtlas::Tile, 6> tiles{};
+        uint32_t tileSize     = 0;  // 0 when the light has no tiles
+        uint64_t lastUpdate   = 0;  // frame the tiles were last rendered in, 0 if they weren't since they were allocated
+        uint64_t lastSelected = 0;  // frame the light was last one of the shadow candidates
+
+        // the light when the tiles were last rendered
+        glm::vec3 position{0.0f};
+        glm::vec3 direction{0.0f};
+        float range  = 0.0f;
+        float cutoff = 0.0f;
+    };
+    ShadowAtlas m_shadowAtlas{SHADOW_ATLAS_SIZE, SHADOW_ATLAS_MIN_TILE_SIZE};
+    std::vector<LocalShadow> m_localShadows;                          // accessed with the shadow slot of the point and spot lights
+    std::vector<LocalShadowData> m_localShadowData;                   // same
+    std::vector<std::unordered_set<uint32_t>> m_changedLocalShadows;  // per frame, shadow slots whose LocalShadowData has to be uploaded
+    std::vector<uint32_t> m_tiledLocalShadows;                        // shadow slots that had tiles at the end of the last UpdateShadowAtlas
+    uint64_t m_shadowAtlasFrame = 0;
+    void UpdateShadowAtlas(uint32_t index);
+    bool AllocateLocalShadowTiles(uint32_t shadowSlot, uint32_t tileSize);
+    void FreeLocalShadowTiles(uint32_t shadowSlot);
+    uint32_t AddLocalShadow(uint32_t lightSlot);  // returns the shadow slot of the light
+
     friend class MaterialSystem;
 
     // vulkan initialization stuff
@@ -156,7 +308,6 @@ private:
     void CreateCommandBuffers();
     void CreateSyncObjects();
 
-    void RecreateSwapchain();
     void CleanupSwapchain();
 
 
@@ -183,6 +334,10 @@ private:
     std::shared_ptr<Window> m_window;
 
     std::shared_ptr<DebugUI> m_debugUI;
+    std::shared_ptr<DebugUIFrame> m_debugUIFrame;  // the debug ui of the frame that is being recorded
+
+    std::mutex m_frameMutex;
+    std::atomic<bool> m_swapchainOutOfDate = false;
 
     std::vector<VkQueryPool> m_queryPools;
     std::vector<uint64_t> m_queryResults;
@@ -229,17 +384,21 @@ private:
 
     std::unique_ptr<DebugUIWindow> m_rendererDebugWindow;
 
+    RenderResources m_resources;  // the passes keep a pointer to it
     RenderGraph m_renderGraph;
 
     std::unordered_map<SamplerConfig, Sampler> m_samplers;
 
     std::unique_ptr<DynamicBufferAllocator> m_vertexBuffer;
     std::unique_ptr<DynamicBufferAllocator> m_indexBuffer;
+    std::unique_ptr<DynamicBufferAllocator> m_indexBuffer16;
+    std::vector<Entity> m_geometryOwners;  // the entity of each mesh in the vertex and index buffers, the user data of their allocations is the index in here + 1
 
     std::unique_ptr<DynamicBufferAllocator> m_shaderDataBuffer;
 
     // TODO temp
     bool m_needDrawBufferReupload = false;
+    bool m_useMeshletCulling      = true;  // otherwise every renderable is culled and drawn as a whole
 
 
     std::list<int32_t> m_freeTextureSlots;  // i think having it sorted will be better for the gpu so the descriptor set doesnt get so fragmented
@@ -254,12 +413,16 @@ private:
     // Renderpasses
     std::unique_ptr<DepthPass> m_depthPass;
     std::unique_ptr<DrawcullPass> m_drawCullPass;
+    std::unique_ptr<ShadowCullPass> m_shadowCullPass;
     std::unique_ptr<ShadowPass> m_shadowPass;
+    std::unique_ptr<ShadowAtlasPass> m_shadowAtlasPass;
     std::unique_ptr<LightCullPass> m_lightCullPass;
     std::unique_ptr<LightingPass> m_lightingPass;
     std::unique_ptr<SkyboxPass> m_skyboxPass;
     std::unique_ptr<GTAOPass> m_gtaoPass;
     std::unique_ptr<DenoisePass> m_denoisePass;
+    std::unique_ptr<HiZPass> m_hizPass;
+    std::unique_ptr<DepthReductionPass> m_depthReductionPass;
 
     std::vector<RenderingTextureResource> m_uiImages;
     std::vector<std::string_view> m_shaderButtons;
@@ -268,10 +431,5 @@ private:
     RenderingTextureArrayResource* m_shadowMaps{nullptr};
 
     // ECS queries
-    Query<const InternalTransform, const Renderable, TransformBuffers> m_transformsQuery;
-    Query<const Renderable, const BoundingBox> m_renderablesQuery;
-
-    Query<const DirectionalLight, const InternalTransform> m_directionalLightsQuery;
-    Query<const PointLight, const InternalTransform> m_pointLightsQuery;
-    Query<const SpotLight, const InternalTransform> m_spotLightsQuery;
+    Query<const Renderable, const BoundingBox, const Mesh> m_renderablesQuery;
 };
@@ -42,50 +42,43 @@ public:
     }
 };
 
-
-Shader::Shader(const std::string& filename, VkShaderStageFlagBits stage, Pipeline* pipeline)
+// the vertex input format is derived from the type declared in the shader
+// integer inputs are used for packed data (see shaders/vertex.glsl) that is decoded in the shader, so they are fetched as is
+static VkFormat GetVertexInputFormat(const spirv_cross::SPIRType& type)
 {
-    std::vector<uint32_t> data;
+    constexpr std::array<VkFormat, 4> floatFormats = {VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT};
+    constexpr std::array<VkFormat, 4> uintFormats  = {VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32A32_UINT};
+    constexpr std::array<VkFormat, 4> intFormats   = {VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT, VK_FORMAT_R32G32B32_SINT, VK_FORMAT_R32G32B32A32_SINT};
+
+    if(type.width != 32 || type.vecsize < 1 || type.vecsize > 4 || type.columns != 1)
     {
-        std::filesystem::path path;
+        LOG_ERROR("Unsupported vertex input type (width: {0}, vecsize: {1}, columns: {2})", type.width, type.vecsize, type.columns);
+        return VK_FORMAT_UNDEFINED;
+    }
 
-        switch(stage)
-        {
-        case VK_SHADER_STAGE_VERTEX_BIT:
-            path = "./shaders/" + filename + ".vert";
-            break;
-        case VK_SHADER_STAGE_FRAGMENT_BIT:
-            path = "./shaders/" + (filename + ".frag");
-            break;
-        case VK_SHADER_STAGE_COMPUTE_BIT:
-            path = "./shaders/" + (filename + ".comp");
-            break;
-        default:
-            LOG_ERROR("Shader stage not supported for shader: {0}", filename);
-            break;
-        }
-        m_stage = stage;
-
-        LOG_TRACE("");
-        LOG_TRACE("Loading {0}", path);
-
-        // TODO make this work better(not hardcodign file path)
-        // std::ifstream file(path.c_str(), std::ios::ate | std::ios::binary);
-        // if(!file.is_open())
-        //     throw std::runtime_error("Failed to open file " + filename);
-        //
-        // std::vector<char> temp;
-        // size_t filesize = (size_t)file.tellg();
-        // temp.resize(filesize);
-        // file.seekg(0, std::ios::beg);
-        // file.read(temp.data(), filesize);
-        // file.close();
-
-        // TODO figure out how to do this better
-        // data = std::vector<uint32_t>(reinterpret_cast<uint32_t*>(temp.data()), reinterpret_cast<uint32_t*>(temp.data()) + filesize / sizeof(uint32_t));
-        data = Compile(path);  // TODO: fall back to loading from file if compilation fails
+    switch(type.basetype)
+    {
+    case spirv_cross::SPIRType::Float:
+        return floatFormats[type.vecsize - 1];
+    case spirv_cross::SPIRType::UInt:
+        return uintFormats[type.vecsize - 1];
+    case spirv_cross::SPIRType::Int:
+        return intFormats[type.vecsize - 1];
+    default:
+        LOG_ERROR("Unsupported vertex input base type");
+        return VK_FORMAT_UNDEFINED;
     }
+}
+
 
+Shader::Shader(const std::string& filename, VkShaderStageFlagBits stage, Pipeline* pipeline)
+    : Shader(filename, stage, Compile(filename, stage), pipeline)
+{
+}
+
+Shader::Shader(const std::string& filename, VkShaderStageFlagBits stage, std::vector<uint32_t> data, Pipeline* pipeline)
+    : m_stage(stage)
+{
     Reflect(filename, &data, pipeline);
 
     VkShaderModuleCreateInfo createInfo = {};
@@ -96,8 +89,33 @@ Shader::Shader(const std::string& filename, VkShaderStageFlagBits stage, Pipelin
     VK_CHECK(vkCreateShaderModule(VulkanContext::GetDevice(), &createInfo, nullptr, &m_shaderModule), "Failed to create shader module");
 }
 
-std::vector<uint32_t> Shader::Compile(const std::filesystem::path& path)
+std::vector<uint32_t> Shader::Compile(const std::string& filename, VkShaderStageFlagBits stage)
 {
+    std::filesystem::path path;
+    shaderc_shader_kind kind;
+    switch(stage)
+    {
+    case VK_SHADER_STAGE_VERTEX_BIT:
+        path = "./shaders/" + filename + ".vert";
+        kind = shaderc_glsl_vertex_shader;
+        break;
+    case VK_SHADER_STAGE_FRAGMENT_BIT:
+        path = "./shaders/" + (filename + ".frag");
+        kind = shaderc_glsl_fragment_shader;
+        break;
+    case VK_SHADER_STAGE_COMPUTE_BIT:
+        path = "./shaders/" + (filename + ".comp");
+        kind = shaderc_glsl_compute_shader;
+        break;
+    default:
+        LOG_ERROR("Shader stage not supported for shader: {0}", filename);
+        return {};
+    }
+
+    LOG_TRACE("");
+    LOG_TRACE("Loading {0}", path);
+
+    // TODO: fall back to loading the .spv from file if compilation fails
     shaderc::Compiler compiler;
     shaderc::CompileOptions options;
 
@@ -107,24 +125,18 @@ std::vector<uint32_t> Shader::Compile(const std::filesystem::path& path)
 #ifdef VDEBUG
     options.SetGenerateDebugInfo();
 #endif
+#ifdef PACKED_VERTICES
+    options.AddMacroDefinition("PACKED_VERTICES");
+#endif
+#if defined(AFFINE_TRANSFORMS)
+    options.AddMacroDefinition("AFFINE_TRANSFORMS");
+#elif defined(RIGID_TRANSFORMS)
+    options.AddMacroDefinition("RIGID_TRANSFORMS");
+#endif
 
 
     auto shaderName = path.filename().string();
 
-    shaderc_shader_kind kind = shaderc_glsl_infer_from_source;
-    if(m_stage == VK_SHADER_STAGE_VERTEX_BIT)
-        kind = shaderc_glsl_vertex_shader;
-    else if(m_stage == VK_SHADER_STAGE_FRAGMENT_BIT)
-        kind = shaderc_glsl_fragment_shader;
-    else if(m_stage == VK_SHADER_STAGE_COMPUTE_BIT)
-        kind = shaderc_glsl_compute_shader;
-    else
-    {
-        LOG_ERROR("Shader stage not supported for shader: {0}", shaderName);
-        return {};
-    }
-
-
     // read file into string
     std::ifstream file(path);
     if(!file.is_open())
@@ -176,21 +188,7 @@ void Shader::Reflect(const std::string& /*filename*/, std::vector<uint32_t>* dat
             VkVertexInputAttributeDescription attribDescription = {};
             attribDescription.binding                           = 0;  // only support one binding for now
             attribDescription.location                          = location;
-            switch(size)
-            {
-            case 4:
-                attribDescription.format = VK_FORMAT_R32_SFLOAT;
-                break;
-            case 8:
-                attribDescription.format = VK_FORMAT_R32G32_SFLOAT;
-                break;
-            case 12:
-                attribDescription.format = VK_FORMAT_R32G32B32_SFLOAT;
-                break;
-            case 16:
-                attribDescription.format = VK_FORMAT_R32G32B32A32_SFLOAT;
-                break;
-            }
+            attribDescription.format                            = GetVertexInputFormat(type);
             // attribDescription.offset = offset; offset is always zero for some reason
             // so we store them in a vector and do another pass to calculate the offsets
             attributeDescriptions[location] = {attribDescription, size};
@@ -11,6 +11,8 @@ class Shader
 {
 public:
     Shader(const std::string& filename, VkShaderStageFlagBits stage, Pipeline* pipeline);
+    // from SPIR-V compiled beforehand with Compile, only the reflection and the module creation are left
+    Shader(const std::string& filename, VkShaderStageFlagBits stage, std::vector<uint32_t> data, Pipeline* pipeline);
     ~Shader()
     {
         DestroyShaderModule();
@@ -41,7 +43,9 @@ private:
     friend class Renderer;
     friend class Pipeline;
 
-    std::vector<uint32_t> Compile(const std::filesystem::path& path);
+    // reads ./shaders/<filename>.<stage> and compiles it to SPIR-V, empty on failure
+    // touches no shared state so the stages of a pipeline can be compiled on the job system at the same time
+    static std::vector<uint32_t> Compile(const std::string& filename, VkShaderStageFlagBits stage);
 
     void Reflect(const std::string& filename, std::vector<uint32_t>* data, Pipeline* pipeline);
 
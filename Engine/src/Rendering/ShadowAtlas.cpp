@@ -0,0 +1,106 @@
+#include "Rendering/ShadowAtlas.hpp"
+
+#include <algorithm>
+#include <array>
+#include <functional>
+
+ShadowAtlas::ShadowAtlas(uint32_t size, uint32_t minTileSize)
+    : m_size(size)
+{
+    assert(size >= minTileSize && minTileSize > 0);
+    assert((size & (size - 1)) == 0 && (minTileSize & (minTileSize - 1)) == 0);
+
+    uint32_t levels = 1;
+    while((size >> levels) >= minTileSize)
+        ++levels;
+
+    m_freeTiles.resize(levels);
+    m_freeTiles[0].emplace_back(0, 0);
+}
+
+uint32_t ShadowAtlas::GetLevel(uint32_t tileSize) const
+{
+    // the smallest tile that is at least tileSize big
+    uint32_t level = 0;
+    while(level + 1 < m_freeTiles.size() && (m_size >> (level + 1)) >= tileSize)
+        ++level;
+    return level;
+}
+
+bool ShadowAtlas::AllocateAtLevel(uint32_t level, glm::uvec2& offset)
+{
+    auto& freeTiles = m_freeTiles[level];
+    if(!freeTiles.empty())
+    {
+        offset = freeTiles.back();
+        freeTiles.pop_back();
+        return true;
+    }
+    if(level == 0)
+        return false;
+
+    // split a tile of the level above, we keep the top left quarter and the 3 others become free
+    glm::uvec2 parent;
+    if(!AllocateAtLevel(level - 1, parent))
+        return false;
+
+    const uint32_t size = m_size >> level;
+    freeTiles.emplace_back(parent.x + size, parent.y);
+    freeTiles.emplace_back(parent.x, parent.y + size);
+    freeTiles.emplace_back(parent.x + size, parent.y + size);
+    offset = parent;
+    return true;
+}
+
+ShadowAtlas::Tile ShadowAtlas::Allocate(uint32_t tileSize)
+{
+    const uint32_t level = GetLevel(tileSize);
+
+    Tile tile;
+    if(AllocateAtLevel(level, tile.offset))
+        tile.size = m_size >> level;
+    return tile;
+}
+
+void ShadowAtlas::Free(const Tile& tile)
+{
+    if(!tile.IsValid())
+        return;
+
+    uint32_t level    = GetLevel(tile.size);
+    glm::uvec2 offset = tile.offset;
+    while(level > 0)
+    {
+        // merge with the 3 other quarters of the parent if they are all free
+        const uint32_t size     = m_size >> level;
+        const glm::uvec2 parent = (offset / (2 * size)) * (2 * size);
+        auto& freeTiles         = m_freeTiles[level];
+        std::array<size_t, 3> siblings{};
+        uint32_t foundSiblings = 0;
+        for(uint32_t i = 0; i < 4; ++i)
+        {
+            const glm::uvec2 sibling = parent + glm::uvec2(i & 1, i >> 1) * size;
+            if(sibling == offset)
+                continue;
+
+            auto it = std::find(freeTiles.begin(), freeTiles.end(), sibling);
+            if(it == freeTiles.end())
+                break;
+            siblings[foundSiblings++] = static_cast<size_t>(it - freeTiles.begin());
+        }
+        if(foundSiblings != 3)
+            break;
+
+        // erase from the back so the other indices stay valid
+        std::sort(siblings.begin(), siblings.end(), std::greater<>());
+        for(size_t index : siblings)
+        {
+            freeTiles[index] = freeTiles.back();
+            freeTiles.pop_back();
+        }
+
+        offset = parent;
+        --level;
+    }
+    m_freeTiles[level].push_back(offset);
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+// Hands out square power of two tiles of one big shadow map, used for the point and spot light shadows
+// Works like a quadtree: a tile that is too big gets split in 4 and 4 free siblings get merged back into their parent
+class ShadowAtlas
+{
+public:
+    struct Tile
+    {
+        glm::uvec2 offset{0};  // in texels
+        uint32_t size = 0;     // 0 if the tile isn't allocated
+
+        [[nodiscard]] bool IsValid() const { return size != 0; }
+    };
+
+    ShadowAtlas(uint32_t size, uint32_t minTileSize);
+
+    // tileSize is rounded up to a power of two and clamped between minTileSize and the size of the atlas
+    // returns an invalid tile if there is no free space left for this size
+    Tile Allocate(uint32_t tileSize);
+    void Free(const Tile& tile);
+
+    [[nodiscard]] uint32_t GetSize() const { return m_size; }
+    [[nodiscard]] uint32_t GetMinTileSize() const { return m_size >> (m_freeTiles.size() - 1); }
+
+private:
+    [[nodiscard]] uint32_t GetLevel(uint32_t tileSize) const;  // 0 is the whole atlas
+    bool AllocateAtLevel(uint32_t level, glm::uvec2& offset);
+
+    uint32_t m_size;
+    std::vector<std::vector<glm::uvec2>> m_freeTiles;  // offsets of the free tiles of every level
+};
@@ -10,9 +10,26 @@
 #include "ECS/CoreComponents/Mesh.hpp"
 #include "Rendering/TextureManager.hpp"
 #include "ECS/CoreComponents/Material.hpp"
+#include "Utils/MeshOptimizer.hpp"
+#include "Utils/MeshletBuilder.hpp"
+#include "Utils/MeshSimplifier.hpp"
+#include "Core/Jobs/JobSystem.hpp"
 
 Assimp::Importer AssimpImporter::s_importer = {};
 
+glm::vec3 ToGLM(const aiVector3D& v) { return {v.x, v.y, v.z}; }
+glm::vec2 ToGLM(const aiVector2D& v) { return {v.x, v.y}; }
+glm::quat ToGLM(const aiQuaternion& q) { return {q.w, q.x, q.y, q.z}; }
+
+Transform NodeTransform(const aiNode* node)
+{
+    aiVector3D pos;
+    aiVector3D scale;
+    aiQuaternion rot;
+    node->mTransformation.Decompose(scale, rot, pos);
+    return {ToGLM(pos), ToGLM(rot), ToGLM(scale)};
+}
+
 Entity AssimpImporter::LoadFile(const std::string& file, ECS* ecs, Entity* parent)
 {
     auto* assimpLogger = Assimp::DefaultLogger::create("DebugTools/AssimpLogger.txt", Assimp::Logger::VERBOSE);
@@ -31,9 +48,22 @@ Entity AssimpImporter::LoadFile(const std::string& file, ECS* ecs, Entity* paren
         LOG_ERROR(s_importer.GetErrorString());
         return {flecs::entity::null()};  // invalid entity
     }
+
+    // converting and optimizing the meshes is most of the import and they are independent, one job each since their sizes vary a lot
+    // the entities and the textures are created on this thread afterwards
+    std::vector<ImportedMesh> meshes(scene->mNumMeshes);
+    {
+        PROFILE_SCOPE("Process meshes");
+        JobCounter counter;
+        for(uint32_t i = 0; i < scene->mNumMeshes; ++i)
+            JobSystem::Run([&meshes, scene, i]() { meshes[i] = ProcessMesh(scene->mMeshes[i]); }, &counter);
+        JobSystem::Wait(counter);
+    }
+
     Entity rootEntity = parent ? ecs->CreateChildEntity(parent, scene->mRootNode->mName.C_Str()) : ecs->CreateEntity(scene->mRootNode->mName.C_Str());
+    rootEntity.SetComponent<Transform>(NodeTransform(scene->mRootNode));
 
-    ProcessNode(scene->mRootNode, scene, ecs, rootEntity);
+    ProcessNode(scene->mRootNode, scene, meshes, ecs, rootEntity);
     LOG_TRACE("Loaded {0}", file);
 
     Assimp::DefaultLogger::kill();
@@ -41,43 +71,43 @@ Entity AssimpImporter::LoadFile(const std::string& file, ECS* ecs, Entity* paren
     return rootEntity;
 }
 
-glm::vec3 ToGLM(const aiVector3D& v) { return {v.x, v.y, v.z}; }
-glm::vec2 ToGLM(const aiVector2D& v) { return {v.x, v.y}; }
-glm::quat ToGLM(const aiQuaternion& q) { return {q.w, q.x, q.y, q.z}; }
-
-void AssimpImporter::ProcessNode(const aiNode* node, const aiScene* scene, ECS* ecs, Entity entity)
+// the children of a node are created together with ECS::CreateChildEntities, entity already has the node's transform
+void AssimpImporter::ProcessNode(const aiNode* node, const aiScene* scene, const std::vector<ImportedMesh>& meshes, ECS* ecs, Entity entity)
 {
-    aiVector3D pos;
-    aiVector3D scale;
-    aiQuaternion rot;
-    node->mTransformation.Decompose(scale, rot, pos);
-
-    auto tpos   = ToGLM(pos);
-    auto trot   = ToGLM(rot);
-    auto tscale = ToGLM(scale);
-    entity.SetComponent<Transform>({tpos, trot, tscale});
-
     if(node->mNumMeshes == 1)
     {
-        LoadMesh(scene->mMeshes[node->mMeshes[0]], scene, entity);
+        LoadMesh(node->mMeshes[0], scene, meshes, entity);
     }
-    else
+    else if(node->mNumMeshes > 1)
     {
+        std::vector<std::string> names(node->mNumMeshes);
         for(uint32_t i = 0; i < node->mNumMeshes; ++i)
-        {
-            auto name = scene->mMeshes[node->mMeshes[i]]->mName.length == 0 ? std::string(node->mName.C_Str()) + std::to_string(i) : scene->mMeshes[node->mMeshes[i]]->mName.C_Str();
-            LoadMesh(scene->mMeshes[node->mMeshes[i]], scene, ecs->CreateChildEntity(&entity, name));
-        }
+            names[i] = scene->mMeshes[node->mMeshes[i]]->mName.length == 0 ? std::string(node->mName.C_Str()) + std::to_string(i) : scene->mMeshes[node->mMeshes[i]]->mName.C_Str();
+
+        const std::vector<Transform> transforms(node->mNumMeshes);
+        std::vector<Entity> meshEntities = ecs->CreateChildEntities(&entity, transforms, names);
+        for(uint32_t i = 0; i < node->mNumMeshes; ++i)
+            LoadMesh(node->mMeshes[i], scene, meshes, meshEntities[i]);
     }
 
+    if(node->mNumChildren == 0)
+        return;
+
+    std::vector<Transform> transforms(node->mNumChildren);
+    std::vector<std::string> names(node->mNumChildren);
     for(uint32_t i = 0; i < node->mNumChildren; ++i)
     {
-        ProcessNode(node->mChildren[i], scene, ecs, ecs->CreateChildEntity(&entity, node->mChildren[i]->mName.C_Str()));
+        transforms[i] = NodeTransform(node->mChildren[i]);
+        names[i]      = node->mChildren[i]->mName.C_Str();
     }
+    std::vector<Entity> children = ecs->CreateChildEntities(&entity, transforms, names);
+    for(uint32_t i = 0; i < node->mNumChildren; ++i)
+        ProcessNode(node->mChildren[i], scene, meshes, ecs, children[i]);
 }
 
-void AssimpImporter::LoadMesh(const aiMesh* mesh, const aiScene* scene, Entity entity)
+AssimpImporter::ImportedMesh AssimpImporter::ProcessMesh(const aiMesh* mesh)
 {
+    PROFILE_FUNCTION();
     std::vector<Vertex> vertices;
     vertices.resize(mesh->mNumVertices);
     std::vector<uint32_t> indices;
@@ -111,6 +141,35 @@ void AssimpImporter::LoadMesh(const aiMesh* mesh, const aiScene* scene, Entity e
         }
     }
 
+    // the optimizer only deals with triangle lists, the preset's sort by primitive type makes sure meshes aren't mixed
+    std::vector<Meshlet> meshlets;
+    std::vector<MeshLod> lods;
+    if(mesh->mPrimitiveTypes == aiPrimitiveType_TRIANGLE)
+    {
+        auto report = MeshOptimizer::OptimizeMesh(vertices, indices);
+        LOG_TRACE("Optimized mesh {0}: ACMR {1:.3f} -> {2:.3f}, ATVR {3:.3f} -> {4:.3f}, overfetch {5:.3f} -> {6:.3f}",
+                  mesh->mName.C_Str(),
+                  report.cacheBefore.acmr, report.cacheAfter.acmr,
+                  report.cacheBefore.atvr, report.cacheAfter.atvr,
+                  report.fetchBefore.overfetch, report.fetchAfter.overfetch);
+
+        // building the meshlets moves triangles around a bit so the vertices are reordered again to match, it doesn't touch the meshlet ranges
+        meshlets = MeshletBuilder::BuildMeshlets(indices, vertices);
+        MeshOptimizer::OptimizeVertexFetch(vertices, indices);
+
+        // the LODs are appended after the full detail indices and reuse its vertices so they have to come last
+        lods = MeshSimplifier::GenerateLods(indices, vertices);
+        LOG_TRACE("Generated {0} LODs for mesh {1}, last one has {2} triangles (error {3:.4f})", lods.size(), mesh->mName.C_Str(), lods.back().indexCount / 3, lods.back().error);
+    }
+
+    return {std::move(vertices), std::move(indices), std::move(meshlets), std::move(lods)};
+}
+
+void AssimpImporter::LoadMesh(uint32_t meshIndex, const aiScene* scene, const std::vector<ImportedMesh>& meshes, Entity entity)
+{
+    const aiMesh* mesh            = scene->mMeshes[meshIndex];
+    const ImportedMesh& processed = meshes[meshIndex];
+
     Material mat{};
     mat.shaderName    = "forwardplus";
     aiMaterial* aiMat = scene->mMaterials[mesh->mMaterialIndex];
@@ -160,7 +219,11 @@ void AssimpImporter::LoadMesh(const aiMesh* mesh, const aiScene* scene, Entity e
         mat.textures["metallic"] = texturePath;
     }
 
-    entity.EmplaceComponent<Mesh>(vertices, indices);
+    // a mesh used by several nodes is copied for each of them
+    Mesh newMesh(processed.vertices, processed.indices);
+    newMesh.meshlets = processed.meshlets;
+    newMesh.lods     = processed.lods;
+    entity.EmplaceComponent<Mesh>(std::move(newMesh));
     entity.EmplaceComponent<BoundingBox>(ToGLM(mesh->mAABB.mMin), ToGLM(mesh->mAABB.mMax));
     entity.SetComponent<Material>(mat);
 }
@@ -7,17 +7,27 @@
 
 #include "ECS/Core.hpp"
 #include "ECS/Entity.hpp"
+#include "ECS/CoreComponents/Mesh.hpp"
 
-struct Vertex;
-struct Mesh;
 class AssimpImporter
 {
 public:
     static Entity LoadFile(const std::string& file, ECS* ecs, Entity* parent = nullptr);
 
 private:
-    static void ProcessNode(const aiNode* node, const aiScene* scene, ECS* ecs, Entity entity);
-    static void LoadMesh(const aiMesh* mesh, const aiScene* scene, Entity entity);
+    // the geometry of an aiMesh ready for the Mesh component
+    struct ImportedMesh
+    {
+        std::vector<Vertex> vertices;
+        std::vector<uint32_t> indices;
+        std::vector<Meshlet> meshlets;
+        std::vector<MeshLod> lods;
+    };
+
+    static void ProcessNode(const aiNode* node, const aiScene* scene, const std::vector<ImportedMesh>& meshes, ECS* ecs, Entity entity);
+    // thread safe, doesn't touch the ECS or the TextureManager
+    static ImportedMesh ProcessMesh(const aiMesh* mesh);
+    static void LoadMesh(uint32_t meshIndex, const aiScene* scene, const std::vector<ImportedMesh>& meshes, Entity entity);
 
     static Assimp::Importer s_importer;
 };
@@ -90,7 +90,13 @@ void DebugUI::ReInit(DebugUIInitInfo initInfo)
     cb.SubmitIdle();
     ImGui_ImplVulkan_DestroyFontUploadObjects();
 }
-void DebugUI::Draw(CommandBuffer* cb)
+DebugUIFrame::~DebugUIFrame()
+{
+    for(ImDrawList* list : drawData.CmdLists)
+        IM_DELETE(list);
+}
+
+std::shared_ptr<DebugUIFrame> DebugUI::BuildFrame()
 {
     ImGui_ImplVulkan_NewFrame();
     ImGui_ImplGlfw_NewFrame();
@@ -104,7 +110,16 @@ void DebugUI::Draw(CommandBuffer* cb)
 
     ImGui::Render();
 
+    auto frame            = std::make_shared<DebugUIFrame>();
+    const ImDrawData* src = ImGui::GetDrawData();
+    frame->drawData       = *src;
+    for(ImDrawList*& list : frame->drawData.CmdLists)
+        list = list->CloneOutput();
+    return frame;
+}
 
+void DebugUI::Draw(CommandBuffer* cb, const DebugUIFrame& frame)
+{
     /*VkCommandBufferInheritanceInfo inheritanceInfo = {};
     inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
     inheritanceInfo.renderPass = renderPass->GetRenderPass();
@@ -114,7 +129,7 @@ void DebugUI::Draw(CommandBuffer* cb)
     m_commandBuffers[imageIndex]->Begin(VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT, inheritanceInfo);
     ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), GetCommandBuffer(imageIndex));
     m_commandBuffers[imageIndex]->End();*/
-    ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), cb->GetCommandBuffer());
+    ImGui_ImplVulkan_RenderDrawData(const_cast<ImDrawData*>(&frame.drawData), cb->GetCommandBuffer());
 }
 
 void DebugUI::AddWindow(DebugUIWindow* window)
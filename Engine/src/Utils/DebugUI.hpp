@@ -21,12 +21,26 @@ struct DebugUIInitInfo
     const VkAllocationCallbacks* allocator = nullptr;
 };
 
+// ImGui reuses its draw lists every frame, this keeps a copy of one frame's so the render thread can draw it while the next one is built
+struct DebugUIFrame
+{
+    ImDrawData drawData;
+
+    DebugUIFrame() = default;
+    ~DebugUIFrame();
+
+    DebugUIFrame(const DebugUIFrame&)            = delete;
+    DebugUIFrame& operator=(const DebugUIFrame&) = delete;
+};
+
 class DebugUI
 {
 public:
     DebugUI(DebugUIInitInfo initInfo);
     ~DebugUI();
-    void Draw(CommandBuffer* cb /*uint32_t imageIndex, uint32_t subpass, RenderPass* renderPass*/);
+    // runs the windows and copies what they drew, on the main thread because the windows touch the ECS and the window
+    std::shared_ptr<DebugUIFrame> BuildFrame();
+    static void Draw(CommandBuffer* cb, const DebugUIFrame& frame /*uint32_t imageIndex, uint32_t subpass, RenderPass* renderPass*/);
     // VkCommandBuffer GetCommandBuffer(uint32_t index) { return m_commandBuffers[index]->GetCommandBuffer(); };
     void SetMinImageCount(VkPresentModeKHR presentMode) { ImGui_ImplVulkan_SetMinImageCount(ImGui_ImplVulkanH_GetMinImageCountFromPresentMode(presentMode)); };
     void ReInit(DebugUIInitInfo initInfo);
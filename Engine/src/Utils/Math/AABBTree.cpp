@@ -0,0 +1,230 @@
+#include "Utils/Math/AABBTree.hpp"
+
+int32_t AABBTree::AllocateNode()
+{
+    if(m_freeList == NULL_NODE)
+    {
+        m_nodes.emplace_back().height = 0;
+        return static_cast<int32_t>(m_nodes.size() - 1);
+    }
+
+    const int32_t node   = m_freeList;
+    m_freeList           = m_nodes[node].parent;
+    m_nodes[node]        = {};
+    m_nodes[node].height = 0;
+    return node;
+}
+
+void AABBTree::FreeNode(int32_t node)
+{
+    m_nodes[node].parent = m_freeList;
+    m_nodes[node].height = -1;
+    m_freeList           = node;
+}
+
+float AABBTree::SurfaceArea(const glm::vec3& min, const glm::vec3& max)
+{
+    const glm::vec3 d = max - min;
+    return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+int32_t AABBTree::CreateProxy(const glm::vec3& min, const glm::vec3& max, uint64_t userData)
+{
+    const int32_t proxy    = AllocateNode();
+    const glm::vec3 margin = (max - min) * FAT_MARGIN + MIN_FAT_MARGIN;
+
+    Node& node    = m_nodes[proxy];
+    node.min      = glm::vec4(min - margin, 0.0f);
+    node.max      = glm::vec4(max + margin, 0.0f);
+    node.userData = userData;
+
+    InsertLeaf(proxy);
+    ++m_proxyCount;
+    return proxy;
+}
+
+void AABBTree::DestroyProxy(int32_t proxy)
+{
+    assert(m_nodes[proxy].IsLeaf() && m_nodes[proxy].height == 0);
+
+    RemoveLeaf(proxy);
+    FreeNode(proxy);
+    --m_proxyCount;
+}
+
+bool AABBTree::MoveProxy(int32_t proxy, const glm::vec3& min, const glm::vec3& max)
+{
+    assert(m_nodes[proxy].IsLeaf() && m_nodes[proxy].height == 0);
+
+    const glm::vec3 margin = (max - min) * FAT_MARGIN + MIN_FAT_MARGIN;
+    const glm::vec3 fatMin = min - margin;
+    const glm::vec3 fatMax = max + margin;
+
+    // still inside its fat box, unless the object shrank so much that the box is way too big for it now
+    Node& node           = m_nodes[proxy];
+    const bool contained = glm::all(glm::lessThanEqual(glm::vec3(node.min), min)) && glm::all(glm::lessThanEqual(max, glm::vec3(node.max)));
+    if(contained && SurfaceArea(node.min, node.max) <= 4.0f * SurfaceArea(fatMin, fatMax))
+        return false;
+
+    RemoveLeaf(proxy);
+    m_nodes[proxy].min = glm::vec4(fatMin, 0.0f);
+    m_nodes[proxy].max = glm::vec4(fatMax, 0.0f);
+    InsertLeaf(proxy);
+    return true;
+}
+
+void AABBTree::Refit(int32_t index)
+{
+    Node& node         = m_nodes[index];
+    const Node& child1 = m_nodes[node.child1];
+    const Node& child2 = m_nodes[node.child2];
+
+    node.min    = glm::min(child1.min, child2.min);
+    node.max    = glm::max(child1.max, child2.max);
+    node.height = 1 + glm::max(child1.height, child2.height);
+}
+
+void AABBTree::InsertLeaf(int32_t leaf)
+{
+    if(m_root == NULL_NODE)
+    {
+        m_root               = leaf;
+        m_nodes[leaf].parent = NULL_NODE;
+        return;
+    }
+
+    const glm::vec3 leafMin = m_nodes[leaf].min;
+    const glm::vec3 leafMax = m_nodes[leaf].max;
+
+    // go down to the child that makes the tree grow the least until pairing the leaf with the current node is cheaper (surface area heuristic)
+    int32_t index = m_root;
+    while(!m_nodes[index].IsLeaf())
+    {
+        const Node& node         = m_nodes[index];
+        const float area         = SurfaceArea(node.min, node.max);
+        const float combinedArea = SurfaceArea(glm::min(glm::vec3(node.min), leafMin), glm::max(glm::vec3(node.max), leafMax));
+
+        // a new parent of this node and the leaf, going further down grows this node and all of its ancestors anyway
+        const float cost            = 2.0f * combinedArea;
+        const float inheritanceCost = 2.0f * (combinedArea - area);
+
+        const auto childCost = [&](int32_t childIndex)
+        {
+            const Node& child   = m_nodes[childIndex];
+            const float grown   = SurfaceArea(glm::min(glm::vec3(child.min), leafMin), glm::max(glm::vec3(child.max), leafMax));
+            const float current = child.IsLeaf() ? 0.0f : SurfaceArea(child.min, child.max);
+            return grown - current + inheritanceCost;
+        };
+        const float cost1 = childCost(node.child1);
+        const float cost2 = childCost(node.child2);
+
+        if(cost < cost1 && cost < cost2)
+            break;
+        index = cost1 < cost2 ? node.child1 : node.child2;
+    }
+
+    const int32_t sibling   = index;
+    const int32_t oldParent = m_nodes[sibling].parent;
+    const int32_t newParent = AllocateNode();
+
+    m_nodes[newParent].parent = oldParent;
+    m_nodes[newParent].child1 = sibling;
+    m_nodes[newParent].child2 = leaf;
+    m_nodes[sibling].parent   = newParent;
+    m_nodes[leaf].parent      = newParent;
+    Refit(newParent);
+
+    if(oldParent == NULL_NODE)
+        m_root = newParent;
+    else if(m_nodes[oldParent].child1 == sibling)
+        m_nodes[oldParent].child1 = newParent;
+    else
+        m_nodes[oldParent].child2 = newParent;
+
+    // grow the ancestors and keep them balanced
+    index = m_nodes[newParent].parent;
+    while(index != NULL_NODE)
+    {
+        index = Balance(index);
+        Refit(index);
+        index = m_nodes[index].parent;
+    }
+}
+
+void AABBTree::RemoveLeaf(int32_t leaf)
+{
+    if(leaf == m_root)
+    {
+        m_root = NULL_NODE;
+        return;
+    }
+
+    const int32_t parent      = m_nodes[leaf].parent;
+    const int32_t grandParent = m_nodes[parent].parent;
+    const int32_t sibling     = m_nodes[parent].child1 == leaf ? m_nodes[parent].child2 : m_nodes[parent].child1;
+
+    // the sibling takes the place of the parent
+    FreeNode(parent);
+    m_nodes[sibling].parent = grandParent;
+    if(grandParent == NULL_NODE)
+    {
+        m_root = sibling;
+        return;
+    }
+
+    if(m_nodes[grandParent].child1 == parent)
+        m_nodes[grandParent].child1 = sibling;
+    else
+        m_nodes[grandParent].child2 = sibling;
+
+    int32_t index = grandParent;
+    while(index != NULL_NODE)
+    {
+        index = Balance(index);
+        Refit(index);
+        index = m_nodes[index].parent;
+    }
+}
+
+// rotates the higher child of a node up if the heights of its children differ by more than 1, returns the node that took the node's place
+int32_t AABBTree::Balance(int32_t a)
+{
+    if(m_nodes[a].IsLeaf() || m_nodes[a].height < 2)
+        return a;
+
+    const int32_t b           = m_nodes[a].child1;
+    const int32_t c           = m_nodes[a].child2;
+    const int32_t heightDelta = m_nodes[c].height - m_nodes[b].height;
+    if(heightDelta >= -1 && heightDelta <= 1)
+        return a;
+
+    // the higher child goes up and the node becomes its child, the node keeps the other child and the lower grandchild
+    const int32_t up        = heightDelta > 1 ? c : b;
+    const int32_t upChild1  = m_nodes[up].child1;
+    const int32_t upChild2  = m_nodes[up].child2;
+    const bool child1Higher = m_nodes[upChild1].height > m_nodes[upChild2].height;
+    const int32_t kept      = child1Higher ? upChild1 : upChild2;  // stays a child of up
+    const int32_t moved     = child1Higher ? upChild2 : upChild1;  // goes to the node
+
+    const int32_t parent = m_nodes[a].parent;
+    m_nodes[up].parent   = parent;
+    m_nodes[a].parent    = up;
+    if(parent == NULL_NODE)
+        m_root = up;
+    else if(m_nodes[parent].child1 == a)
+        m_nodes[parent].child1 = up;
+    else
+        m_nodes[parent].child2 = up;
+
+    m_nodes[up].child1    = a;
+    m_nodes[up].child2    = kept;
+    m_nodes[moved].parent = a;
+    if(up == c)
+        m_nodes[a].child2 = moved;
+    else
+        m_nodes[a].child1 = moved;
+
+    Refit(a);
+    Refit(up);
+    return up;
+}
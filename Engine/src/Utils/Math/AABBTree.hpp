@@ -0,0 +1,318 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+#include <glm/glm.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#define AABB_TREE_SSE
+#include <xmmintrin.h>
+#endif
+
+// Dynamic bounding volume hierarchy over axis aligned boxes, like the broadphase trees of physics engines
+// Leaves are inserted next to the sibling that grows the tree's surface area the least and the tree is kept balanced with rotations
+// Every leaf stores a fat box so an object that moves a little doesn't have to be reinserted, the queries test against the fat boxes
+class AABBTree
+{
+public:
+    static constexpr int32_t NULL_NODE = -1;
+
+    // a proxy is a leaf of the tree, its index stays the same until it's destroyed
+    int32_t CreateProxy(const glm::vec3& min, const glm::vec3& max, uint64_t userData);
+    void DestroyProxy(int32_t proxy);
+    // returns true if the proxy had to be reinserted because it left its fat box
+    bool MoveProxy(int32_t proxy, const glm::vec3& min, const glm::vec3& max);
+
+    [[nodiscard]] uint64_t GetUserData(int32_t proxy) const { return m_nodes[proxy].userData; }
+    [[nodiscard]] uint32_t GetProxyCount() const { return m_proxyCount; }
+    [[nodiscard]] int32_t GetHeight() const { return m_root == NULL_NODE ? 0 : m_nodes[m_root].height; }
+
+    // the queries call fn(userData) for every proxy whose fat box touches the shape
+    template<typename Fn>
+    void QueryBox(const glm::vec3& min, const glm::vec3& max, Fn fn) const;
+    template<typename Fn>
+    void QuerySphere(const glm::vec3& center, float radius, Fn fn) const;
+    template<typename Fn>
+    void QueryFrustum(std::span<const glm::vec4> planes, Fn fn) const;  // at most 8 world space planes facing inside
+    // fn(userData, distance) is called with the distance where the ray enters the fat box and returns the new max distance
+    // return distance to only look for closer hits, maxDistance to get every proxy along the ray
+    template<typename Fn>
+    void RayCast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, Fn fn) const;
+
+private:
+    static constexpr float FAT_MARGIN     = 0.1f;  // fraction of the box's size added on every side
+    static constexpr float MIN_FAT_MARGIN = 0.05f;
+    static constexpr uint32_t STACK_SIZE  = 128;   // the tree is balanced so its height stays way below this
+
+    struct Node
+    {
+        glm::vec4 min{0.0f};  // w is unused, padding for the SIMD loads
+        glm::vec4 max{0.0f};
+        uint64_t userData = 0;
+        int32_t parent    = NULL_NODE;  // next free node when the node isn't used
+        int32_t child1    = NULL_NODE;
+        int32_t child2    = NULL_NODE;
+        int32_t height    = -1;  // 0 for leaves, -1 for free nodes
+
+        [[nodiscard]] bool IsLeaf() const { return child1 == NULL_NODE; }
+    };
+
+    // the planes in groups of 4 so every group is tested at once, the unused planes always pass
+    struct FrustumPlanes
+    {
+        alignas(16) std::array<float, 8> x{};
+        alignas(16) std::array<float, 8> y{};
+        alignas(16) std::array<float, 8> z{};
+        alignas(16) std::array<float, 8> w{1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f};
+        uint32_t groupCount = 0;
+    };
+
+    enum class Containment
+    {
+        Outside,
+        Intersecting,
+        Inside
+    };
+
+    int32_t AllocateNode();
+    void FreeNode(int32_t node);
+    void InsertLeaf(int32_t leaf);
+    void RemoveLeaf(int32_t leaf);
+    int32_t Balance(int32_t node);
+    void Refit(int32_t node);  // bounds and height of an inner node from its children
+    static float SurfaceArea(const glm::vec3& min, const glm::vec3& max);
+
+    static bool Overlaps(const Node& node, const glm::vec3& min, const glm::vec3& max);
+    static bool Overlaps(const Node& node, const glm::vec3& center, float radius);
+    static bool RayHits(const Node& node, const glm::vec3& origin, const glm::vec3& invDirection, float maxDistance, float& distance);
+    static Containment Classify(const Node& node, const FrustumPlanes& planes);
+
+    template<typename Test, typename Fn>
+    void Traverse(Test test, Fn fn) const;
+
+    std::vector<Node> m_nodes;
+    int32_t m_root        = NULL_NODE;
+    int32_t m_freeList    = NULL_NODE;
+    uint32_t m_proxyCount = 0;
+};
+
+
+inline bool AABBTree::Overlaps(const Node& node, const glm::vec3& min, const glm::vec3& max)
+{
+#ifdef AABB_TREE_SSE
+    const __m128 queryMin = _mm_set_ps(0.0f, min.z, min.y, min.x);
+    const __m128 queryMax = _mm_set_ps(0.0f, max.z, max.y, max.x);
+    const __m128 overlap  = _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(&node.min.x), queryMax), _mm_cmple_ps(queryMin, _mm_loadu_ps(&node.max.x)));
+    return (_mm_movemask_ps(overlap) & 7) == 7;
+#else
+    return glm::all(glm::lessThanEqual(glm::vec3(node.min), max)) && glm::all(glm::lessThanEqual(min, glm::vec3(node.max)));
+#endif
+}
+
+inline bool AABBTree::Overlaps(const Node& node, const glm::vec3& center, float radius)
+{
+#ifdef AABB_TREE_SSE
+    const __m128 c       = _mm_set_ps(0.0f, center.z, center.y, center.x);
+    const __m128 closest = _mm_min_ps(_mm_max_ps(c, _mm_loadu_ps(&node.min.x)), _mm_loadu_ps(&node.max.x));
+    const __m128 d       = _mm_sub_ps(c, closest);
+    const __m128 d2      = _mm_mul_ps(d, d);  // w is 0 - 0
+    __m128 sum           = _mm_add_ps(d2, _mm_movehl_ps(d2, d2));
+    sum                  = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, _MM_SHUFFLE(1, 1, 1, 1)));
+    return _mm_cvtss_f32(sum) <= radius * radius;
+#else
+    const glm::vec3 d = center - glm::clamp(center, glm::vec3(node.min), glm::vec3(node.max));
+    return glm::dot(d, d) <= radius * radius;
+#endif
+}
+
+inline bool AABBTree::RayHits(const Node& node, const glm::vec3& origin, const glm::vec3& invDirection, float maxDistance, float& distance)
+{
+    // slab test, the ray enters the box at the last of the 3 near planes and leaves it at the first of the far ones
+#ifdef AABB_TREE_SSE
+    const __m128 o     = _mm_set_ps(0.0f, origin.z, origin.y, origin.x);
+    const __m128 inv   = _mm_set_ps(0.0f, invDirection.z, invDirection.y, invDirection.x);
+    const __m128 t1    = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&node.min.x), o), inv);
+    const __m128 t2    = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&node.max.x), o), inv);
+    const __m128 tNear = _mm_min_ps(t1, t2);
+    const __m128 tFar  = _mm_max_ps(t1, t2);
+
+    __m128 tEnter = _mm_max_ss(tNear, _mm_shuffle_ps(tNear, tNear, _MM_SHUFFLE(1, 1, 1, 1)));
+    tEnter        = _mm_max_ss(tEnter, _mm_shuffle_ps(tNear, tNear, _MM_SHUFFLE(2, 2, 2, 2)));
+    __m128 tExit  = _mm_min_ss(tFar, _mm_shuffle_ps(tFar, tFar, _MM_SHUFFLE(1, 1, 1, 1)));
+    tExit         = _mm_min_ss(tExit, _mm_shuffle_ps(tFar, tFar, _MM_SHUFFLE(2, 2, 2, 2)));
+
+    const float enter = glm::max(_mm_cvtss_f32(tEnter), 0.0f);
+    const float exit  = _mm_cvtss_f32(tExit);
+#else
+    const glm::vec3 t1    = (glm::vec3(node.min) - origin) * invDirection;
+    const glm::vec3 t2    = (glm::vec3(node.max) - origin) * invDirection;
+    const glm::vec3 tNear = glm::min(t1, t2);
+    const glm::vec3 tFar  = glm::max(t1, t2);
+
+    const float enter = glm::max(glm::max(tNear.x, glm::max(tNear.y, tNear.z)), 0.0f);
+    const float exit  = glm::min(tFar.x, glm::min(tFar.y, tFar.z));
+#endif
+    distance = enter;
+    return enter <= exit && enter <= maxDistance;
+}
+
+inline AABBTree::Containment AABBTree::Classify(const Node& node, const FrustumPlanes& planes)
+{
+    // the distance to a plane of the box's corners that are the farthest along and against its normal
+    bool inside = true;
+#ifdef AABB_TREE_SSE
+    const __m128 minX = _mm_set1_ps(node.min.x);
+    const __m128 minY = _mm_set1_ps(node.min.y);
+    const __m128 minZ = _mm_set1_ps(node.min.z);
+    const __m128 maxX = _mm_set1_ps(node.max.x);
+    const __m128 maxY = _mm_set1_ps(node.max.y);
+    const __m128 maxZ = _mm_set1_ps(node.max.z);
+    const __m128 zero = _mm_setzero_ps();
+    for(uint32_t group = 0; group < planes.groupCount; ++group)
+    {
+        const __m128 nx = _mm_load_ps(&planes.x[group * 4]);
+        const __m128 ny = _mm_load_ps(&planes.y[group * 4]);
+        const __m128 nz = _mm_load_ps(&planes.z[group * 4]);
+        const __m128 nw = _mm_load_ps(&planes.w[group * 4]);
+
+        const __m128 ax = _mm_mul_ps(nx, minX);
+        const __m128 bx = _mm_mul_ps(nx, maxX);
+        const __m128 ay = _mm_mul_ps(ny, minY);
+        const __m128 by = _mm_mul_ps(ny, maxY);
+        const __m128 az = _mm_mul_ps(nz, minZ);
+        const __m128 bz = _mm_mul_ps(nz, maxZ);
+
+        const __m128 farthest = _mm_add_ps(_mm_add_ps(_mm_max_ps(ax, bx), _mm_max_ps(ay, by)), _mm_add_ps(_mm_max_ps(az, bz), nw));
+        if(_mm_movemask_ps(_mm_cmplt_ps(farthest, zero)) != 0)
+            return Containment::Outside;
+
+        const __m128 closest = _mm_add_ps(_mm_add_ps(_mm_min_ps(ax, bx), _mm_min_ps(ay, by)), _mm_add_ps(_mm_min_ps(az, bz), nw));
+        inside               = inside && _mm_movemask_ps(_mm_cmplt_ps(closest, zero)) == 0;
+    }
+#else
+    for(uint32_t i = 0; i < planes.groupCount * 4; ++i)
+    {
+        const glm::vec3 a = glm::vec3(planes.x[i], planes.y[i], planes.z[i]) * glm::vec3(node.min);
+        const glm::vec3 b = glm::vec3(planes.x[i], planes.y[i], planes.z[i]) * glm::vec3(node.max);
+
+        const glm::vec3 farthest = glm::max(a, b);
+        if(farthest.x + farthest.y + farthest.z + planes.w[i] < 0.0f)
+            return Containment::Outside;
+
+        const glm::vec3 closest = glm::min(a, b);
+        inside                  = inside && closest.x + closest.y + closest.z + planes.w[i] >= 0.0f;
+    }
+#endif
+    return inside ? Containment::Inside : Containment::Intersecting;
+}
+
+template<typename Test, typename Fn>
+void AABBTree::Traverse(Test test, Fn fn) const
+{
+    if(m_root == NULL_NODE)
+        return;
+
+    std::array<int32_t, STACK_SIZE> stack;
+    uint32_t stackSize = 0;
+    stack[stackSize++] = m_root;
+    while(stackSize > 0)
+    {
+        const Node& node = m_nodes[stack[--stackSize]];
+        if(!test(node))
+            continue;
+
+        if(node.IsLeaf())
+        {
+            fn(node.userData);
+        }
+        else
+        {
+            assert(stackSize + 2 <= STACK_SIZE);
+            stack[stackSize++] = node.child1;
+            stack[stackSize++] = node.child2;
+        }
+    }
+}
+
+template<typename Fn>
+void AABBTree::QueryBox(const glm::vec3& min, const glm::vec3& max, Fn fn) const
+{
+    Traverse([&](const Node& node) { return Overlaps(node, min, max); }, fn);
+}
+
+template<typename Fn>
+void AABBTree::QuerySphere(const glm::vec3& center, float radius, Fn fn) const
+{
+    Traverse([&](const Node& node) { return Overlaps(node, center, radius); }, fn);
+}
+
+template<typename Fn>
+void AABBTree::QueryFrustum(std::span<const glm::vec4> planes, Fn fn) const
+{
+    assert(planes.size() <= 8);
+    if(m_root == NULL_NODE)
+        return;
+
+    FrustumPlanes soa;
+    for(size_t i = 0; i < planes.size(); ++i)
+    {
+        soa.x[i] = planes[i].x;
+        soa.y[i] = planes[i].y;
+        soa.z[i] = planes[i].z;
+        soa.w[i] = planes[i].w;
+    }
+    soa.groupCount = static_cast<uint32_t>((planes.size() + 3) / 4);
+
+    // the stack holds the nodes to test, a node completely inside the frustum gives all of its leaves without testing them
+    std::array<int32_t, STACK_SIZE> stack;
+    std::array<bool, STACK_SIZE> inside;
+    uint32_t stackSize = 0;
+    stack[stackSize]    = m_root;
+    inside[stackSize++] = false;
+    while(stackSize > 0)
+    {
+        --stackSize;
+        const Node& node = m_nodes[stack[stackSize]];
+        bool nodeInside  = inside[stackSize];
+        if(!nodeInside)
+        {
+            const Containment containment = Classify(node, soa);
+            if(containment == Containment::Outside)
+                continue;
+            nodeInside = containment == Containment::Inside;
+        }
+
+        if(node.IsLeaf())
+        {
+            fn(node.userData);
+        }
+        else
+        {
+            assert(stackSize + 2 <= STACK_SIZE);
+            stack[stackSize]    = node.child1;
+            inside[stackSize++] = nodeInside;
+            stack[stackSize]    = node.child2;
+            inside[stackSize++] = nodeInside;
+        }
+    }
+}
+
+template<typename Fn>
+void AABBTree::RayCast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, Fn fn) const
+{
+    // a zero direction component gives an infinite inverse, the slab test handles it
+    const glm::vec3 invDirection = 1.0f / direction;
+    Traverse(
+        [&](const Node& node)
+        {
+            float distance = 0.0f;
+            if(!RayHits(node, origin, invDirection, maxDistance, distance))
+                return false;
+            if(node.IsLeaf())
+                maxDistance = fn(node.userData, distance);
+            return !node.IsLeaf();
+        },
+        [](uint64_t /*userData*/) {});
+}
@@ -0,0 +1,176 @@
+#include "Utils/Math/AffineTransforms.hpp"
+
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <xmmintrin.h>
+#endif
+
+namespace
+{
+// the kernel is written once against these so it also builds where SSE isn't available
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+struct SSEOps
+{
+    using V                        = __m128;
+    static constexpr uint32_t LANES = 4;
+
+    static V Load(const float* p) { return _mm_load_ps(p); }
+    static void Store(float* p, V v) { _mm_store_ps(p, v); }
+    static V Set(float f) { return _mm_set1_ps(f); }
+    static V Add(V a, V b) { return _mm_add_ps(a, b); }
+    static V Sub(V a, V b) { return _mm_sub_ps(a, b); }
+    static V Mul(V a, V b) { return _mm_mul_ps(a, b); }
+};
+using BlockOps = SSEOps;
+#else
+struct ScalarOps
+{
+    using V                        = float;
+    static constexpr uint32_t LANES = 1;
+
+    static V Load(const float* p) { return *p; }
+    static void Store(float* p, V v) { *p = v; }
+    static V Set(float f) { return f; }
+    static V Add(V a, V b) { return a + b; }
+    static V Sub(V a, V b) { return a - b; }
+    static V Mul(V a, V b) { return a * b; }
+};
+using BlockOps = ScalarOps;
+#endif
+
+// inputs of a block, one array of LANES values per component
+enum Input : uint32_t
+{
+    POS_X,
+    POS_Y,
+    POS_Z,
+    ROT_X,
+    ROT_Y,
+    ROT_Z,
+    ROT_W,
+    SCALE_X,
+    SCALE_Y,
+    SCALE_Z,
+    INPUT_COUNT
+};
+constexpr uint32_t OUTPUT_COUNT = 12;  // the first three rows of the columns, the last row of an affine matrix is 0, 0, 0, 1
+
+const Transform IDENTITY = {};
+
+// outputs[column * 3 + row]
+template<typename Ops>
+void ComposeBlock(const float* inputs, const InternalTransform* parentTransform, float* outputs)
+{
+    using V                  = typename Ops::V;
+    constexpr uint32_t LANES = Ops::LANES;
+
+    const V qx = Ops::Load(inputs + ROT_X * LANES);
+    const V qy = Ops::Load(inputs + ROT_Y * LANES);
+    const V qz = Ops::Load(inputs + ROT_Z * LANES);
+    const V qw = Ops::Load(inputs + ROT_W * LANES);
+    const V sx = Ops::Load(inputs + SCALE_X * LANES);
+    const V sy = Ops::Load(inputs + SCALE_Y * LANES);
+    const V sz = Ops::Load(inputs + SCALE_Z * LANES);
+
+    // same terms as glm::mat3_cast, the factors of 2 are exact so the rotation matches it bit for bit
+    const V x2 = Ops::Add(qx, qx);
+    const V y2 = Ops::Add(qy, qy);
+    const V z2 = Ops::Add(qz, qz);
+    const V xx = Ops::Mul(qx, x2);
+    const V yy = Ops::Mul(qy, y2);
+    const V zz = Ops::Mul(qz, z2);
+    const V xy = Ops::Mul(qx, y2);
+    const V xz = Ops::Mul(qx, z2);
+    const V yz = Ops::Mul(qy, z2);
+    const V wx = Ops::Mul(qw, x2);
+    const V wy = Ops::Mul(qw, y2);
+    const V wz = Ops::Mul(qw, z2);
+
+    const V one = Ops::Set(1.0f);
+
+    // rotation * scale, the columns of the rotation scaled by the scale's components
+    V local[OUTPUT_COUNT];
+    local[0]  = Ops::Mul(Ops::Sub(one, Ops::Add(yy, zz)), sx);
+    local[1]  = Ops::Mul(Ops::Add(xy, wz), sx);
+    local[2]  = Ops::Mul(Ops::Sub(xz, wy), sx);
+    local[3]  = Ops::Mul(Ops::Sub(xy, wz), sy);
+    local[4]  = Ops::Mul(Ops::Sub(one, Ops::Add(xx, zz)), sy);
+    local[5]  = Ops::Mul(Ops::Add(yz, wx), sy);
+    local[6]  = Ops::Mul(Ops::Add(xz, wy), sz);
+    local[7]  = Ops::Mul(Ops::Sub(yz, wx), sz);
+    local[8]  = Ops::Mul(Ops::Sub(one, Ops::Add(xx, yy)), sz);
+    local[9]  = Ops::Load(inputs + POS_X * LANES);
+    local[10] = Ops::Load(inputs + POS_Y * LANES);
+    local[11] = Ops::Load(inputs + POS_Z * LANES);
+
+    if(parentTransform == nullptr)
+    {
+        for(uint32_t i = 0; i < OUTPUT_COUNT; ++i)
+            Ops::Store(outputs + i * LANES, local[i]);
+        return;
+    }
+
+    // parent * local with the terms summed in the order of glm's mat4 product, the products with the zeros of local's last row are left out
+    // so the matrices are the same as glm's bit for bit, unless the compiler is allowed to fuse the multiply adds of one of them (__FP_FAST_FMAF)
+    const glm::mat4& parent = parentTransform->worldTransform;
+    for(uint32_t column = 0; column < 4; ++column)
+    {
+        const V lx = local[column * 3 + 0];
+        const V ly = local[column * 3 + 1];
+        const V lz = local[column * 3 + 2];
+        for(uint32_t row = 0; row < 3; ++row)
+        {
+            V value = Ops::Add(Ops::Add(Ops::Mul(Ops::Set(parent[0][row]), lx), Ops::Mul(Ops::Set(parent[1][row]), ly)), Ops::Mul(Ops::Set(parent[2][row]), lz));
+            if(column == 3)
+                value = Ops::Add(value, Ops::Set(parent[3][row]));
+            Ops::Store(outputs + (column * 3 + row) * LANES, value);
+        }
+    }
+}
+}
+
+void MathUtils::ComposeWorldTransforms(const Transform* transforms, uint32_t count, const InternalTransform* parentTransform, InternalTransform* internalTransforms, uint8_t* changed)
+{
+    constexpr uint32_t LANES = BlockOps::LANES;
+
+    alignas(64) float inputs[INPUT_COUNT * LANES];
+    alignas(64) float outputs[OUTPUT_COUNT * LANES];
+    for(uint32_t first = 0; first < count; first += LANES)
+    {
+        // the lanes past the end get identity transforms and aren't written back
+        const uint32_t laneCount = std::min(count - first, LANES);
+        for(uint32_t lane = 0; lane < LANES; ++lane)
+        {
+            const Transform& transform     = lane < laneCount ? transforms[first + lane] : IDENTITY;
+            inputs[POS_X * LANES + lane]   = transform.pos.x;
+            inputs[POS_Y * LANES + lane]   = transform.pos.y;
+            inputs[POS_Z * LANES + lane]   = transform.pos.z;
+            inputs[ROT_X * LANES + lane]   = transform.rot.x;
+            inputs[ROT_Y * LANES + lane]   = transform.rot.y;
+            inputs[ROT_Z * LANES + lane]   = transform.rot.z;
+            inputs[ROT_W * LANES + lane]   = transform.rot.w;
+            inputs[SCALE_X * LANES + lane] = transform.scale.x;
+            inputs[SCALE_Y * LANES + lane] = transform.scale.y;
+            inputs[SCALE_Z * LANES + lane] = transform.scale.z;
+        }
+
+        ComposeBlock<BlockOps>(inputs, parentTransform, outputs);
+
+        for(uint32_t lane = 0; lane < laneCount; ++lane)
+        {
+            glm::mat4 worldTransform;
+            for(uint32_t column = 0; column < 4; ++column)
+            {
+                worldTransform[column] = glm::vec4(outputs[(column * 3 + 0) * LANES + lane],
+                                                   outputs[(column * 3 + 1) * LANES + lane],
+                                                   outputs[(column * 3 + 2) * LANES + lane],
+                                                   column == 3 ? 1.0f : 0.0f);
+            }
+
+            glm::mat4& current    = internalTransforms[first + lane].worldTransform;
+            changed[first + lane] = worldTransform != current ? 1 : 0;
+            current               = worldTransform;
+        }
+    }
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "ECS/CoreComponents/InternalTransform.hpp"
+#include "ECS/CoreComponents/Transform.hpp"
+#include <cstdint>
+
+namespace MathUtils
+{
+// Composes translate * rotate * scale of count transforms straight into affine matrices and multiplies them by the parent's world transform
+// Gives the same matrices as the glm products without the multiplications by the zeros of the translation, rotation and scale matrices
+// The transforms are copied to a structure of arrays in blocks so the math runs on 4 transforms at once with SSE
+// parentTransform is nullptr for the roots and has to be affine like every composition of transforms
+// changed is set to 1 for the world transforms that got a different value and to 0 for the others
+void ComposeWorldTransforms(const Transform* transforms, uint32_t count, const InternalTransform* parentTransform, InternalTransform* internalTransforms, uint8_t* changed);
+}
@@ -0,0 +1,159 @@
+#include "Utils/Math/FrustumCuller.hpp"
+#include "Core/Jobs/JobSystem.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cfloat>
+
+void FrustumCuller::Resize(uint32_t count)
+{
+    // empty boxes have min > max, the corner picked for a plane is then far behind it
+    const size_t padded = (count + BATCH_SIZE - 1) / BATCH_SIZE * BATCH_SIZE;
+    m_minX.resize(padded, FLT_MAX);
+    m_minY.resize(padded, FLT_MAX);
+    m_minZ.resize(padded, FLT_MAX);
+    m_maxX.resize(padded, -FLT_MAX);
+    m_maxY.resize(padded, -FLT_MAX);
+    m_maxZ.resize(padded, -FLT_MAX);
+    m_count = count;
+}
+
+void FrustumCuller::SetBounds(uint32_t index, const glm::vec3& min, const glm::vec3& max)
+{
+    assert(index < m_count);
+    m_minX[index] = min.x;
+    m_minY[index] = min.y;
+    m_minZ[index] = min.z;
+    m_maxX[index] = max.x;
+    m_maxY[index] = max.y;
+    m_maxZ[index] = max.z;
+}
+
+void FrustumCuller::ClearBounds(uint32_t index)
+{
+    SetBounds(index, glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX));
+}
+
+uint32_t FrustumCuller::CullRange(std::span<const glm::vec4> planes, uint32_t first, uint32_t end, uint32_t* visible) const
+{
+    // a box is behind a plane when its corner farthest along the plane's normal is, the corner only depends on the signs of the normal
+    // so every plane reads one of the min or max arrays per axis
+    struct PlaneArrays
+    {
+        const float* x;
+        const float* y;
+        const float* z;
+        glm::vec4 plane;
+    };
+    std::array<PlaneArrays, MAX_PLANES> arrays;
+    for(size_t p = 0; p < planes.size(); ++p)
+    {
+        const glm::vec4& plane = planes[p];
+        arrays[p]              = {plane.x >= 0.0f ? m_maxX.data() : m_minX.data(),
+                                  plane.y >= 0.0f ? m_maxY.data() : m_minY.data(),
+                                  plane.z >= 0.0f ? m_maxZ.data() : m_minZ.data(),
+                                  plane};
+    }
+
+    uint32_t count = 0;
+    for(uint32_t i = first; i < end; i += BATCH_SIZE)
+    {
+#if defined(FRUSTUM_CULLER_AVX2)
+        __m256 outside = _mm256_setzero_ps();
+        for(size_t p = 0; p < planes.size(); ++p)
+        {
+            const PlaneArrays& a = arrays[p];
+            __m256 d             = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(a.x + i), _mm256_set1_ps(a.plane.x)), _mm256_set1_ps(a.plane.w));
+            d                    = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(a.y + i), _mm256_set1_ps(a.plane.y)), d);
+            d                    = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(a.z + i), _mm256_set1_ps(a.plane.z)), d);
+            outside              = _mm256_or_ps(outside, _mm256_cmp_ps(d, _mm256_setzero_ps(), _CMP_LT_OQ));
+        }
+        uint32_t mask = ~static_cast<uint32_t>(_mm256_movemask_ps(outside)) & 0xFF;
+#elif defined(FRUSTUM_CULLER_SSE)
+        __m128 outsideLow  = _mm_setzero_ps();
+        __m128 outsideHigh = _mm_setzero_ps();
+        for(size_t p = 0; p < planes.size(); ++p)
+        {
+            const PlaneArrays& a = arrays[p];
+            const __m128 nx      = _mm_set1_ps(a.plane.x);
+            const __m128 ny      = _mm_set1_ps(a.plane.y);
+            const __m128 nz      = _mm_set1_ps(a.plane.z);
+            const __m128 w       = _mm_set1_ps(a.plane.w);
+
+            __m128 low  = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(a.x + i), nx), w);
+            __m128 high = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(a.x + i + 4), nx), w);
+            low         = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(a.y + i), ny), low);
+            high        = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(a.y + i + 4), ny), high);
+            low         = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(a.z + i), nz), low);
+            high        = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(a.z + i + 4), nz), high);
+            outsideLow  = _mm_or_ps(outsideLow, _mm_cmplt_ps(low, _mm_setzero_ps()));
+            outsideHigh = _mm_or_ps(outsideHigh, _mm_cmplt_ps(high, _mm_setzero_ps()));
+        }
+        const auto outside = static_cast<uint32_t>(_mm_movemask_ps(outsideLow) | (_mm_movemask_ps(outsideHigh) << 4));
+        uint32_t mask      = ~outside & 0xFF;
+#else
+        uint32_t mask = 0;
+        for(uint32_t j = 0; j < BATCH_SIZE; ++j)
+        {
+            bool inside = true;
+            for(size_t p = 0; p < planes.size() && inside; ++p)
+            {
+                const PlaneArrays& a = arrays[p];
+                inside               = a.x[i + j] * a.plane.x + a.y[i + j] * a.plane.y + a.z[i + j] * a.plane.z + a.plane.w >= 0.0f;
+            }
+            mask |= inside ? 1u << j : 0u;
+        }
+#endif
+        // the padding at the end of the arrays
+        if(end - i < BATCH_SIZE)
+            mask &= (1u << (end - i)) - 1;
+
+        while(mask != 0)
+        {
+            visible[count++] = i + static_cast<uint32_t>(std::countr_zero(mask));
+            mask &= mask - 1;
+        }
+    }
+    return count;
+}
+
+void FrustumCuller::Cull(std::span<const glm::vec4> planes, std::vector<uint32_t>& visible) const
+{
+    PROFILE_FUNCTION();
+    assert(planes.size() <= MAX_PLANES);
+
+    // every range writes its indices where its boxes would be if they were all visible, then the ranges are moved together
+    const auto offset = static_cast<uint32_t>(visible.size());
+    visible.resize(offset + m_count);
+
+    const uint32_t batchCount = (m_count + BATCH_SIZE - 1) / BATCH_SIZE;
+    const uint32_t rangeCount = std::clamp(m_count / MIN_BOXES_PER_JOB, 1u, JobSystem::GetWorkerCount() + 1);
+    if(rangeCount == 1)
+    {
+        visible.resize(offset + CullRange(planes, 0, m_count, visible.data() + offset));
+        return;
+    }
+
+    std::vector<uint32_t> rangeStarts(rangeCount + 1);
+    for(uint32_t r = 0; r <= rangeCount; ++r)
+        rangeStarts[r] = std::min(batchCount * r / rangeCount * BATCH_SIZE, m_count);
+
+    std::vector<uint32_t> rangeCounts(rangeCount);
+    const auto cullRange = [&](uint32_t r) { rangeCounts[r] = CullRange(planes, rangeStarts[r], rangeStarts[r + 1], visible.data() + offset + rangeStarts[r]); };
+    JobCounter counter;
+    for(uint32_t r = 1; r < rangeCount; ++r)
+        JobSystem::Run([&cullRange, r]() { cullRange(r); }, &counter);  // the jobs only have room for a few captures
+    cullRange(0);
+    JobSystem::Wait(counter);
+
+    // the ranges only move towards the front so copying them in order never overwrites one that wasn't moved yet
+    uint32_t count = rangeCounts[0];
+    for(uint32_t r = 1; r < rangeCount; ++r)
+    {
+        const uint32_t* rangeBegin = visible.data() + offset + rangeStarts[r];
+        std::copy(rangeBegin, rangeBegin + rangeCounts[r], visible.data() + offset + count);
+        count += rangeCounts[r];
+    }
+    visible.resize(offset + count);
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+#include <glm/glm.hpp>
+
+#if defined(__AVX2__)
+#define FRUSTUM_CULLER_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#define FRUSTUM_CULLER_SSE
+#include <xmmintrin.h>
+#endif
+
+// Frustum culling of many axis aligned boxes on the CPU, for the views the GPU culling doesn't handle and to check its results
+// The bounds are stored as a structure of arrays so a plane is tested against 8 boxes at once with AVX2 (4 at a time with SSE)
+// and big sets are split into one contiguous range per worker of the JobSystem
+class FrustumCuller
+{
+public:
+    static constexpr uint32_t MAX_PLANES = 8;
+
+    // new boxes are empty, empty boxes are never visible
+    void Resize(uint32_t count);
+    void SetBounds(uint32_t index, const glm::vec3& min, const glm::vec3& max);
+    void ClearBounds(uint32_t index);
+
+    [[nodiscard]] uint32_t GetCount() const { return m_count; }
+    [[nodiscard]] bool HasBounds(uint32_t index) const { return m_minX[index] <= m_maxX[index]; }
+
+    // appends the indices of the boxes that aren't fully behind one of the planes, in increasing order
+    // world space planes facing inside, they don't have to be normalized
+    void Cull(std::span<const glm::vec4> planes, std::vector<uint32_t>& visible) const;
+
+private:
+    static constexpr uint32_t BATCH_SIZE        = 8;       // the arrays are padded to a multiple of it
+    static constexpr uint32_t MIN_BOXES_PER_JOB = 16'384;  // smaller sets aren't worth splitting
+
+    // writes the visible indices of [first, end) to visible and returns how many there were, first is a multiple of BATCH_SIZE
+    uint32_t CullRange(std::span<const glm::vec4> planes, uint32_t first, uint32_t end, uint32_t* visible) const;
+
+    uint32_t m_count = 0;
+    std::vector<float> m_minX;
+    std::vector<float> m_minY;
+    std::vector<float> m_minZ;
+    std::vector<float> m_maxX;
+    std::vector<float> m_maxY;
+    std::vector<float> m_maxZ;
+};
@@ -0,0 +1,377 @@
+#include "Utils/MeshOptimizer.hpp"
+
+#include <algorithm>
+#include <array>
+#include <numeric>
+#include <glm/glm.hpp>
+
+#include "ECS/CoreComponents/Mesh.hpp"
+#include "Utils/TriangleAdjacency.hpp"
+
+namespace
+{
+// Forsyth's scoring uses a bigger LRU cache than what we simulate for the stats, this is what the paper recommends
+constexpr uint32_t FORSYTH_CACHE_SIZE = 32;
+constexpr uint32_t MAX_VALENCE        = 32;  // valence scores above this are clamped, they are tiny anyway
+
+constexpr float CACHE_DECAY_POWER   = 1.5f;
+constexpr float LAST_TRI_SCORE      = 0.75f;
+constexpr float VALENCE_BOOST_SCALE = 2.0f;
+constexpr float VALENCE_BOOST_POWER = 0.5f;
+
+constexpr uint32_t FETCH_CACHE_LINE_SIZE  = 64;
+constexpr uint32_t FETCH_CACHE_LINE_COUNT = 64;  // 4KB
+
+struct ScoreTables
+{
+    std::array<float, FORSYTH_CACHE_SIZE> cache{};
+    std::array<float, MAX_VALENCE + 1> valence{};
+
+    ScoreTables()
+    {
+        for(uint32_t i = 0; i < FORSYTH_CACHE_SIZE; ++i)
+        {
+            // the last triangle's vertices get a fixed score so that we don't favour the strip-like pattern too much
+            if(i < 3)
+                cache[i] = LAST_TRI_SCORE;
+            else
+                cache[i] = glm::pow(1.0f - static_cast<float>(i - 3) / static_cast<float>(FORSYTH_CACHE_SIZE - 3), CACHE_DECAY_POWER);
+        }
+
+        // valence 0 never gets looked up since vertices without remaining triangles have a fixed score of -1
+        for(uint32_t i = 1; i <= MAX_VALENCE; ++i)
+            valence[i] = VALENCE_BOOST_SCALE * glm::pow(static_cast<float>(i), -VALENCE_BOOST_POWER);
+    }
+};
+
+float VertexScore(const ScoreTables& tables, int32_t cachePosition, uint32_t remainingTriangles)
+{
+    if(remainingTriangles == 0)
+        return -1.0f;  // no triangle needs this vertex anymore
+
+    float score = cachePosition >= 0 ? tables.cache[cachePosition] : 0.0f;
+    return score + tables.valence[std::min(remainingTriangles, MAX_VALENCE)];
+}
+
+// Fifo cache simulation, a vertex is in the cache if it was loaded less than cacheSize misses ago
+class FifoCache
+{
+public:
+    FifoCache(uint32_t elementCount, uint32_t cacheSize)
+        : m_timestamps(elementCount, 0), m_cacheSize(cacheSize), m_time(cacheSize + 1) {}
+
+    // returns true on a miss
+    bool Access(uint32_t element)
+    {
+        if(m_time - m_timestamps[element] > m_cacheSize)
+        {
+            m_timestamps[element] = m_time++;
+            return true;
+        }
+        return false;
+    }
+
+    void Reset()
+    {
+        // skipping ahead invalidates every entry without having to touch the timestamps
+        m_time += m_cacheSize + 1;
+    }
+
+private:
+    std::vector<uint32_t> m_timestamps;
+    uint32_t m_cacheSize;
+    uint32_t m_time;
+};
+}
+
+namespace MeshOptimizer
+{
+void OptimizeVertexCache(std::vector<uint32_t>& indices, uint32_t vertexCount)
+{
+    PROFILE_FUNCTION();
+    assert(indices.size() % 3 == 0);
+
+    const uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+    if(triangleCount == 0)
+        return;
+
+    static const ScoreTables tables;
+
+    TriangleAdjacency adjacency(indices, vertexCount);
+    std::vector<uint32_t>& liveTriangles = adjacency.counts;  // gets decremented as triangles are emitted
+
+    std::vector<float> vertexScores(vertexCount);
+    for(uint32_t i = 0; i < vertexCount; ++i)
+        vertexScores[i] = VertexScore(tables, -1, liveTriangles[i]);
+
+    std::vector<float> triangleScores(triangleCount);
+    for(uint32_t i = 0; i < triangleCount; ++i)
+        triangleScores[i] = vertexScores[indices[i * 3 + 0]] + vertexScores[indices[i * 3 + 1]] + vertexScores[indices[i * 3 + 2]];
+
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<uint32_t> result;
+    result.reserve(indices.size());
+
+    // +3 because the new triangle gets pushed in front before the old entries get evicted
+    std::array<uint32_t, FORSYTH_CACHE_SIZE + 3> cache{};
+    std::array<uint32_t, FORSYTH_CACHE_SIZE + 3> newCache{};
+    uint32_t cacheCount = 0;
+
+    uint32_t bestTriangle = static_cast<uint32_t>(std::max_element(triangleScores.begin(), triangleScores.end()) - triangleScores.begin());
+    uint32_t inputCursor  = 0;  // used to find a new starting triangle when the cache doesn't contain any candidates
+
+    while(true)
+    {
+        const uint32_t tri[3] = {indices[bestTriangle * 3 + 0], indices[bestTriangle * 3 + 1], indices[bestTriangle * 3 + 2]};
+        result.insert(result.end(), tri, tri + 3);
+        emitted[bestTriangle] = true;
+
+        if(result.size() == indices.size())
+            break;
+
+        // remove the triangle from the adjacency of its vertices
+        for(uint32_t v : tri)
+        {
+            uint32_t* begin = adjacency.triangles.data() + adjacency.offsets[v];
+            uint32_t* end   = begin + liveTriangles[v];
+            uint32_t* it    = std::find(begin, end, bestTriangle);
+            assert(it != end);
+            std::swap(*it, *(end - 1));
+            liveTriangles[v]--;
+        }
+
+        // push the vertices of the triangle to the front of the lru cache
+        uint32_t newCacheCount = 0;
+        for(uint32_t v : tri)
+            newCache[newCacheCount++] = v;
+        for(uint32_t i = 0; i < cacheCount; ++i)
+        {
+            uint32_t v = cache[i];
+            if(v != tri[0] && v != tri[1] && v != tri[2])
+                newCache[newCacheCount++] = v;
+        }
+
+        // update the scores of everything that was touched
+        for(uint32_t i = 0; i < newCacheCount; ++i)
+        {
+            uint32_t v               = newCache[i];
+            int32_t position         = i < FORSYTH_CACHE_SIZE ? static_cast<int32_t>(i) : -1;  // the last 3 got evicted
+            float newScore           = VertexScore(tables, position, liveTriangles[v]);
+            float delta              = newScore - vertexScores[v];
+            vertexScores[v]          = newScore;
+            const uint32_t* adjBegin = adjacency.triangles.data() + adjacency.offsets[v];
+            for(uint32_t j = 0; j < liveTriangles[v]; ++j)
+                triangleScores[adjBegin[j]] += delta;
+        }
+
+        // the next triangle is the best one that uses a vertex from the cache
+        bestTriangle    = ~0u;
+        float bestScore = -1.0f;
+        for(uint32_t i = 0; i < newCacheCount; ++i)
+        {
+            uint32_t v               = newCache[i];
+            const uint32_t* adjBegin = adjacency.triangles.data() + adjacency.offsets[v];
+            for(uint32_t j = 0; j < liveTriangles[v]; ++j)
+            {
+                uint32_t t = adjBegin[j];
+                if(triangleScores[t] > bestScore)
+                {
+                    bestScore    = triangleScores[t];
+                    bestTriangle = t;
+                }
+            }
+        }
+
+        cacheCount = std::min(newCacheCount, FORSYTH_CACHE_SIZE);
+        std::copy_n(newCache.begin(), cacheCount, cache.begin());
+
+        if(bestTriangle == ~0u)
+        {
+            // nothing in the cache has triangles left, pick the next unemitted triangle in input order
+            while(emitted[inputCursor])
+                inputCursor++;
+            bestTriangle = inputCursor;
+        }
+    }
+
+    indices = std::move(result);
+}
+
+void OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, float threshold)
+{
+    PROFILE_FUNCTION();
+    assert(indices.size() % 3 == 0);
+
+    const uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+    const uint32_t vertexCount   = static_cast<uint32_t>(vertices.size());
+    if(triangleCount == 0)
+        return;
+
+    // find hard boundaries: triangles where every vertex misses the cache, starting from here has no cost for the cache
+    std::vector<uint32_t> hardClusters;
+    {
+        FifoCache cache(vertexCount, VERTEX_CACHE_SIZE);
+        for(uint32_t i = 0; i < triangleCount; ++i)
+        {
+            uint32_t misses = cache.Access(indices[i * 3 + 0]) + cache.Access(indices[i * 3 + 1]) + cache.Access(indices[i * 3 + 2]);
+            if(misses == 3)
+                hardClusters.push_back(i);
+        }
+    }
+    hardClusters.push_back(triangleCount);
+
+    // split the hard clusters further as long as the local acmr stays under the threshold
+    const float acmrLimit = AnalyzeVertexCache(indices, vertexCount).acmr * threshold;
+
+    std::vector<uint32_t> clusters;
+    {
+        FifoCache cache(vertexCount, VERTEX_CACHE_SIZE);
+        for(size_t c = 0; c + 1 < hardClusters.size(); ++c)
+        {
+            uint32_t end = hardClusters[c + 1];
+
+            uint32_t clusterStart = hardClusters[c];
+            uint32_t misses       = 0;
+            cache.Reset();
+            clusters.push_back(clusterStart);
+
+            for(uint32_t i = clusterStart; i < end; ++i)
+            {
+                misses += cache.Access(indices[i * 3 + 0]) + cache.Access(indices[i * 3 + 1]) + cache.Access(indices[i * 3 + 2]);
+
+                if(i + 1 < end && static_cast<float>(misses) / static_cast<float>(i + 1 - clusterStart) <= acmrLimit)
+                {
+                    clusterStart = i + 1;
+                    misses       = 0;
+                    cache.Reset();
+                    clusters.push_back(clusterStart);
+                }
+            }
+        }
+    }
+    clusters.push_back(triangleCount);
+
+    // sort the clusters based on how much they face away from the center of the mesh
+    glm::vec3 meshCenter(0.0f);
+    for(const Vertex& v : vertices)
+        meshCenter += v.pos;
+    meshCenter /= static_cast<float>(std::max(vertexCount, 1u));
+
+    const size_t clusterCount = clusters.size() - 1;
+    std::vector<float> sortKeys(clusterCount);
+    for(size_t c = 0; c < clusterCount; ++c)
+    {
+        glm::vec3 centroid(0.0f);
+        glm::vec3 normal(0.0f);  // length is twice the area of the cluster
+        float area = 0.0f;
+
+        for(uint32_t i = clusters[c]; i < clusters[c + 1]; ++i)
+        {
+            const glm::vec3& p0 = vertices[indices[i * 3 + 0]].pos;
+            const glm::vec3& p1 = vertices[indices[i * 3 + 1]].pos;
+            const glm::vec3& p2 = vertices[indices[i * 3 + 2]].pos;
+
+            glm::vec3 n     = glm::cross(p1 - p0, p2 - p0);
+            float triArea   = glm::length(n);
+            centroid       += (p0 + p1 + p2) / 3.0f * triArea;
+            normal         += n;
+            area           += triArea;
+        }
+
+        if(area > 0.0f)
+            centroid /= area;
+        float normalLength = glm::length(normal);
+        if(normalLength > 0.0f)
+            normal /= normalLength;
+
+        sortKeys[c] = glm::dot(centroid - meshCenter, normal);
+    }
+
+    std::vector<uint32_t> order(clusterCount);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t lhs, uint32_t rhs) { return sortKeys[lhs] > sortKeys[rhs]; });
+
+    std::vector<uint32_t> result;
+    result.reserve(indices.size());
+    for(uint32_t c : order)
+        result.insert(result.end(), indices.begin() + clusters[c] * 3, indices.begin() + clusters[c + 1] * 3);
+
+    indices = std::move(result);
+}
+
+uint32_t OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+    PROFILE_FUNCTION();
+
+    std::vector<uint32_t> remap(vertices.size(), ~0u);
+    std::vector<Vertex> result;
+    result.reserve(vertices.size());
+
+    for(uint32_t& index : indices)
+    {
+        if(remap[index] == ~0u)
+        {
+            remap[index] = static_cast<uint32_t>(result.size());
+            result.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+
+    vertices = std::move(result);
+    return static_cast<uint32_t>(vertices.size());
+}
+
+OptimizationReport OptimizeMesh(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, float overdrawThreshold)
+{
+    PROFILE_FUNCTION();
+
+    OptimizationReport report{};
+    report.cacheBefore = AnalyzeVertexCache(indices, static_cast<uint32_t>(vertices.size()));
+    report.fetchBefore = AnalyzeVertexFetch(indices, static_cast<uint32_t>(vertices.size()), sizeof(Vertex));
+
+    OptimizeVertexCache(indices, static_cast<uint32_t>(vertices.size()));
+    OptimizeOverdraw(indices, vertices, overdrawThreshold);
+    OptimizeVertexFetch(vertices, indices);
+
+    report.cacheAfter = AnalyzeVertexCache(indices, static_cast<uint32_t>(vertices.size()));
+    report.fetchAfter = AnalyzeVertexFetch(indices, static_cast<uint32_t>(vertices.size()), sizeof(Vertex));
+    return report;
+}
+
+VertexCacheStats AnalyzeVertexCache(const std::vector<uint32_t>& indices, uint32_t vertexCount, uint32_t cacheSize)
+{
+    VertexCacheStats stats{};
+    stats.triangleCount = static_cast<uint32_t>(indices.size() / 3);
+    stats.vertexCount   = vertexCount;
+
+    FifoCache cache(vertexCount, cacheSize);
+    for(uint32_t index : indices)
+        stats.verticesTransformed += cache.Access(index);
+
+    stats.acmr = stats.triangleCount == 0 ? 0.0f : static_cast<float>(stats.verticesTransformed) / static_cast<float>(stats.triangleCount);
+    stats.atvr = vertexCount == 0 ? 0.0f : static_cast<float>(stats.verticesTransformed) / static_cast<float>(vertexCount);
+    return stats;
+}
+
+VertexFetchStats AnalyzeVertexFetch(const std::vector<uint32_t>& indices, uint32_t vertexCount, uint32_t vertexSize)
+{
+    VertexFetchStats stats{};
+
+    uint32_t lineCount = (vertexCount * vertexSize + FETCH_CACHE_LINE_SIZE - 1) / FETCH_CACHE_LINE_SIZE;
+    FifoCache cache(lineCount, FETCH_CACHE_LINE_COUNT);
+
+    for(uint32_t index : indices)
+    {
+        uint32_t firstLine = (index * vertexSize) / FETCH_CACHE_LINE_SIZE;
+        uint32_t lastLine  = (index * vertexSize + vertexSize - 1) / FETCH_CACHE_LINE_SIZE;
+        for(uint32_t line = firstLine; line <= lastLine; ++line)
+        {
+            if(cache.Access(line))
+                stats.bytesFetched += FETCH_CACHE_LINE_SIZE;
+        }
+    }
+
+    stats.overfetch = vertexCount == 0 ? 0.0f : static_cast<float>(stats.bytesFetched) / static_cast<float>(vertexCount * vertexSize);
+    return stats;
+}
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+struct Vertex;
+
+// Import time mesh processing to make the meshes friendlier to the gpu's vertex pipeline
+// Every function works on a plain triangle list so they can be used on any vertex/index data, not just what comes out of assimp
+namespace MeshOptimizer
+{
+// Size of the fifo post transform cache that is simulated by the analysis functions, 16 is a conservative estimate for modern gpus
+constexpr uint32_t VERTEX_CACHE_SIZE = 16;
+
+struct VertexCacheStats
+{
+    uint32_t verticesTransformed = 0;
+    uint32_t triangleCount       = 0;
+    uint32_t vertexCount         = 0;
+
+    float acmr = 0.0f;  // average cache miss ratio: transformed vertices / triangles, lower is better (0.5 is the theoretical best)
+    float atvr = 0.0f;  // average transformed vertex ratio: transformed vertices / vertices, lower is better (1.0 is the best)
+};
+
+struct VertexFetchStats
+{
+    uint32_t bytesFetched = 0;
+    float overfetch       = 0.0f;  // bytes fetched / vertex buffer size, 1.0 is the best
+};
+
+// Reorders the triangles for post transform cache efficiency using Tom Forsyth's linear speed vertex cache optimisation
+// https://tomforsyth1000.github.io/papers/fast_vert_cache_opt.html
+void OptimizeVertexCache(std::vector<uint32_t>& indices, uint32_t vertexCount);
+
+// Splits the cache optimised triangle list into clusters and sorts them so that outward facing clusters are drawn first to reduce overdraw
+// threshold controls how much acmr we are allowed to lose (1.05 = 5% worse) in exchange of having smaller clusters that can be sorted better
+// Based on "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw" by Sander, Nehab and Barczak
+// Should be called after OptimizeVertexCache
+void OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, float threshold = 1.05f);
+
+// Reorders the vertices in the order they are first referenced by the index buffer and updates the indices to match
+// Unreferenced vertices are removed, returns the new vertex count
+// Should be called last since it depends on the final triangle order
+uint32_t OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+struct OptimizationReport
+{
+    VertexCacheStats cacheBefore;
+    VertexCacheStats cacheAfter;
+    VertexFetchStats fetchBefore;
+    VertexFetchStats fetchAfter;
+};
+
+// Runs all of the above in the correct order and returns the before/after statistics
+OptimizationReport OptimizeMesh(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, float overdrawThreshold = 1.05f);
+
+VertexCacheStats AnalyzeVertexCache(const std::vector<uint32_t>& indices, uint32_t vertexCount, uint32_t cacheSize = VERTEX_CACHE_SIZE);
+
+// Simulates fetching the vertex buffer through 64 byte cache lines
+VertexFetchStats AnalyzeVertexFetch(const std::vector<uint32_t>& indices, uint32_t vertexCount, uint32_t vertexSize);
+}
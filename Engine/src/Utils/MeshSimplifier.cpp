@@ -0,0 +1,315 @@
+#include "Utils/MeshSimplifier.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
+#include <glm/glm.hpp>
+
+#include "ECS/CoreComponents/Mesh.hpp"
+#include "Utils/MeshOptimizer.hpp"
+
+namespace
+{
+// symmetric 4x4 matrix summing the squared distances to a set of planes, doubles because the error is a difference of big numbers
+struct Quadric
+{
+    double a2 = 0.0, ab = 0.0, ac = 0.0, ad = 0.0;
+    double b2 = 0.0, bc = 0.0, bd = 0.0;
+    double c2 = 0.0, cd = 0.0;
+    double d2 = 0.0;
+
+    void AddPlane(const glm::dvec3& n, double d)
+    {
+        a2 += n.x * n.x;
+        ab += n.x * n.y;
+        ac += n.x * n.z;
+        ad += n.x * d;
+        b2 += n.y * n.y;
+        bc += n.y * n.z;
+        bd += n.y * d;
+        c2 += n.z * n.z;
+        cd += n.z * d;
+        d2 += d * d;
+    }
+
+    Quadric& operator+=(const Quadric& other)
+    {
+        a2 += other.a2;
+        ab += other.ab;
+        ac += other.ac;
+        ad += other.ad;
+        b2 += other.b2;
+        bc += other.bc;
+        bd += other.bd;
+        c2 += other.c2;
+        cd += other.cd;
+        d2 += other.d2;
+        return *this;
+    }
+
+    [[nodiscard]] double Evaluate(const glm::dvec3& p) const
+    {
+        double error = a2 * p.x * p.x + 2.0 * ab * p.x * p.y + 2.0 * ac * p.x * p.z + 2.0 * ad * p.x
+                     + b2 * p.y * p.y + 2.0 * bc * p.y * p.z + 2.0 * bd * p.y
+                     + c2 * p.z * p.z + 2.0 * cd * p.z
+                     + d2;
+        return glm::max(error, 0.0);  // can go slightly negative because of precision
+    }
+};
+
+struct Collapse
+{
+    uint32_t source;
+    uint32_t target;
+    double cost;
+};
+
+struct PositionHash
+{
+    size_t operator()(const glm::vec3& p) const
+    {
+        uint32_t bits[3];
+        std::memcpy(bits, &p, sizeof(bits));
+        return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+    }
+};
+
+// maps every vertex to the first vertex with the same position, split vertices (uv/normal seams) end up sharing one id
+std::vector<uint32_t> WeldPositions(const std::vector<Vertex>& vertices)
+{
+    std::vector<uint32_t> remap(vertices.size());
+    std::unordered_map<glm::vec3, uint32_t, PositionHash> firstVertex;
+    firstVertex.reserve(vertices.size());
+    for(uint32_t i = 0; i < vertices.size(); ++i)
+        remap[i] = firstVertex.try_emplace(vertices[i].pos, i).first->second;
+    return remap;
+}
+
+uint64_t EdgeKey(uint32_t a, uint32_t b)
+{
+    return a < b ? (static_cast<uint64_t>(a) << 32) | b : (static_cast<uint64_t>(b) << 32) | a;
+}
+
+// a collapse is rejected if it flips one of the triangles that get stretched
+bool FlipsTriangle(const std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& triangles, uint32_t source, uint32_t target)
+{
+    for(uint32_t triangle : triangles)
+    {
+        uint32_t i0 = indices[triangle * 3 + 0];
+        uint32_t i1 = indices[triangle * 3 + 1];
+        uint32_t i2 = indices[triangle * 3 + 2];
+        if(i0 == target || i1 == target || i2 == target)
+            continue;  // this one collapses
+
+        glm::vec3 p0 = vertices[i0].pos;
+        glm::vec3 p1 = vertices[i1].pos;
+        glm::vec3 p2 = vertices[i2].pos;
+
+        glm::vec3 before = glm::cross(p1 - p0, p2 - p0);
+        (i0 == source ? p0 : i1 == source ? p1 : p2) = vertices[target].pos;
+        glm::vec3 after = glm::cross(p1 - p0, p2 - p0);
+
+        if(glm::dot(before, after) <= 0.0f)
+            return true;
+    }
+    return false;
+}
+}
+
+namespace MeshSimplifier
+{
+std::vector<uint32_t> Simplify(const std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, size_t targetIndexCount, float& error)
+{
+    PROFILE_FUNCTION();
+    assert(indices.size() % 3 == 0);
+
+    const auto vertexCount = static_cast<uint32_t>(vertices.size());
+    std::vector<uint32_t> result(indices);
+    double maxCost = 0.0;
+
+    const std::vector<uint32_t> weld = WeldPositions(vertices);
+
+    // seams can't move since the vertices on the other side of the seam wouldn't follow
+    std::vector<bool> locked(vertexCount, false);
+    for(uint32_t i = 0; i < vertexCount; ++i)
+    {
+        if(weld[i] != i)
+        {
+            locked[i]       = true;
+            locked[weld[i]] = true;
+        }
+    }
+
+    // open borders can't move either or holes would grow, an edge is on the border if only one triangle uses it
+    std::unordered_map<uint64_t, uint32_t> edgeUses;
+    edgeUses.reserve(result.size());
+    for(size_t i = 0; i < result.size(); i += 3)
+    {
+        for(uint32_t k = 0; k < 3; ++k)
+            edgeUses[EdgeKey(weld[result[i + k]], weld[result[i + (k + 1) % 3]])]++;
+    }
+    for(size_t i = 0; i < result.size(); i += 3)
+    {
+        for(uint32_t k = 0; k < 3; ++k)
+        {
+            uint32_t a = result[i + k];
+            uint32_t b = result[i + (k + 1) % 3];
+            if(edgeUses[EdgeKey(weld[a], weld[b])] == 1)
+            {
+                locked[a] = true;
+                locked[b] = true;
+            }
+        }
+    }
+
+    // the quadrics live on the welded vertices so every copy of a seam vertex sees all of its planes
+    std::vector<Quadric> quadrics(vertexCount);
+    for(size_t i = 0; i < result.size(); i += 3)
+    {
+        glm::dvec3 p0(vertices[result[i + 0]].pos);
+        glm::dvec3 p1(vertices[result[i + 1]].pos);
+        glm::dvec3 p2(vertices[result[i + 2]].pos);
+
+        glm::dvec3 n  = glm::cross(p1 - p0, p2 - p0);
+        double length = glm::length(n);
+        if(length == 0.0)
+            continue;
+        n /= length;
+
+        Quadric q;
+        q.AddPlane(n, -glm::dot(n, p0));
+        for(uint32_t k = 0; k < 3; ++k)
+            quadrics[weld[result[i + k]]] += q;
+    }
+
+    std::vector<uint32_t> collapseTo(vertexCount);
+    std::vector<bool> touched(vertexCount);
+    std::vector<Collapse> collapses;
+
+    std::vector<uint32_t> adjacencyOffsets(vertexCount + 1);
+    std::vector<uint32_t> adjacency;
+    std::vector<uint32_t> vertexTriangles;
+
+    while(result.size() > targetIndexCount)
+    {
+        // vertex -> triangles
+        std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+        for(uint32_t index : result)
+            adjacencyOffsets[index + 1]++;
+        for(uint32_t i = 0; i < vertexCount; ++i)
+            adjacencyOffsets[i + 1] += adjacencyOffsets[i];
+        adjacency.resize(result.size());
+        {
+            std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+            for(uint32_t i = 0; i < result.size(); ++i)
+                adjacency[fill[result[i]]++] = i / 3;
+        }
+
+        // every edge in both directions, collapsing onto the other end keeps the vertex buffer as it is
+        collapses.clear();
+        for(size_t i = 0; i < result.size(); i += 3)
+        {
+            for(uint32_t k = 0; k < 3; ++k)
+            {
+                uint32_t a = result[i + k];
+                uint32_t b = result[i + (k + 1) % 3];
+                for(auto [source, target] : {std::pair{a, b}, std::pair{b, a}})
+                {
+                    if(locked[source])
+                        continue;
+
+                    Quadric q = quadrics[weld[source]];
+                    q        += quadrics[weld[target]];
+                    collapses.push_back({source, target, q.Evaluate(glm::dvec3(vertices[target].pos))});
+                }
+            }
+        }
+        if(collapses.empty())
+            break;
+
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& lhs, const Collapse& rhs) { return lhs.cost < rhs.cost; });
+
+        // cheapest collapses first, every vertex around a collapse is frozen until the next pass so the flip checks stay valid
+        std::iota(collapseTo.begin(), collapseTo.end(), 0);
+        std::fill(touched.begin(), touched.end(), false);
+
+        // a collapse removes about 2 triangles
+        size_t trianglesToRemove = (result.size() - targetIndexCount) / 3;
+        size_t removed           = 0;
+        for(const Collapse& collapse : collapses)
+        {
+            if(removed >= trianglesToRemove)
+                break;
+            if(touched[collapse.source] || touched[collapse.target])
+                continue;
+
+            vertexTriangles.assign(adjacency.begin() + adjacencyOffsets[collapse.source], adjacency.begin() + adjacencyOffsets[collapse.source + 1]);
+            if(FlipsTriangle(result, vertices, vertexTriangles, collapse.source, collapse.target))
+                continue;
+
+            collapseTo[collapse.source]      = collapse.target;
+            quadrics[weld[collapse.target]] += quadrics[weld[collapse.source]];
+            maxCost                          = glm::max(maxCost, collapse.cost);
+
+            for(uint32_t triangle : vertexTriangles)
+            {
+                for(uint32_t k = 0; k < 3; ++k)
+                    touched[result[triangle * 3 + k]] = true;
+            }
+            removed += 2;
+        }
+        if(removed == 0)
+            break;
+
+        // apply the collapses and drop the triangles that became degenerate
+        size_t writeIndex = 0;
+        for(size_t i = 0; i < result.size(); i += 3)
+        {
+            uint32_t a = collapseTo[result[i + 0]];
+            uint32_t b = collapseTo[result[i + 1]];
+            uint32_t c = collapseTo[result[i + 2]];
+            if(weld[a] == weld[b] || weld[b] == weld[c] || weld[a] == weld[c])
+                continue;
+
+            result[writeIndex++] = a;
+            result[writeIndex++] = b;
+            result[writeIndex++] = c;
+        }
+        result.resize(writeIndex);
+    }
+
+    // the cost is a sum of squared distances, its root is an upper bound of the distance to any of the planes
+    error = static_cast<float>(glm::sqrt(maxCost));
+    return result;
+}
+
+std::vector<MeshLod> GenerateLods(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices)
+{
+    PROFILE_FUNCTION();
+    std::vector<MeshLod> lods;
+    lods.push_back({0, static_cast<uint32_t>(indices.size()), 0.0f});
+
+    std::vector<uint32_t> previous(indices);
+    float error = 0.0f;
+    while(lods.size() < MAX_MESH_LODS)
+    {
+        size_t target = static_cast<size_t>(static_cast<float>(previous.size() / 3) * LOD_TRIANGLE_RATIO) * 3;
+
+        float lodError                   = 0.0f;
+        std::vector<uint32_t> lodIndices = Simplify(previous, vertices, target, lodError);
+        if(lodIndices.empty() || static_cast<float>(lodIndices.size()) > static_cast<float>(previous.size()) * (1.0f - LOD_MIN_REDUCTION))
+            break;
+
+        // simplifying from the previous LOD is much faster, the errors add up
+        error += lodError;
+        MeshOptimizer::OptimizeVertexCache(lodIndices, static_cast<uint32_t>(vertices.size()));
+
+        lods.push_back({static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(lodIndices.size()), error});
+        indices.insert(indices.end(), lodIndices.begin(), lodIndices.end());
+        previous = std::move(lodIndices);
+    }
+    return lods;
+}
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+struct Vertex;
+struct MeshLod;
+
+// Import time mesh simplification for the LOD chain
+// Only the index buffer is simplified, every LOD shares the vertex buffer of the full detail mesh
+namespace MeshSimplifier
+{
+// every LOD tries to halve the triangle count of the previous one
+constexpr float LOD_TRIANGLE_RATIO = 0.5f;
+
+// a LOD that removes less than this fraction of the previous one's triangles isn't worth keeping (usually means everything left is locked)
+constexpr float LOD_MIN_REDUCTION = 0.15f;
+
+// Simplifies the triangle list with quadric error metric edge collapses (Garland & Heckbert, "Surface Simplification Using Quadric Error Metrics")
+// Vertices are collapsed onto one of their neighbours so no new vertices are created
+// Vertices on open borders and attribute seams (several vertices with the same position) never move so the mesh doesn't tear
+// Stops when indices.size() <= targetIndexCount or when nothing else can be collapsed
+// error is set to an estimate of the largest distance between the result and the original surface in object space units
+std::vector<uint32_t> Simplify(const std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, size_t targetIndexCount, float& error);
+
+// Generates up to MAX_MESH_LODS LODs, the indices of LOD 1+ are appended to indices (LOD 0 is left untouched at the start)
+// The error of every LOD is relative to LOD 0 and grows with the LOD index
+std::vector<MeshLod> GenerateLods(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices);
+}
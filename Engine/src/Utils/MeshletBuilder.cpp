@@ -0,0 +1,180 @@
+#include "Utils/MeshletBuilder.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <glm/glm.hpp>
+
+#include "ECS/CoreComponents/Mesh.hpp"
+#include "Utils/TriangleAdjacency.hpp"
+
+namespace
+{
+constexpr uint8_t NOT_IN_MESHLET = 0xFF;
+static_assert(MeshletBuilder::MESHLET_MAX_VERTICES < NOT_IN_MESHLET);
+
+// if every normal is within ~84 degrees of the average one the cone can still cull something, otherwise we don't bother with it
+constexpr float MIN_CONE_DOT = 0.1f;
+}
+
+namespace MeshletBuilder
+{
+std::vector<Meshlet> BuildMeshlets(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices)
+{
+    PROFILE_FUNCTION();
+    assert(indices.size() % 3 == 0);
+
+    const auto triangleCount = static_cast<uint32_t>(indices.size() / 3);
+    const auto vertexCount   = static_cast<uint32_t>(vertices.size());
+
+    TriangleAdjacency adjacency(indices, vertexCount);
+
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<uint8_t> localIndex(vertexCount, NOT_IN_MESHLET);
+    std::vector<uint32_t> meshletVertices;
+    meshletVertices.reserve(MESHLET_MAX_VERTICES);
+
+    std::vector<uint32_t> reordered;
+    reordered.reserve(indices.size());
+    std::vector<Meshlet> meshlets;
+
+    Meshlet current{};
+
+    auto NewVertexCount = [&](uint32_t triangle)
+    {
+        uint32_t count = 0;
+        for(uint32_t k = 0; k < 3; ++k)
+            count += localIndex[indices[triangle * 3 + k]] == NOT_IN_MESHLET ? 1 : 0;
+        return count;
+    };
+
+    auto FinishMeshlet = [&]()
+    {
+        if(current.indexCount == 0)
+            return;
+
+        meshlets.push_back(current);
+        for(uint32_t v : meshletVertices)
+            localIndex[v] = NOT_IN_MESHLET;
+        meshletVertices.clear();
+
+        current             = {};
+        current.indexOffset = static_cast<uint32_t>(reordered.size());
+    };
+
+    uint32_t nextSeed = 0;
+    for(uint32_t emittedCount = 0; emittedCount < triangleCount; ++emittedCount)
+    {
+        // look for the triangle connected to the meshlet that adds the least new vertices, ties go to the earlier triangle to keep the cache order
+        uint32_t best    = std::numeric_limits<uint32_t>::max();
+        uint32_t bestNew = 4;
+        for(uint32_t v : meshletVertices)
+        {
+            for(uint32_t i = adjacency.offsets[v]; i < adjacency.offsets[v] + adjacency.counts[v]; ++i)
+            {
+                uint32_t triangle = adjacency.triangles[i];
+                if(emitted[triangle])
+                    continue;
+
+                uint32_t newVertices = NewVertexCount(triangle);
+                if(newVertices < bestNew || (newVertices == bestNew && triangle < best))
+                {
+                    best    = triangle;
+                    bestNew = newVertices;
+                }
+            }
+        }
+
+        // nothing connected, continue with the next triangle in the original order
+        if(best == std::numeric_limits<uint32_t>::max())
+        {
+            while(emitted[nextSeed])
+                ++nextSeed;
+            best    = nextSeed;
+            bestNew = NewVertexCount(best);
+        }
+
+        // the triangle doesn't fit anymore so it starts the next meshlet instead, it's still next to the previous one which keeps them coherent
+        if(meshletVertices.size() + bestNew > MESHLET_MAX_VERTICES || current.indexCount / 3 + 1 > MESHLET_MAX_TRIANGLES)
+            FinishMeshlet();
+
+        emitted[best] = true;
+        for(uint32_t k = 0; k < 3; ++k)
+        {
+            uint32_t v = indices[best * 3 + k];
+            if(localIndex[v] == NOT_IN_MESHLET)
+            {
+                localIndex[v] = static_cast<uint8_t>(meshletVertices.size());
+                meshletVertices.push_back(v);
+            }
+            reordered.push_back(v);
+        }
+        current.indexCount += 3;
+    }
+    FinishMeshlet();
+
+    indices = std::move(reordered);
+
+    for(Meshlet& meshlet : meshlets)
+        ComputeMeshletBounds(meshlet, indices, vertices);
+
+    return meshlets;
+}
+
+void ComputeMeshletBounds(Meshlet& meshlet, const std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices)
+{
+    glm::vec3 min(std::numeric_limits<float>::max());
+    glm::vec3 max(std::numeric_limits<float>::lowest());
+    for(uint32_t i = meshlet.indexOffset; i < meshlet.indexOffset + meshlet.indexCount; ++i)
+    {
+        min = glm::min(min, vertices[indices[i]].pos);
+        max = glm::max(max, vertices[indices[i]].pos);
+    }
+
+    // sphere around the aabb center, not the tightest but good enough for culling
+    meshlet.center = (min + max) * 0.5f;
+    meshlet.radius = 0.0f;
+    for(uint32_t i = meshlet.indexOffset; i < meshlet.indexOffset + meshlet.indexCount; ++i)
+        meshlet.radius = glm::max(meshlet.radius, glm::distance(meshlet.center, vertices[indices[i]].pos));
+
+    // the normal cone is built from the face normals since those are what the rasterizer uses for backface culling
+    std::vector<glm::vec3> normals;
+    normals.reserve(meshlet.indexCount / 3);
+    glm::vec3 axis(0.0f);
+    for(uint32_t i = meshlet.indexOffset; i < meshlet.indexOffset + meshlet.indexCount; i += 3)
+    {
+        const glm::vec3& p0 = vertices[indices[i + 0]].pos;
+        const glm::vec3& p1 = vertices[indices[i + 1]].pos;
+        const glm::vec3& p2 = vertices[indices[i + 2]].pos;
+
+        glm::vec3 n  = glm::cross(p1 - p0, p2 - p0);
+        float length = glm::length(n);
+        if(length == 0.0f)
+            continue;  // degenerate triangle, never rasterized
+
+        n    /= length;
+        axis += n;
+        normals.push_back(n);
+    }
+
+    meshlet.coneAxis   = glm::vec3(0.0f, 0.0f, 1.0f);
+    meshlet.coneCutoff = 1.0f;
+
+    float axisLength = glm::length(axis);
+    if(normals.empty() || axisLength == 0.0f)
+        return;
+
+    axis /= axisLength;
+
+    float minDot = 1.0f;
+    for(const glm::vec3& n : normals)
+        minDot = glm::min(minDot, glm::dot(n, axis));
+
+    if(minDot <= MIN_CONE_DOT)
+        return;
+
+    // the meshlet is backfacing if the view direction is outside the normal cone widened by 90 degrees
+    // -cos(angle + 90) = sin(angle) = sqrt(1 - cos(angle)^2)
+    meshlet.coneAxis   = axis;
+    meshlet.coneCutoff = glm::sqrt(1.0f - minDot * minDot);
+}
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+struct Vertex;
+struct Meshlet;
+
+// Splits meshes into small clusters that can be culled individually on the gpu
+namespace MeshletBuilder
+{
+// 64 vertices / 124 triangles is what most vendors recommend for mesh shaders, we use the same limits so the meshlets can be reused if we ever switch to them
+constexpr uint32_t MESHLET_MAX_VERTICES  = 64;
+constexpr uint32_t MESHLET_MAX_TRIANGLES = 124;
+
+// Greedily grows meshlets from the current triangle order, preferring triangles that add the fewest new vertices
+// Reorders the triangles in indices so that every meshlet's triangles are contiguous (Meshlet::indexOffset points into indices)
+// Should be called after MeshOptimizer::OptimizeVertexCache/OptimizeOverdraw since it mostly keeps their order
+std::vector<Meshlet> BuildMeshlets(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices);
+
+// Computes the bounding sphere and normal cone of the triangles in [indexOffset, indexOffset + indexCount)
+void ComputeMeshletBounds(Meshlet& meshlet, const std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices);
+}
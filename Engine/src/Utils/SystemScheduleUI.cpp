@@ -0,0 +1,117 @@
+#include "Utils/SystemScheduleUI.hpp"
+
+#include "Application.hpp"
+#include "ECS/Core.hpp"
+#include "ECS/System.hpp"
+
+#include <algorithm>
+#include <vector>
+
+namespace
+{
+// what a system did during the last update, from the runs of all the threads
+struct SystemActivity
+{
+    uint32_t threadCount = 0;     // threads that ran it
+    uint32_t thread      = 0;     // the first of them
+    float first          = 0.0f;  // start of the first run and end of the last one
+    float last           = 0.0f;
+    float busy           = 0.0f;  // sum of the runs, more than last - first when they overlapped
+};
+
+std::vector<SystemActivity> GetActivity(const SystemFrameRecord& record, size_t systemCount)
+{
+    std::vector<SystemActivity> activities(systemCount);
+    std::vector<uint32_t> lastThread(systemCount, ~0u);  // to count every thread once
+    for(uint32_t thread = 0; thread < record.threads.size(); ++thread)
+    {
+        for(const SystemFrameRecord::Run& run : record.threads[thread])
+        {
+            if(run.system >= systemCount)
+                continue;
+
+            SystemActivity& activity = activities[run.system];
+            if(activity.threadCount == 0)
+            {
+                activity.thread = thread;
+                activity.first  = run.start;
+                activity.last   = run.end;
+            }
+            if(lastThread[run.system] != thread)
+            {
+                lastThread[run.system] = thread;
+                ++activity.threadCount;
+            }
+            activity.first = std::min(activity.first, run.start);
+            activity.last  = std::max(activity.last, run.end);
+            activity.busy += run.end - run.start;
+        }
+    }
+    return activities;
+}
+}
+
+void SystemScheduleUI::Update()
+{
+    ImGui::PushID(this);
+
+    ECS* ecs                                     = Application::GetInstance()->GetScene()->GetECS();
+    const auto* schedule                         = ecs->GetSingleton<SystemSchedule>();
+    const SystemFrameRecord& record              = ecs->GetLastFrameRecord();
+    const std::vector<SystemActivity> activities = GetActivity(record, schedule != nullptr ? schedule->systems.size() : 0);
+    ImGui::Text("ECS threads: %u, last update %.3f ms", ecs->GetThreadCount(), record.duration);
+
+    constexpr SystemPhase PHASES[] = {SystemPhase::OnStart, SystemPhase::OnLoad, SystemPhase::PreUpdate, SystemPhase::OnUpdate, SystemPhase::PostUpdate, SystemPhase::PreRender};
+    for(SystemPhase phase : PHASES)
+    {
+        if(schedule == nullptr || std::none_of(schedule->systems.begin(), schedule->systems.end(), [phase](const SystemSchedule::Entry& entry) { return entry.phase == phase; }))
+            continue;
+
+        if(!ImGui::TreeNodeEx(GetPhaseName(phase), ImGuiTreeNodeFlags_DefaultOpen))
+            continue;
+
+        if(ImGui::BeginTable("systems", 4, ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersInnerV))
+        {
+            ImGui::TableSetupColumn("System");
+            ImGui::TableSetupColumn("Threads");
+            ImGui::TableSetupColumn("Rate");
+            ImGui::TableSetupColumn("Last update");
+            ImGui::TableHeadersRow();
+
+            for(size_t i = 0; i < schedule->systems.size(); ++i)
+            {
+                const SystemSchedule::Entry& entry = schedule->systems[i];
+                if(entry.phase != phase)
+                    continue;
+
+                ImGui::TableNextRow();
+                ImGui::TableSetColumnIndex(0);
+                ImGui::TextUnformatted(entry.name.c_str());
+                ImGui::TableSetColumnIndex(1);
+                if(entry.multiThreaded && ecs->GetThreadCount() > 1)
+                    ImGui::Text("parallel on %u", ecs->GetThreadCount());
+                else
+                    ImGui::TextUnformatted("main thread");
+                ImGui::TableSetColumnIndex(2);
+                if(entry.framerate > 0)
+                    ImGui::Text("%u Hz", entry.framerate);
+                else
+                    ImGui::TextUnformatted("every frame");
+
+                // busy time over the span of the runs, above 1 when the threads actually ran it at the same time
+                const SystemActivity& activity = activities[i];
+                ImGui::TableSetColumnIndex(3);
+                if(activity.threadCount == 0)
+                    ImGui::TextUnformatted("didn't run");
+                else if(activity.threadCount == 1)
+                    ImGui::Text("%.3f ms on thread %u", activity.busy, activity.thread);
+                else
+                    ImGui::Text("%.3f ms on %u threads, %.1fx in parallel", activity.last - activity.first, activity.threadCount, activity.busy / std::max(activity.last - activity.first, 1e-6f));
+            }
+            ImGui::EndTable();
+        }
+        ImGui::TreePop();
+    }
+
+    ImGui::PopID();
+}
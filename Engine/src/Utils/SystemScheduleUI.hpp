@@ -0,0 +1,17 @@
+#pragma once
+
+#include "Utils/DebugUIElements.hpp"
+
+// Lists the systems of the current scene's ECS by phase in the order flecs runs them and which of them are split across the ECS's threads
+// the multi threaded systems of a phase run one after the other on every thread, the others run on the main thread while the rest wait
+// next to that it shows what the last update did according to the SystemFrameRecord: which threads ran each system and whether they overlapped
+class SystemScheduleUI : public DebugUIElement
+{
+public:
+    SystemScheduleUI()
+    {
+        m_name = "System schedule";
+    }
+
+    void Update() override;
+};
@@ -0,0 +1,43 @@
+#include "Utils/TransformPacking.hpp"
+
+#include <glm/gtc/quaternion.hpp>
+
+namespace TransformPacking
+{
+AffineTransform PackAffine(const glm::mat4& transform)
+{
+    // glm matrices are column major, transform[column][row]
+    AffineTransform packed;
+    for(int row = 0; row < 3; ++row)
+        packed.rows[row] = glm::vec4(transform[0][row], transform[1][row], transform[2][row], transform[3][row]);
+    return packed;
+}
+
+RigidTransform PackRigid(const glm::mat4& transform)
+{
+    const glm::vec3 lengths(glm::length(glm::vec3(transform[0])), glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2])));
+
+    RigidTransform packed;
+    packed.pos   = glm::vec3(transform[3]);
+    packed.scale = (lengths.x + lengths.y + lengths.z) / 3.0f;
+
+    // a zero scale collapses everything to the position, the rotation doesn't matter then
+    if(lengths.x == 0.0f || lengths.y == 0.0f || lengths.z == 0.0f)
+    {
+        packed.rot = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        return packed;
+    }
+
+    // a mirrored transform gets a negative scale, the negated axes are a rotation again
+    glm::mat3 rotation(glm::vec3(transform[0]) / lengths.x, glm::vec3(transform[1]) / lengths.y, glm::vec3(transform[2]) / lengths.z);
+    if(glm::determinant(rotation) < 0.0f)
+    {
+        rotation     = -rotation;
+        packed.scale = -packed.scale;
+    }
+
+    const glm::quat q = glm::normalize(glm::quat_cast(rotation));
+    packed.rot        = glm::vec4(q.x, q.y, q.z, q.w);
+    return packed;
+}
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+// Compact formats of the world transforms in the gpu transform buffer, picked with ENGINE_GPU_TRANSFORMS (see Engine/CMakeLists.txt)
+// AFFINE_TRANSFORMS stores the first three rows of the matrix in 48 bytes instead of the 64 of a mat4, the last row of a world transform is always 0, 0, 0, 1
+// RIGID_TRANSFORMS stores a rotation, a translation and a uniform scale in 32 bytes, it is only exact for transforms without a non uniform scale
+// the shaders turn them back into a mat4 with LoadTransform in shaders/bindings.glsl
+namespace TransformPacking
+{
+struct AffineTransform
+{
+    glm::vec4 rows[3];
+};
+static_assert(sizeof(AffineTransform) == 48);
+
+struct RigidTransform
+{
+    glm::vec4 rot;  // quaternion, xyzw
+    glm::vec3 pos;
+    float scale;
+};
+static_assert(sizeof(RigidTransform) == 32);
+
+AffineTransform PackAffine(const glm::mat4& transform);
+
+// the scale is the average length of the axes, the rotation is taken from the normalized axes
+RigidTransform PackRigid(const glm::mat4& transform);
+}
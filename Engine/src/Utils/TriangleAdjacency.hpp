@@ -0,0 +1,36 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// vertex -> list of triangles using it, stored in one flat array
+// the triangles of vertex v are triangles[offsets[v]] to triangles[offsets[v] + counts[v] - 1]
+// used by the MeshOptimizer and the MeshletBuilder
+struct TriangleAdjacency
+{
+    std::vector<uint32_t> counts;
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> triangles;
+
+    TriangleAdjacency(const std::vector<uint32_t>& indices, uint32_t vertexCount)
+        : counts(vertexCount, 0), offsets(vertexCount, 0), triangles(indices.size())
+    {
+        for(uint32_t index : indices)
+            counts[index]++;
+
+        uint32_t offset = 0;
+        for(uint32_t i = 0; i < vertexCount; ++i)
+        {
+            offsets[i]  = offset;
+            offset     += counts[i];
+        }
+
+        std::fill(counts.begin(), counts.end(), 0);
+        for(uint32_t i = 0; i < indices.size(); ++i)
+        {
+            uint32_t v                          = indices[i];
+            triangles[offsets[v] + counts[v]++] = i / 3;
+        }
+    }
+};
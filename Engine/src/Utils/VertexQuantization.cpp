@@ -0,0 +1,74 @@
+#include "Utils/VertexQuantization.hpp"
+#include "ECS/CoreComponents/Mesh.hpp"
+
+#include <limits>
+#include <glm/packing.hpp>
+
+namespace VertexQuantization
+{
+QuantizationParams ComputeQuantizationParams(const std::vector<Vertex>& vertices)
+{
+    QuantizationParams params{};
+    if(vertices.empty())
+        return params;
+
+    glm::vec3 min(std::numeric_limits<float>::max());
+    glm::vec3 max(std::numeric_limits<float>::lowest());
+    for(const Vertex& v : vertices)
+    {
+        min = glm::min(min, v.pos);
+        max = glm::max(max, v.pos);
+    }
+
+    params.offset = glm::vec4(min, 0.0f);
+    params.scale  = glm::vec4(max - min, 0.0f);
+    return params;
+}
+
+std::vector<PackedVertex> PackVertices(const std::vector<Vertex>& vertices, const QuantizationParams& params)
+{
+    PROFILE_FUNCTION();
+    // flat axes (e.g. a plane) have 0 scale, everything on them quantizes to 0 which decodes back to the offset
+    glm::vec3 scale = glm::vec3(params.scale);
+    glm::vec3 invScale(scale.x > 0.0f ? 1.0f / scale.x : 0.0f,
+                       scale.y > 0.0f ? 1.0f / scale.y : 0.0f,
+                       scale.z > 0.0f ? 1.0f / scale.z : 0.0f);
+
+    std::vector<PackedVertex> packed(vertices.size());
+    for(size_t i = 0; i < vertices.size(); ++i)
+    {
+        const Vertex& v = vertices[i];
+        glm::vec3 p     = glm::clamp((v.pos - glm::vec3(params.offset)) * invScale, 0.0f, 1.0f);
+
+        packed[i].pos      = glm::uvec2(glm::packUnorm2x16(glm::vec2(p.x, p.y)), glm::packUnorm2x16(glm::vec2(p.z, 0.0f)));
+        packed[i].texCoord = glm::packHalf2x16(v.texCoord);
+        packed[i].normal   = glm::packSnorm2x16(OctEncode(v.normal));
+    }
+    return packed;
+}
+
+glm::vec2 OctEncode(glm::vec3 n)
+{
+    float l1 = glm::abs(n.x) + glm::abs(n.y) + glm::abs(n.z);
+    if(l1 == 0.0f)
+        return glm::vec2(0.0f);  // degenerate normal, decodes to +z
+
+    n /= l1;
+    glm::vec2 e(n.x, n.y);
+    if(n.z < 0.0f)
+    {
+        glm::vec2 signNotZero(e.x >= 0.0f ? 1.0f : -1.0f, e.y >= 0.0f ? 1.0f : -1.0f);
+        e = (1.0f - glm::abs(glm::vec2(e.y, e.x))) * signNotZero;
+    }
+    return e;
+}
+
+glm::vec3 OctDecode(glm::vec2 e)
+{
+    glm::vec3 n(e.x, e.y, 1.0f - glm::abs(e.x) - glm::abs(e.y));
+    float t  = glm::max(-n.z, 0.0f);
+    n.x     += n.x >= 0.0f ? -t : t;
+    n.y     += n.y >= 0.0f ? -t : t;
+    return glm::normalize(n);
+}
+}
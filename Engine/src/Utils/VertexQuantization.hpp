@@ -0,0 +1,37 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+struct Vertex;
+
+// Compact 16 byte vertex format used when the engine is built with PACKED_VERTICES (see Engine/CMakeLists.txt)
+// Halves the vertex fetch bandwidth compared to the 32 byte Vertex struct, the shaders decode it with the functions in shaders/vertex.glsl
+namespace VertexQuantization
+{
+struct PackedVertex
+{
+    glm::uvec2 pos;     // xyz: unorm16 relative to the mesh bounds, w: unused
+    uint32_t texCoord;  // half2
+    uint32_t normal;    // octahedral encoded, snorm16x2
+};
+static_assert(sizeof(PackedVertex) == 16);
+
+// Per mesh dequantization parameters, stored on the gpu indexed by objectID
+// pos = offset + unpacked * scale
+struct QuantizationParams
+{
+    glm::vec4 offset{0.0f};  // w unused
+    glm::vec4 scale{0.0f};   // w unused
+};
+
+QuantizationParams ComputeQuantizationParams(const std::vector<Vertex>& vertices);
+
+std::vector<PackedVertex> PackVertices(const std::vector<Vertex>& vertices, const QuantizationParams& params);
+
+// Octahedral normal encoding, maps a unit vector to [-1, 1]^2
+// https://knarkowicz.wordpress.com/2014/04/16/octahedron-normal-vector-encoding/
+glm::vec2 OctEncode(glm::vec3 n);
+glm::vec3 OctDecode(glm::vec2 e);
+}
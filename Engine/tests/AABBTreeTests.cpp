@@ -0,0 +1,232 @@
+#include "TestUtils.hpp"
+#include "Utils/Math/AABBTree.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <vector>
+
+// checks the queries of the AABBTree against testing every box, after building it, moving the proxies and destroying some of them
+// the timings are in AABBTreeBench
+namespace
+{
+constexpr uint32_t PROXY_COUNT = 20'000;
+constexpr float WORLD_SIZE     = 1000.0f;
+
+struct Box
+{
+    glm::vec3 min;
+    glm::vec3 max;
+    int32_t proxy = AABBTree::NULL_NODE;  // NULL_NODE once destroyed
+};
+
+Box RandomBox()
+{
+    const glm::vec3 center(RandomFloat(0.0f, WORLD_SIZE), RandomFloat(0.0f, WORLD_SIZE), RandomFloat(0.0f, WORLD_SIZE));
+    const glm::vec3 halfSize(RandomFloat(0.1f, 5.0f), RandomFloat(0.1f, 5.0f), RandomFloat(0.1f, 5.0f));
+    return {center - halfSize, center + halfSize};
+}
+
+// the tree tests the fat boxes so it can return boxes a bit outside of the query, but never more than the fat margin
+// a bit bigger than AABBTree::FAT_MARGIN and MIN_FAT_MARGIN so rounding doesn't matter
+Box FatBox(const Box& box)
+{
+    const glm::vec3 margin = (box.max - box.min) * 0.11f + 0.06f;
+    return {box.min - margin, box.max + margin};
+}
+
+bool Overlaps(const Box& box, const glm::vec3& min, const glm::vec3& max)
+{
+    return glm::all(glm::lessThanEqual(box.min, max)) && glm::all(glm::lessThanEqual(min, box.max));
+}
+
+bool Overlaps(const Box& box, const glm::vec3& center, float radius)
+{
+    const glm::vec3 d = center - glm::clamp(center, box.min, box.max);
+    return glm::dot(d, d) <= radius * radius;
+}
+
+bool Overlaps(const Box& box, std::span<const glm::vec4> planes)
+{
+    for(const glm::vec4& plane : planes)
+    {
+        const glm::vec3 farthest = glm::mix(box.min, box.max, glm::greaterThanEqual(glm::vec3(plane), glm::vec3(0.0f)));
+        if(glm::dot(glm::vec3(plane), farthest) + plane.w < 0.0f)
+            return false;
+    }
+    return true;
+}
+
+// distance along the ray where it enters the box, or a negative value if it misses it, the same slab test as the tree's
+float RayEnter(const Box& box, const glm::vec3& origin, const glm::vec3& direction)
+{
+    const glm::vec3 invDirection = 1.0f / direction;
+    const glm::vec3 t1           = (box.min - origin) * invDirection;
+    const glm::vec3 t2           = (box.max - origin) * invDirection;
+    const glm::vec3 tNear        = glm::min(t1, t2);
+    const glm::vec3 tFar         = glm::max(t1, t2);
+    const float enter            = std::max(std::max(tNear.x, std::max(tNear.y, tNear.z)), 0.0f);
+    const float exit             = std::min(tFar.x, std::min(tFar.y, tFar.z));
+    return enter <= exit ? enter : -1.0f;
+}
+
+// every box the ray hits before maxDistance has to be found once, at a distance no farther than where it enters the box
+// as it enters the fat box first, and the closest hit can't be farther than the closest box
+void CheckRayCast(const AABBTree& tree, const std::vector<Box>& boxes, const glm::vec3& origin, const glm::vec3& direction, float maxDistance)
+{
+    std::vector<std::pair<uint32_t, float>> found;
+    tree.RayCast(origin, direction, maxDistance,
+                 [&](uint64_t userData, float distance)
+                 {
+                     found.emplace_back(static_cast<uint32_t>(userData), distance);
+                     return maxDistance;
+                 });
+    std::sort(found.begin(), found.end());
+    CHECK(std::adjacent_find(found.begin(), found.end(), [](const auto& a, const auto& b) { return a.first == b.first; }) == found.end());
+
+    float closest    = maxDistance;
+    float closestFat = maxDistance;
+    size_t next      = 0;
+    for(uint32_t i = 0; i < boxes.size(); ++i)
+    {
+        const bool wasFound  = next < found.size() && found[next].first == i;
+        const float distance = wasFound ? found[next].second : 0.0f;
+        next += wasFound ? 1 : 0;
+        if(boxes[i].proxy == AABBTree::NULL_NODE)
+        {
+            CHECK(!wasFound);
+            continue;
+        }
+
+        const float enter    = RayEnter(boxes[i], origin, direction);
+        const float fatEnter = RayEnter(FatBox(boxes[i]), origin, direction);
+        if(enter >= 0.0f && enter <= maxDistance)
+        {
+            CHECK(wasFound);
+            closest = std::min(closest, enter);
+        }
+        if(fatEnter >= 0.0f)
+            closestFat = std::min(closestFat, fatEnter);
+        if(wasFound)
+            CHECK(fatEnter >= 0.0f && distance >= fatEnter - 1e-3f && distance <= maxDistance);
+        if(wasFound && enter >= 0.0f)
+            CHECK(distance <= enter + 1e-3f);
+    }
+
+    // returning the distance only keeps looking for closer hits
+    float hit = maxDistance;
+    tree.RayCast(origin, direction, maxDistance,
+                 [&](uint64_t /*userData*/, float distance)
+                 {
+                     hit = std::min(hit, distance);
+                     return distance;
+                 });
+    CHECK(hit <= closest + 1e-3f && hit >= closestFat - 1e-3f);
+}
+
+// every box that overlaps has to be found once, the others only if their fat box overlaps
+template<typename Query, typename Test>
+void CheckQuery(const std::vector<Box>& boxes, Query query, Test overlaps)
+{
+    std::vector<uint32_t> found;
+    query([&](uint64_t userData) { found.push_back(static_cast<uint32_t>(userData)); });
+    std::sort(found.begin(), found.end());
+    CHECK(std::adjacent_find(found.begin(), found.end()) == found.end());
+
+    size_t next = 0;
+    for(uint32_t i = 0; i < boxes.size(); ++i)
+    {
+        const bool wasFound = next < found.size() && found[next] == i;
+        next += wasFound ? 1 : 0;
+        if(boxes[i].proxy == AABBTree::NULL_NODE)
+        {
+            CHECK(!wasFound);
+            continue;
+        }
+        if(overlaps(boxes[i]))
+            CHECK(wasFound);
+        else if(wasFound)
+            CHECK(overlaps(FatBox(boxes[i])));
+    }
+}
+
+void CheckQueries(const AABBTree& tree, const std::vector<Box>& boxes)
+{
+    for(uint32_t i = 0; i < 20; ++i)
+    {
+        const Box query     = RandomBox();
+        const glm::vec3 min = query.min - 20.0f;
+        const glm::vec3 max = query.max + 20.0f;
+        CheckQuery(boxes, [&](auto fn) { tree.QueryBox(min, max, fn); }, [&](const Box& box) { return Overlaps(box, min, max); });
+
+        const glm::vec3 center = (query.min + query.max) * 0.5f;
+        const float radius     = RandomFloat(1.0f, 50.0f);
+        CheckQuery(boxes, [&](auto fn) { tree.QuerySphere(center, radius, fn); }, [&](const Box& box) { return Overlaps(box, center, radius); });
+
+        // the inside of a box around the center with planes that aren't axis aligned
+        std::array<glm::vec4, 6> planes;
+        for(uint32_t p = 0; p < planes.size(); ++p)
+        {
+            glm::vec3 normal(0.0f);
+            normal[p % 3]      = p < 3 ? 1.0f : -1.0f;
+            normal             = glm::normalize(normal + glm::vec3(RandomFloat(-0.3f, 0.3f), RandomFloat(-0.3f, 0.3f), RandomFloat(-0.3f, 0.3f)));
+            const float extent = RandomFloat(20.0f, 200.0f);
+            planes[p]          = glm::vec4(normal, extent - glm::dot(normal, center));
+        }
+        CheckQuery(boxes, [&](auto fn) { tree.QueryFrustum(planes, fn); }, [&](const Box& box) { return Overlaps(box, planes); });
+
+        // from outside and inside of the world, and along an axis where the other components of the inverse direction are infinite
+        const glm::vec3 direction = glm::normalize(glm::vec3(RandomFloat(-1.0f, 1.0f), RandomFloat(-1.0f, 1.0f), RandomFloat(-1.0f, 1.0f)));
+        CheckRayCast(tree, boxes, center, direction, RandomFloat(10.0f, 2000.0f));
+        CheckRayCast(tree, boxes, center - direction * WORLD_SIZE * 2.0f, direction, WORLD_SIZE * 4.0f);
+        glm::vec3 axis(0.0f);
+        axis[i % 3] = i % 2 == 0 ? 1.0f : -1.0f;
+        CheckRayCast(tree, boxes, center, axis, WORLD_SIZE);
+    }
+}
+}
+
+int main()
+{
+    std::vector<Box> boxes(PROXY_COUNT);
+    for(Box& box : boxes)
+        box = RandomBox();
+
+    AABBTree tree;
+    for(uint32_t i = 0; i < boxes.size(); ++i)
+        boxes[i].proxy = tree.CreateProxy(boxes[i].min, boxes[i].max, i);
+
+    CHECK(tree.GetProxyCount() == PROXY_COUNT);
+    CHECK(tree.GetHeight() <= 40);  // balanced, log2 of the proxy count is about 14
+    CheckQueries(tree, boxes);
+
+    // small moves stay inside the fat boxes and don't change the tree, big ones reinsert the proxies
+    for(uint32_t i = 0; i < boxes.size(); ++i)
+    {
+        Box& box               = boxes[i];
+        const bool bigMove     = i % 4 == 0;
+        const glm::vec3 offset = bigMove ? glm::vec3(RandomFloat(10.0f, 100.0f), RandomFloat(-100.0f, 100.0f), RandomFloat(-100.0f, 100.0f)) : glm::vec3(0.01f);
+
+        box.min += offset;
+        box.max += offset;
+        CHECK(tree.MoveProxy(box.proxy, box.min, box.max) == bigMove);
+    }
+    CHECK(tree.GetHeight() <= 40);
+    CheckQueries(tree, boxes);
+
+    for(uint32_t i = 0; i < boxes.size(); i += 3)
+    {
+        tree.DestroyProxy(boxes[i].proxy);
+        boxes[i].proxy = AABBTree::NULL_NODE;
+    }
+    CHECK(tree.GetProxyCount() == PROXY_COUNT - (PROXY_COUNT + 2) / 3);
+    CheckQueries(tree, boxes);
+
+    // and created again in the freed nodes
+    for(uint32_t i = 0; i < boxes.size(); i += 3)
+        boxes[i].proxy = tree.CreateProxy(boxes[i].min, boxes[i].max, i);
+    CHECK(tree.GetProxyCount() == PROXY_COUNT);
+    CheckQueries(tree, boxes);
+
+    return TestResult();
+}
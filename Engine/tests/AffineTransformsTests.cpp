@@ -0,0 +1,108 @@
+#include "TestUtils.hpp"
+#include "Utils/Math/AffineTransforms.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <glm/gtc/matrix_transform.hpp>
+#include <vector>
+
+// checks the world transforms of MathUtils::ComposeWorldTransforms and their inverses against the glm mat4 products
+// the timings are in AffineTransformsBench
+namespace
+{
+// the kernel sums the products in the order of glm's so the matrices are the same bit for bit
+// unless the compiler fuses the multiply adds of one of them, then they only match up to rounding
+#ifdef __FP_FAST_FMAF
+constexpr float COMPOSE_TOLERANCE = 1e-5f;
+constexpr float INVERSE_TOLERANCE = 1e-3f;  // the inverse amplifies the rounding by the condition number, at most 25 * 25 with these scales and a parent scaled the same way
+#else
+constexpr float COMPOSE_TOLERANCE = 0.0f;
+constexpr float INVERSE_TOLERANCE = 0.0f;
+#endif
+
+Transform RandomTransform()
+{
+    Transform transform;
+    transform.pos   = glm::vec3(RandomFloat(-100.0f, 100.0f), RandomFloat(-100.0f, 100.0f), RandomFloat(-100.0f, 100.0f));
+    transform.rot   = glm::normalize(glm::quat(RandomFloat(-1.0f, 1.0f), RandomFloat(-1.0f, 1.0f), RandomFloat(-1.0f, 1.0f), RandomFloat(-1.0f, 1.0f)));
+    transform.scale = glm::vec3(RandomFloat(0.2f, 5.0f), RandomFloat(0.2f, 5.0f), RandomFloat(0.2f, 5.0f));
+    return transform;
+}
+
+glm::mat4 ReferenceTransform(const Transform& transform)
+{
+    return glm::translate(glm::mat4(1.0f), transform.pos) * glm::mat4_cast(transform.rot) * glm::scale(glm::mat4(1.0f), transform.scale);
+}
+
+// relative to the largest value of the matrix since a value near 0 can be what's left of big terms that cancelled
+bool NearlyEqual(const glm::mat4& a, const glm::mat4& b, float tolerance)
+{
+    float scale = 1.0f;
+    for(uint32_t column = 0; column < 4; ++column)
+    {
+        for(uint32_t row = 0; row < 4; ++row)
+            scale = std::max(scale, std::abs(b[column][row]));
+    }
+    for(uint32_t column = 0; column < 4; ++column)
+    {
+        for(uint32_t row = 0; row < 4; ++row)
+        {
+            if(std::abs(a[column][row] - b[column][row]) > tolerance * scale)
+                return false;
+        }
+    }
+    return true;
+}
+
+void CheckCompose(uint32_t count, const InternalTransform* parentTransform)
+{
+    std::vector<Transform> transforms(count);
+    for(Transform& transform : transforms)
+        transform = RandomTransform();
+
+    std::vector<InternalTransform> internalTransforms(count);
+    std::vector<uint8_t> changed(count, 2);
+    MathUtils::ComposeWorldTransforms(transforms.data(), count, parentTransform, internalTransforms.data(), changed.data());
+
+    std::vector<glm::mat4> expected(count);
+    for(uint32_t i = 0; i < count; ++i)
+        expected[i] = parentTransform != nullptr ? parentTransform->worldTransform * ReferenceTransform(transforms[i]) : ReferenceTransform(transforms[i]);
+
+    for(uint32_t i = 0; i < count; ++i)
+    {
+        const glm::mat4& worldTransform = internalTransforms[i].worldTransform;
+        CHECK(changed[i] == 1);  // none of the random transforms is the identity the world transforms start with
+        CHECK(NearlyEqual(worldTransform, expected[i], COMPOSE_TOLERANCE));
+        CHECK(worldTransform[0][3] == 0.0f && worldTransform[1][3] == 0.0f && worldTransform[2][3] == 0.0f && worldTransform[3][3] == 1.0f);
+
+        CHECK(NearlyEqual(glm::inverse(worldTransform), glm::inverse(expected[i]), INVERSE_TOLERANCE));
+        CHECK(NearlyEqual(worldTransform * glm::inverse(expected[i]), glm::mat4(1.0f), 1e-3f));  // the inverse itself is only exact up to rounding
+    }
+
+    // the same transforms again give the same matrices, then only the modified ones are flagged
+    MathUtils::ComposeWorldTransforms(transforms.data(), count, parentTransform, internalTransforms.data(), changed.data());
+    for(uint32_t i = 0; i < count; ++i)
+        CHECK(changed[i] == 0);
+
+    for(uint32_t i = 0; i < count; i += 3)
+        transforms[i].pos.x += 1.0f;
+    MathUtils::ComposeWorldTransforms(transforms.data(), count, parentTransform, internalTransforms.data(), changed.data());
+    for(uint32_t i = 0; i < count; ++i)
+        CHECK(changed[i] == (i % 3 == 0 ? 1 : 0));
+}
+}
+
+int main()
+{
+    InternalTransform parent;
+    parent.worldTransform = ReferenceTransform(RandomTransform());
+
+    // counts that leave a partial last block, then enough for every kind of random transform
+    for(uint32_t count : {1u, 3u, 5u, 17u, 1000u})
+    {
+        CheckCompose(count, nullptr);
+        CheckCompose(count, &parent);
+    }
+
+    return TestResult();
+}
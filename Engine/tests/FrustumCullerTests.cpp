@@ -0,0 +1,135 @@
+#include "TestUtils.hpp"
+#include "Core/Jobs/JobSystem.hpp"
+#include "Utils/Math/FrustumCuller.hpp"
+
+#include <array>
+#include <cmath>
+#include <vector>
+
+// checks that the SIMD culling of the FrustumCuller keeps the same boxes as testing them one by one, on one thread and split over the workers
+namespace
+{
+struct Box
+{
+    glm::vec3 min;
+    glm::vec3 max;
+    bool empty = false;  // cleared, never visible
+};
+
+// distance of the box's corner farthest along the plane's normal, the box is culled when it's negative for one of the planes
+float FarthestDistance(const Box& box, const glm::vec4& plane)
+{
+    const float x = plane.x >= 0.0f ? box.max.x : box.min.x;
+    const float y = plane.y >= 0.0f ? box.max.y : box.min.y;
+    const float z = plane.z >= 0.0f ? box.max.z : box.min.z;
+    return x * plane.x + y * plane.y + z * plane.z + plane.w;
+}
+
+std::vector<uint32_t> CullScalar(const std::vector<Box>& boxes, std::span<const glm::vec4> planes)
+{
+    std::vector<uint32_t> visible;
+    for(uint32_t i = 0; i < boxes.size(); ++i)
+    {
+        bool inside = !boxes[i].empty;
+        for(size_t p = 0; p < planes.size() && inside; ++p)
+            inside = FarthestDistance(boxes[i], planes[p]) >= 0.0f;
+        if(inside)
+            visible.push_back(i);
+    }
+    return visible;
+}
+
+// a box whose corner is this close to a plane can go either way depending on how the compiler fused the multiply adds
+bool IsOnPlane(const Box& box, std::span<const glm::vec4> planes)
+{
+    for(const glm::vec4& plane : planes)
+    {
+        if(std::abs(FarthestDistance(box, plane)) < 1e-3f)
+            return true;
+    }
+    return false;
+}
+
+std::vector<Box> RandomBoxes(uint32_t count)
+{
+    std::vector<Box> boxes(count);
+    for(uint32_t i = 0; i < count; ++i)
+    {
+        const glm::vec3 center(RandomFloat(-500.0f, 500.0f), RandomFloat(-50.0f, 50.0f), RandomFloat(-500.0f, 500.0f));
+        const glm::vec3 halfSize(RandomFloat(0.1f, 5.0f), RandomFloat(0.1f, 5.0f), RandomFloat(0.1f, 5.0f));
+        boxes[i] = {center - halfSize, center + halfSize, i % 17 == 0};
+    }
+    return boxes;
+}
+
+// the 5 planes of a perspective camera at the origin like the ones DrawcullPass extracts, the far plane is infinite
+std::array<glm::vec4, 5> RandomFrustum()
+{
+    const float angle = RandomFloat(0.0f, 6.28f);
+    const glm::vec3 forward(std::cos(angle), 0.0f, std::sin(angle));
+    const glm::vec3 right(-forward.z, 0.0f, forward.x);
+    const glm::vec3 up(0.0f, 1.0f, 0.0f);
+    const float tanHalfFov = std::tan(RandomFloat(0.3f, 0.8f));
+    return {glm::vec4(glm::normalize(forward + right / tanHalfFov), 0.0f),
+            glm::vec4(glm::normalize(forward - right / tanHalfFov), 0.0f),
+            glm::vec4(glm::normalize(forward + up / tanHalfFov), 0.0f),
+            glm::vec4(glm::normalize(forward - up / tanHalfFov), 0.0f),
+            glm::vec4(forward, -0.1f)};
+}
+
+void CheckCull(uint32_t count, uint32_t frustumCount)
+{
+    const std::vector<Box> boxes = RandomBoxes(count);
+    FrustumCuller culler;
+    culler.Resize(count);
+    for(uint32_t i = 0; i < count; ++i)
+    {
+        culler.SetBounds(i, boxes[i].min, boxes[i].max);
+        if(boxes[i].empty)
+            culler.ClearBounds(i);
+    }
+    CHECK(culler.GetCount() == count);
+
+    for(uint32_t f = 0; f < frustumCount; ++f)
+    {
+        const std::array<glm::vec4, 5> planes = RandomFrustum();
+
+        // the visible boxes are appended after what the vector already holds
+        std::vector<uint32_t> visible = {count};
+        culler.Cull(planes, visible);
+        const std::vector<uint32_t> expected = CullScalar(boxes, planes);
+
+        CHECK(!visible.empty() && visible[0] == count);
+        size_t nextVisible  = 1;
+        size_t nextExpected = 0;
+        for(uint32_t i = 0; i < count; ++i)
+        {
+            const bool isVisible  = nextVisible < visible.size() && visible[nextVisible] == i;
+            const bool isExpected = nextExpected < expected.size() && expected[nextExpected] == i;
+            nextVisible += isVisible ? 1 : 0;
+            nextExpected += isExpected ? 1 : 0;
+            if(isVisible != isExpected)
+                CHECK(IsOnPlane(boxes[i], planes));
+        }
+        CHECK(nextVisible == visible.size());  // sorted and nothing past the last box
+    }
+}
+}
+
+int main()
+{
+    Log::Init();
+
+    // small counts with a partial last batch, then enough boxes to be split into a range per worker, the timings are in FrustumCullerBench
+    CheckCull(1, 10);
+    CheckCull(13, 10);
+    CheckCull(1000, 50);
+    CheckCull(100'000, 20);
+
+    JobSystem::Initialize(3);
+    CheckCull(100'000, 20);
+    CheckCull(100'003, 20);
+    JobSystem::Shutdown();
+
+    return TestResult();
+}
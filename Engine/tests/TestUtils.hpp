@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdio>
+#include <random>
+
+// Minimal helpers for the test executables, ctest runs them and a non zero exit code is a failure
+// a failed CHECK is printed and counted, main returns TestResult() so every check still runs after the first failure
+inline int g_failedChecks = 0;
+
+#define CHECK(condition)                                                                   \
+    do                                                                                     \
+    {                                                                                      \
+        if(!(condition))                                                                   \
+        {                                                                                  \
+            std::printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition);      \
+            ++g_failedChecks;                                                              \
+        }                                                                                  \
+    } while(false)
+
+inline int TestResult()
+{
+    if(g_failedChecks != 0)
+        std::printf("%d checks failed\n", g_failedChecks);
+    return g_failedChecks == 0 ? 0 : 1;
+}
+
+// the same seed every run so a failure can be reproduced
+inline std::mt19937& TestRandom()
+{
+    static std::mt19937 random(1234);
+    return random;
+}
+
+inline float RandomFloat(float min, float max)
+{
+    return std::uniform_real_distribution<float>(min, max)(TestRandom());
+}
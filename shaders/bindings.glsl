@@ -7,15 +7,59 @@
 layout (set = 0, binding = 0) uniform sampler2D textures[];
 layout (set = 0, binding = 0) uniform usampler2D texturesU[];
 layout (set = 0, binding = 0) uniform sampler2DArrayShadow shadowTextures[];
+layout (set = 0, binding = 0) uniform sampler2DShadow shadowTextures2D[];
 layout (set = 0, binding = 0) uniform samplerCube cubemapTextures[];
 layout (set = 0, binding = 1) uniform image2D storageTextures[];
 layout (set = 0, binding = 1) uniform uimage2D storageTexturesU[];
-layout(buffer_reference, buffer_reference_align=4) readonly buffer Transforms {
-    mat4 m[];
+// the world transforms, in the format Utils/TransformPacking.hpp picks with ENGINE_GPU_TRANSFORMS, read them with LoadTransform
+#if defined(AFFINE_TRANSFORMS)
+struct PackedTransform
+{
+    vec4 rows[3]; // the last row is 0, 0, 0, 1
+};
+#elif defined(RIGID_TRANSFORMS)
+struct PackedTransform
+{
+    vec4 rot;      // quaternion, xyzw
+    vec4 posScale; // xyz: translation, w: uniform scale
 };
+#else
+#define PackedTransform mat4
+#endif
+layout(buffer_reference, std430, buffer_reference_align=16) readonly buffer Transforms {
+    PackedTransform data[];
+};
+
+mat4 LoadTransform(Transforms transforms, uint objectID)
+{
+    PackedTransform t = transforms.data[objectID];
+#if defined(AFFINE_TRANSFORMS)
+    // the rows are the columns of the transpose, the mat4x3 is padded with the identity's last row
+    return mat4(transpose(mat3x4(t.rows[0], t.rows[1], t.rows[2])));
+#elif defined(RIGID_TRANSFORMS)
+    // same terms as glm::mat3_cast
+    vec4 q = t.rot;
+    vec3 q2 = q.xyz + q.xyz;
+    vec3 sq = q.xyz * q2;
+    float xy = q.x * q2.y;
+    float xz = q.x * q2.z;
+    float yz = q.y * q2.z;
+    vec3 w = q.w * q2;
+    float s = t.posScale.w;
+    return mat4(vec4(1.0 - sq.y - sq.z, xy + w.z, xz - w.y, 0.0) * s,
+                vec4(xy - w.z, 1.0 - sq.x - sq.z, yz + w.x, 0.0) * s,
+                vec4(xz + w.y, yz - w.x, 1.0 - sq.x - sq.y, 0.0) * s,
+                vec4(t.posScale.xyz, 1.0));
+#else
+    return t;
+#endif
+}
 layout(buffer_reference, buffer_reference_align=4) readonly buffer ObjectIDMap {
     uint data[];  // 0: count, 1+: maps gl_draw_id-1 to object_id
 };
+// the culled draws are split into one batch per index type (16 bit first, then 32 bit), has to match MAX_DRAWS_PER_BATCH in RenderPass.hpp
+// each batch has its own ObjectIDMap (MAX_DRAWS_PER_BATCH + 1 uints) and MAX_DRAWS_PER_BATCH draw commands
+#define MAX_DRAWS_PER_BATCH 5000
 // TODO look at alignment
 layout(buffer_reference, std430, buffer_reference_align=4) readonly buffer ShaderData;
 layout(buffer_reference, std430, buffer_reference_align=4) readonly buffer MaterialData;
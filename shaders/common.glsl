@@ -1,5 +1,9 @@
 #define MAX_LIGHTS_PER_TILE 1024
 #define TILE_SIZE 16
+#define CLUSTER_TILE_SIZE 64 // has to match Renderer.hpp
+#define CLUSTER_SLICES 32 // same
+#define CLUSTER_BIN_TILES 4 // same
+#define MAX_BIN_LIGHTS 1024 // same
 
 #define DIRECTIONAL_LIGHT 0
 #define POINT_LIGHT 1
@@ -9,6 +13,7 @@
 #define PCF_SAMPLES 64
 
 #define NUM_CASCADES 4
+#define NO_SHADOW_SLOT 0xFFFFFFFFu // has to match Renderer.hpp, the directional lights past the shadowed ones have it
 
 #define PI 3.1415926535897932384626433832795
 #define TWO_PI 6.283185307179586476925286766559
@@ -85,12 +90,20 @@ struct ShadowMatrices
     vec2 zPlanes[NUM_CASCADES]; // TODO do the cascade splits need to be per light?
 };
 
-struct TileLights
+// lights of one tile or cluster in a packed light index list
+// clusters are indexed with (tileY * tileCountX + tileX) * CLUSTER_SLICES + slice
+struct LightList
 {
-	uint count;
-	uint indices[MAX_LIGHTS_PER_TILE];
+    uint offset; // in indices, not in uints when the tiled list uses 16 bit indices
+    uint count;
 };
 
+// the depth slices are exponential: slice = log(distance) * sliceScale + sliceBias
+uint GetClusterSlice(float logDistance, float sliceScale, float sliceBias)
+{
+    return uint(clamp(floor(logDistance * sliceScale + sliceBias), 0.0, float(CLUSTER_SLICES - 1)));
+}
+
 const vec2 Poisson64[64] = vec2[](
     vec2(-0.934812, 0.366741),
     vec2(-0.918943, -0.0941496),
@@ -2,15 +2,13 @@
 #extension GL_GOOGLE_include_directive : require
 #extension GL_ARB_separate_shader_objects : enable
 #include "bindings.glsl"
-
-layout(location = 0) in vec3 inPosition;
-layout(location = 1) in vec2 inTexCoord;
-layout(location = 2) in vec3 inNormal;
+#include "vertex.glsl"
 
 layout(push_constant) uniform PushConstants {
     Transforms transformsPtr;
     ShaderData shaderDataPtr;
     ObjectIDMap objectIDMap;
+    VertexQuantization vertexQuantization;
 };
 
 layout(location = 0) out vec3 outNormal;
@@ -23,8 +21,9 @@ SHADER_DATA
 
 void main() {
     uint objectID = objectIDMap.data[gl_DrawID + 1];
-    mat4 model = transformsPtr.m[objectID];
-    outNormal = (shaderDataPtr.view * model * vec4(inNormal, 0.0)).xyz;
-    gl_Position = shaderDataPtr.viewProj * model * vec4(inPosition, 1.0);
+    mat4 model = LoadTransform(transformsPtr, objectID);
+    vec3 position = DecodePosition(vertexQuantization, objectID);
+    outNormal = (shaderDataPtr.view * model * vec4(DecodeNormal(), 0.0)).xyz;
+    gl_Position = shaderDataPtr.viewProj * model * vec4(position, 1.0);
 }
 
@@ -16,7 +16,13 @@ layout(buffer_reference, std430, buffer_reference_align=4) readonly buffer Light
     Light data[];
 };
 layout(buffer_reference, std430, buffer_reference_align=4) readonly buffer VisibleLightsBuffer {
-    TileLights data[];
+    LightList data[];
+};
+layout(buffer_reference, std430, buffer_reference_align=4) readonly buffer ClusterBuffer {
+    LightList data[];
+};
+layout(buffer_reference, std430, buffer_reference_align=4) readonly buffer LightIndexBuffer {
+    uint data[];
 };
 
 layout(buffer_reference, std430, buffer_reference_align=4) readonly buffer MaterialData
@@ -38,6 +44,16 @@ layout(buffer_reference, std430, buffer_reference_align=4) readonly buffer Shado
     ShadowMatrices data[];
 };
 
+// has to match Renderer::LocalShadowData
+struct LocalShadow
+{
+    mat4 viewProj[6]; // one per cube face for point lights, spot lights only use the first one
+    vec4 atlasRects[6]; // xy = offset, z = size in atlas uv, z = 0 when the face has no shadow
+};
+layout(buffer_reference, std430, buffer_reference_align=4) readonly buffer LocalShadowBuffer {
+    LocalShadow data[];
+};
+
 layout(buffer_reference, std430, buffer_reference_align=4) readonly buffer ShaderData {
     ivec2 viewportSize;
     ivec2 tileNums;
@@ -53,6 +69,17 @@ layout(buffer_reference, std430, buffer_reference_align=4) readonly buffer Shade
     uint BRDFLUTIndex;
 
     uint aoTextureIndex;
+
+    uint shadowAtlasIndex;
+    LocalShadowBuffer localShadowBuffer; // accessed with the shadow slot of the point and spot lights
+
+    uint useClusters; // otherwise the tiled light lists are used
+    float clusterSliceScale; // with reverse z the slice is -log(depth) * clusterSliceScale
+    uint clusterTilesX;
+    uint use16BitIndices; // of the tiled lists, two indices per uint
+    ClusterBuffer clusterBuffer;
+    LightIndexBuffer lightIndexBuffer; // the cluster lists point into it
+    LightIndexBuffer tileLightIndexBuffer; // the tile lists point into it
 };
 
 layout(push_constant) uniform PC
@@ -68,6 +95,7 @@ layout(push_constant) uniform PC
 };
 
 const float HORIZON_FADE_FACTOR = 1.3;
+const float LOCAL_SHADOW_BIAS = 0.005; // fraction of the distance to the light
 
 // tonemap from https://64.github.io/tonemapping/
 vec3 uncharted2_tonemap_partial(vec3 x)
@@ -132,6 +160,9 @@ float PCF(vec3 coords, int slot, int cascadeIndex, float radius)
 
 float CalculateShadow(Light light)
 {
+    if(light.shadowSlot == NO_SHADOW_SLOT)
+        return 1.0;
+
     int cascadeIndex = 0;
     ShadowMatrices shadowMatrices = shaderDataPtr.shadowMatricesBuffer.data[light.matricesSlot];
     for(int i = 0; i < NUM_CASCADES; ++i)
@@ -160,6 +191,45 @@ float CalculateShadow(Light light)
 
 
 
+// point and spot light shadows, read from the light's tiles in the shadow atlas
+float CalculateLocalShadow(Light light, vec3 lightToFrag)
+{
+    uint face = 0;
+    if(light.type == POINT_LIGHT)
+    {
+        // +x, -x, +y, -y, +z, -z like the faces of Renderer::UpdateShadowAtlas
+        vec3 absDir = abs(lightToFrag);
+        if(absDir.x >= absDir.y && absDir.x >= absDir.z)
+            face = lightToFrag.x >= 0.0 ? 0 : 1;
+        else if(absDir.y >= absDir.z)
+            face = lightToFrag.y >= 0.0 ? 2 : 3;
+        else
+            face = lightToFrag.z >= 0.0 ? 4 : 5;
+    }
+
+    vec4 rect = shaderDataPtr.localShadowBuffer.data[light.shadowSlot].atlasRects[face];
+    if(rect.z == 0.0)
+        return 1.0; // no tile or not rendered yet
+
+    vec4 lsPos = shaderDataPtr.localShadowBuffer.data[light.shadowSlot].viewProj[face] * vec4(worldPos, 1.0);
+    vec3 ndc = lsPos.xyz / lsPos.w;
+    vec2 uv = rect.xy + vec2(0.5 + 0.5 * ndc.x, 0.5 - 0.5 * ndc.y) * rect.z; // flipped viewport like the cascades
+    float depth = ndc.z * (1.0 + LOCAL_SHADOW_BIAS); // reverse z, bigger is closer to the light
+
+    // 3x3 PCF that stays inside of the tile so it never reads the neighbouring ones
+    uint slot = shaderDataPtr.shadowAtlasIndex;
+    float texel = 1.0 / float(textureSize(shadowTextures2D[slot], 0).x);
+    vec2 minUV = rect.xy + 0.5 * texel;
+    vec2 maxUV = rect.xy + rect.z - 0.5 * texel;
+    float sum = 0.0;
+    for(int x = -1; x <= 1; ++x)
+    {
+        for(int y = -1; y <= 1; ++y)
+            sum += texture(shadowTextures2D[slot], vec3(clamp(uv + vec2(x, y) * texel, minUV, maxUV), depth));
+    }
+    return sum / 9.0;
+}
+
 float CalculateAttenuation(Light light)
 {
     if(light.type == DIRECTIONAL_LIGHT)
@@ -179,12 +249,12 @@ float CalculateAttenuation(Light light)
             light.attenuation.constant + 0.00001);
 
     if(light.type == POINT_LIGHT)
-        return attenuation;
+        return attenuation * CalculateLocalShadow(light, lightDir);
 
 
     // SPOT_LIGHT TODO: make the spotlight's edges not be instant but smooth
     float angle = dot(lightDir, normalize(-light.direction));
-    return angle > light.cutoff ? attenuation * (1.0 -(1.0 - angle) / (1.0 - light.cutoff)) : 0.0;
+    return angle > light.cutoff ? attenuation * (1.0 -(1.0 - angle) / (1.0 - light.cutoff)) * CalculateLocalShadow(light, lightDir) : 0.0;
 
 
 }
@@ -219,7 +289,19 @@ vec3 F_SchlickRoughness(float cosTheta, vec3 F0, float roughness)
     return F0 + (max(vec3(1.0 - roughness), F0) - F0) * pow(clamp(1.0 - cosTheta, 0.0, 1.0), 5.0);
 }
 
-vec3 CookTorrance(vec3 viewDir, vec3 normal, vec3 F0, vec3 albedo, float metallic, float roughness, uint tileIndex, uint lightNum)
+// list is the offset of the tile or cluster in its light index list
+uint GetLightIndex(uint list, uint i)
+{
+    if(shaderDataPtr.useClusters != 0)
+        return shaderDataPtr.lightIndexBuffer.data[list + i];
+
+    uint index = list + i;
+    if(shaderDataPtr.use16BitIndices != 0)
+        return (shaderDataPtr.tileLightIndexBuffer.data[index / 2] >> (16 * (index & 1))) & 0xFFFF;
+    return shaderDataPtr.tileLightIndexBuffer.data[index];
+}
+
+vec3 CookTorrance(vec3 viewDir, vec3 normal, vec3 F0, vec3 albedo, float metallic, float roughness, uint lightList, uint lightNum)
 {
     vec3 Lo = vec3(0.0);
     float NdotV = clamp(dot(normal, viewDir), 0.0, 1.0);
@@ -228,7 +310,7 @@ vec3 CookTorrance(vec3 viewDir, vec3 normal, vec3 F0, vec3 albedo, float metalli
 
     for(int i = 0; i < lightNum; ++i)
     {
-        uint lightIndex = shaderDataPtr.visibleLightsBuffer.data[tileIndex].indices[i];
+        uint lightIndex = GetLightIndex(lightList, i);
 
         Light light = shaderDataPtr.lightBuffer.data[lightIndex];
         vec3 lightDir = light.type == DIRECTIONAL_LIGHT ? -light.direction : (light.position - worldPos);
@@ -277,10 +359,23 @@ vec3 GTAOMultiBounce(vec3 albedo, float ao)
 }
 
 void main() {
-    ivec2 tileID = ivec2(gl_FragCoord.xy / TILE_SIZE);
-    uint tileIndex = tileID.y * shaderDataPtr.tileNums.x + tileID.x;
-
-    uint tileLightNum = shaderDataPtr.visibleLightsBuffer.data[tileIndex].count;
+    uint lightList;
+    uint lightNum;
+    if(shaderDataPtr.useClusters != 0)
+    {
+        uvec2 tileID = uvec2(gl_FragCoord.xy) / CLUSTER_TILE_SIZE;
+        uint slice = GetClusterSlice(-log(gl_FragCoord.z), shaderDataPtr.clusterSliceScale, 0.0);
+        LightList cluster = shaderDataPtr.clusterBuffer.data[(tileID.y * shaderDataPtr.clusterTilesX + tileID.x) * CLUSTER_SLICES + slice];
+        lightList = cluster.offset;
+        lightNum = cluster.count;
+    }
+    else
+    {
+        ivec2 tileID = ivec2(gl_FragCoord.xy / TILE_SIZE);
+        LightList tile = shaderDataPtr.visibleLightsBuffer.data[tileID.y * shaderDataPtr.tileNums.x + tileID.x];
+        lightList = tile.offset;
+        lightNum = tile.count;
+    }
 
 
     //vec3 normal = GetNormalFromMap();
@@ -295,7 +390,7 @@ void main() {
 
     vec3 F0 = mix(vec3(0.04), albedo, metallic);
 
-    vec3 Lo = CookTorrance(viewDir, normal, F0, albedo, metallic, roughness, tileIndex, tileLightNum);
+    vec3 Lo = CookTorrance(viewDir, normal, F0, albedo, metallic, roughness, lightList, lightNum);
 
     vec3 irradiance = texture(cubemapTextures[shaderDataPtr.irradianceMapIndex], normal).rgb;
     vec3 r = reflect(-viewDir, normal);
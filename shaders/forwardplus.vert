@@ -2,10 +2,7 @@
 #extension GL_GOOGLE_include_directive : require
 
 #include "bindings.glsl"
-
-layout(location = 0) in vec3 inPosition;
-layout(location = 1) in vec2 inTexCoord;
-layout(location = 2) in vec3 inNormal;
+#include "vertex.glsl"
 
 layout(location = 0) out vec3 outNormal;
 layout(location = 1) out vec2 fragTexCoord;
@@ -23,16 +20,18 @@ layout(push_constant) uniform PC
     Transforms transformsPtr; // accessed with objectId
     MaterialData materialsPtr; // accessed with objectid
     ObjectIDMap objectIDMap;
+    VertexQuantization vertexQuantization;
 };
 
 void main() {
     ID  = objectIDMap.data[gl_DrawID + 1];
-    mat4 model = transformsPtr.m[ID];
+    mat4 model = LoadTransform(transformsPtr, ID);
+    vec3 position = DecodePosition(vertexQuantization, ID);
 
-    outNormal = normalize(vec3(model * vec4(inNormal, 0.0)));
+    outNormal = normalize(vec3(model * vec4(DecodeNormal(), 0.0)));
 
-    fragTexCoord = inTexCoord;
-    worldPos = (model * vec4(inPosition, 1.0)).xyz;
+    fragTexCoord = DecodeTexCoord();
+    worldPos = (model * vec4(position, 1.0)).xyz;
 
-    gl_Position = viewProj * model * vec4(inPosition, 1.0); // can't just use the tempWorldPos because we loose precision or something and depth tests start to fail
+    gl_Position = viewProj * model * vec4(position, 1.0); // can't just use the tempWorldPos because we loose precision or something and depth tests start to fail
 }
@@ -5,10 +5,7 @@
 
 #include "common.glsl"
 #include "bindings.glsl"
-
-layout(location = 0) in vec3 inPosition;
-layout(location = 1) in vec2 inTexCoord;
-layout(location = 2) in vec3 inNormal;
+#include "vertex.glsl"
 
 layout(buffer_reference, std430, buffer_reference_align=4) readonly buffer ShadowMatricesBuffer {
     ShadowMatrices data[];
@@ -19,7 +16,8 @@ layout(push_constant) uniform PushConstants {
     ShadowMatricesBuffer shadowMatricesBuffer;
     Transforms transformsPtr;
     ObjectIDMap objectIDMap;
+    VertexQuantization vertexQuantization;
 };
 void main() {
     uint objectID = objectIDMap.data[gl_DrawID + 1];
-    gl_Position = shadowMatricesBuffer.data[lightIndex].lightSpaceMatrices[gl_ViewIndex] * transformsPtr.m[objectID] * vec4(inPosition, 1.0);}
+    gl_Position = shadowMatricesBuffer.data[lightIndex].lightSpaceMatrices[gl_ViewIndex] * LoadTransform(transformsPtr, objectID) * vec4(DecodePosition(vertexQuantization, objectID), 1.0);}
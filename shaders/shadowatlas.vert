@@ -0,0 +1,23 @@
+#version 460
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : require
+
+#include "common.glsl"
+#include "bindings.glsl"
+#include "vertex.glsl"
+
+layout(buffer_reference, std430, buffer_reference_align=4) readonly buffer AtlasViewBuffer {
+    mat4 data[];
+};
+
+layout(push_constant) uniform PushConstants {
+    int viewIndex; // tile of the shadow atlas rendered by this draw
+    AtlasViewBuffer atlasViews;
+    Transforms transformsPtr;
+    ObjectIDMap objectIDMap;
+    VertexQuantization vertexQuantization;
+};
+void main() {
+    uint objectID = objectIDMap.data[gl_DrawID + 1];
+    gl_Position = atlasViews.data[viewIndex] * LoadTransform(transformsPtr, objectID) * vec4(DecodePosition(vertexQuantization, objectID), 1.0);
+}
@@ -0,0 +1,64 @@
+// vertex inputs for the passes that read the mesh vertex buffer
+// has to be included after bindings.glsl
+// with PACKED_VERTICES the vertices use the 16 byte format from Utils/VertexQuantization.hpp, use the Decode* functions instead of reading the inputs directly
+
+struct QuantizationParams
+{
+    vec4 offset; // w unused
+    vec4 scale;  // w unused
+};
+
+layout(buffer_reference, std430, buffer_reference_align=16) readonly buffer VertexQuantization {
+    QuantizationParams data[]; // accessed with objectId
+};
+
+vec3 OctDecode(vec2 e)
+{
+    vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+#ifdef PACKED_VERTICES
+layout(location = 0) in uvec2 inPosition; // xyz unorm16 relative to the mesh bounds
+layout(location = 1) in uint inTexCoord;  // half2
+layout(location = 2) in uint inNormal;    // octahedral snorm16x2
+
+vec3 DecodePosition(VertexQuantization quantization, uint objectID)
+{
+    vec3 p = vec3(unpackUnorm2x16(inPosition.x), unpackUnorm2x16(inPosition.y).x);
+    QuantizationParams params = quantization.data[objectID];
+    return params.offset.xyz + p * params.scale.xyz;
+}
+
+vec2 DecodeTexCoord()
+{
+    return unpackHalf2x16(inTexCoord);
+}
+
+vec3 DecodeNormal()
+{
+    return OctDecode(unpackSnorm2x16(inNormal));
+}
+#else
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec2 inTexCoord;
+layout(location = 2) in vec3 inNormal;
+
+vec3 DecodePosition(VertexQuantization quantization, uint objectID)
+{
+    return inPosition;
+}
+
+vec2 DecodeTexCoord()
+{
+    return inTexCoord;
+}
+
+vec3 DecodeNormal()
+{
+    return inNormal;
+}
+#endif